@@ -6,8 +6,15 @@
  * functions */
 #include <syslog.h>
 
+#include "coremap.h"
+#include "schedpol.h"
+#include "rtstack.h"
+
 // Specified number of threads for this assignment: 128
 #define NUM_THREADS 128
+// CPU affinity: 3, or the core given as the first argument
+#define CPU_AFFINITY 3
+int cpu_affinity=CPU_AFFINITY;
 
 // Structure required by pthread_create
 typedef struct
@@ -15,6 +22,17 @@ typedef struct
 	int threadIdx;
 } threadParams_t;
 
+// every thread on a THREAD_STACK stack carved from one locked arena
+// rather than an 8 MB default one, 4.5 MB for all 128 instead of 1 GB of
+// address space, high water marks printed at the end, see rtstack.h
+#define STACK_ARENA
+#define THREAD_STACK (32*1024)
+#define STARTER_STACK (64*1024)
+
+#ifdef STACK_ARENA
+rts_arena_t stacks;
+#endif
+
 // POSIX thread declarations and scheduling attributes
 pthread_t threads[NUM_THREADS];
 pthread_t startthread;
@@ -24,6 +42,8 @@ pthread_attr_t fifo_sched_attr;
 struct sched_param fifo_param;
 
 #define SCHED_POLICY SCHED_FIFO
+// or the policy given as the second argument, fifo, rr or other
+int sched_policy=SCHED_POLICY;
 
 void print_scheduling_policy(void){
 
@@ -36,7 +56,7 @@ void print_scheduling_policy(void){
       printf("Using SCHED_OTHER policy\n");
       break;
     case SCHED_RR:
-      printf("Using SCHED_RR policy\n");
+      printf("Using SCHED_RR policy, %.1lf ms quantum\n", schedpol_rr_quantum_ms(0));
       break;
     default:
       printf("Using UNKNOWN policy (%d)\n", schedType);
@@ -66,25 +86,25 @@ void set_scheduler(void){
    * by the attributes object */
   pthread_attr_setinheritsched(&fifo_sched_attr, PTHREAD_EXPLICIT_SCHED);
   
-  // Sets the scheduling policy to SCHED_FIFO
-  pthread_attr_setschedpolicy(&fifo_sched_attr, SCHED_POLICY);
+  // Sets the scheduling policy, SCHED_FIFO unless given
+  pthread_attr_setschedpolicy(&fifo_sched_attr, sched_policy);
   
   CPU_ZERO(&cpuset); // Clears the cpuset variables, so that it contains no CPU
-  cpuidx=(3);
+  cpuidx=coremap_online(cpu_affinity);  // add the CPU affinity core, if it is online, to CPU set
   CPU_SET(cpuidx, &cpuset); // Set the CPU set to the indicated cpuidx
   
   // Uses the cpuset to set the thread affinity attribute to the predefined core
   pthread_attr_setaffinity_np(&fifo_sched_attr, sizeof(cpu_set_t), &cpuset);
   
   // returns  the  maximum  priority value that can be used with the scheduling algorithm
-  max_prio = sched_get_priority_max(SCHED_POLICY);
+  max_prio = sched_get_priority_max(sched_policy);
   
   // sets the priority to the max_prio value got at the line before
   fifo_param.sched_priority = max_prio;
   
   /*  sets both the scheduling policy and parameters for the thread whose
    *  ID is specified in pid */ 
-  if(sched_setscheduler(getpid(), SCHED_POLICY, &fifo_param) < 0){
+  if(sched_setscheduler(getpid(), sched_policy, &fifo_param) < 0){
     perror("sched_setscheduler");
   }
   
@@ -121,11 +141,19 @@ void* counterThread(void* threadp)
 void starterThread(void *threadp)
 {
    int i;
+#ifdef STACK_ARENA
+   char stack_name[RTS_NAME_LEN];
+#endif
    printf("starter thread running on CPU=%d\n", sched_getcpu());
 
    for(i=0; i < NUM_THREADS; i++)
    {
        threadParams[i].threadIdx=i;
+#ifdef STACK_ARENA
+       // the attr is copied by pthread_create, so each thread gets its own
+       snprintf(stack_name, sizeof(stack_name), "thread %d", i);
+       rts_attr_stack(&stacks, &fifo_sched_attr, THREAD_STACK, stack_name);
+#endif
 
        pthread_create(&threads[i],   				// pointer to thread descriptor
                       &fifo_sched_attr,     		// use FIFO RT max priority attributes
@@ -144,9 +172,23 @@ void starterThread(void *threadp)
 
 int main(int argc, char* argv[])
 {
+    // core to run on, e.g. "./prog 7" on an 8 core board, then "./prog 7 rr"
+    // to compare the policies, policy_compare.c does that with a real load
+    if(argc > 1) cpu_affinity=atoi(argv[1]);
+    if(argc > 2 && (sched_policy=schedpol_parse(argv[2])) < 0)
+    {
+        printf("usage: fifothreads [core [fifo|rr|other]]\n");
+        exit(-1);
+    }
+
     // Sets the scheduler according to configuraiton
     set_scheduler();
 
+#ifdef STACK_ARENA
+    rts_arena_init(&stacks, NUM_THREADS+1, NUM_THREADS*rts_span(THREAD_STACK) + rts_span(STARTER_STACK));
+    rts_attr_stack(&stacks, &fifo_sched_attr, STARTER_STACK, "starter");
+#endif
+
 	// Creates the thread
     pthread_create(&startthread,   			// pointer to thread descriptor
                   &fifo_sched_attr,     	// use FIFO RT max priority attributes
@@ -155,6 +197,10 @@ int main(int argc, char* argv[])
                  );
 
     pthread_join(startthread, NULL);
+#ifdef STACK_ARENA
+    rts_report(&stacks);
+    rts_arena_free(&stacks);
+#endif
     printf("\nTEST COMPLETE\n");
 
 	closelog();
@@ -0,0 +1,300 @@
+// policy_compare.c
+//
+// SCHED_FIFO against time sliced SCHED_RR, and SCHED_OTHER, for CPU bound
+// workers sharing one core, the case the fifothreads.c threads are in.
+//
+//    policy_compare [-p fifo|rr|other|all] [-n workers] [-l ms[,ms...]] [-c core]
+//
+// Each policy runs -n workers, default 8, pinned to one core at the same
+// priority, one below the controlling thread.  Worker i burns the i-th
+// load of the -l list, cycled, in ms of its own CPU time, default 50, so
+// "-l 10,100" mixes short and long jobs.  All are released together from
+// a gate, and the report gives per worker
+//
+//    order   which place it finished in
+//    resp    release -> finish, wall clock
+//    share   fraction of its load done when the first worker finished
+//    invcs   involuntary context switches, the RR quantum expiring
+//
+// and per policy the makespan, release -> last finish, the mean and worst
+// response, and Jain's fairness index of the shares, 1.0 when every
+// worker had made the same relative progress, 1/n when one ran alone.
+// FIFO runs the workers to completion one after another, so the first of
+// them responds at once and the last after the whole makespan; RR hands
+// the core round in quanta, the size each RR worker gets from
+// sched_rr_get_interval() printed with its summary.
+//
+// FIFO and RR need root.
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "coremap.h"
+#include "schedpol.h"
+
+#define MAX_WORKERS 128
+#define MAX_LOADS 16
+#define NUM_WORKERS 8
+#define LOAD_MSEC 50
+// CPU affinity: 3, or the core given with -c
+#define CPU_AFFINITY 3
+
+typedef struct
+{
+    int idx;
+    double load_ms;
+    pthread_t thread;
+
+    double start_ms, finish_ms;     // from the release
+    double share;                   // load done at the first finish
+    long invcs;
+    double quantum_ms;              // sched_rr_get_interval, 0 unless RR
+    int order;
+} worker_t;
+
+static worker_t workers[MAX_WORKERS];
+static pthread_mutex_t gate_lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate=PTHREAD_COND_INITIALIZER;
+static int released, aborted;
+static struct timespec release;
+static int nworkers=NUM_WORKERS, finished;
+
+static double loads[MAX_LOADS]={LOAD_MSEC};
+static int nloads=1;
+
+
+static double since_ms(const struct timespec *t0, clockid_t clk)
+{
+    struct timespec now;
+
+    clock_gettime(clk, &now);
+    return (now.tv_sec - t0->tv_sec)*1000.0 + (now.tv_nsec - t0->tv_nsec)/1000000.0;
+}
+
+
+static double cpu_ms(clockid_t clk)
+{
+    struct timespec t;
+
+    clock_gettime(clk, &t);
+    return t.tv_sec*1000.0 + t.tv_nsec/1000000.0;
+}
+
+
+// every worker's progress, sampled by the first one to finish
+static void sample_shares(void)
+{
+    clockid_t clk;
+    int j;
+
+    for(j=0; j<nworkers; j++)
+    {
+        if(pthread_getcpuclockid(workers[j].thread, &clk) == 0)
+            workers[j].share=cpu_ms(clk)/workers[j].load_ms;
+        if(workers[j].share > 1.0) workers[j].share=1.0;
+    }
+}
+
+
+void *workerThread(void *workerp)
+{
+    worker_t *w=(worker_t *)workerp;
+    struct rusage ru;
+    double base;
+
+    pthread_mutex_lock(&gate_lock);
+    while(!released)
+        pthread_cond_wait(&gate, &gate_lock);
+    pthread_mutex_unlock(&gate_lock);
+    if(aborted) return NULL;
+
+    w->start_ms=since_ms(&release, CLOCK_MONOTONIC);
+    w->quantum_ms=schedpol_rr_quantum_ms(0);
+
+    // CPU time, not wall time, so preemption does not shorten the load
+    base=cpu_ms(CLOCK_THREAD_CPUTIME_ID);
+    while(cpu_ms(CLOCK_THREAD_CPUTIME_ID) - base < w->load_ms)
+        ;
+
+    w->finish_ms=since_ms(&release, CLOCK_MONOTONIC);
+    w->order=__atomic_fetch_add(&finished, 1, __ATOMIC_ACQ_REL);
+    if(w->order == 0)
+        sample_shares();
+
+    getrusage(RUSAGE_THREAD, &ru);
+    w->invcs=ru.ru_nivcsw;
+    return NULL;
+}
+
+
+static void report(int policy)
+{
+    double makespan=0.0, sum_resp=0.0, max_resp=0.0, s=0.0, s2=0.0;
+    int i;
+
+    printf("\n%s\n%6s %8s %9s %9s %6s %6s %6s\n", schedpol_name(policy),
+           "worker", "load ms", "start ms", "resp ms", "order", "share", "invcs");
+
+    for(i=0; i<nworkers; i++)
+    {
+        worker_t *w=&workers[i];
+
+        // released at 0, so the finish time is the response time
+        printf("%6d %8.1lf %9.1lf %9.1lf %6d %6.2lf %6ld\n", w->idx, w->load_ms, w->start_ms,
+               w->finish_ms, w->order+1, w->share, w->invcs);
+
+        if(w->finish_ms > makespan) makespan=w->finish_ms;
+        if(w->finish_ms > max_resp) max_resp=w->finish_ms;
+        sum_resp+=w->finish_ms;
+        s+=w->share;
+        s2+=w->share*w->share;
+    }
+
+    printf("%s: makespan %.1lf ms, response mean %.1lf max %.1lf ms, fairness %.3lf", schedpol_name(policy),
+           makespan, sum_resp/nworkers, max_resp, s2 > 0.0 ? s*s/(nworkers*s2) : 0.0);
+    if(policy == SCHED_RR)
+        printf(", quantum %.1lf ms", workers[0].quantum_ms);
+    printf("\n");
+}
+
+
+// one run of every worker under policy, returns -1 if none could be created
+static int run_policy(int policy, int core)
+{
+    struct sched_param param;
+    pthread_attr_t attr;
+    cpu_set_t cpuset;
+    int i, rc, prio;
+
+    // one below the controller, so it finishes the release before they run
+    prio=(policy == SCHED_OTHER) ? 0 : sched_get_priority_max(policy) - 1;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, policy);
+    param.sched_priority=prio;
+    pthread_attr_setschedparam(&attr, &param);
+    CPU_ZERO(&cpuset);
+    CPU_SET(core, &cpuset);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+
+    memset(workers, 0, sizeof(workers));
+    finished=0;
+    released=0;
+    aborted=0;
+
+    for(i=0; i<nworkers; i++)
+    {
+        workers[i].idx=i;
+        workers[i].load_ms=loads[i % nloads];
+        if((rc=pthread_create(&workers[i].thread, &attr, workerThread, (void *)&workers[i])) != 0)
+        {
+            printf("%s skipped, pthread_create rc=%d%s\n", schedpol_name(policy), rc, (rc == 1) ? ", needs root" : "");
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    // release the workers, or with one missing send back the ones created
+    pthread_mutex_lock(&gate_lock);
+    aborted=(i < nworkers);
+    clock_gettime(CLOCK_MONOTONIC, &release);
+    released=1;
+    pthread_cond_broadcast(&gate);
+    pthread_mutex_unlock(&gate_lock);
+
+    for(rc=i, i=0; i<rc; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    if(aborted)
+        return -1;
+    report(policy);
+    return 0;
+}
+
+
+static int parse_loads(char *spec)
+{
+    char *tok, *save;
+
+    for(nloads=0, tok=strtok_r(spec, ",", &save); tok && nloads < MAX_LOADS; tok=strtok_r(NULL, ",", &save))
+        if((loads[nloads++]=atof(tok)) <= 0.0)
+            return -1;
+    return nloads ? 0 : -1;
+}
+
+
+int main(int argc, char *argv[])
+{
+    static const int all[]={SCHED_FIFO, SCHED_RR, SCHED_OTHER};
+    struct sched_param param;
+    cpu_set_t cpuset;
+    int c, i, core, policy=-1, n=NUM_WORKERS;
+
+    core=CPU_AFFINITY;
+    while((c=getopt(argc, argv, "p:n:l:c:")) != -1)
+    {
+        switch(c)
+        {
+            case 'p':
+                if(strcmp(optarg, "all") != 0 && (policy=schedpol_parse(optarg)) < 0)
+                {
+                    printf("unknown policy %s\n", optarg);
+                    exit(-1);
+                }
+                break;
+            case 'n': n=atoi(optarg); break;
+            case 'l':
+                if(parse_loads(optarg) != 0)
+                {
+                    printf("loads are ms > 0, comma separated\n");
+                    exit(-1);
+                }
+                break;
+            case 'c': core=atoi(optarg); break;
+            default:
+                printf("usage: policy_compare [-p fifo|rr|other|all] [-n workers] [-l ms[,ms...]] [-c core]\n");
+                exit(-1);
+        }
+    }
+
+    if(n < 1 || n > MAX_WORKERS)
+    {
+        printf("need 1..%d workers\n", MAX_WORKERS);
+        exit(-1);
+    }
+
+    // the controller on the same core, above every worker
+    core=coremap_online(core);
+    CPU_ZERO(&cpuset);
+    CPU_SET(core, &cpuset);
+    if(sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) != 0)
+        perror("sched_setaffinity");
+    param.sched_priority=sched_get_priority_max(SCHED_FIFO);
+    if(sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+        perror("sched_setscheduler, controller not SCHED_FIFO");
+
+    printf("%d workers on core %d, loads", n, core);
+    for(i=0; i<nloads; i++)
+        printf("%s%.1lf", i ? "," : " ", loads[i]);
+    printf(" ms\n");
+
+    for(i=0; i<3; i++)
+    {
+        if(policy >= 0 && all[i] != policy) continue;
+        nworkers=n;
+        run_policy(all[i], core);
+    }
+
+    printf("\nTEST COMPLETE\n");
+    return 0;
+}
@@ -0,0 +1,223 @@
+// reduce_bench.c
+//
+// The counterThread sums done as one real reduction: sum 1..N split over
+// 1, 2, 4 .. 128 threads with preduce.h, for the same three policies as
+// thread_bench.c, SCHED_OTHER, SCHED_FIFO and SCHED_FIFO pinned to one
+// core.
+//
+//    reduce_bench [-N elements] [-n max threads] [-r runs] [-c core]
+//
+// Each thread count runs -r times, default 5, in four ways
+//
+//    packed    running total stored per element, slots packed 8 bytes
+//              apart, the false sharing a threadParams write back gets
+//    padded    the same stores into cache line aligned slots
+//    tree      register sum stored once, slots combined by a join tree
+//    atomic    register sum stored once, atomic add to one total
+//
+// and reports the average time, the speedup over one thread of the same
+// kind, and elements per second.  Every result is checked against
+// N(N+1)/2.  The pinned runs cannot scale, all threads share the core;
+// the others scale up to the online core count.  SCHED_FIFO needs root.
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/sysinfo.h>
+
+#include "coremap.h"
+#include "tstamp.h"
+#include "preduce.h"
+
+// Specified number of threads for the assignments: 128
+#define NUM_THREADS 128
+#define NUM_RUNS 5
+#define NUM_ELEMENTS (1ULL << 26)
+// CPU affinity for the pinned runs: 3, or the core given with -c
+#define CPU_AFFINITY 3
+
+typedef struct
+{
+    const char *name;
+    int policy;
+    int pinned;
+} bench_policy_t;
+
+static const bench_policy_t policies[] =
+{
+    {"SCHED_OTHER", SCHED_OTHER, 0},
+    {"SCHED_FIFO",  SCHED_FIFO,  0},
+    {"FIFO pinned", SCHED_FIFO,  1},
+};
+
+#define NUM_POLICIES (sizeof(policies)/sizeof(policies[0]))
+
+typedef struct
+{
+    const char *name;
+    prd_combine_t combine;
+    int layout;
+    prd_fn_t fn;
+} bench_kind_t;
+
+static const bench_kind_t kinds[] =
+{
+    {"packed", PRD_TREE,   PRD_PACKED, prd_sum_inplace},
+    {"padded", PRD_TREE,   PRD_PADDED, prd_sum_inplace},
+    {"tree",   PRD_TREE,   PRD_PADDED, prd_sum},
+    {"atomic", PRD_ATOMIC, PRD_PADDED, prd_sum},
+};
+
+#define NUM_KINDS (sizeof(kinds)/sizeof(kinds[0]))
+
+unsigned long long elements=NUM_ELEMENTS;
+int max_threads=NUM_THREADS, runs=NUM_RUNS, cpu_affinity=CPU_AFFINITY;
+
+
+// average usec of runs reductions of kind over n threads, -1 on failure
+static double run_kind(const bench_kind_t *k, pthread_attr_t *attr, int n)
+{
+    unsigned long long result, expect=elements*(elements+1)/2;
+    long long total=0;
+    ts_t start;
+    prd_t r;
+    int i;
+
+    if(prd_create(&r, n, k->combine, k->layout, k->fn, NULL) != 0)
+    {
+        printf("prd_create: no memory for %d slots\n", n);
+        return -1.0;
+    }
+
+    for(i=0; i<runs; i++)
+    {
+        start=ts_now();
+        if(prd_run(&r, attr, elements, &result) != 0)
+            break;
+        total+=ts_delta_ns(start, ts_now());
+
+        if(result != expect)
+            printf("%s %d threads: sum %llu, expected %llu\n", k->name, n, result, expect);
+    }
+
+    prd_destroy(&r);
+    return (i == runs) ? (double)total/runs/1000.0 : -1.0;
+}
+
+
+// starter thread for one policy, args points at its bench_policy_t
+void *starterThread(void *policyp)
+{
+    const bench_policy_t *p=(const bench_policy_t *)policyp;
+    struct sched_param param;
+    pthread_attr_t attr;
+    cpu_set_t cpuset;
+    double one[NUM_KINDS], usec;
+    unsigned int k;
+    int n, policy;
+
+    // reduction threads get the starter's policy, priority and affinity
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, p->policy);
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    pthread_attr_setschedparam(&attr, &param);
+    pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+
+    for(n=1; ; n*=2)
+    {
+        if(n > max_threads) n=max_threads;
+
+        printf("%-12s %5d", p->name, n);
+        for(k=0; k<NUM_KINDS; k++)
+        {
+            usec=run_kind(&kinds[k], &attr, n);
+            if(n == 1) one[k]=usec;
+
+            if(usec <= 0.0)
+                printf("  %10s %6s %8s", "failed", "", "");
+            else
+                printf("  %10.0lf %6.2lf %8.1lf", usec, one[k] > 0.0 ? one[k]/usec : 0.0, elements/usec);
+        }
+        printf("\n");
+        fflush(stdout);
+
+        if(n == max_threads) break;
+    }
+
+    pthread_attr_destroy(&attr);
+    return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct sched_param param;
+    pthread_attr_t attr;
+    pthread_t startthread;
+    cpu_set_t cpuset;
+    unsigned int p, k;
+    int c, rc;
+
+    while((c=getopt(argc, argv, "N:n:r:c:")) != -1)
+    {
+        switch(c)
+        {
+            case 'N': elements=strtoull(optarg, NULL, 0); break;
+            case 'n': max_threads=atoi(optarg); break;
+            case 'r': runs=atoi(optarg); break;
+            case 'c': cpu_affinity=atoi(optarg); break;
+            default:
+                printf("usage: reduce_bench [-N elements] [-n max threads] [-r runs] [-c core]\n");
+                exit(-1);
+        }
+    }
+
+    // N(N+1)/2 has to fit 64 bits
+    if(max_threads < 1 || max_threads > NUM_THREADS*64 || runs < 1 || elements < 1 || elements > (1ULL << 32))
+    {
+        printf("need 1..%d threads, at least one run and 1..2^32 elements\n", NUM_THREADS*64);
+        exit(-1);
+    }
+
+    ts_init();
+    printf("Sum 1..%llu, 1..%d threads, %d runs each, %d cores, time stamps from %s\n",
+           elements, max_threads, runs, get_nprocs(), ts_source_name());
+    printf("\n%-12s %5s", "policy", "thr");
+    for(k=0; k<NUM_KINDS; k++)
+        printf("  %10s %6s %8s", kinds[k].name, "x", "Melem/s");
+    printf("\n");
+
+    for(p=0; p<NUM_POLICIES; p++)
+    {
+        pthread_attr_init(&attr);
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, policies[p].policy);
+        param.sched_priority=(policies[p].policy == SCHED_FIFO) ? sched_get_priority_max(SCHED_FIFO) : 0;
+        pthread_attr_setschedparam(&attr, &param);
+
+        if(policies[p].pinned)
+        {
+            CPU_ZERO(&cpuset);
+            CPU_SET(coremap_online(cpu_affinity), &cpuset);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        }
+
+        if((rc=pthread_create(&startthread, &attr, starterThread, (void *)&policies[p])) != 0)
+            printf("%-12s skipped, pthread_create rc=%d%s\n", policies[p].name, rc, (rc == 1) ? ", needs root" : "");
+        else
+            pthread_join(startthread, NULL);
+
+        pthread_attr_destroy(&attr);
+    }
+
+    printf("\nTEST COMPLETE\n");
+    return 0;
+}
@@ -9,10 +9,16 @@
  * functions */
 #include <syslog.h>
 
+#include "coremap.h"
+#include "rtinit.h"
+#include "schedpol.h"
+#include "rtstack.h"
+
 // Specified number of threads for this assignment: 128
 #define NUM_THREADS 128
-// Specified CPU affinity: 3
+// Specified CPU affinity: 3, or the core given as the first argument
 #define CPU_AFFINITY 3
+int cpu_affinity=CPU_AFFINITY;
 
 // Structure required by pthread_create
 typedef struct
@@ -31,6 +37,24 @@ pthread_attr_t fifo_sched_attr;
 struct sched_param fifo_param;
 
 #define SCHED_POLICY SCHED_FIFO
+// or the policy given as the second argument, fifo, rr or other
+int sched_policy=SCHED_POLICY;
+
+// lock memory before the threads are created, and give each of them a
+// 256K locked stack rather than 8 MB, see rtinit.h, or with STACK_ARENA
+// the smaller arena stack below
+#define MEMORY_LOCK
+
+// every thread on a THREAD_STACK stack carved from one locked arena
+// rather than an 8 MB default one, 4.5 MB for all 128 instead of 1 GB of
+// address space, high water marks printed at the end, see rtstack.h
+#define STACK_ARENA
+#define THREAD_STACK (32*1024)
+#define STARTER_STACK (64*1024)
+
+#ifdef STACK_ARENA
+rts_arena_t stacks;
+#endif
 
 void print_scheduling_policy(void){
 
@@ -43,7 +67,7 @@ void print_scheduling_policy(void){
       printf("Pthread policy is SCHED_OTHER\n");
       break;
     case SCHED_RR:
-      printf("Pthread policy is SCHED_RR\n");
+      printf("Pthread policy is SCHED_RR, %.1lf ms quantum\n", schedpol_rr_quantum_ms(0));
       break;
     default:
       printf("Pthread policy is UNKNOWN (%d)\n", schedType);
@@ -62,6 +86,9 @@ void set_scheduler(void){
 
   // Initialises the fifo_sched_attr variable to default settings
   pthread_attr_init(&fifo_sched_attr);
+#ifdef MEMORY_LOCK
+  rti_attr_stack(&fifo_sched_attr);
+#endif
   
   /* The inherit-scheduler attribute determines whether a thread created using the
    * thread attributes object attr will inherit its scheduling
@@ -74,24 +101,24 @@ void set_scheduler(void){
   pthread_attr_setinheritsched(&fifo_sched_attr, PTHREAD_EXPLICIT_SCHED);
   
   // Sets the scheduling policy to SCHED_FIFO
-  pthread_attr_setschedpolicy(&fifo_sched_attr, SCHED_POLICY);
+  pthread_attr_setschedpolicy(&fifo_sched_attr, sched_policy);
   
   CPU_ZERO(&cpuset); // Clears the cpuset variables, so that it contains no CPU
-  cpuidx=(CPU_AFFINITY);  // add CPU number 3 (CPU affinity) to CPU set
+  cpuidx=coremap_online(cpu_affinity);  // add the CPU affinity core, if it is online, to CPU set
   CPU_SET(cpuidx, &cpuset); // Set the CPU set to the indicated cpuidx
   
   // Uses the cpuset to set the thread affinity attribute to the predefined core
   pthread_attr_setaffinity_np(&fifo_sched_attr, sizeof(cpu_set_t), &cpuset);
   
   // Returns  the  maximum  priority value that can be used with the scheduling algorithm
-  max_prio = sched_get_priority_max(SCHED_POLICY);
+  max_prio = sched_get_priority_max(sched_policy);
   
   // Sets the priority to the max_prio value got at the line before
   fifo_param.sched_priority = max_prio;
   
   /*  Sets both the scheduling policy and parameters for the thread whose
    *  ID is specified in pid */ 
-  if(sched_setscheduler(getpid(), SCHED_POLICY, &fifo_param) < 0){
+  if(sched_setscheduler(getpid(), sched_policy, &fifo_param) < 0){
     perror("sched_setscheduler");
   }
   
@@ -144,11 +171,19 @@ void* counterThread(void* threadp)
 void starterThread(void *threadp)
 {
    int i;
+#ifdef STACK_ARENA
+   char stack_name[RTS_NAME_LEN];
+#endif
    printf("Starter thread running on CPU = %d\n", sched_getcpu());
 
    for(i=0; i < NUM_THREADS; i++)
    {
        threadParams[i].threadIdx=i;
+#ifdef STACK_ARENA
+       // the attr is copied by pthread_create, so each thread gets its own
+       snprintf(stack_name, sizeof(stack_name), "thread %d", i);
+       rts_attr_stack(&stacks, &fifo_sched_attr, THREAD_STACK, stack_name);
+#endif
 
        pthread_create(&threads[i],   				// pointer to thread descriptor
                       &fifo_sched_attr,     		// use FIFO RT max priority attributes
@@ -167,11 +202,36 @@ void starterThread(void *threadp)
 
 int main(int argc, char* argv[])
 {
+#ifdef MEMORY_LOCK
+    rti_faults_t run_faults;
+#endif
+
+    // core to run on, e.g. "./prog 7" on an 8 core board
+    if(argc > 1) cpu_affinity=atoi(argv[1]);
+    if(argc > 2 && (sched_policy=schedpol_parse(argv[2])) < 0)
+    {
+        printf("usage: thread_affinity [core [fifo|rr|other]]\n");
+        exit(-1);
+    }
+
+#ifdef MEMORY_LOCK
+    rti_init(0);
+#endif
+
     // Sets the scheduler according to configuraiton
     set_scheduler();
 
     openlog ("[COURSE:1][ASSIGNMENT:4]", LOG_NDELAY, LOG_USER);
 
+#ifdef STACK_ARENA
+    rts_arena_init(&stacks, NUM_THREADS+1, NUM_THREADS*rts_span(THREAD_STACK) + rts_span(STARTER_STACK));
+    rts_attr_stack(&stacks, &fifo_sched_attr, STARTER_STACK, "starter");
+#endif
+
+#ifdef MEMORY_LOCK
+    rti_faults(&run_faults);
+#endif
+
 	// Creates the thread
     pthread_create(&startthread,   			// pointer to thread descriptor
                   &fifo_sched_attr,     	// use FIFO RT max priority attributes
@@ -180,7 +240,14 @@ int main(int argc, char* argv[])
                  );
 
     pthread_join(startthread, NULL);
+#ifdef STACK_ARENA
+    rts_report(&stacks);
+    rts_arena_free(&stacks);
+#endif
     printf("\nTEST COMPLETE\n");
+#ifdef MEMORY_LOCK
+    rti_report("thread create, stacks locked, and run", &run_faults);
+#endif
 
 	closelog();
 }
\ No newline at end of file
@@ -0,0 +1,318 @@
+// thread_bench.c
+//
+// What the 128 counterThread spawns of multiplethreads.c (SCHED_OTHER),
+// fifothreads.c (SCHED_FIFO) and thread_affinity.c (SCHED_FIFO pinned to
+// one core) cost, against the same work handed to a pool of threads that
+// were created up front.
+//
+//    thread_bench [-n max threads] [-r runs] [-c core]
+//
+// For 1, 2, 4 .. max threads, each policy runs -r batches, default 10, of
+//
+//    spawn   one pthread_create per counterThread, then join all
+//    pool    one counterThread per item given as one batch to rtpool.h
+//            workers created up front, one per online core, one for the
+//            pinned case
+//
+// and reports per thread
+//
+//    start   pthread_create called, or item queued -> thread runs it
+//    join    thread done -> pthread_join returns, or last item done ->
+//            waiter wakes
+//    batch   first create / queue -> last join / wake, and items per sec
+//
+// Like thread_affinity.c each policy is driven from a starter thread
+// created with that policy's attributes, so under SCHED_FIFO the created
+// threads only run once the starter blocks.  SCHED_FIFO needs root.
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/sysinfo.h>
+
+#include "coremap.h"
+#include "tstamp.h"
+#include "rtpool.h"
+
+// Specified number of threads for the assignments: 128
+#define NUM_THREADS 128
+#define NUM_RUNS 10
+// CPU affinity for the pinned runs: 3, or the core given with -c
+#define CPU_AFFINITY 3
+
+typedef struct
+{
+    int threadIdx;
+    int gsum;
+    ts_t submit, start, end;
+} bench_item_t;
+
+typedef struct
+{
+    const char *name;
+    int policy;
+    int pinned;
+} bench_policy_t;
+
+static const bench_policy_t policies[] =
+{
+    {"SCHED_OTHER", SCHED_OTHER, 0},
+    {"SCHED_FIFO",  SCHED_FIFO,  0},
+    {"FIFO pinned", SCHED_FIFO,  1},
+};
+
+#define NUM_POLICIES (sizeof(policies)/sizeof(policies[0]))
+
+typedef struct
+{
+    long long sum, max;
+    unsigned long long n;
+} bench_acc_t;
+
+int max_threads=NUM_THREADS, runs=NUM_RUNS, cpu_affinity=CPU_AFFINITY;
+
+static bench_item_t items[NUM_THREADS*64];
+static pthread_t threads[NUM_THREADS*64];
+static void *item_args[NUM_THREADS*64];
+
+
+static void acc_add(bench_acc_t *a, long long v)
+{
+    a->sum+=v;
+    a->n++;
+    if(v > a->max) a->max=v;
+}
+
+
+static double acc_avg_usec(const bench_acc_t *a)
+{
+    return a->n ? (double)a->sum/a->n/1000.0 : 0.0;
+}
+
+
+// sum[0...threadIdx] as counterThread does, without the printf
+static void counter_work(bench_item_t *item)
+{
+    int i, gsum=0;
+
+    for(i=1; i <= item->threadIdx+1; i++)
+        gsum+=i;
+    item->gsum=gsum;
+}
+
+
+void *counterThread(void *threadp)
+{
+    bench_item_t *item=(bench_item_t *)threadp;
+
+    item->start=ts_now();
+    counter_work(item);
+    item->end=ts_now();
+
+    return NULL;
+}
+
+
+// the same work as a pool task
+static void counterTask(void *itemp)
+{
+    bench_item_t *item=(bench_item_t *)itemp;
+
+    item->start=ts_now();
+    counter_work(item);
+    item->end=ts_now();
+}
+
+
+// one spawn batch of n threads, returns the batch time in ns
+static long long run_spawn(pthread_attr_t *attr, int n, bench_acc_t *start, bench_acc_t *join)
+{
+    ts_t first, joined;
+    int i;
+
+    first=ts_now();
+    for(i=0; i<n; i++)
+    {
+        items[i].threadIdx=i;
+        items[i].submit=ts_now();
+        if(pthread_create(&threads[i], attr, counterThread, (void *)&items[i]) != 0)
+        {
+            perror("pthread_create");
+            n=i;
+            break;
+        }
+    }
+
+    for(i=0; i<n; i++)
+    {
+        pthread_join(threads[i], NULL);
+        joined=ts_now();
+        acc_add(start, ts_delta_ns(items[i].submit, items[i].start));
+        acc_add(join, ts_delta_ns(items[i].end, joined));
+    }
+
+    return n ? ts_delta_ns(first, ts_now()) : 0;
+}
+
+
+// the same n items through the pool as one batch
+static long long run_pool(rtpool_t *pool, int n, bench_acc_t *start, bench_acc_t *join)
+{
+    rtp_batch_t b;
+    ts_t first, woke, last=0;
+    int i;
+
+    first=ts_now();
+    for(i=0; i<n; i++)
+    {
+        items[i].threadIdx=i;
+        items[i].submit=first;
+        item_args[i]=(void *)&items[i];
+    }
+
+    rtp_batch_init(&b);
+    if(rtp_submit_batch(pool, &b, counterTask, item_args, n) != n)
+        printf("pool ring full, batch of %d cut short\n", n);
+    rtp_wait(&b);
+    woke=ts_now();
+
+    for(i=0; i<n; i++)
+    {
+        acc_add(start, ts_delta_ns(items[i].submit, items[i].start));
+        if(items[i].end > last) last=items[i].end;
+    }
+    acc_add(join, ts_delta_ns(last, woke));
+
+    return ts_delta_ns(first, woke);
+}
+
+
+static void print_row(const char *policy, const char *kind, int n, const bench_acc_t *start,
+                      const bench_acc_t *join, const bench_acc_t *batch)
+{
+    double avg=acc_avg_usec(batch);
+
+    printf("%-12s %-6s %5d %9.1lf %9.1lf %9.1lf %9.1lf %10.1lf %12.0lf\n", policy, kind, n,
+           acc_avg_usec(start), start->max/1000.0, acc_avg_usec(join), join->max/1000.0,
+           avg, avg > 0.0 ? n*1.0e6/avg : 0.0);
+}
+
+
+// starter thread for one policy, args points at its bench_policy_t
+void *starterThread(void *policyp)
+{
+    const bench_policy_t *p=(const bench_policy_t *)policyp;
+    struct sched_param param;
+    pthread_attr_t attr;
+    cpu_set_t cpuset;
+    rtpool_t pool;
+    bench_acc_t start, join, batch;
+    int n, r, policy;
+
+    // the starter's own policy, priority and affinity, default stack as in the originals
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, p->policy);
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    pthread_attr_setschedparam(&attr, &param);
+    pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+
+    // one worker for the pinned core, one per online core otherwise
+    if(rtp_create(&pool, p->pinned ? 1 : get_nprocs(), p->policy, param.sched_priority,
+                  p->pinned ? &cpuset : NULL, max_threads) != 0)
+    {
+        printf("%s: no pool workers\n", p->name);
+        pthread_attr_destroy(&attr);
+        return NULL;
+    }
+
+    for(n=1; ; n*=2)
+    {
+        if(n > max_threads) n=max_threads;
+
+        memset(&start, 0, sizeof(start)); memset(&join, 0, sizeof(join)); memset(&batch, 0, sizeof(batch));
+        for(r=0; r<runs; r++)
+            acc_add(&batch, run_spawn(&attr, n, &start, &join));
+        print_row(p->name, "spawn", n, &start, &join, &batch);
+
+        memset(&start, 0, sizeof(start)); memset(&join, 0, sizeof(join)); memset(&batch, 0, sizeof(batch));
+        for(r=0; r<runs; r++)
+            acc_add(&batch, run_pool(&pool, n, &start, &join));
+        print_row(p->name, "pool", n, &start, &join, &batch);
+
+        if(n == max_threads) break;
+    }
+
+    rtp_destroy(&pool);
+    pthread_attr_destroy(&attr);
+    return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct sched_param param;
+    pthread_attr_t attr;
+    pthread_t startthread;
+    cpu_set_t cpuset;
+    unsigned int p;
+    int c, rc;
+
+    while((c=getopt(argc, argv, "n:r:c:")) != -1)
+    {
+        switch(c)
+        {
+            case 'n': max_threads=atoi(optarg); break;
+            case 'r': runs=atoi(optarg); break;
+            case 'c': cpu_affinity=atoi(optarg); break;
+            default:
+                printf("usage: thread_bench [-n max threads] [-r runs] [-c core]\n");
+                exit(-1);
+        }
+    }
+
+    if(max_threads < 1 || max_threads > NUM_THREADS*64 || runs < 1)
+    {
+        printf("need 1..%d threads and at least one run\n", NUM_THREADS*64);
+        exit(-1);
+    }
+
+    ts_init();
+    printf("Thread creation vs pool, 1..%d threads, %d runs each, %d cores, time stamps from %s\n",
+           max_threads, runs, get_nprocs(), ts_source_name());
+    printf("\n%-12s %-6s %5s %9s %9s %9s %9s %10s %12s\n", "policy", "", "thr", "start avg", "start max",
+           "join avg", "join max", "batch usec", "threads/sec");
+
+    for(p=0; p<NUM_POLICIES; p++)
+    {
+        pthread_attr_init(&attr);
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, policies[p].policy);
+        param.sched_priority=(policies[p].policy == SCHED_FIFO) ? sched_get_priority_max(SCHED_FIFO) : 0;
+        pthread_attr_setschedparam(&attr, &param);
+
+        if(policies[p].pinned)
+        {
+            CPU_ZERO(&cpuset);
+            CPU_SET(coremap_online(cpu_affinity), &cpuset);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        }
+
+        if((rc=pthread_create(&startthread, &attr, starterThread, (void *)&policies[p])) != 0)
+            printf("%-12s skipped, pthread_create rc=%d%s\n", policies[p].name, rc, (rc == 1) ? ", needs root" : "");
+        else
+            pthread_join(startthread, NULL);
+
+        pthread_attr_destroy(&attr);
+    }
+
+    printf("\nTEST COMPLETE\n");
+    return 0;
+}
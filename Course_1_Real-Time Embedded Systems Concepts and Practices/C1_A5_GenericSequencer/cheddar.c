@@ -0,0 +1,435 @@
+// Loader for Cheddar XML task set models, see cheddar.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "cheddar.h"
+
+#define CH_MAX_DEPTH (16)
+#define CH_TEXT_LEN (256)
+
+typedef struct
+{
+    ch_model_t *m;
+    const char *file;
+    int line;
+
+    char path[CH_MAX_DEPTH][CH_NAME_LEN];
+    int depth;
+
+    char text[CH_TEXT_LEN];
+    int ntext;
+
+    ch_task_t cur;
+    int in_task, in_core, in_cpu;
+} ch_parser_t;
+
+
+static void copy_name(char *dst, const char *src)
+{
+    snprintf(dst, CH_NAME_LEN, "%s", src);
+}
+
+
+// trim and decode the five predefined entities in place
+static char *clean_text(char *s)
+{
+    static const char *ent[] = {"&amp;", "&lt;", "&gt;", "&quot;", "&apos;"};
+    static const char rep[] = {'&', '<', '>', '"', '\''};
+    char *src, *dst, *end;
+    int i;
+
+    while(isspace((unsigned char)*s)) s++;
+    end=s+strlen(s);
+    while(end > s && isspace((unsigned char)end[-1])) *--end='\0';
+
+    for(src=dst=s; *src; )
+    {
+        if(*src == '&')
+        {
+            for(i=0; i<5; i++)
+                if(strncmp(src, ent[i], strlen(ent[i])) == 0) break;
+
+            if(i < 5) { *dst++=rep[i]; src+=strlen(ent[i]); continue; }
+        }
+        *dst++=*src++;
+    }
+    *dst='\0';
+
+    return s;
+}
+
+
+static const char *parent(ch_parser_t *p)
+{
+    return (p->depth >= 2) ? p->path[p->depth-2] : "";
+}
+
+
+static void start_element(ch_parser_t *p, const char *tag, const char *id, const char *ref)
+{
+    ch_model_t *m=p->m;
+
+    if(strcmp(tag, "core_unit") == 0 && m->ncores < CH_MAX_CORES)
+    {
+        copy_name(m->core[m->ncores].id, id);
+        m->core[m->ncores].scheduler[0]='\0';
+        p->in_core=1;
+    }
+    else if(strcmp(tag, "mono_core_processor") == 0 && m->ncpus < CH_MAX_CORES)
+    {
+        memset(&m->cpu[m->ncpus], 0, sizeof(ch_cpu_t));
+        p->in_cpu=1;
+    }
+    else if(p->in_cpu && strcmp(tag, "core") == 0)
+        copy_name(m->cpu[m->ncpus].core_ref, ref);
+    else if(strcmp(tag, "periodic_task") == 0)
+    {
+        memset(&p->cur, 0, sizeof(ch_task_t));
+        p->in_task=1;
+    }
+    else if(strcmp(parent(p), "tasks") == 0)
+        m->skipped++;
+}
+
+
+static void end_element(ch_parser_t *p, const char *tag)
+{
+    ch_model_t *m=p->m;
+    char *text;
+
+    p->text[p->ntext]='\0';
+    text=clean_text(p->text);
+
+    if(p->in_task && strcmp(parent(p), "periodic_task") == 0)
+    {
+        if(strcmp(tag, "name") == 0) copy_name(p->cur.name, text);
+        else if(strcmp(tag, "cpu_name") == 0) copy_name(p->cur.cpu, text);
+        else if(strcmp(tag, "capacity") == 0) p->cur.capacity=strtoul(text, (char **)0, 10);
+        else if(strcmp(tag, "deadline") == 0) p->cur.deadline=strtoul(text, (char **)0, 10);
+        else if(strcmp(tag, "period") == 0) p->cur.period=strtoul(text, (char **)0, 10);
+        else if(strcmp(tag, "priority") == 0) p->cur.priority=atoi(text);
+        else if(strcmp(tag, "start_time") == 0) p->cur.start_time=strtoul(text, (char **)0, 10);
+        else if(strcmp(tag, "jitter") == 0) p->cur.jitter=strtoul(text, (char **)0, 10);
+    }
+    else if(strcmp(tag, "periodic_task") == 0)
+    {
+        if(m->ntasks < CH_MAX_TASKS)
+            m->task[m->ntasks++]=p->cur;
+        else
+            m->skipped++;
+        p->in_task=0;
+    }
+    else if(p->in_core && strcmp(tag, "scheduler_type") == 0)
+        copy_name(m->core[m->ncores].scheduler, text);
+    else if(p->in_core && strcmp(tag, "core_unit") == 0)
+    {
+        m->ncores++;
+        p->in_core=0;
+    }
+    else if(p->in_cpu && strcmp(tag, "name") == 0 && strcmp(parent(p), "mono_core_processor") == 0)
+        copy_name(m->cpu[m->ncpus].name, text);
+    else if(p->in_cpu && strcmp(tag, "mono_core_processor") == 0)
+    {
+        m->ncpus++;
+        p->in_cpu=0;
+    }
+
+    p->ntext=0;
+}
+
+
+static int push(ch_parser_t *p, const char *tag)
+{
+    if(p->depth == CH_MAX_DEPTH)
+    {
+        printf("%s:%d: elements nested deeper than %d\n", p->file, p->line, CH_MAX_DEPTH);
+        return -1;
+    }
+
+    copy_name(p->path[p->depth++], tag);
+    return 0;
+}
+
+
+static int pop(ch_parser_t *p, const char *tag)
+{
+    if(p->depth == 0 || strncmp(p->path[p->depth-1], tag, CH_NAME_LEN-1) != 0)
+    {
+        printf("%s:%d: </%s> does not close <%s>\n", p->file, p->line, tag, p->depth ? p->path[p->depth-1] : "");
+        return -1;
+    }
+
+    end_element(p, tag);
+    p->depth--;
+    return 0;
+}
+
+
+static int next_char(ch_parser_t *p, FILE *fp)
+{
+    int c=getc_unlocked(fp);
+
+    if(c == '\n') p->line++;
+    return c;
+}
+
+
+// skip to the end of a <? ?>, <!-- --> or <! > construct, the first
+// character after '<' already read
+static int skip_markup(ch_parser_t *p, FILE *fp, int first)
+{
+    int c, prev=0, prev2=0, comment=0;
+
+    if(first == '!')
+    {
+        if((c=next_char(p, fp)) == '-' && (c=next_char(p, fp)) == '-') comment=1;
+        if(c == '>') return 0;
+    }
+
+    while((c=next_char(p, fp)) != EOF)
+    {
+        if(c == '>')
+        {
+            if(comment ? (prev == '-' && prev2 == '-') : (first != '?' || prev == '?'))
+                return 0;
+        }
+        prev2=prev; prev=c;
+    }
+
+    printf("%s:%d: unterminated markup\n", p->file, p->line);
+    return -1;
+}
+
+
+// read a tag after '<', returns 0, or -1 on a syntax error
+static int read_tag(ch_parser_t *p, FILE *fp, int c)
+{
+    char tag[CH_NAME_LEN], key[CH_NAME_LEN], val[CH_NAME_LEN];
+    char id[CH_NAME_LEN]="", ref[CH_NAME_LEN]="";
+    int n, closing=0, quote;
+
+    if(c == '/') { closing=1; c=next_char(p, fp); }
+
+    for(n=0; c != EOF && !isspace(c) && c != '>' && c != '/'; c=next_char(p, fp))
+        if(n < CH_NAME_LEN-1) tag[n++]=c;
+    tag[n]='\0';
+
+    if(n == 0)
+    {
+        printf("%s:%d: empty tag name\n", p->file, p->line);
+        return -1;
+    }
+
+    // attributes, only id= and ref= are kept
+    while(c != EOF && c != '>' && c != '/')
+    {
+        while(isspace(c)) c=next_char(p, fp);
+        if(c == '>' || c == '/' || c == EOF) break;
+
+        for(n=0; c != EOF && c != '=' && !isspace(c) && c != '>'; c=next_char(p, fp))
+            if(n < CH_NAME_LEN-1) key[n++]=c;
+        key[n]='\0';
+
+        while(isspace(c)) c=next_char(p, fp);
+        if(c != '=') { printf("%s:%d: attribute %s has no value\n", p->file, p->line, key); return -1; }
+
+        do c=next_char(p, fp); while(isspace(c));
+        if(c != '"' && c != '\'') { printf("%s:%d: attribute %s is not quoted\n", p->file, p->line, key); return -1; }
+        quote=c;
+
+        for(n=0; (c=next_char(p, fp)) != EOF && c != quote; )
+            if(n < CH_NAME_LEN-1) val[n++]=c;
+        val[n]='\0';
+
+        if(strcmp(key, "id") == 0) copy_name(id, val);
+        else if(strcmp(key, "ref") == 0) copy_name(ref, val);
+
+        c=next_char(p, fp);
+    }
+
+    if(c == '/')
+    {
+        // <tag/> opens and closes
+        if((c=next_char(p, fp)) != '>')
+        {
+            printf("%s:%d: expected /> in <%s\n", p->file, p->line, tag);
+            return -1;
+        }
+
+        if(push(p, tag) != 0) return -1;
+        p->ntext=0;
+        start_element(p, tag, id, ref);
+        return pop(p, tag);
+    }
+
+    if(c != '>')
+    {
+        printf("%s:%d: unterminated <%s\n", p->file, p->line, tag);
+        return -1;
+    }
+
+    if(closing) return pop(p, tag);
+
+    if(push(p, tag) != 0) return -1;
+    p->ntext=0;
+    start_element(p, tag, id, ref);
+    return 0;
+}
+
+
+int ch_load(const char *path, ch_model_t *m)
+{
+    ch_parser_t p;
+    FILE *fp;
+    int c, rc=0;
+
+    memset(m, 0, sizeof(ch_model_t));
+    memset(&p, 0, sizeof(ch_parser_t));
+    p.m=m;
+    p.file=path;
+    p.line=1;
+
+    if((fp=fopen(path, "r")) == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    while(rc == 0 && (c=next_char(&p, fp)) != EOF)
+    {
+        if(c != '<')
+        {
+            if(p.ntext < CH_TEXT_LEN-1) p.text[p.ntext++]=c;
+            continue;
+        }
+
+        c=next_char(&p, fp);
+        if(c == '?' || c == '!')
+            rc=skip_markup(&p, fp, c);
+        else
+            rc=read_tag(&p, fp, c);
+    }
+
+    fclose(fp);
+
+    if(rc == 0 && p.depth != 0)
+    {
+        printf("%s: <%s> is not closed\n", path, p.path[p.depth-1]);
+        rc=-1;
+    }
+
+    if(rc == 0 && m->ntasks == 0)
+    {
+        printf("%s: no periodic tasks\n", path);
+        rc=-1;
+    }
+
+    return (rc == 0) ? m->ntasks : -1;
+}
+
+
+const char *ch_scheduler(const ch_model_t *m, int i)
+{
+    int c, k;
+
+    for(c=0; c<m->ncpus; c++)
+    {
+        if(strcmp(m->cpu[c].name, m->task[i].cpu) != 0) continue;
+
+        for(k=0; k<m->ncores; k++)
+            if(strcmp(m->core[k].id, m->cpu[c].core_ref) == 0)
+                return m->core[k].scheduler;
+    }
+
+    return "";
+}
+
+
+// a ahead of b under the scheduler of task a
+static int ranks_before(const ch_model_t *m, int a, int b)
+{
+    const ch_task_t *ta=&m->task[a], *tb=&m->task[b];
+    const char *sched=ch_scheduler(m, a);
+    unsigned int da=ta->deadline ? ta->deadline : ta->period;
+    unsigned int db=tb->deadline ? tb->deadline : tb->period;
+
+    if(strcmp(sched, "RATE_MONOTONIC_PROTOCOL") == 0)
+    {
+        if(ta->period != tb->period) return ta->period < tb->period;
+    }
+    else if(strcmp(sched, "DEADLINE_MONOTONIC_PROTOCOL") == 0 || strcmp(sched, "EARLIEST_DEADLINE_FIRST_PROTOCOL") == 0)
+    {
+        if(da != db) return da < db;
+    }
+    else if(ta->priority != tb->priority)
+        return ta->priority > tb->priority;
+
+    return a < b;
+}
+
+
+// task indices in priority order
+static void rank(const ch_model_t *m, int *order)
+{
+    int i, j, t;
+
+    for(i=0; i<m->ntasks; i++) order[i]=i;
+
+    for(i=1; i<m->ntasks; i++)
+    {
+        t=order[i];
+        for(j=i; j>0 && ranks_before(m, t, order[j-1]); j--)
+            order[j]=order[j-1];
+        order[j]=t;
+    }
+}
+
+
+int ch_to_services(const ch_model_t *m, service_desc_t *table, int top_priority, service_fn_t work)
+{
+    int order[CH_MAX_TASKS];
+    int i, t;
+
+    rank(m, order);
+
+    for(i=0; i<m->ntasks; i++)
+    {
+        t=order[i];
+
+        table[i].name=m->task[t].name;
+        table[i].divisor=m->task[t].period;
+        table[i].wcet=m->task[t].capacity;
+        table[i].deadline=(m->task[t].deadline == m->task[t].period) ? 0 : m->task[t].deadline;
+        table[i].priority=top_priority-i;
+        table[i].core=SEQ_ANY_CORE;
+        table[i].work=work;
+    }
+
+    return m->ntasks;
+}
+
+
+int ch_to_tasks(const ch_model_t *m, sa_task_t *task)
+{
+    int order[CH_MAX_TASKS];
+    int i, t;
+
+    rank(m, order);
+
+    for(i=0; i<m->ntasks; i++)
+    {
+        t=order[i];
+
+        task[t].T=m->task[t].period;
+        task[t].C=m->task[t].capacity;
+        task[t].D=m->task[t].deadline ? m->task[t].deadline : m->task[t].period;
+        task[t].priority=m->ntasks-i;
+        task[t].B=0;
+    }
+
+    return m->ntasks;
+}
@@ -0,0 +1,71 @@
+#ifndef _CHEDDAR_
+#define _CHEDDAR_
+
+// Loader for Cheddar XML task set models, as in C1_A6_CheddarAnalysisSchedules
+//
+// The file is read once, front to back, by a small SAX style tokenizer:
+// elements are matched as they close against the path of open elements, and
+// only the fields the sequencer and schedan.h need are kept, so there is no
+// document tree and no XML library.  Kept from the model:
+//
+//    core_unit id, scheduler_type of its scheduling_parameters
+//    mono_core_processor name and the core ref it runs on
+//    periodic_task name, cpu_name, capacity, deadline, period, priority,
+//    start_time and jitter
+//
+// Cheddar time units are taken to be sequencer ticks.  Other task kinds
+// (aperiodic, sporadic, ...) are counted and skipped.
+//
+
+#include "seqtable.h"
+#include "schedan.h"
+
+#define CH_MAX_TASKS (SA_MAX_TASKS)
+#define CH_MAX_CORES (16)
+#define CH_NAME_LEN (48)
+
+typedef struct
+{
+    char name[CH_NAME_LEN];
+    char cpu[CH_NAME_LEN];
+    unsigned int capacity, deadline, period, start_time, jitter;
+    int priority;                       // Cheddar, higher runs first
+} ch_task_t;
+
+typedef struct
+{
+    char id[CH_NAME_LEN];
+    char scheduler[CH_NAME_LEN];        // e.g. RATE_MONOTONIC_PROTOCOL
+} ch_core_t;
+
+typedef struct
+{
+    char name[CH_NAME_LEN];
+    char core_ref[CH_NAME_LEN];
+} ch_cpu_t;
+
+typedef struct
+{
+    int ntasks, ncores, ncpus;
+    int skipped;                        // tasks that are not periodic
+    ch_task_t task[CH_MAX_TASKS];
+    ch_core_t core[CH_MAX_CORES];
+    ch_cpu_t cpu[CH_MAX_CORES];
+} ch_model_t;
+
+// Parse one Cheddar file, returns the number of periodic tasks or -1
+int ch_load(const char *path, ch_model_t *m);
+
+// Scheduler of the core task i's processor runs on, "" if not found
+const char *ch_scheduler(const ch_model_t *m, int i);
+
+// Service table rows for the tasks, ranked the way the task's scheduler
+// would: by period for RM, deadline for DM and EDF, Cheddar priority
+// otherwise.  The top service gets top_priority, the next one less, and so
+// on.  Names point into m.  Returns ntasks.
+int ch_to_services(const ch_model_t *m, service_desc_t *table, int top_priority, service_fn_t work);
+
+// schedan.h input for the same tasks and ranking
+int ch_to_tasks(const ch_model_t *m, sa_task_t *task);
+
+#endif
@@ -3,13 +3,34 @@
  * from the man page - https://man7.org/linux/man-pages/man2/clock_getres.2.html
  *
  *  Licensed under GNU General Public License v2 or later.
+ *
+ *  clock_times [-r]                        value and resolution of each clock
+ *  clock_times -b [-n calls] [-w wakes] [-f]
+ *
+ *  -b benchmarks the clock sources to pick MY_CLOCK_TYPE and the seqtimer.h
+ *     backend for a board:
+ *
+ *     read cost   ns per clock_gettime() of each clock, _COARSE included,
+ *                 and of the cycle counter where user space may read it,
+ *                 rdtsc on x86 and cntvct_el0 on ARMv8
+ *     steps       distribution of the difference between back to back
+ *                 reads, zero steps are reads the clock could not tell
+ *                 apart, backward steps should never happen
+ *     wake-up     how late nanosleep(), relative clock_nanosleep() and
+ *                 TIMER_ABSTIME clock_nanosleep() wake for 10 and 1 msec
+ *
+ *  -n calls per clock, default 200000, -w wake-ups per sleep, default 100,
+ *  -f runs SCHED_FIFO at max priority, as the sequencer does.
 */
-#define _XOPEN_SOURCE 600
+#define _GNU_SOURCE
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
+#include <sched.h>
+#include <sys/prctl.h>
 
 #define SECS_IN_DAY (24 * 60 * 60)
 
@@ -46,14 +67,369 @@ displayClock(clockid_t clock, char *name, bool showRes)
 
 #define DELAY_LOOPS (10)
 #define USEC_PER_MSEC (1000)
+#define NSEC_PER_SEC (1000000000LL)
+
+#define BENCH_CALLS (200000)
+#define BENCH_WAKES (100)
+
+typedef struct
+{
+    clockid_t id;
+    const char *name;
+} bench_clock_t;
+
+static const bench_clock_t bench_clocks[] =
+{
+    {CLOCK_REALTIME,         "CLOCK_REALTIME"},
+    {CLOCK_REALTIME_COARSE,  "CLOCK_REALTIME_COARSE"},
+    {CLOCK_MONOTONIC,        "CLOCK_MONOTONIC"},
+    {CLOCK_MONOTONIC_COARSE, "CLOCK_MONOTONIC_COARSE"},
+    {CLOCK_MONOTONIC_RAW,    "CLOCK_MONOTONIC_RAW"},
+#ifdef CLOCK_BOOTTIME
+    {CLOCK_BOOTTIME,         "CLOCK_BOOTTIME"},
+#endif
+#ifdef CLOCK_TAI
+    {CLOCK_TAI,              "CLOCK_TAI"},
+#endif
+};
+
+#define NUM_CLOCKS (sizeof(bench_clocks)/sizeof(bench_clocks[0]))
+
+typedef struct
+{
+    long long min, p50, p99, max;
+    double avg;
+} bench_dist_t;
+
+
+static long long ts_ns(const struct timespec *ts)
+{
+    return (long long)ts->tv_sec*NSEC_PER_SEC + ts->tv_nsec;
+}
+
+
+static long long raw_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts_ns(&ts);
+}
+
+
+// cycle counter, 0 where there is none user space may read
+#if defined(__x86_64__) || defined(__i386__)
+#define COUNTER_NAME "rdtsc"
+static inline unsigned long long counter_read(void)
+{
+    unsigned int lo, hi;
+
+    asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+    return (unsigned long long)hi << 32 | lo;
+}
+
+// PR_SET_TSC can make rdtsc fault
+static int counter_readable(void)
+{
+    int tsc=0;
+
+    return prctl(PR_GET_TSC, &tsc) != 0 || tsc == PR_TSC_ENABLE;
+}
+#elif defined(__aarch64__)
+#define COUNTER_NAME "cntvct_el0"
+static inline unsigned long long counter_read(void)
+{
+    unsigned long long cnt;
+
+    asm volatile("isb; mrs %0, cntvct_el0" : "=r" (cnt) :: "memory");
+    return cnt;
+}
+
+// EL0 access to the virtual counter is on in every Linux arm64 kernel
+static int counter_readable(void)
+{
+    return 1;
+}
+#else
+#define COUNTER_NAME "none"
+static inline unsigned long long counter_read(void)
+{
+    return 0;
+}
+
+// the ARMv7 PMU cycle counter needs a kernel module, see seqgen2.c
+static int counter_readable(void)
+{
+    return 0;
+}
+#endif
+
+
+static int cmp_ll(const void *a, const void *b)
+{
+    long long x=*(const long long *)a, y=*(const long long *)b;
+
+    return (x > y) - (x < y);
+}
+
+
+// sorts v
+static void distribution(long long *v, int n, bench_dist_t *d)
+{
+    long long sum=0;
+    int i;
+
+    qsort(v, n, sizeof(long long), cmp_ll);
+    for(i=0; i<n; i++) sum+=v[i];
+
+    d->min=v[0];
+    d->p50=v[n/2];
+    d->p99=v[(int)((n-1)*0.99)];
+    d->max=v[n-1];
+    d->avg=(double)sum/n;
+}
+
+
+// ns per read over calls back to back reads, with the steps between them
+static double bench_clock(clockid_t id, long long *step, int calls, int *zero, int *back)
+{
+    struct timespec ts;
+    long long start, prev, now;
+    int i;
+
+    clock_gettime(id, &ts);
+    prev=ts_ns(&ts);
+    start=raw_ns();
+
+    for(i=0; i<calls; i++)
+    {
+        clock_gettime(id, &ts);
+        now=ts_ns(&ts);
+        step[i]=now - prev;
+        prev=now;
+    }
+
+    now=raw_ns();
+
+    for(*zero=*back=0, i=0; i<calls; i++)
+    {
+        if(step[i] == 0) (*zero)++;
+        else if(step[i] < 0) (*back)++;
+    }
+
+    return (double)(now - start)/calls;
+}
+
+
+static void bench_clocks_run(long long *step, int calls, clockid_t *best)
+{
+    struct timespec res;
+    bench_dist_t d;
+    double cost, best_cost=0.0;
+    int zero, back;
+    unsigned int c;
+
+    printf("\n%-23s %9s %8s %7s %6s %8s %8s %8s %8s\n", "clock", "res", "ns/read", "zero", "back",
+           "step min", "p50", "p99", "max");
+
+    for(c=0; c<NUM_CLOCKS; c++)
+    {
+        if(clock_getres(bench_clocks[c].id, &res) != 0)
+        {
+            printf("%-23s not available\n", bench_clocks[c].name);
+            continue;
+        }
+
+        cost=bench_clock(bench_clocks[c].id, step, calls, &zero, &back);
+        distribution(step, calls, &d);
+
+        printf("%-23s %9lld %8.1lf %6.1lf%% %6d %8lld %8lld %8lld %8lld\n", bench_clocks[c].name, ts_ns(&res),
+               cost, 100.0*zero/calls, back, d.min, d.p50, d.p99, d.max);
+
+        // the sequencers time stamp with one of the two monotonic clocks, which
+        // has to tell back to back events apart and never step back, RAW is
+        // not slewed by NTP so it wins unless it costs 10% more
+        if(bench_clocks[c].id != CLOCK_MONOTONIC && bench_clocks[c].id != CLOCK_MONOTONIC_RAW) continue;
+        if(ts_ns(&res) > 1000 || back || zero*2 > calls) continue;
+        if(*best < 0 || (bench_clocks[c].id == CLOCK_MONOTONIC_RAW ? cost < 1.1*best_cost : cost < best_cost))
+        {
+            *best=bench_clocks[c].id;
+            best_cost=cost;
+        }
+    }
+}
+
+
+static void bench_counter(long long *step, int calls)
+{
+    struct timespec pause={0, 100000000};
+    unsigned long long c0, c1, prev, now;
+    long long t0, t1;
+    bench_dist_t d;
+    double hz;
+    int i;
+
+    if(!counter_readable())
+    {
+        printf("\ncycle counter %s not readable from user space\n", COUNTER_NAME);
+        return;
+    }
+
+    // rate against CLOCK_MONOTONIC_RAW over 100 msec
+    t0=raw_ns(); c0=counter_read();
+    nanosleep(&pause, NULL);
+    t1=raw_ns(); c1=counter_read();
+    hz=(double)(c1 - c0)*NSEC_PER_SEC/(t1 - t0);
+
+    prev=counter_read();
+    t0=raw_ns();
+    for(i=0; i<calls; i++)
+    {
+        now=counter_read();
+        step[i]=(long long)(now - prev);
+        prev=now;
+    }
+    t1=raw_ns();
+
+    distribution(step, calls, &d);
+
+    printf("\ncycle counter %s at %.3lf MHz, %.1lf ns/read\n", COUNTER_NAME, hz/1.0e6, (double)(t1 - t0)/calls);
+    printf("  step ticks min %lld p50 %lld p99 %lld max %lld, p50 %.1lf ns\n", d.min, d.p50, d.p99, d.max,
+           d.p50*1.0e9/hz);
+}
+
+
+// how late each of the three sleeps wakes for delay_ns
+static void bench_wakeup(long long delay_ns, long long *late, int wakes, long long *abs_p99)
+{
+    static const char *names[] = {"nanosleep", "clock_nanosleep rel", "clock_nanosleep abs"};
+    struct timespec delay={delay_ns/NSEC_PER_SEC, delay_ns%NSEC_PER_SEC}, target, now;
+    long long start;
+    bench_dist_t d;
+    int kind, i;
+
+    for(kind=0; kind<3; kind++)
+    {
+        // the absolute sleep advances its target by delay_ns, like seqtimer.h
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        start=ts_ns(&now);
+
+        for(i=0; i<wakes; i++)
+        {
+            if(kind == 2)
+            {
+                target.tv_sec=(start + delay_ns)/NSEC_PER_SEC;
+                target.tv_nsec=(start + delay_ns)%NSEC_PER_SEC;
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL);
+            }
+            else if(kind == 1)
+                clock_nanosleep(CLOCK_MONOTONIC, 0, &delay, NULL);
+            else
+                nanosleep(&delay, NULL);
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            late[i]=ts_ns(&now) - start - delay_ns;
+
+            start=(kind == 2) ? start + delay_ns : ts_ns(&now);
+        }
+
+        distribution(late, wakes, &d);
+        printf("%-21s %5lld %9.1lf %9.1lf %9.1lf %9.1lf %9.1lf\n", names[kind], delay_ns/1000000,
+               d.min/1000.0, d.avg/1000.0, d.p50/1000.0, d.p99/1000.0, d.max/1000.0);
+
+        if(kind == 2 && d.p99 > *abs_p99) *abs_p99=d.p99;
+    }
+}
+
+
+static int run_bench(int calls, int wakes, bool fifo)
+{
+    struct sched_param param;
+    long long *buf, abs_p99=0;
+    clockid_t best=-1;
+    unsigned int c;
+
+    if(fifo)
+    {
+        param.sched_priority=sched_get_priority_max(SCHED_FIFO);
+        if(sched_setscheduler(getpid(), SCHED_FIFO, &param) != 0)
+            perror("sched_setscheduler, running SCHED_OTHER");
+    }
+
+    if((buf=(long long *)malloc((calls > wakes ? calls : wakes)*sizeof(long long))) == NULL)
+    {
+        printf("no memory for %d samples\n", calls);
+        return -1;
+    }
+
+    printf("Clock benchmark, %d reads per clock, %d wake-ups per sleep, %s\n", calls, wakes,
+           (sched_getscheduler(0) == SCHED_FIFO) ? "SCHED_FIFO" : "SCHED_OTHER");
+
+    bench_clocks_run(buf, calls, &best);
+    bench_counter(buf, calls);
+
+    printf("\n%-21s %5s %9s %9s %9s %9s %9s\n", "wake-up late", "msec", "min usec", "avg", "p50", "p99", "max");
+    bench_wakeup(10*NSEC_PER_SEC/1000, buf, wakes, &abs_p99);
+    bench_wakeup(NSEC_PER_SEC/1000, buf, wakes, &abs_p99);
+
+    free(buf);
+
+    printf("\n");
+    for(c=0; c<NUM_CLOCKS; c++)
+        if(bench_clocks[c].id == best)
+            printf("MY_CLOCK_TYPE: %s\n", bench_clocks[c].name);
+    if(best < 0)
+        printf("MY_CLOCK_TYPE: no clock below 1 usec resolution, keep CLOCK_MONOTONIC\n");
+
+    // seqtimer hybrid spins the last SEQT_SPIN_NSEC, 100 usec, before each tick
+    if(abs_p99 > 100000)
+        printf("seqtimer: abs sleeps wake up to %.1lf usec late, use -t hybrid with -j %lld or more\n",
+               abs_p99/1000.0, (abs_p99 + 999)/1000);
+    else
+        printf("seqtimer: abs sleeps wake within %.1lf usec, -t abs is enough, -t hybrid -j %lld for less jitter\n",
+               abs_p99/1000.0, (abs_p99 + 999)/1000);
+    printf("seqtimer: -t adaptive learns the spin from the wake-ups themselves, no -j needed\n");
+
+    return 0;
+}
+
 
 int main(int argc, char *argv[])
 {
     struct timespec delay_time={0,10000000};
     struct timespec remaining_time={0,1000000};
-    bool showRes = argc > 1;
+    bool showRes = false, bench = false, fifo = false;
+    int calls=BENCH_CALLS, wakes=BENCH_WAKES;
     int idx=0, rc;
 
+    while((rc=getopt(argc, argv, "rbn:w:f")) != -1)
+    {
+        switch(rc)
+        {
+            case 'r': showRes=true; break;
+            case 'b': bench=true; break;
+            case 'f': fifo=true; break;
+            case 'n': calls=atoi(optarg); break;
+            case 'w': wakes=atoi(optarg); break;
+            default:
+                printf("usage: clock_times [-r] | -b [-n calls] [-w wakes] [-f]\n");
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    // as before, any argument at all shows the resolution
+    if(optind < argc) showRes=true;
+
+    if(bench)
+    {
+        if(calls < 1 || wakes < 1)
+        {
+            printf("need at least one call and one wake-up\n");
+            exit(EXIT_FAILURE);
+        }
+        exit(run_bench(calls, wakes, fifo) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
     displayClock(CLOCK_REALTIME, "CLOCK_REALTIME", showRes);
 #ifdef CLOCK_TAI
     displayClock(CLOCK_TAI, "CLOCK_TAI", showRes);
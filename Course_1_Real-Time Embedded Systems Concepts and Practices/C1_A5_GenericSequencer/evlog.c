@@ -0,0 +1,374 @@
+// Lock-free in-memory event logger, see evlog.h
+//
+// The rings are plain SPSC queues: the service is the only writer of head,
+// the drain the only writer of tail.  The producer publishes an event with a
+// release store of head after filling the slot, the consumer frees the slot
+// with a release store of tail after reading it.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <syslog.h>
+
+#include "evlog.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+
+static evlog_ring_t rings[EVLOG_MAX_RINGS];
+static evlog_event_t *ring_events;
+static unsigned int ring_size=0, ring_mask;
+static clockid_t evlog_clk;
+static struct timespec evlog_start;
+
+static pthread_t drain_thread;
+static volatile int drain_running=0;
+
+// evlog_file() output, NULL for syslog
+static FILE *evlog_fp;
+static int labelled[EVLOG_MAX_RINGS];
+
+// evlog_tick0(), set before the first release so before any event
+static struct timespec tick0_ts;
+static int tick0_set=0, tick0_written=0;
+
+
+void evlog_init(clockid_t clk, const struct timespec *start)
+{
+    evlog_init_size(clk, start, EVLOG_RING_SIZE);
+}
+
+
+void evlog_init_size(clockid_t clk, const struct timespec *start, unsigned int nevents)
+{
+    unsigned int size=1;
+    size_t bytes;
+    int i;
+
+    evlog_clk=clk;
+
+    if(start)
+        evlog_start=*start;
+    else
+        clock_gettime(clk, &evlog_start);
+
+    while(size < nevents && size < EVLOG_RING_MAX)
+        size<<=1;
+
+    memset(rings, 0, sizeof(rings));
+    tick0_set=0;
+
+    // one block for every ring, resized only before any producer exists
+    bytes=(size_t)EVLOG_MAX_RINGS*size*sizeof(evlog_event_t);
+    if(size != ring_size)
+    {
+        free(ring_events);
+        if(posix_memalign((void **)&ring_events, EVLOG_CACHE_LINE, bytes) != 0)
+        {
+            printf("evlog: no memory for %d rings of %u events\n", EVLOG_MAX_RINGS, size);
+            exit(-1);
+        }
+        ring_size=size;
+        ring_mask=size-1;
+    }
+
+    // fault in every page now rather than on the first release
+    memset(ring_events, 0, bytes);
+    for(i=0; i<EVLOG_MAX_RINGS; i++)
+        rings[i].ev=&ring_events[(size_t)i*size];
+}
+
+
+unsigned int evlog_ring_events(double rate_hz, unsigned long long releases)
+{
+    double n=rate_hz*EVLOG_BACKLOG_SEC;
+
+    if(releases && (double)releases < n)
+        n=(double)releases;
+    if(n > EVLOG_RING_MAX)
+        n=EVLOG_RING_MAX;
+
+    return (n < 1.0) ? 1 : (unsigned int)n;
+}
+
+
+evlog_ring_t *evlog_ring(int id, const char *label)
+{
+    evlog_ring_t *ring;
+
+    if(id < 0 || id >= EVLOG_MAX_RINGS)
+    {
+        printf("evlog: ring %d out of range\n", id);
+        exit(-1);
+    }
+
+    ring=&rings[id];
+    ring->id=id;
+    snprintf(ring->label, sizeof(ring->label), "%s", label);
+
+    return ring;
+}
+
+
+void evlog_ring_task(evlog_ring_t *ring, unsigned int T, unsigned int C, unsigned int D, int priority, long long tick_ns, long long work_ns)
+{
+    ring->T=T;
+    ring->C=C;
+    ring->D=D;
+    ring->priority=priority;
+    ring->tick_ns=tick_ns;
+    ring->work_ns=work_ns;
+    ring->has_task=1;
+}
+
+
+static inline void put_event(evlog_ring_t *ring, unsigned long long count, int done)
+{
+    unsigned int head=ring->head;
+    unsigned int tail=__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    evlog_event_t *ev;
+
+    if((head - tail) >= ring_size)
+    {
+        ring->dropped++;
+        return;
+    }
+
+    ev=&ring->ev[head & ring_mask];
+    clock_gettime(evlog_clk, &ev->ts);
+    ev->count=count;
+    ev->id=ring->id;
+    ev->core=sched_getcpu();
+    ev->done=done;
+
+    __atomic_store_n(&ring->head, head+1, __ATOMIC_RELEASE);
+}
+
+
+void evlog_record(evlog_ring_t *ring, unsigned long long count)
+{
+    put_event(ring, count, 0);
+}
+
+
+void evlog_record_done(evlog_ring_t *ring, unsigned long long count)
+{
+    put_event(ring, count, 1);
+}
+
+
+void evlog_tick0(void)
+{
+    clock_gettime(evlog_clk, &tick0_ts);
+    __atomic_store_n(&tick0_set, 1, __ATOMIC_RELEASE);
+}
+
+
+static long long evlog_ns(const struct timespec *ts)
+{
+    return (long long)(ts->tv_sec - evlog_start.tv_sec)*NANOSEC_PER_SEC + (ts->tv_nsec - evlog_start.tv_nsec);
+}
+
+
+static double evlog_sec(const struct timespec *ts)
+{
+    return (double)(ts->tv_sec - evlog_start.tv_sec) +
+           ((double)(ts->tv_nsec - evlog_start.tv_nsec) / (double)NANOSEC_PER_SEC);
+}
+
+
+static void put_rec(int type, int id, int core, unsigned long long count, long long t_ns, const char *label)
+{
+    evlog_rec_t rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.type=type;
+    rec.id=id;
+    rec.core=core;
+    if(label)
+        snprintf(rec.u.label, EVLOG_LABEL_LEN, "%s", label);
+    else
+    {
+        rec.u.ev.count=count;
+        rec.u.ev.t_ns=t_ns;
+    }
+
+    fwrite(&rec, sizeof(rec), 1, evlog_fp);
+}
+
+
+// label of ring i, and its release parameters when it has them
+static void put_label(int i)
+{
+    evlog_ring_t *ring=&rings[i];
+    evlog_rec_t rec;
+
+    put_rec(EVLOG_REC_LABEL, i, 0, 0, 0, ring->label);
+    labelled[i]=1;
+
+    if(!ring->has_task)
+        return;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.type=EVLOG_REC_TASK;
+    rec.id=i;
+    rec.u.task.T=ring->T;
+    rec.u.task.C=ring->C;
+    rec.u.task.D=ring->D;
+    rec.u.task.priority=ring->priority;
+    rec.u.task.tick_ns=ring->tick_ns;
+    rec.u.task.work_ns=ring->work_ns;
+
+    fwrite(&rec, sizeof(rec), 1, evlog_fp);
+}
+
+
+int evlog_file(const char *path)
+{
+    if((evlog_fp=fopen(path, "wb")) == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    memset(labelled, 0, sizeof(labelled));
+    tick0_written=0;
+    put_rec(EVLOG_REC_HEADER, 0, 0, 0, 0, EVLOG_FILE_MAGIC);
+    return 0;
+}
+
+
+int evlog_dump(void)
+{
+    int i, n=0;
+    unsigned int head, tail;
+    evlog_ring_t *ring;
+    evlog_event_t *ev;
+
+    // tick 0 comes before any release, so before the first event in the file
+    if(evlog_fp && !tick0_written && __atomic_load_n(&tick0_set, __ATOMIC_ACQUIRE))
+    {
+        put_rec(EVLOG_REC_TICK0, 0, 0, 0, evlog_ns(&tick0_ts), (const char *)0);
+        tick0_written=1;
+    }
+
+    for(i=0; i<EVLOG_MAX_RINGS; i++)
+    {
+        ring=&rings[i];
+        tail=ring->tail;
+        head=__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        if(evlog_fp && tail != head && !labelled[i])
+            put_label(i);
+
+        while(tail != head)
+        {
+            ev=&ring->ev[tail & ring_mask];
+            if(evlog_fp)
+                put_rec(ev->done ? EVLOG_REC_DONE : EVLOG_REC_EVENT, i, ev->core, ev->count, evlog_ns(&ev->ts), (const char *)0);
+            else if(!ev->done)
+                syslog(LOG_CRIT, "%s on core %d for release %llu @ sec=%6.9lf\n",
+                       ring->label, ev->core, ev->count, evlog_sec(&ev->ts));
+            tail++; n++;
+
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        }
+    }
+
+    return n;
+}
+
+
+static void *evlog_drain(void *threadp)
+{
+    struct timespec period = {0, EVLOG_DRAIN_MSEC*1000000};
+
+    while(drain_running)
+    {
+        evlog_dump();
+        nanosleep(&period, (struct timespec *)0);
+    }
+
+    return (void *)0;
+}
+
+
+int evlog_drain_start(int cpu)
+{
+    pthread_attr_t attr;
+    struct sched_param param;
+    cpu_set_t cpuset;
+    int rc;
+
+    // callers are usually SCHED_FIFO, so do not inherit their policy
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    param.sched_priority=0;
+    pthread_attr_setschedparam(&attr, &param);
+
+    if(cpu >= 0)
+    {
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+    }
+
+    drain_running=1;
+
+    // fall back to an unpinned drain if the core is not in our cpuset
+    if((rc=pthread_create(&drain_thread, &attr, evlog_drain, (void *)0)) != 0 && cpu >= 0)
+    {
+        CPU_ZERO(&cpuset);
+        sched_getaffinity(0, sizeof(cpu_set_t), &cpuset);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        rc=pthread_create(&drain_thread, &attr, evlog_drain, (void *)0);
+    }
+
+    pthread_attr_destroy(&attr);
+
+    if(rc != 0)
+    {
+        drain_running=0;
+        printf("evlog: drain pthread_create failed, events dumped at exit\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void evlog_drain_stop(void)
+{
+    int i;
+
+    if(drain_running)
+    {
+        drain_running=0;
+        pthread_join(drain_thread, (void **)0);
+    }
+
+    evlog_dump();
+
+    for(i=0; i<EVLOG_MAX_RINGS; i++)
+    {
+        if(!rings[i].dropped)
+            continue;
+
+        if(evlog_fp)
+        {
+            if(!labelled[i]) put_label(i);
+            put_rec(EVLOG_REC_DROPPED, i, 0, rings[i].dropped, 0, (const char *)0);
+        }
+        syslog(LOG_CRIT, "%s dropped %u events, ring full\n", rings[i].label, rings[i].dropped);
+    }
+
+    if(evlog_fp)
+    {
+        fclose(evlog_fp);
+        evlog_fp=NULL;
+    }
+}
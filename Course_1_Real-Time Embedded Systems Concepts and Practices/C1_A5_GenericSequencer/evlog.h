@@ -0,0 +1,166 @@
+#ifndef _EVLOG_
+#define _EVLOG_
+
+// Lock-free in-memory event logger
+//
+// Each service thread owns one single-producer/single-consumer ring.  The
+// release path only reads the clock and the core number and stores a small
+// binary record; no formatting, no locks and no system call other than
+// clock_gettime, which is normally a vDSO read.
+//
+// A SCHED_OTHER drain thread, or evlog_dump() at exit, formats the records
+// and hands them to syslog with the same "... on core %d for release %llu
+// @ sec=%6.9lf" text the services used to log directly.
+//
+// If a ring is full the event is dropped and counted, the producer never
+// waits for the drain.
+//
+// The rings are allocated and faulted in by evlog_init(), EVLOG_RING_SIZE
+// events each, or sized by the caller with evlog_init_size() from its tick
+// rate and run length, so nothing is allocated or grows once releases
+// start, however long the run.
+//
+// With evlog_file() the drain writes the raw records to a binary file
+// instead of formatting them for syslog, evlog_rec_t in order, a header
+// first and a label record before the first event of each ring.  A long
+// soak then costs the drain one fwrite per record, and logcheck reads the
+// file back in the same pass as syslog text.
+//
+// For seqreplay the file can also carry what the run is compared against:
+// the release parameters of each ring's service, given with
+// evlog_ring_task() and written after its label, the time of the
+// sequencer's tick 0 from evlog_tick0(), and with evlog_record_done() the
+// completion of each release as well as its start.  Completions only go to
+// the file, the syslog text stays one line per release.
+//
+
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define EVLOG_MAX_RINGS (16)
+
+// default, 4096 events is about 80 sec of a 50 Hz service; sizes are
+// rounded up to a power of two and kept at most EVLOG_RING_MAX
+#define EVLOG_RING_SIZE (4096)
+#define EVLOG_RING_MAX (65536)
+
+// how long a drain stall the rings should ride out, for evlog_ring_events()
+#define EVLOG_BACKLOG_SEC (8)
+
+#define EVLOG_LABEL_LEN (32)
+#define EVLOG_CACHE_LINE (64)
+
+// default drain period, 10 Hz is well below any service rate
+#define EVLOG_DRAIN_MSEC (100)
+
+typedef struct
+{
+    struct timespec ts;         // raw clock value, converted only by the drain
+    unsigned long long count;   // release count of the service
+    int id;                     // thread index
+    int core;                   // sched_getcpu() at the time of the event
+    int done;                   // completion of release count, not its start
+} evlog_event_t;
+
+typedef struct
+{
+    // producer and consumer indices on their own cache lines so the service
+    // and the drain never share a line they both write
+    volatile unsigned int head __attribute__((aligned(EVLOG_CACHE_LINE)));
+    unsigned int dropped;
+
+    volatile unsigned int tail __attribute__((aligned(EVLOG_CACHE_LINE)));
+
+    int id;
+    char label[EVLOG_LABEL_LEN];
+
+    // evlog_ring_task() parameters, for the EVLOG_REC_TASK record
+    int has_task;
+    unsigned int T, C, D;
+    int priority;
+    long long tick_ns, work_ns;
+
+    evlog_event_t *ev;          // evlog_init_size() events, cache line aligned
+} evlog_ring_t;
+
+// evlog_file() records, 48 bytes each, host byte order
+#define EVLOG_FILE_MAGIC "EVLOG1"
+#define EVLOG_REC_HEADER (0)    // label holds EVLOG_FILE_MAGIC
+#define EVLOG_REC_LABEL (1)     // label of ring id
+#define EVLOG_REC_EVENT (2)     // ev of ring id
+#define EVLOG_REC_DROPPED (3)   // ev.count events of ring id lost, ring full
+#define EVLOG_REC_DONE (4)      // ev of ring id, release ev.count completed
+#define EVLOG_REC_TASK (5)      // task of ring id, after its label
+#define EVLOG_REC_TICK0 (6)     // ev.t_ns of the sequencer's tick 0, ring 0
+
+typedef struct
+{
+    int32_t type;
+    int32_t id;
+    int32_t core;
+    int32_t rsvd;
+    union
+    {
+        struct
+        {
+            uint64_t count;     // release count
+            int64_t t_ns;       // since the evlog_init() start
+        } ev;
+        char label[EVLOG_LABEL_LEN];
+        struct
+        {
+            uint32_t T, C, D;   // ticks, D 0 for D=T
+            int32_t priority;
+            int64_t tick_ns;
+            int64_t work_ns;    // busy work of each release, 0 for none
+        } task;
+    } u;
+} evlog_rec_t;
+
+// Timestamps come from clk and are reported relative to start, or to the
+// time of this call when start is NULL.  Touches every ring so no page is
+// first faulted on a release path.
+void evlog_init(clockid_t clk, const struct timespec *start);
+
+// Same, with rings of at least nevents events
+void evlog_init_size(clockid_t clk, const struct timespec *start, unsigned int nevents);
+
+// Ring size for a service released up to rate_hz times a second over a run
+// of releases in all, 0 for no limit: EVLOG_BACKLOG_SEC of releases, or the
+// whole run if that is less
+unsigned int evlog_ring_events(double rate_hz, unsigned long long releases);
+
+// Claim ring id for one producer thread, label prefixes each formatted line
+evlog_ring_t *evlog_ring(int id, const char *label);
+
+// Release parameters of the ring's service for the evlog_file(), T, C and
+// D in ticks of tick_ns, and work_ns of busy work done by each release;
+// call before the drain starts
+void evlog_ring_task(evlog_ring_t *ring, unsigned int T, unsigned int C, unsigned int D, int priority, long long tick_ns, long long work_ns);
+
+// Hot path, record one release of the ring's service
+void evlog_record(evlog_ring_t *ring, unsigned long long count);
+
+// Hot path, record the completion of release count, written only to an
+// evlog_file()
+void evlog_record_done(evlog_ring_t *ring, unsigned long long count);
+
+// From the sequencer, just before it releases tick 0
+void evlog_tick0(void);
+
+// Drain to binary file path instead of syslog, call before the drain
+// starts, returns 0 or -1
+int evlog_file(const char *path);
+
+// Start the drain thread at SCHED_OTHER, on core cpu if cpu >= 0
+int evlog_drain_start(int cpu);
+
+// Stop the drain thread and flush what is left, closing the evlog_file()
+void evlog_drain_stop(void);
+
+// Format and syslog, or write, everything in the rings, safe only from the consumer
+// side, i.e. the drain thread or after all producers have finished
+int evlog_dump(void);
+
+#endif
@@ -0,0 +1,486 @@
+// Post-run check of sequencer release logs
+//
+// Reads the syslog captures of the sequencer examples, e.g. syslog1_5.txt,
+// and the binary event logs of seqgen4 -L (evlog.h), in one streaming pass
+// each, and prints per service:
+//
+//    releases    events seen, and the first and last release number
+//    missed      release numbers skipped, plus events the ring dropped
+//    late        releases more than half a period after the last one
+//    period      average, shortest and longest time between releases
+//    jitter      largest and RMS difference of those from the period
+//    cores       cores it ran on and how often it moved between them
+//
+// The sequencers post every service once more when they shut down, so a
+// last release that comes less than half a period after the one before is
+// taken as that wake-up and left out of the timing.
+//
+// Two line forms are understood, wherever they sit in the syslog line:
+//
+//    <label> on core <c> for release <n> @ sec=<t>
+//    <label> start <n> @ sec=<t> on core <c>
+//
+// the first from evlog and the Course 1 sequencers, the second from the
+// Course 2 assignments.  A label that names its rate, "S1 50 Hz", or its
+// period in ticks, "S2 T=10" with -f for the tick rate, is checked
+// against it, as is a binary log service with the period it was run with;
+// for any other the measured average period is the reference and only
+// jitter, misses and late releases are flagged.  A rated service is also
+// expected to be released span*rate times, span the time from the first to
+// the last release of any service in the log, so one that fell silent, or
+// only ran at shutdown, is flagged even with nothing left to time.
+//
+//    logcheck [-f hz] [-p pct] [-j pct] file ...
+//
+//    -f  tick rate for T=<ticks> labels, default 100 Hz
+//    -p  allowed error of the average rate, default 1%
+//    -j  allowed jitter, largest difference from the period, default 10%
+//        of the period
+//
+// "-" reads stdin.  Exits 0 when every service is within its rate and
+// jitter with nothing missed, 1 when a service deviates, -1 on error.
+// Nothing is kept per event, so an hours long soak log is read at the
+// speed of the disk.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "evlog.h"
+
+#define TRUE (1)
+#define FALSE (0)
+
+#define MAX_SERVICES (64)
+#define MAX_CORES (64)
+#define LINE_LEN (1024)
+
+typedef struct
+{
+    char label[EVLOG_LABEL_LEN+32];
+    double rate_hz;                 // configured, 0 for none
+
+    unsigned long long events, first, last, missed, dropped, late, backwards;
+    double t_first, t_last;
+    int core, migrations;
+    unsigned long long on_core[MAX_CORES];
+
+    // intervals between consecutive releases, the latest held back until
+    // the next one shows it was not the shutdown wake-up
+    unsigned long long n;
+    double sum, sum_sq, min, max;
+    double pend;
+    int has_pend, shutdown;
+} svc_log_t;
+
+static svc_log_t svcs[MAX_SERVICES];
+static int nsvcs;
+
+// first and last release of any service, the span a rated service is
+// expected to have run for
+static double log_t_first, log_t_last;
+static int log_events;
+
+static double tick_hz=100.0;
+static double rate_pct=1.0, jitter_pct=10.0;
+
+
+// rate from "<x> Hz" or "T=<ticks>" in the label, 0 for neither
+static double label_rate(const char *label)
+{
+    const char *p;
+    double hz, ticks;
+
+    if((p=strstr(label, " Hz")) != NULL)
+    {
+        while(p > label && (p[-1] == '.' || (p[-1] >= '0' && p[-1] <= '9')))
+            p--;
+        if(sscanf(p, "%lf", &hz) == 1 && hz > 0.0)
+            return hz;
+    }
+
+    if((p=strstr(label, "T=")) != NULL && sscanf(p+2, "%lf", &ticks) == 1 && ticks > 0.0)
+        return tick_hz/ticks;
+
+    return 0.0;
+}
+
+
+static svc_log_t *service(const char *label, int len)
+{
+    int i;
+    svc_log_t *s;
+
+    if(len >= (int)sizeof(svcs[0].label))
+        len=sizeof(svcs[0].label)-1;
+
+    for(i=0; i<nsvcs; i++)
+        if(strncmp(svcs[i].label, label, len) == 0 && svcs[i].label[len] == '\0')
+            return &svcs[i];
+
+    if(nsvcs == MAX_SERVICES)
+        return (svc_log_t *)0;
+
+    s=&svcs[nsvcs++];
+    memset(s, 0, sizeof(svc_log_t));
+    memcpy(s->label, label, len);
+    s->label[len]='\0';
+    s->rate_hz=label_rate(s->label);
+    s->core=-1;
+
+    return s;
+}
+
+
+static void add_interval(svc_log_t *s, double dt)
+{
+    if(s->n++ == 0)
+        s->min=s->max=dt;
+    if(dt < s->min) s->min=dt;
+    if(dt > s->max) s->max=dt;
+    s->sum+=dt;
+    s->sum_sq+=dt*dt;
+}
+
+
+static void release(svc_log_t *s, unsigned long long n, double t, int core)
+{
+    double dt, period;
+
+    if(s == NULL) return;
+
+    if(log_events++ == 0) log_t_first=log_t_last=t;
+    if(t < log_t_first) log_t_first=t;
+    if(t > log_t_last) log_t_last=t;
+
+    if(core >= 0 && core < MAX_CORES)
+    {
+        s->on_core[core]++;
+        if(s->core >= 0 && core != s->core) s->migrations++;
+        s->core=core;
+    }
+
+    if(s->events++ == 0)
+    {
+        s->first=s->last=n;
+        s->t_first=s->t_last=t;
+        return;
+    }
+
+    // a repeated or older release number is counted but not timed
+    if(n <= s->last)
+    {
+        s->backwards++;
+        return;
+    }
+
+    s->missed+=n - s->last - 1;
+
+    // per release, so a gap is a miss and not jitter
+    dt=(t - s->t_last)/(double)(n - s->last);
+    period=s->rate_hz > 0.0 ? 1.0/s->rate_hz : 0.0;
+    if(period > 0.0 && (t - s->t_last) > (n - s->last)*period*1.5)
+        s->late++;
+
+    if(s->has_pend) add_interval(s, s->pend);
+    s->pend=dt;
+    s->has_pend=(n == s->last+1);
+    if(!s->has_pend) add_interval(s, dt);
+
+    s->last=n;
+    s->t_last=t;
+}
+
+
+// start of the label that ends at end, after the last ": " of the syslog
+// prefix or ]: of a tag
+static const char *label_start(const char *line, const char *end)
+{
+    const char *p;
+
+    for(p=end; p > line; p--)
+        if(p[-1] == ' ' && p-1 > line && p[-2] == ':')
+            return p;
+
+    return line;
+}
+
+
+static void parse_line(const char *line)
+{
+    const char *on, *rel, *at, *start;
+    unsigned long long n;
+    double t;
+    int core;
+
+    if((at=strstr(line, "@ sec=")) == NULL)
+        return;
+
+    // <label> on core <c> for release <n> @ sec=<t>, "forrelease" included
+    if((on=strstr(line, " on core ")) != NULL && on < at &&
+       (rel=strstr(on, "release ")) != NULL && rel < at &&
+       sscanf(on+9, "%d", &core) == 1 && sscanf(rel+8, "%llu", &n) == 1 && sscanf(at+6, "%lf", &t) == 1)
+    {
+        start=label_start(line, on);
+        release(service(start, (int)(on-start)), n, t, core);
+        return;
+    }
+
+    // <label> start <n> @ sec=<t> on core <c>
+    if((rel=strstr(line, " start ")) != NULL && rel < at &&
+       (on=strstr(at, " on core ")) != NULL &&
+       sscanf(rel+7, "%llu", &n) == 1 && sscanf(at+6, "%lf", &t) == 1 && sscanf(on+9, "%d", &core) == 1)
+    {
+        start=label_start(line, rel);
+        release(service(start, (int)(rel-start)), n, t, core);
+        return;
+    }
+}
+
+
+static void parse_dropped(const char *line)
+{
+    const char *d, *start;
+    unsigned long long n;
+    svc_log_t *s;
+
+    if((d=strstr(line, " dropped ")) == NULL || strstr(d, "events, ring full") == NULL || sscanf(d+9, "%llu", &n) != 1)
+        return;
+
+    start=label_start(line, d);
+    if((s=service(start, (int)(d-start))) != NULL)
+        s->dropped+=n;
+}
+
+
+static int read_text(FILE *fp)
+{
+    char line[LINE_LEN];
+
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        parse_line(line);
+        parse_dropped(line);
+    }
+
+    return 0;
+}
+
+
+static int read_evlog(FILE *fp, const char *path)
+{
+    evlog_rec_t rec;
+    svc_log_t *ring_svc[EVLOG_MAX_RINGS];
+    int id;
+
+    memset(ring_svc, 0, sizeof(ring_svc));
+
+    while(fread(&rec, sizeof(rec), 1, fp) == 1)
+    {
+        id=rec.id;
+        if(id < 0 || id >= EVLOG_MAX_RINGS)
+        {
+            printf("%s: ring %d out of range\n", path, id);
+            return -1;
+        }
+
+        switch(rec.type)
+        {
+            case EVLOG_REC_LABEL:
+                rec.u.label[EVLOG_LABEL_LEN-1]='\0';
+                ring_svc[id]=service(rec.u.label, (int)strlen(rec.u.label));
+                break;
+            case EVLOG_REC_EVENT:
+                release(ring_svc[id], rec.u.ev.count, rec.u.ev.t_ns/1e9, rec.core);
+                break;
+            case EVLOG_REC_DROPPED:
+                if(ring_svc[id]) ring_svc[id]->dropped+=rec.u.ev.count;
+                break;
+            case EVLOG_REC_TASK:
+                // the period the run was given beats one guessed from the label
+                if(ring_svc[id] && rec.u.task.T && rec.u.task.tick_ns > 0)
+                    ring_svc[id]->rate_hz=1e9/((double)rec.u.task.T*rec.u.task.tick_ns);
+                break;
+            case EVLOG_REC_HEADER:
+            case EVLOG_REC_DONE:
+            case EVLOG_REC_TICK0:
+                break;
+            default:
+                printf("%s: unknown record type %d\n", path, rec.type);
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int read_file(const char *path)
+{
+    FILE *fp;
+    evlog_rec_t hdr;
+    int c, rc;
+
+    if(strcmp(path, "-") == 0)
+        fp=stdin;
+    else if((fp=fopen(path, "rb")) == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    // a binary evlog starts with a zero header type byte, text never does
+    if((c=getc(fp)) != EOF) ungetc(c, fp);
+
+    if(c == 0)
+    {
+        if(fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.type != EVLOG_REC_HEADER ||
+           strncmp(hdr.u.label, EVLOG_FILE_MAGIC, EVLOG_LABEL_LEN) != 0)
+        {
+            printf("%s: not a text log or an evlog file\n", path);
+            rc=-1;
+        }
+        else
+            rc=read_evlog(fp, path);
+    }
+    else
+        rc=read_text(fp);
+
+    if(fp != stdin) fclose(fp);
+    return rc;
+}
+
+
+// prints one service, returns TRUE if it is off its rate or missed releases
+static int report(svc_log_t *s)
+{
+    double period, avg, rms, worst, rate, expected;
+    int c, deviates=FALSE, short_run=FALSE, ncores=0;
+    char cores[128];
+    int len=0;
+
+    // the last interval, unless it was the shutdown wake-up
+    if(s->has_pend)
+    {
+        period=(s->rate_hz > 0.0) ? 1.0/s->rate_hz : (s->n ? s->sum/s->n : 0.0);
+        if(period > 0.0 && s->pend < 0.5*period)
+            s->shutdown=TRUE;
+        else
+            add_interval(s, s->pend);
+        s->has_pend=FALSE;
+    }
+
+    avg=s->n ? s->sum/s->n : 0.0;
+    period=(s->rate_hz > 0.0) ? 1.0/s->rate_hz : avg;
+    rate=(avg > 0.0) ? 1.0/avg : 0.0;
+
+    // RMS and largest difference from the reference period
+    rms=s->n ? sqrt(fabs(s->sum_sq/s->n - 2.0*period*avg + period*period)) : 0.0;
+    worst=s->n ? fmax(fabs(s->max - period), fabs(period - s->min)) : 0.0;
+
+    cores[0]='\0';
+    for(c=0; c<MAX_CORES && len < (int)sizeof(cores)-8; c++)
+        if(s->on_core[c])
+        {
+            len+=snprintf(cores+len, sizeof(cores)-len, "%s%d", ncores ? "," : "", c);
+            ncores++;
+        }
+
+    printf("%-20s %8llu %8llu..%-8llu %6llu %6llu %10.3lf %10.3lf %10.3lf %10.1lf %10.1lf  %-8s %4d",
+           s->label, s->events, s->first, s->last, s->missed + s->dropped, s->late,
+           avg*1e3, s->min*1e3, s->max*1e3, worst*1e6, rms*1e6, cores, s->migrations);
+
+    // a rated service is released span*rate times over the whole log, one
+    // either way for where the capture starts and stops
+    expected=(log_t_last - log_t_first)*s->rate_hz;
+    if(s->rate_hz > 0.0 && (s->events < 2 || (double)s->events < expected*(1.0 - rate_pct/100.0) - 1.0))
+    {
+        printf("  RATE %llu of %.0lf releases in %.3lf sec", s->events, expected, log_t_last - log_t_first);
+        short_run=deviates=TRUE;
+    }
+
+    if(s->n == 0)
+    {
+        printf("%s\n", short_run ? "  MISSED" : "  one release, nothing to time");
+        return deviates;
+    }
+
+    if(s->rate_hz > 0.0 && fabs(rate - s->rate_hz) > s->rate_hz*rate_pct/100.0)
+    {
+        printf("  RATE %.3lf Hz, not %.3lf", rate, s->rate_hz);
+        deviates=TRUE;
+    }
+    if(worst > period*jitter_pct/100.0)
+    {
+        printf("  JITTER %.1lf%%", 100.0*worst/period);
+        deviates=TRUE;
+    }
+    if(short_run || s->missed + s->dropped + s->late)
+    {
+        printf("  MISSED");
+        deviates=TRUE;
+    }
+    if(s->backwards)
+        printf("  %llu out of order", s->backwards);
+    if(s->shutdown)
+        printf("  (last release at shutdown, untimed)");
+
+    printf("%s\n", deviates ? "" : "  ok");
+    return deviates;
+}
+
+
+static void usage(void)
+{
+    printf("usage: logcheck [-f hz] [-p pct] [-j pct] file ...\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    int i, j, opt, bad=0;
+
+    while((opt=getopt(argc, argv, "f:p:j:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'f':
+                tick_hz=atof(optarg);
+                break;
+            case 'p':
+                rate_pct=atof(optarg);
+                break;
+            case 'j':
+                jitter_pct=atof(optarg);
+                break;
+            default:
+                usage(); exit(-1);
+        }
+    }
+
+    if(optind == argc || tick_hz <= 0.0)
+    {
+        usage(); exit(-1);
+    }
+
+    for(i=optind; i<argc; i++)
+    {
+        nsvcs=0; log_events=0;
+        if(read_file(argv[i]) != 0) exit(-1);
+
+        printf("%s: %d services\n", argv[i], nsvcs);
+        printf("%-20s %8s %18s %6s %6s %10s %10s %10s %10s %10s  %-8s %4s\n",
+               "service", "releases", "first..last", "missed", "late",
+               "T avg ms", "T min ms", "T max ms", "jit max us", "jit rms us", "cores", "migr");
+
+        for(j=0; j<nsvcs; j++)
+            bad+=report(&svcs[j]);
+
+        if(i+1 < argc) printf("\n");
+    }
+
+    exit(bad ? 1 : 0);
+}
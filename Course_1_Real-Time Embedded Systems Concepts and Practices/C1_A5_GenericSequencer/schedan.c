@@ -0,0 +1,494 @@
+// Feasibility analysis of a periodic service set, see schedan.h
+//
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "schedan.h"
+
+// hyperperiods above this use floating point for the U <= 1 test
+#define SA_MAX_EXACT_H (1ULL << 40)
+
+// float slack for the LUB and hyperbolic bounds
+#define SA_EPSILON (1e-12)
+
+static const char *order_names[SA_ORDERS] = {"FP", "RM", "DM"};
+
+
+const char *sa_order_name(int order)
+{
+    return order_names[order];
+}
+
+
+static unsigned long long gcd(unsigned long long a, unsigned long long b)
+{
+    unsigned long long t;
+
+    while(b) { t=a%b; a=b; b=t; }
+    return a;
+}
+
+
+static unsigned long long ceil_div(unsigned long long a, unsigned long long b)
+{
+    return (a + b - 1) / b;
+}
+
+
+// a before b in the given priority order, index breaks ties
+static int runs_before(const sa_task_t *task, int order, int a, int b)
+{
+    const sa_task_t *ta=&task[a], *tb=&task[b];
+
+    switch(order)
+    {
+        case SA_FP:
+            if(ta->priority != tb->priority) return ta->priority > tb->priority;
+            break;
+        case SA_RM:
+            if(ta->T != tb->T) return ta->T < tb->T;
+            if(ta->D != tb->D) return ta->D < tb->D;
+            break;
+        case SA_DM:
+            if(ta->D != tb->D) return ta->D < tb->D;
+            if(ta->T != tb->T) return ta->T < tb->T;
+            break;
+    }
+
+    return a < b;
+}
+
+
+// task indices in the given priority order
+static void sort_order(const sa_task_t *task, int n, int order, int *idx)
+{
+    int i, j, t;
+
+    for(i=0; i<n; i++) idx[i]=i;
+
+    for(i=1; i<n; i++)
+    {
+        t=idx[i];
+        for(j=i; j>0 && runs_before(task, order, t, idx[j-1]); j--)
+            idx[j]=idx[j-1];
+        idx[j]=t;
+    }
+}
+
+
+// worst case response time of each task in order, 0 once past its deadline
+//
+// With D > T a job can still be running when the next one is released, so
+// every job in the level-i busy period is checked, Lehoczky's
+// w(q) = (q+1)Ci + Bi + sum ceil(w/Tj)Cj, R = max w(q) - qTi.  Classic RM
+// is judged against D=T, as in the assignment sheets.
+static int rta(const sa_task_t *task, int n, int order, unsigned long long *R)
+{
+    int idx[SA_MAX_TASKS];
+    int j, p, t, ok=1;
+    unsigned long long w, next, q, resp, worst, D;
+
+    sort_order(task, n, order, idx);
+
+    for(p=0; p<n; p++)
+    {
+        t=idx[p];
+        D=(order == SA_RM) ? task[t].T : task[t].D;
+        worst=0;
+
+        // start from the critical instant demand of this level
+        w=task[t].B;
+        for(j=0; j<p; j++) w+=task[idx[j]].C;
+
+        for(q=0; ; q++)
+        {
+            w+=task[t].C;
+
+            while(1)
+            {
+                next=(q+1)*task[t].C + task[t].B;
+                for(j=0; j<p; j++)
+                    next+=ceil_div(w, task[idx[j]].T) * task[idx[j]].C;
+
+                if(next == w || next - q*task[t].T > D) { w=next; break; }
+                w=next;
+            }
+
+            resp=w - q*task[t].T;
+            if(resp > worst) worst=resp;
+
+            // past the deadline, or the busy period ended with this job
+            if(worst > D || w <= (q+1)*task[t].T) break;
+        }
+
+        if(worst <= D)
+            R[t]=worst;
+        else
+        {
+            R[t]=0;
+            ok=0;
+        }
+    }
+
+    return ok;
+}
+
+
+// U > 1 decided exactly over the hyperperiod where it fits
+static int over_utilized(const sa_task_t *task, int n, double U)
+{
+    unsigned long long H=1, demand=0;
+    int i;
+
+    for(i=0; i<n; i++)
+    {
+        H=(H/gcd(H, task[i].T))*task[i].T;
+        if(H > SA_MAX_EXACT_H) return U > 1.0 + SA_EPSILON;
+    }
+
+    for(i=0; i<n; i++)
+        demand+=(H/task[i].T)*task[i].C;
+
+    return demand > H;
+}
+
+
+static void edf(const sa_task_t *task, int n, sa_result_t *r)
+{
+    unsigned long long L, next, d, dbf;
+    int i, j, implicit=1;
+
+    r->edf_ok=1;
+    r->edf_t=0;
+    r->busy_period=0;
+
+    if(over_utilized(task, n, r->U))
+    {
+        r->edf_ok=0;
+        return;
+    }
+
+    for(i=0; i<n; i++)
+        if(task[i].D != task[i].T) implicit=0;
+
+    // synchronous busy period, converges because U <= 1
+    L=0;
+    for(i=0; i<n; i++) L+=task[i].C;
+
+    while(1)
+    {
+        next=0;
+        for(i=0; i<n; i++)
+            next+=ceil_div(L, task[i].T) * task[i].C;
+
+        if(next == L) break;
+        L=next;
+    }
+    r->busy_period=L;
+
+    // D=T, U <= 1 is exact
+    if(implicit) return;
+
+    for(i=0; i<n; i++)
+    {
+        for(d=task[i].D; d<=L; d+=task[i].T)
+        {
+            dbf=0;
+            for(j=0; j<n; j++)
+                if(d >= task[j].D)
+                    dbf+=((d - task[j].D)/task[j].T + 1) * task[j].C;
+
+            if(dbf > d && (r->edf_ok || d < r->edf_t))
+            {
+                r->edf_ok=0;
+                r->edf_t=d;
+            }
+        }
+    }
+}
+
+
+int sa_from_table(const service_desc_t *table, int n, sa_task_t *task)
+{
+    int i;
+
+    if(n > SA_MAX_TASKS)
+    {
+        printf("sa_from_table: %d services, at most %d\n", n, SA_MAX_TASKS);
+        return -1;
+    }
+
+    for(i=0; i<n; i++)
+    {
+        if(table[i].wcet == 0)
+        {
+            printf("sa_from_table: %s has no C\n", table[i].name);
+            return -1;
+        }
+
+        task[i].T=table[i].divisor;
+        task[i].C=table[i].wcet;
+        task[i].D=table[i].deadline ? table[i].deadline : table[i].divisor;
+        task[i].priority=table[i].priority;
+        task[i].B=0;
+    }
+
+    return n;
+}
+
+
+int sa_analyze(const sa_task_t *task, int n, sa_result_t *r)
+{
+    double prod=1.0;
+    int i, order;
+
+    memset(r, 0, sizeof(sa_result_t));
+
+    if(n < 1 || n > SA_MAX_TASKS)
+    {
+        printf("sa_analyze: %d tasks, expected 1 to %d\n", n, SA_MAX_TASKS);
+        return -1;
+    }
+
+    for(i=0; i<n; i++)
+    {
+        if(task[i].T == 0 || task[i].C == 0 || task[i].D == 0)
+        {
+            printf("sa_analyze: task %d needs T, C and D > 0, has T=%u C=%u D=%u\n",
+                   i, task[i].T, task[i].C, task[i].D);
+            return -1;
+        }
+
+        r->U+=(double)task[i].C/task[i].T;
+        prod*=(double)task[i].C/task[i].T + 1.0;
+    }
+
+    r->n=n;
+    r->lub=n*(pow(2.0, 1.0/n) - 1.0);
+    r->lub_ok=(r->U <= r->lub + SA_EPSILON);
+    r->hyper=prod;
+    r->hyper_ok=(prod <= 2.0 + SA_EPSILON);
+
+    for(order=0; order<SA_ORDERS; order++)
+        r->rta_ok[order]=rta(task, n, order, r->R[order]);
+
+    edf(task, n, r);
+
+    return 0;
+}
+
+
+void sa_report(const sa_task_t *task, const sa_result_t *r, const char *name)
+{
+    int i, order, blocking=0;
+
+    for(i=0; i<r->n; i++)
+        if(task[i].B) blocking=1;
+
+    printf("\n%s: %d services, U=%.4lf\n", name, r->n, r->U);
+    printf("  LUB        %.4lf %s\n", r->lub, r->lub_ok ? "pass, RM feasible" : "fail, inconclusive");
+    printf("  hyperbolic %.4lf %s\n", r->hyper, r->hyper_ok ? "pass, RM feasible" : "fail, inconclusive");
+
+    printf("  %-8s %4s %4s %4s", "service", "T", "C", "D");
+    if(blocking) printf(" %4s", "B");
+    for(order=0; order<SA_ORDERS; order++)
+        printf("  R %s", order_names[order]);
+    printf("\n");
+
+    for(i=0; i<r->n; i++)
+    {
+        printf("  %-8d %4u %4u %4u", i+1, task[i].T, task[i].C, task[i].D);
+        if(blocking) printf(" %4u", task[i].B);
+        for(order=0; order<SA_ORDERS; order++)
+        {
+            if(r->R[order][i]) printf(" %5llu", r->R[order][i]);
+            else printf(" %5s", "miss");
+        }
+        printf("\n");
+    }
+
+    for(order=0; order<SA_ORDERS; order++)
+        printf("  RTA %s     %s\n", order_names[order], r->rta_ok[order] ? "feasible" : "not feasible");
+
+    if(r->edf_ok)
+        printf("  EDF        feasible, busy period %llu\n", r->busy_period);
+    else if(r->edf_t)
+        printf("  EDF        not feasible, demand exceeds t=%llu\n", r->edf_t);
+    else
+        printf("  EDF        not feasible, U > 1\n");
+}
+
+
+static double demand(const sa_task_t *task, const int *idx, int p, unsigned long long t)
+{
+    double W=0.0;
+    int j;
+
+    for(j=0; j<=p; j++)
+        W+=(double)ceil_div(t, task[idx[j]].T) * task[idx[j]].C;
+
+    return W;
+}
+
+
+double sa_scaling(const sa_task_t *task, int n, int order)
+{
+    int idx[SA_MAX_TASKS];
+    int p, j, t;
+    unsigned long long D, k, point;
+    double alpha=0.0, best, a;
+
+    if(n < 1 || n > SA_MAX_TASKS) return 0.0;
+
+    sort_order(task, n, order, idx);
+
+    for(p=0; p<n; p++)
+    {
+        t=idx[p];
+        D=(order == SA_RM || task[t].D > task[t].T) ? task[t].T : task[t].D;
+
+        // the deadline and every higher priority release before it, less
+        // the blocking, which does not scale with C
+        best=(D > task[t].B) ? (double)(D - task[t].B) / demand(task, idx, p, D) : 0.0;
+        for(j=0; j<p; j++)
+        {
+            for(k=1; (point=k*task[idx[j]].T) < D && k <= SA_MAX_POINTS; k++)
+            {
+                if(point <= task[t].B) continue;
+                a=(double)(point - task[t].B) / demand(task, idx, p, point);
+                if(a > best) best=a;
+            }
+        }
+
+        if(p == 0 || best < alpha) alpha=best;
+    }
+
+    return alpha;
+}
+
+
+double sa_edf_scaling(const sa_task_t *task, int n)
+{
+    unsigned long long next[SA_MAX_TASKS];
+    unsigned long long H=1, end, d, dmax=0;
+    double U=0.0, slack=0.0, alpha, dbf, a, La;
+    int i, j, points=0;
+
+    if(n < 1 || n > SA_MAX_TASKS) return 0.0;
+
+    for(i=0; i<n; i++)
+    {
+        U+=(double)task[i].C/task[i].T;
+        if(task[i].D > dmax) dmax=task[i].D;
+        if(task[i].D < task[i].T) slack+=(double)(task[i].T - task[i].D)*task[i].C/task[i].T;
+        if(H <= SA_MAX_EXACT_H) H=(H/gcd(H, task[i].T))*task[i].T;
+    }
+    alpha=1.0/U;
+
+    // past H+Dmax the demand only grows by U*t
+    end=H + dmax;
+
+    for(i=0; i<n && task[i].D == task[i].T; i++);
+    if(i == n) return alpha;
+
+    // any absolute deadline can be where t/dbf(t) is least, taken in time
+    // order so the cap cuts the horizon short rather than some services
+    for(i=0; i<n; i++) next[i]=task[i].D;
+
+    while(points++ < SA_MAX_POINTS)
+    {
+        d=next[0];
+        for(i=1; i<n; i++)
+            if(next[i] < d) d=next[i];
+        if(d > end) break;
+
+        dbf=0.0;
+        for(j=0; j<n; j++)
+        {
+            if(d >= task[j].D)
+                dbf+=(double)((d - task[j].D)/task[j].T + 1) * task[j].C;
+            if(next[j] == d) next[j]+=task[j].T;
+        }
+
+        a=(double)d/dbf;
+        if(a < alpha)
+        {
+            // a set of utilization aU < 1 can only fail before
+            // La = max(Dmax, a sum (Ti-Di)Ui / (1-aU)), Baruah et al.
+            alpha=a;
+            La=alpha*slack/(1.0 - alpha*U);
+            if(La < dmax) La=dmax;
+            if(La < end) end=(unsigned long long)La;
+        }
+    }
+
+    return alpha;
+}
+
+
+int sa_blocking(sa_task_t *task, int n, const sa_cs_t *cs, int ncs, int protocol)
+{
+    static unsigned int longest[SA_MAX_TASKS][SA_MAX_RESOURCES];
+    int idx[SA_MAX_TASKS], rank[SA_MAX_TASKS], top[SA_MAX_RESOURCES];
+    unsigned int m, worst, by_task, by_res;
+    int i, j, k, p;
+
+    if(n < 1 || n > SA_MAX_TASKS) return -1;
+
+    sort_order(task, n, SA_FP, idx);
+    for(p=0; p<n; p++) rank[idx[p]]=p;
+
+    // longest section of each task on each resource, and the rank of its
+    // highest priority user, the ceiling
+    memset(longest, 0, sizeof(longest));
+    for(k=0; k<SA_MAX_RESOURCES; k++) top[k]=n;
+
+    for(i=0; i<ncs; i++)
+    {
+        if(cs[i].task < 0 || cs[i].task >= n || cs[i].resource < 0 || cs[i].resource >= SA_MAX_RESOURCES)
+        {
+            printf("sa_blocking: critical section %d on task %d resource %d out of range\n", i, cs[i].task, cs[i].resource);
+            return -1;
+        }
+
+        if(cs[i].ticks > longest[cs[i].task][cs[i].resource])
+            longest[cs[i].task][cs[i].resource]=cs[i].ticks;
+        if(rank[cs[i].task] < top[cs[i].resource])
+            top[cs[i].resource]=rank[cs[i].task];
+    }
+
+    for(i=0; i<n; i++)
+    {
+        worst=0; by_task=0; by_res=0;
+
+        for(j=0; j<n; j++)
+        {
+            if(rank[j] <= rank[i]) continue;
+
+            m=0;
+            for(k=0; k<SA_MAX_RESOURCES; k++)
+                if(top[k] <= rank[i] && longest[j][k] > m) m=longest[j][k];
+
+            by_task+=m;
+            if(m > worst) worst=m;
+        }
+
+        for(k=0; k<SA_MAX_RESOURCES; k++)
+        {
+            if(top[k] > rank[i]) continue;
+
+            m=0;
+            for(j=0; j<n; j++)
+                if(rank[j] > rank[i] && longest[j][k] > m) m=longest[j][k];
+            by_res+=m;
+        }
+
+        if(protocol == SA_CEILING)
+            task[i].B=worst;
+        else
+            task[i].B=(by_task < by_res) ? by_task : by_res;
+    }
+
+    return 0;
+}
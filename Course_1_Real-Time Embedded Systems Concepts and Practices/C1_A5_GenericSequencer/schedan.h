@@ -0,0 +1,117 @@
+#ifndef _SCHEDAN_
+#define _SCHEDAN_
+
+// Feasibility analysis of a periodic service set, single core
+//
+// Runs the tests behind the Course 2 assignments on a task set in integer
+// sequencer ticks, so a configuration can be rejected before any SCHED_FIFO
+// thread is started:
+//
+//    LUB         U <= n(2^(1/n)-1), Liu and Layland, sufficient for RM
+//    hyperbolic  prod(Ui+1) <= 2, Bini and Buttazzo, sufficient for RM
+//    RTA         exact response time analysis, R = C + sum ceil(R/Tj)Cj over
+//                the higher priority services, for the table's own
+//                priorities and deadline monotonic order against D, and
+//                rate monotonic order against D=T; D > T is allowed
+//    EDF         U <= 1 when every D=T, otherwise the processor demand test
+//                dbf(t) <= t at every absolute deadline in the synchronous
+//                busy period
+//
+// and, for capacity planning, the critical scaling factor: how far every C
+// can be scaled together before the set stops being feasible, times U the
+// breakdown utilization.
+//
+// Services that share a resource (seqshare.h) can be blocked by a lower
+// priority one holding it.  sa_blocking() bounds that per service as B,
+// which RTA adds as R = C + B + sum ceil(R/Tj)Cj and the scaling factor
+// keeps unscaled.  The EDF test does not include B.
+//
+// All of it is integer arithmetic apart from the two utilization bounds,
+// so a set of a few services takes microseconds.
+//
+
+#include "seqtable.h"
+
+#define SA_MAX_TASKS (64)
+
+// priority orders the response time analysis is run for
+#define SA_FP (0)       // table priorities, what seqgen4 runs
+#define SA_RM (1)
+#define SA_DM (2)
+#define SA_ORDERS (3)
+
+typedef struct
+{
+    unsigned int T, C, D;       // ticks, D=T when the row has none
+    int priority;               // higher runs first, as SCHED_FIFO
+    unsigned int B;             // blocking, 0 unless set by sa_blocking
+} sa_task_t;
+
+// a service holding a shared resource for up to ticks per job
+typedef struct
+{
+    int task;
+    int resource;
+    unsigned int ticks;
+} sa_cs_t;
+
+#define SA_MAX_RESOURCES (16)
+
+// resource protocols, as SHR_INHERIT and SHR_CEILING in seqshare.h
+#define SA_INHERIT (0)
+#define SA_CEILING (1)
+
+typedef struct
+{
+    int n;
+    double U, lub, hyper;
+    int lub_ok, hyper_ok;
+
+    // per order, response times in ticks, 0 when it went past D
+    unsigned long long R[SA_ORDERS][SA_MAX_TASKS];
+    int rta_ok[SA_ORDERS];
+
+    int edf_ok;
+    unsigned long long edf_t;           // first t with dbf(t) > t
+    unsigned long long busy_period;
+} sa_result_t;
+
+// Tasks from n service table rows, returns n or -1 if there are too many
+// or a row has no C
+int sa_from_table(const service_desc_t *table, int n, sa_task_t *task);
+
+// Run every test, returns 0 or -1 for a bad task set
+int sa_analyze(const sa_task_t *task, int n, sa_result_t *r);
+
+// Print the bounds, response times and verdicts
+void sa_report(const sa_task_t *task, const sa_result_t *r, const char *name);
+
+const char *sa_order_name(int order);
+
+// Critical scaling factor, the largest a with every C scaled by a still
+// feasible, Lehoczky's min over i of max over scheduling points t <= Di of
+// t / sum ceil(t/Tj)Cj.  A D above T is taken as T here, so for those rows
+// the factor is a lower bound.
+double sa_scaling(const sa_task_t *task, int n, int order);
+
+// Same for EDF, min of 1/U and t/dbf(t) over the absolute deadlines of the
+// first hyperperiod plus the longest D, or the first SA_MAX_POINTS of them
+double sa_edf_scaling(const sa_task_t *task, int n);
+
+#define SA_MAX_POINTS (1000000)
+
+// Set B of every task from the ncs critical sections, by table priority
+// with equal priorities in index order as in RTA.  A resource can block
+// task i if a task after i uses it and one at or above i does, so its
+// ceiling is at or above i:
+//
+//    SA_CEILING   B = the longest such critical section, only one can
+//                 be in progress when i is released
+//    SA_INHERIT   B = the lesser of the sum over lower tasks of their
+//                 longest such section and the sum over such resources of
+//                 their longest section by a lower task, Sha et al.
+//
+// Returns 0 or -1 for a bad task or resource index.
+int sa_blocking(sa_task_t *task, int n, const sa_cs_t *cs, int ncs, int protocol);
+
+#endif
@@ -0,0 +1,292 @@
+// Feasibility check of a periodic service set from the command line
+//
+//    schedcheck [-p rm|dm|edf] [-g rm|dm|edf|llf|fp [-n ticks] [-C]] T:C[:D] ...
+//    schedcheck [-p rm|dm|edf] -x file ...
+//    schedcheck [-p rm|dm|edf] -M cores [-f ff|wf] T:C[:D] ...
+//
+// Each argument is one service with period T, execution time C and
+// optionally deadline D in the same unit, e.g. the Course 2 assignment 6
+// set in 10 msec ticks:
+//
+//    schedcheck -p dm 2:1:2 5:1:4 7:1:7 13:2:13
+//
+// Services are given rate monotonic priorities, so FP and RM agree.  Prints
+// the schedan.h report and how long the analysis took, and exits 0 when the
+// set is feasible under the -p policy, rm by default, 1 when it is not.
+//
+// With -g the set is also run through the schedsim.h event simulator under
+// the given policy for -n ticks, one hyperperiod by default, and the
+// timeline is printed as a Gantt chart like the sched-example sheets, or as
+// CSV slices with -C.  The exit status is then whether the simulation
+// missed a deadline.
+//
+// With -M the set is partitioned over that many cores, first fit or worst
+// fit decreasing by utilization against the exact test of the -p policy
+// on each core (schedmc.h), and the global EDF bounds are checked.  The
+// exit status is then whether every service found a core.
+//
+// With -x the arguments are Cheddar XML models (cheddar.h), e.g.
+//
+//    schedcheck -x ../C1_A6_CheddarAnalysisSchedules/*/*[^gx]
+//
+// and each one is loaded and analyzed in turn, FP being the ranking of the
+// model's own scheduler.  One verdict line is printed per file, the full
+// report when there is only one, then the files per second of the whole
+// load and analysis.  Exits 0 only when every file is feasible.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "schedan.h"
+#include "cheddar.h"
+#include "schedsim.h"
+#include "schedmc.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+#define TRUE (1)
+#define FALSE (0)
+
+// repeat the analysis to time it above the clock resolution
+#define TIMING_RUNS (1000)
+
+
+static void usage(void)
+{
+    printf("usage: schedcheck [-p rm|dm|edf] [-g rm|dm|edf|llf|fp [-n ticks] [-C]] T:C[:D] ...\n");
+    printf("       schedcheck [-p rm|dm|edf] -x file ...\n");
+    printf("       schedcheck [-p rm|dm|edf] -M cores [-f ff|wf] T:C[:D] ...\n");
+}
+
+
+static double elapsed_usec(struct timespec *start, struct timespec *stop)
+{
+    return ((stop->tv_sec - start->tv_sec)*(double)NANOSEC_PER_SEC + (stop->tv_nsec - start->tv_nsec))/1000.0;
+}
+
+
+static int feasible_under(const sa_result_t *r, int policy)
+{
+    return (policy < 0) ? r->edf_ok : r->rta_ok[policy];
+}
+
+
+// Simulate the set under policy, returns the number of missed deadlines or
+// -1 if it could not be simulated
+static int simulate(const sa_task_t *task, int n, int policy, unsigned long long horizon, int csv)
+{
+    ss_trace_t trace;
+    struct timespec start, stop;
+    unsigned long long misses;
+
+    if(horizon == 0 && (horizon=ss_hyperperiod(task, n)) == 0)
+    {
+        printf("hyperperiod does not fit 64 bits, give -n\n");
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(ss_simulate(task, n, policy, horizon, TRUE, &trace) != 0) return -1;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    if(csv)
+        ss_csv(&trace, stdout);
+    else
+    {
+        ss_report(&trace, "schedcheck", policy);
+        printf("  simulation took %.3lf usec\n\n", elapsed_usec(&start, &stop));
+        ss_gantt(task, &trace, stdout);
+    }
+
+    misses=trace.total_misses;
+    ss_free(&trace);
+
+    return misses ? 1 : 0;
+}
+
+
+// Partition over cores 0..m-1, returns the services left without a core or
+// -1 if it could not be done
+static int partition(sa_task_t *task, int n, int m, int heuristic, int policy)
+{
+    int cores[SMC_MAX_CORES], core[SA_MAX_TASKS];
+    smc_global_t g;
+    int i, overflow;
+
+    if(m < 1 || m > SMC_MAX_CORES)
+    {
+        printf("1 to %d cores\n", SMC_MAX_CORES);
+        return -1;
+    }
+
+    for(i=0; i<m; i++) cores[i]=i;
+
+    // deadline monotonic priorities for a dm partition
+    if(policy == SA_DM)
+        for(i=0; i<n; i++) task[i].priority=-(int)task[i].D;
+
+    if((overflow=smc_partition(task, n, cores, m, heuristic, (policy < 0) ? SMC_EDF : SMC_FP, core)) < 0)
+        return -1;
+
+    printf("\n%d services on %d cores, %s decreasing against %s\n", n, m, smc_heuristic_name(heuristic),
+           (policy < 0) ? "EDF" : sa_order_name(policy));
+    smc_report(task, n, cores, m, core);
+    if(overflow)
+        printf("  %d services did not fit, placed on the least loaded core\n", overflow);
+
+    smc_global(task, n, m, &g);
+    printf("  global EDF   U=%.4lf Umax=%.4lf density=%.4lf max density=%.4lf\n", g.U, g.Umax, g.density, g.dmax);
+    printf("    U <= m     %s\n", g.necessary_ok ? "pass" : "fail, not feasible on any scheduler");
+    printf("    GFB bound  %.4lf %s\n", m - (m-1)*g.dmax, g.gfb_ok ? "pass, feasible" : "fail, inconclusive");
+
+    return overflow;
+}
+
+
+// Load and analyze each Cheddar file, returns the number not feasible, or
+// -1 if one could not be read
+static int check_models(char **files, int nfiles, int policy)
+{
+    static ch_model_t model;
+    sa_task_t task[SA_MAX_TASKS];
+    sa_result_t result;
+    struct timespec start, stop;
+    double usec;
+    int i, n, failed=0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(i=0; i<nfiles; i++)
+    {
+        if((n=ch_load(files[i], &model)) < 0) return -1;
+
+        ch_to_tasks(&model, task);
+        if(sa_analyze(task, n, &result) != 0) return -1;
+
+        if(!feasible_under(&result, policy)) failed++;
+
+        if(nfiles == 1)
+            sa_report(task, &result, files[i]);
+        else
+            printf("%-3s U=%.4lf FP %-3s RM %-3s DM %-3s EDF %-3s %s\n",
+                   feasible_under(&result, policy) ? "ok" : "NOT", result.U,
+                   result.rta_ok[SA_FP] ? "ok" : "no", result.rta_ok[SA_RM] ? "ok" : "no",
+                   result.rta_ok[SA_DM] ? "ok" : "no", result.edf_ok ? "ok" : "no", files[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    usec=elapsed_usec(&start, &stop);
+
+    printf("  %d models loaded and analyzed in %.1lf usec, %.0lf per second\n", nfiles, usec, nfiles/(usec/1000000.0));
+    return failed;
+}
+
+
+int main(int argc, char *argv[])
+{
+    sa_task_t task[SA_MAX_TASKS];
+    sa_result_t result;
+    struct timespec start, stop;
+    double usec;
+    char *end;
+    unsigned long long horizon=0;
+    int i, n=0, opt, policy=SA_RM, models=0, sim=-1, csv=FALSE, ncores=0, heuristic=SMC_FIRST_FIT;
+
+    while((opt=getopt(argc, argv, "p:xg:n:CM:f:")) != -1)
+    {
+        if(opt == 'M') { ncores=atoi(optarg); continue; }
+        if(opt == 'f')
+        {
+            if((heuristic=smc_heuristic(optarg)) < 0)
+            {
+                printf("unknown heuristic %s\n", optarg);
+                usage(); exit(-1);
+            }
+            continue;
+        }
+        if(opt == 'x') { models=1; continue; }
+        if(opt == 'C') { csv=TRUE; continue; }
+        if(opt == 'n') { horizon=strtoull(optarg, (char **)0, 10); continue; }
+        if(opt == 'g')
+        {
+            if((sim=ss_policy(optarg)) < 0)
+            {
+                printf("unknown simulation policy %s\n", optarg);
+                usage(); exit(-1);
+            }
+            continue;
+        }
+        if(opt != 'p') { usage(); exit(-1); }
+
+        if(strcmp(optarg, "rm") == 0) policy=SA_RM;
+        else if(strcmp(optarg, "dm") == 0) policy=SA_DM;
+        else if(strcmp(optarg, "edf") == 0) policy=-1;
+        else
+        {
+            printf("unknown policy %s\n", optarg);
+            usage(); exit(-1);
+        }
+    }
+
+    if(models)
+    {
+        if(optind == argc) { usage(); exit(-1); }
+
+        if((n=check_models(&argv[optind], argc-optind, policy)) < 0) exit(-1);
+        return n ? 1 : 0;
+    }
+
+    for(i=optind; i<argc; i++)
+    {
+        if(n == SA_MAX_TASKS)
+        {
+            printf("at most %d services\n", SA_MAX_TASKS);
+            exit(-1);
+        }
+
+        task[n].T=strtoul(argv[i], &end, 10);
+        task[n].C=(*end == ':') ? strtoul(end+1, &end, 10) : 0;
+        task[n].D=(*end == ':') ? strtoul(end+1, &end, 10) : task[n].T;
+
+        if(*end != '\0' || task[n].C == 0)
+        {
+            printf("bad service \"%s\", expected T:C or T:C:D\n", argv[i]);
+            usage(); exit(-1);
+        }
+
+        // shorter period, higher priority
+        task[n].priority=-(int)task[n].T;
+        task[n].B=0;
+        n++;
+    }
+
+    if(n == 0) { usage(); exit(-1); }
+
+    if(ncores)
+    {
+        if((i=partition(task, n, ncores, heuristic, policy)) < 0) exit(-1);
+        return i ? 1 : 0;
+    }
+
+    if(sim >= 0)
+    {
+        if((i=simulate(task, n, sim, horizon, csv)) < 0) exit(-1);
+        return i;
+    }
+
+    if(sa_analyze(task, n, &result) != 0) exit(-1);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i=0; i<TIMING_RUNS; i++)
+        sa_analyze(task, n, &result);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    usec=elapsed_usec(&start, &stop)/TIMING_RUNS;
+
+    sa_report(task, &result, "schedcheck");
+    printf("  analysis took %.3lf usec\n", usec);
+
+    return feasible_under(&result, policy) ? 0 : 1;
+}
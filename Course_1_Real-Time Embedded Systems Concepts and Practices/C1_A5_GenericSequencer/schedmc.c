@@ -0,0 +1,150 @@
+// Multicore analysis of a periodic service set, see schedmc.h
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schedmc.h"
+
+static const char *heuristic_names[] = {"ff", "wf"};
+
+
+int smc_heuristic(const char *name)
+{
+    if(strcmp(name, "ff") == 0) return SMC_FIRST_FIT;
+    if(strcmp(name, "wf") == 0) return SMC_WORST_FIT;
+    return -1;
+}
+
+
+const char *smc_heuristic_name(int heuristic)
+{
+    return heuristic_names[heuristic];
+}
+
+
+// the services on one core plus t pass the core's test
+static int fits(const sa_task_t *task, const int *member, int count, int t, int test)
+{
+    sa_task_t sub[SA_MAX_TASKS];
+    sa_result_t r;
+    int i;
+
+    if(count + 1 > SA_MAX_TASKS) return 0;
+
+    for(i=0; i<count; i++) sub[i]=task[member[i]];
+    sub[count]=task[t];
+
+    if(sa_analyze(sub, count+1, &r) != 0) return 0;
+
+    return (test == SMC_EDF) ? r.edf_ok : r.rta_ok[SA_FP];
+}
+
+
+int smc_partition(const sa_task_t *task, int n, const int *cores, int ncores, int heuristic, int test, int *core)
+{
+    static int member[SMC_MAX_CORES][SA_MAX_TASKS];
+    int count[SMC_MAX_CORES], order[SA_MAX_TASKS];
+    double load[SMC_MAX_CORES], util[SA_MAX_TASKS];
+    int i, j, k, t, pick, best, overflow=0;
+
+    if(n > SA_MAX_TASKS || ncores < 1 || ncores > SMC_MAX_CORES)
+    {
+        printf("smc_partition: %d services on %d cores, at most %d on 1 to %d\n", n, ncores, SA_MAX_TASKS, SMC_MAX_CORES);
+        return -1;
+    }
+
+    for(k=0; k<ncores; k++) { load[k]=0.0; count[k]=0; }
+
+    for(i=0; i<n; i++)
+    {
+        util[i]=(double)task[i].C/task[i].T;
+        order[i]=i;
+    }
+
+    // decreasing utilization
+    for(i=1; i<n; i++)
+    {
+        t=order[i];
+        for(j=i; j>0 && util[order[j-1]] < util[t]; j--)
+            order[j]=order[j-1];
+        order[j]=t;
+    }
+
+    for(i=0; i<n; i++)
+    {
+        t=order[i];
+        pick=-1;
+
+        for(k=0; k<ncores; k++)
+        {
+            if(heuristic == SMC_WORST_FIT && pick >= 0 && load[k] >= load[pick]) continue;
+            if(!fits(task, member[k], count[k], t, test)) continue;
+
+            pick=k;
+            if(heuristic == SMC_FIRST_FIT) break;
+        }
+
+        if(pick < 0)
+        {
+            best=0;
+            for(k=1; k<ncores; k++)
+                if(load[k] < load[best]) best=k;
+            pick=best;
+            overflow++;
+        }
+
+        if(count[pick] < SA_MAX_TASKS) member[pick][count[pick]++]=t;
+        load[pick]+=util[t];
+        core[t]=cores[pick];
+    }
+
+    return overflow;
+}
+
+
+void smc_global(const sa_task_t *task, int n, int m, smc_global_t *g)
+{
+    double u, d;
+    int i;
+
+    memset(g, 0, sizeof(smc_global_t));
+    g->m=m;
+    g->necessary_ok=1;
+
+    for(i=0; i<n; i++)
+    {
+        u=(double)task[i].C/task[i].T;
+        d=(double)task[i].C/((task[i].D < task[i].T) ? task[i].D : task[i].T);
+
+        g->U+=u;
+        g->density+=d;
+        if(u > g->Umax) g->Umax=u;
+        if(d > g->dmax) g->dmax=d;
+        if(task[i].C > task[i].D) g->necessary_ok=0;
+    }
+
+    if(g->U > m + 1e-12) g->necessary_ok=0;
+    g->gfb_ok=(g->density <= m - (m-1)*g->dmax + 1e-12);
+}
+
+
+void smc_report(const sa_task_t *task, int n, const int *cores, int ncores, const int *core)
+{
+    double U;
+    int i, k, count;
+
+    for(k=0; k<ncores; k++)
+    {
+        U=0.0; count=0;
+        printf("  core %d:", cores[k]);
+        for(i=0; i<n; i++)
+        {
+            if(core[i] != cores[k]) continue;
+            printf(" %d", i+1);
+            U+=(double)task[i].C/task[i].T;
+            count++;
+        }
+        printf("%s  %d services, U=%.3lf\n", count ? "" : " -", count, U);
+    }
+}
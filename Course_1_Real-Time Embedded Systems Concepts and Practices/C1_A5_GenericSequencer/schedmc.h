@@ -0,0 +1,54 @@
+#ifndef _SCHEDMC_
+#define _SCHEDMC_
+
+// Multicore analysis of a periodic service set, on top of schedan.h
+//
+// Partitioned: services are sorted by decreasing utilization and placed
+// one at a time, first fit or worst fit, on a core only if the services
+// already there plus the new one still pass the exact single core test,
+// RTA with the table priorities or the EDF demand test.  That packs the
+// tighter harmonic sets the Liu and Layland bound of coremap_pack() turns
+// away.
+//
+// Global EDF: the Goossens, Funk and Baruah bound on m cores,
+// U <= m - (m-1)Umax, in its density form for D < T, sufficient only, next
+// to the necessary U <= m.
+//
+// The partition is in real core numbers, so it goes straight into the
+// service table's core column, see seqgen4 -c.
+//
+
+#include "schedan.h"
+
+#define SMC_FIRST_FIT (0)
+#define SMC_WORST_FIT (1)
+
+#define SMC_FP (0)      // RTA with the table priorities on each core
+#define SMC_EDF (1)     // processor demand test on each core
+
+#define SMC_MAX_CORES (64)
+
+typedef struct
+{
+    int m;
+    double U, Umax, density, dmax;
+    int necessary_ok;           // U <= m and every Ui <= 1
+    int gfb_ok;                 // density bound, global EDF feasible
+} smc_global_t;
+
+// Heuristic from "ff" or "wf", -1 if unknown
+int smc_heuristic(const char *name);
+const char *smc_heuristic_name(int heuristic);
+
+// Place n services on the ncores cores in cores[], core[i] gets the core of
+// service i.  A service that fits nowhere goes to the least loaded core and
+// the call returns how many did, 0 when every core passes its test.
+int smc_partition(const sa_task_t *task, int n, const int *cores, int ncores, int heuristic, int test, int *core);
+
+// Global EDF bounds on m cores
+void smc_global(const sa_task_t *task, int n, int m, smc_global_t *g);
+
+// Services and utilization of each core of a partition
+void smc_report(const sa_task_t *task, int n, const int *cores, int ncores, const int *core);
+
+#endif
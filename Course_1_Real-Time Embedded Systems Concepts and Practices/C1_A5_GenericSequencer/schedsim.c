@@ -0,0 +1,446 @@
+// Discrete event simulation of a periodic service set, see schedsim.h
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "schedsim.h"
+
+static const char *policy_names[SS_POLICIES] = {"rm", "dm", "edf", "llf", "fp"};
+
+// binary min-heap of service indices on key[], index breaks ties
+typedef struct
+{
+    int *idx;
+    int n;
+    const unsigned long long *key;
+} ss_heap_t;
+
+// per service simulation state
+typedef struct
+{
+    unsigned long long head_release;    // of the oldest pending job
+    unsigned long long remaining;       // of the oldest pending job
+    unsigned long long pending;
+} ss_svc_t;
+
+
+int ss_policy(const char *name)
+{
+    int i;
+
+    for(i=0; i<SS_POLICIES; i++)
+        if(strcmp(name, policy_names[i]) == 0) return i;
+
+    return -1;
+}
+
+
+const char *ss_policy_name(int policy)
+{
+    return policy_names[policy];
+}
+
+
+static unsigned long long gcd(unsigned long long a, unsigned long long b)
+{
+    unsigned long long t;
+
+    while(b) { t=a%b; a=b; b=t; }
+    return a;
+}
+
+
+unsigned long long ss_hyperperiod(const sa_task_t *task, int n)
+{
+    unsigned long long H=1, m;
+    int i;
+
+    for(i=0; i<n; i++)
+    {
+        m=H/gcd(H, task[i].T);
+        if(m > ~0ULL/task[i].T) return 0;
+        H=m*task[i].T;
+    }
+
+    return H;
+}
+
+
+static int heap_less(const ss_heap_t *h, int a, int b)
+{
+    if(h->key[a] != h->key[b]) return h->key[a] < h->key[b];
+    return a < b;
+}
+
+
+static void heap_push(ss_heap_t *h, int t)
+{
+    int i=h->n++, parent;
+
+    while(i > 0)
+    {
+        parent=(i-1)/2;
+        if(!heap_less(h, t, h->idx[parent])) break;
+        h->idx[i]=h->idx[parent];
+        i=parent;
+    }
+    h->idx[i]=t;
+}
+
+
+static int heap_pop(ss_heap_t *h)
+{
+    int top=h->idx[0], last=h->idx[--h->n];
+    int i=0, child;
+
+    while((child=2*i+1) < h->n)
+    {
+        if(child+1 < h->n && heap_less(h, h->idx[child+1], h->idx[child])) child++;
+        if(!heap_less(h, h->idx[child], last)) break;
+        h->idx[i]=h->idx[child];
+        i=child;
+    }
+    if(h->n) h->idx[i]=last;
+
+    return top;
+}
+
+
+static int add_slice(ss_trace_t *tr, int task, unsigned long long start, unsigned long long end)
+{
+    ss_slice_t *s;
+
+    if(tr->nslices && tr->slice[tr->nslices-1].task == task && tr->slice[tr->nslices-1].end == start)
+    {
+        tr->slice[tr->nslices-1].end=end;
+        return 0;
+    }
+
+    if(tr->nslices == tr->max_slices)
+    {
+        tr->max_slices=tr->max_slices ? 2*tr->max_slices : 1024;
+        if((s=(ss_slice_t *)realloc(tr->slice, tr->max_slices*sizeof(ss_slice_t))) == NULL)
+        {
+            printf("ss_simulate: no memory for %d slices\n", tr->max_slices);
+            return -1;
+        }
+        tr->slice=s;
+    }
+
+    tr->slice[tr->nslices].task=task;
+    tr->slice[tr->nslices].start=start;
+    tr->slice[tr->nslices].end=end;
+    tr->nslices++;
+
+    return 0;
+}
+
+
+static void miss(ss_trace_t *tr, int t, unsigned long long deadline)
+{
+    tr->misses[t]++;
+    tr->total_misses++;
+
+    if(tr->first_miss_task < 0 || deadline < tr->first_miss)
+    {
+        tr->first_miss=deadline;
+        tr->first_miss_task=t;
+    }
+}
+
+
+static long long laxity(const sa_task_t *task, const ss_svc_t *svc, int t, unsigned long long now)
+{
+    return (long long)(svc[t].head_release + task[t].D) - (long long)now - (long long)svc[t].remaining;
+}
+
+
+static int least_laxity(const sa_task_t *task, const ss_svc_t *svc, int n, int running, unsigned long long now)
+{
+    long long lax, best_lax=0;
+    int i, best=-1;
+
+    // the running job keeps the core on a tie
+    if(running >= 0 && svc[running].pending)
+    {
+        best=running;
+        best_lax=laxity(task, svc, running, now);
+    }
+
+    for(i=0; i<n; i++)
+    {
+        if(!svc[i].pending || i == best) continue;
+
+        lax=laxity(task, svc, i, now);
+        if(best < 0 || lax < best_lax) { best=i; best_lax=lax; }
+    }
+
+    return best;
+}
+
+
+int ss_simulate(const sa_task_t *task, int n, int policy, unsigned long long horizon, int keep_slices, ss_trace_t *tr)
+{
+    ss_svc_t *svc;
+    ss_heap_t rel, ready;
+    unsigned long long *rel_key, *ready_key;
+    unsigned long long now=0, end, next_rel, ran, d;
+    long long lc, lw;
+    int i, cur, last=-1, rc=0;
+
+    memset(tr, 0, sizeof(ss_trace_t));
+    tr->first_miss_task=-1;
+
+    if(n < 1 || policy < 0 || policy >= SS_POLICIES)
+    {
+        printf("ss_simulate: %d tasks, policy %d\n", n, policy);
+        return -1;
+    }
+
+    for(i=0; i<n; i++)
+    {
+        if(task[i].T == 0 || task[i].C == 0 || task[i].D == 0)
+        {
+            printf("ss_simulate: task %d needs T, C and D > 0\n", i);
+            return -1;
+        }
+    }
+
+    tr->n=n;
+    tr->horizon=horizon;
+    tr->jobs=(unsigned long long *)calloc(n, sizeof(unsigned long long));
+    tr->misses=(unsigned long long *)calloc(n, sizeof(unsigned long long));
+    tr->worst_resp=(unsigned long long *)calloc(n, sizeof(unsigned long long));
+    svc=(ss_svc_t *)calloc(n, sizeof(ss_svc_t));
+    rel_key=(unsigned long long *)calloc(n, sizeof(unsigned long long));
+    ready_key=(unsigned long long *)calloc(n, sizeof(unsigned long long));
+    rel.idx=(int *)malloc(n*sizeof(int));
+    ready.idx=(int *)malloc(n*sizeof(int));
+
+    if(!tr->jobs || !tr->misses || !tr->worst_resp || !svc || !rel_key || !ready_key || !rel.idx || !ready.idx)
+    {
+        printf("ss_simulate: no memory for %d tasks\n", n);
+        rc=-1;
+        goto out;
+    }
+
+    rel.n=0; rel.key=rel_key;
+    ready.n=0; ready.key=ready_key;
+
+    // synchronous release, every service due at 0
+    for(i=0; i<n; i++)
+        heap_push(&rel, i);
+
+    while(now < horizon)
+    {
+        // releases due now
+        while(rel.n && rel_key[rel.idx[0]] <= now)
+        {
+            i=heap_pop(&rel);
+
+            if(svc[i].pending++ == 0)
+            {
+                svc[i].head_release=rel_key[i];
+                svc[i].remaining=task[i].C;
+
+                if(policy != SS_LLF)
+                {
+                    ready_key[i]=(policy == SS_RM) ? task[i].T :
+                                 (policy == SS_DM) ? task[i].D :
+                                 (policy == SS_FP) ? (unsigned long long)((long long)INT_MAX - task[i].priority) :
+                                 svc[i].head_release + task[i].D;
+                    heap_push(&ready, i);
+                }
+            }
+
+            rel_key[i]+=task[i].T;
+            heap_push(&rel, i);
+            tr->events++;
+        }
+
+        if(policy == SS_LLF)
+            cur=least_laxity(task, svc, n, last, now);
+        else
+            cur=ready.n ? ready.idx[0] : -1;
+
+        if(last >= 0 && cur != last && svc[last].pending && svc[last].remaining < task[last].C)
+            tr->preemptions++;
+
+        next_rel=rel_key[rel.idx[0]];
+        end=(next_rel < horizon) ? next_rel : horizon;
+
+        if(cur < 0)
+        {
+            if(keep_slices && add_slice(tr, SS_IDLE, now, end) != 0) { rc=-1; goto out; }
+            now=end;
+            last=-1;
+            continue;
+        }
+
+        if(now + svc[cur].remaining < end) end=now + svc[cur].remaining;
+
+        // under LLF a waiting job's laxity falls a tick per tick, the
+        // running one's does not, so stop where the first one goes below
+        if(policy == SS_LLF)
+        {
+            lc=laxity(task, svc, cur, now);
+            for(i=0; i<n; i++)
+            {
+                if(i == cur || !svc[i].pending) continue;
+
+                lw=laxity(task, svc, i, now);
+                if(lw >= lc && now + (unsigned long long)(lw - lc) + 1 < end)
+                    end=now + (unsigned long long)(lw - lc) + 1;
+            }
+        }
+
+        if(keep_slices && add_slice(tr, cur, now, end) != 0) { rc=-1; goto out; }
+
+        ran=end - now;
+        now=end;
+        svc[cur].remaining-=ran;
+        last=cur;
+
+        if(svc[cur].remaining)
+            continue;
+
+        // completion of the oldest pending job
+        tr->events++;
+        tr->jobs[cur]++;
+        if(now - svc[cur].head_release > tr->worst_resp[cur])
+            tr->worst_resp[cur]=now - svc[cur].head_release;
+        if(now > svc[cur].head_release + task[cur].D)
+            miss(tr, cur, svc[cur].head_release + task[cur].D);
+
+        if(policy != SS_LLF) heap_pop(&ready);
+
+        if(--svc[cur].pending)
+        {
+            svc[cur].head_release+=task[cur].T;
+            svc[cur].remaining=task[cur].C;
+
+            if(policy != SS_LLF)
+            {
+                if(policy == SS_EDF) ready_key[cur]=svc[cur].head_release + task[cur].D;
+                heap_push(&ready, cur);
+            }
+        }
+    }
+
+    // jobs still pending whose deadline is inside the horizon missed it too
+    for(i=0; i<n; i++)
+    {
+        for(d=svc[i].head_release + task[i].D; svc[i].pending && d <= horizon; d+=task[i].T)
+        {
+            miss(tr, i, d);
+            svc[i].pending--;
+        }
+    }
+
+out:
+    free(svc); free(rel_key); free(ready_key); free(rel.idx); free(ready.idx);
+    if(rc != 0) ss_free(tr);
+
+    return rc;
+}
+
+
+void ss_free(ss_trace_t *tr)
+{
+    free(tr->jobs); free(tr->misses); free(tr->worst_resp); free(tr->slice);
+    tr->jobs=tr->misses=tr->worst_resp=(unsigned long long *)0;
+    tr->slice=(ss_slice_t *)0;
+    tr->nslices=tr->max_slices=0;
+}
+
+
+void ss_report(const ss_trace_t *tr, const char *name, int policy)
+{
+    int i;
+
+    printf("\n%s: %s simulation of %llu ticks, %llu events, %llu preemptions\n",
+           name, policy_names[policy], tr->horizon, tr->events, tr->preemptions);
+    printf("  %-8s %10s %10s %10s\n", "service", "jobs", "missed", "worst R");
+
+    for(i=0; i<tr->n; i++)
+        printf("  %-8d %10llu %10llu %10llu\n", i+1, tr->jobs[i], tr->misses[i], tr->worst_resp[i]);
+
+    if(tr->first_miss_task < 0)
+        printf("  no deadline missed\n");
+    else
+        printf("  %llu deadlines missed, first by service %d at t=%llu\n",
+               tr->total_misses, tr->first_miss_task+1, tr->first_miss);
+}
+
+
+void ss_gantt(const sa_task_t *task, const ss_trace_t *tr, FILE *fp)
+{
+    unsigned long long H=tr->horizon, t, r, done, need, k;
+    char *row, *missed;
+    int i, s;
+
+    row=(char *)malloc(H+1);
+    missed=(char *)malloc(H);
+    if(!row || !missed)
+    {
+        free(row); free(missed);
+        printf("ss_gantt: no memory for %llu ticks\n", H);
+        return;
+    }
+
+    // tick numbers, 1 based as in the sheets
+    fprintf(fp, "%-8s ", "");
+    for(t=0; t<H; t++) fputc((t+1) % 10 == 0 ? '0' + (int)(((t+1)/10) % 10) : ' ', fp);
+    fprintf(fp, "\n%-8s ", "tick");
+    for(t=0; t<H; t++) fputc('0' + (int)((t+1) % 10), fp);
+    fputc('\n', fp);
+
+    for(i=0; i<tr->n; i++)
+    {
+        memset(row, ' ', H);
+        memset(missed, 0, H);
+        row[H]='\0';
+
+        for(s=0; s<tr->nslices; s++)
+            if(tr->slice[s].task == i)
+                memset(row + tr->slice[s].start, '#', tr->slice[s].end - tr->slice[s].start);
+
+        // walk the jobs in order, each done once C ticks of its service ran
+        done=0;
+        t=0;
+        for(k=0, r=0; r<H; k++, r+=task[i].T)
+        {
+            need=(k+1)*task[i].C;
+            if(t < r) t=r;
+
+            while(t < H && done < need)
+            {
+                if(row[t] == '#') done++;
+                else row[t]='-';
+                t++;
+            }
+
+            if(done < need || t > r + task[i].D)
+                if(r + task[i].D < H) missed[r + task[i].D]=1;
+        }
+
+        for(t=0; t<H; t++)
+            if(missed[t]) row[t]='X';
+
+        fprintf(fp, "S%-7d %s\n", i+1, row);
+    }
+
+    free(row); free(missed);
+}
+
+
+void ss_csv(const ss_trace_t *tr, FILE *fp)
+{
+    int s;
+
+    fprintf(fp, "service,start,end\n");
+    for(s=0; s<tr->nslices; s++)
+        fprintf(fp, "%d,%llu,%llu\n", tr->slice[s].task+1, tr->slice[s].start, tr->slice[s].end);
+}
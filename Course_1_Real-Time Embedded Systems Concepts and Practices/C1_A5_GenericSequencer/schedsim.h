@@ -0,0 +1,86 @@
+#ifndef _SCHEDSIM_
+#define _SCHEDSIM_
+
+// Offline discrete event simulation of a periodic service set, single core
+//
+// Runs the schedan.h task set on a simulated core in integer ticks from the
+// synchronous release at 0, so the timeline of the Course 2 sched-example
+// sheets can be drawn without running the services in real time.  Time
+// jumps from event to event, a release or the completion of the running
+// job, rather than stepping every tick:
+//
+//    RM, DM   fixed priority by T or D, ready services in a heap
+//    EDF      earliest absolute deadline first, ready services in a heap
+//    LLF      least laxity first, ready services scanned, the running one
+//             keeps the core on a laxity tie
+//    FP       fixed priority by the task's own priority, higher first, as
+//             SCHED_FIFO runs the table rows
+//
+// Jobs are never dropped, a late job runs to completion and is counted as
+// missed, and with D > T a service can have several jobs pending.
+//
+// The trace is kept as run slices, printed either as a Gantt chart with one
+// row per service and one column per tick like the sheets, or as CSV.
+//
+
+#include <stdio.h>
+
+#include "schedan.h"
+
+#define SS_RM (0)
+#define SS_DM (1)
+#define SS_EDF (2)
+#define SS_LLF (3)
+#define SS_FP (4)
+#define SS_POLICIES (5)
+
+// service index of a slice the core was idle for
+#define SS_IDLE (-1)
+
+typedef struct
+{
+    unsigned long long start, end;      // ticks, end is exclusive
+    int task;                           // SS_IDLE for none
+} ss_slice_t;
+
+typedef struct
+{
+    int n;
+    unsigned long long horizon;
+
+    // per service
+    unsigned long long *jobs, *misses, *worst_resp;
+
+    unsigned long long first_miss;      // deadline of the first miss
+    int first_miss_task;                // -1 when nothing missed
+    unsigned long long total_misses, preemptions, events;
+
+    // run slices, only kept when asked for
+    ss_slice_t *slice;
+    int nslices, max_slices;
+} ss_trace_t;
+
+// Policy from "rm", "dm", "edf", "llf" or "fp", -1 if unknown
+int ss_policy(const char *name);
+const char *ss_policy_name(int policy);
+
+// LCM of the periods, 0 if it does not fit 64 bits
+unsigned long long ss_hyperperiod(const sa_task_t *task, int n);
+
+// Simulate [0, horizon), keeping the slices when keep_slices is set.
+// Returns 0, or -1 for a bad task set or no memory.
+int ss_simulate(const sa_task_t *task, int n, int policy, unsigned long long horizon, int keep_slices, ss_trace_t *tr);
+
+void ss_free(ss_trace_t *tr);
+
+// Jobs, misses and worst response time of each service
+void ss_report(const ss_trace_t *tr, const char *name, int policy);
+
+// One row per service, '#' running, '-' released and waiting, 'X' on the
+// tick a deadline was missed.  Needs the slices.
+void ss_gantt(const sa_task_t *task, const ss_trace_t *tr, FILE *fp);
+
+// service,start,end rows of the slices, service 0 is idle
+void ss_csv(const ss_trace_t *tr, FILE *fp);
+
+#endif
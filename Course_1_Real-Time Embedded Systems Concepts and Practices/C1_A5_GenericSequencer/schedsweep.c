@@ -0,0 +1,509 @@
+// Design space sweep of periodic service sets, spread over every core
+//
+//    schedsweep [-j threads] [-p rm|dm|edf] T[-Tmax]:C[:D] ...
+//    schedsweep [-j threads] -u [-n services] [-N sets] [-U lo:hi:step] [-T min:max] [-D] [-S seed]
+//
+// Grid mode takes a service set like schedcheck, e.g. the Course 2
+// assignment 4 set in 10 msec ticks, and a period can be a range:
+//
+//    schedsweep 2:1 5:1 7:1 13:2
+//    schedsweep 2:1 4-6:1 7-9:1 10-16:2
+//
+// For the set at the low end of each range it prints the critical scaling
+// factor and breakdown utilization under FP, RM, DM and EDF (schedan.h)
+// and how far each service's C can grow on its own before the set stops
+// being feasible under the -p policy, rm by default.  With ranges every
+// period combination is analyzed and the number feasible under each
+// policy is counted, along with the feasible one of highest U and the
+// infeasible one of lowest U.
+//
+// -u instead draws random sets of -n services, 5 by default, with UUniFast
+// utilizations for each total U from lo to hi in steps of step, default
+// 0.5:1.0:0.05, -N sets each, periods log-uniform over -T, default 10:1000
+// ticks, and D=T or with -D uniform in [C, T].  The acceptance ratio of
+// each test and the mean DM and EDF breakdown utilization are printed per
+// U.  Each set is drawn from its own seed, so the result does not depend
+// on -j.
+//
+// Sets are handed to -j worker threads, one per online core by default,
+// in chunks taken off a shared counter.  Services get rate monotonic
+// priorities, so FP and RM agree.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <sys/sysinfo.h>
+
+#include "schedan.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+#define TRUE (1)
+#define FALSE (0)
+
+// sets a worker takes off the counter at a time
+#define SWEEP_CHUNK (64)
+
+#define MAX_THREADS (64)
+#define MAX_BINS (1000)
+
+typedef struct
+{
+    unsigned long long sets, lub, rm, dm, edf;
+    double breakdown_dm, breakdown_edf;
+} sweep_bin_t;
+
+typedef struct
+{
+    unsigned long long sets, fp, rm, dm, edf;
+    double best_U, worst_U;              // feasible with most U, infeasible with least
+    unsigned long long best, worst;      // their combination index, ~0 for none
+} sweep_grid_t;
+
+typedef struct
+{
+    pthread_t thread;
+    sweep_bin_t bin[MAX_BINS];
+    sweep_grid_t grid;
+} sweep_worker_t;
+
+// grid mode
+static sa_task_t base[SA_MAX_TASKS];
+static unsigned int tmax[SA_MAX_TASKS];
+static int nservices;
+static unsigned long long ncombos;
+
+// random mode
+static int random_mode=FALSE, constrained=FALSE;
+static int nbins;
+static double u_lo=0.5, u_hi=1.0, u_step=0.05;
+static unsigned int t_min=10, t_max=1000, seed=1;
+static unsigned long long nsets=1000;
+
+static int policy=SA_RM;
+static unsigned long long next_item, nitems;
+static sweep_worker_t *workers;
+
+
+static void usage(void)
+{
+    printf("usage: schedsweep [-j threads] [-p rm|dm|edf] T[-Tmax]:C[:D] ...\n");
+    printf("       schedsweep [-j threads] -u [-n services] [-N sets] [-U lo:hi:step] [-T min:max] [-D] [-S seed]\n");
+}
+
+
+static int feasible_under(const sa_result_t *r, int pol)
+{
+    return (pol < 0) ? r->edf_ok : r->rta_ok[pol];
+}
+
+
+static void rm_priorities(sa_task_t *task, int n)
+{
+    int i;
+
+    for(i=0; i<n; i++) task[i].priority=-(int)task[i].T;
+}
+
+
+// uniform in [0, 1) from a per set seed
+static double uniform(unsigned int *state)
+{
+    return rand_r(state) / ((double)RAND_MAX + 1.0);
+}
+
+
+// UUniFast utilizations summing to U, Bini and Buttazzo
+static void uunifast(double U, int n, double *u, unsigned int *state)
+{
+    double sum=U, next;
+    int i;
+
+    for(i=0; i<n-1; i++)
+    {
+        next=sum*pow(uniform(state), 1.0/(n-1-i));
+        u[i]=sum - next;
+        sum=next;
+    }
+    u[n-1]=sum;
+}
+
+
+static void random_set(unsigned long long item, sa_task_t *task)
+{
+    unsigned int state=seed*2654435761U + (unsigned int)item*40503U + (unsigned int)(item >> 32);
+    int bin=(int)(item / nsets);
+    double u[SA_MAX_TASKS];
+    double U=u_lo + bin*u_step;
+    int i;
+
+    uunifast(U, nservices, u, &state);
+
+    for(i=0; i<nservices; i++)
+    {
+        task[i].T=(unsigned int)exp(log(t_min) + uniform(&state)*(log(t_max) - log(t_min)));
+        task[i].C=(unsigned int)(u[i]*task[i].T + 0.5);
+        if(task[i].C == 0) task[i].C=1;
+        if(task[i].C > task[i].T) task[i].C=task[i].T;
+
+        task[i].D=constrained ? task[i].C + (unsigned int)(uniform(&state)*(task[i].T - task[i].C + 1)) : task[i].T;
+        if(task[i].D > task[i].T) task[i].D=task[i].T;
+        task[i].B=0;
+    }
+
+    rm_priorities(task, nservices);
+}
+
+
+// the period combination of a grid index, mixed radix over the ranges
+static void grid_set(unsigned long long item, sa_task_t *task)
+{
+    unsigned long long span;
+    int i;
+
+    for(i=0; i<nservices; i++)
+    {
+        task[i]=base[i];
+        span=tmax[i] - base[i].T + 1;
+        task[i].T=base[i].T + (unsigned int)(item % span);
+        item/=span;
+
+        // a D at the low end of the range kept its distance to T
+        if(base[i].D != base[i].T)
+            task[i].D=base[i].D + (task[i].T - base[i].T);
+        else
+            task[i].D=task[i].T;
+    }
+
+    rm_priorities(task, nservices);
+}
+
+
+static void sweep_item(sweep_worker_t *w, unsigned long long item)
+{
+    sa_task_t task[SA_MAX_TASKS];
+    sa_result_t r;
+    sweep_bin_t *b;
+    sweep_grid_t *g=&w->grid;
+    int ok;
+
+    if(random_mode)
+    {
+        random_set(item, task);
+        if(sa_analyze(task, nservices, &r) != 0) return;
+
+        b=&w->bin[item / nsets];
+        b->sets++;
+        b->lub+=r.lub_ok;
+        b->rm+=r.rta_ok[SA_RM];
+        b->dm+=r.rta_ok[SA_DM];
+        b->edf+=r.edf_ok;
+        b->breakdown_dm+=sa_scaling(task, nservices, SA_DM)*r.U;
+        b->breakdown_edf+=sa_edf_scaling(task, nservices)*r.U;
+        return;
+    }
+
+    grid_set(item, task);
+    if(sa_analyze(task, nservices, &r) != 0) return;
+
+    g->sets++;
+    g->fp+=r.rta_ok[SA_FP];
+    g->rm+=r.rta_ok[SA_RM];
+    g->dm+=r.rta_ok[SA_DM];
+    g->edf+=r.edf_ok;
+
+    ok=feasible_under(&r, policy);
+    if(ok && (g->best == ~0ULL || r.U > g->best_U)) { g->best_U=r.U; g->best=item; }
+    if(!ok && (g->worst == ~0ULL || r.U < g->worst_U)) { g->worst_U=r.U; g->worst=item; }
+}
+
+
+static void *sweep_worker(void *arg)
+{
+    sweep_worker_t *w=(sweep_worker_t *)arg;
+    unsigned long long first, item, last;
+
+    while((first=__atomic_fetch_add(&next_item, SWEEP_CHUNK, __ATOMIC_RELAXED)) < nitems)
+    {
+        last=(first + SWEEP_CHUNK < nitems) ? first + SWEEP_CHUNK : nitems;
+        for(item=first; item<last; item++)
+            sweep_item(w, item);
+    }
+
+    return (void *)0;
+}
+
+
+static void print_set(const sa_task_t *task, int n)
+{
+    int i;
+
+    for(i=0; i<n; i++)
+        printf(" %u:%u:%u", task[i].T, task[i].C, task[i].D);
+    printf("\n");
+}
+
+
+// how far each service's C grows alone, the set at the low end of the ranges
+static void report_base(void)
+{
+    sa_task_t task[SA_MAX_TASKS];
+    sa_result_t r;
+    unsigned int lo, hi, mid, D;
+    double U;
+    int i, order, feasible;
+
+    memcpy(task, base, nservices*sizeof(sa_task_t));
+    rm_priorities(task, nservices);
+    if(sa_analyze(task, nservices, &r) != 0) exit(-1);
+    U=r.U;
+
+    printf("base set U=%.4lf:", U);
+    print_set(task, nservices);
+
+    printf("  %-8s %10s %10s\n", "policy", "scaling", "breakdown");
+    for(order=0; order<SA_ORDERS; order++)
+        printf("  %-8s %10.4lf %10.4lf\n", sa_order_name(order), sa_scaling(task, nservices, order), sa_scaling(task, nservices, order)*U);
+    printf("  %-8s %10.4lf %10.4lf\n", "EDF", sa_edf_scaling(task, nservices), sa_edf_scaling(task, nservices)*U);
+
+    printf("  %-8s %4s %4s %4s %8s, alone under %s\n", "service", "T", "C", "D", "max C", (policy < 0) ? "EDF" : sa_order_name(policy));
+    feasible=feasible_under(&r, policy);
+
+    for(i=0; i<nservices; i++)
+    {
+        // largest C up to D still feasible, demand only grows with C
+        D=(task[i].D < task[i].T) ? task[i].D : task[i].T;
+        lo=base[i].C; hi=D;
+        while(feasible && lo < hi)
+        {
+            mid=(lo + hi + 1)/2;
+            task[i].C=mid;
+            sa_analyze(task, nservices, &r);
+            if(feasible_under(&r, policy)) lo=mid;
+            else hi=mid-1;
+        }
+        task[i].C=base[i].C;
+
+        printf("  %-8d %4u %4u %4u %8u\n", i+1, task[i].T, task[i].C, task[i].D, feasible ? lo : 0);
+    }
+}
+
+
+static void report_grid(int nthreads)
+{
+    sweep_grid_t g;
+    sa_task_t task[SA_MAX_TASKS];
+    int t;
+
+    memset(&g, 0, sizeof(g));
+    g.best=g.worst=~0ULL;
+
+    for(t=0; t<nthreads; t++)
+    {
+        sweep_grid_t *w=&workers[t].grid;
+
+        g.sets+=w->sets; g.fp+=w->fp; g.rm+=w->rm; g.dm+=w->dm; g.edf+=w->edf;
+        if(w->best != ~0ULL && (g.best == ~0ULL || w->best_U > g.best_U || (w->best_U == g.best_U && w->best < g.best)))
+            { g.best_U=w->best_U; g.best=w->best; }
+        if(w->worst != ~0ULL && (g.worst == ~0ULL || w->worst_U < g.worst_U || (w->worst_U == g.worst_U && w->worst < g.worst)))
+            { g.worst_U=w->worst_U; g.worst=w->worst; }
+    }
+
+    printf("\n%llu period combinations, feasible FP %llu RM %llu DM %llu EDF %llu\n", g.sets, g.fp, g.rm, g.dm, g.edf);
+
+    if(g.best != ~0ULL)
+    {
+        grid_set(g.best, task);
+        printf("  feasible with most U=%.4lf:", g.best_U);
+        print_set(task, nservices);
+    }
+
+    if(g.worst != ~0ULL)
+    {
+        grid_set(g.worst, task);
+        printf("  infeasible with least U=%.4lf:", g.worst_U);
+        print_set(task, nservices);
+    }
+}
+
+
+static void report_random(int nthreads)
+{
+    sweep_bin_t b;
+    int i, t;
+
+    printf("\n%d services, %llu sets per U, periods %u..%u, %s deadlines\n",
+           nservices, nsets, t_min, t_max, constrained ? "constrained" : "implicit");
+    printf("  %6s %8s %6s %6s %6s %6s %10s %10s\n", "U", "sets", "LUB", "RM", "DM", "EDF", "DM break", "EDF break");
+
+    for(i=0; i<nbins; i++)
+    {
+        memset(&b, 0, sizeof(b));
+        for(t=0; t<nthreads; t++)
+        {
+            b.sets+=workers[t].bin[i].sets;
+            b.lub+=workers[t].bin[i].lub;
+            b.rm+=workers[t].bin[i].rm;
+            b.dm+=workers[t].bin[i].dm;
+            b.edf+=workers[t].bin[i].edf;
+            b.breakdown_dm+=workers[t].bin[i].breakdown_dm;
+            b.breakdown_edf+=workers[t].bin[i].breakdown_edf;
+        }
+        if(b.sets == 0) continue;
+
+        printf("  %6.3lf %8llu %6.3lf %6.3lf %6.3lf %6.3lf %10.4lf %10.4lf\n", u_lo + i*u_step, b.sets,
+               (double)b.lub/b.sets, (double)b.rm/b.sets, (double)b.dm/b.sets, (double)b.edf/b.sets,
+               b.breakdown_dm/b.sets, b.breakdown_edf/b.sets);
+    }
+}
+
+
+static int parse_service(const char *arg, int i)
+{
+    char *end;
+
+    base[i].T=strtoul(arg, &end, 10);
+    tmax[i]=(*end == '-') ? strtoul(end+1, &end, 10) : base[i].T;
+    base[i].C=(*end == ':') ? strtoul(end+1, &end, 10) : 0;
+    base[i].D=(*end == ':') ? strtoul(end+1, &end, 10) : base[i].T;
+
+    if(*end != '\0' || base[i].T == 0 || base[i].C == 0 || tmax[i] < base[i].T)
+    {
+        printf("bad service \"%s\", expected T:C, T:C:D or Tmin-Tmax:C[:D]\n", arg);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct timespec start, stop;
+    double sec;
+    int i, opt, nthreads=get_nprocs();
+
+    while((opt=getopt(argc, argv, "j:p:un:N:U:T:DS:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'j':
+                nthreads=atoi(optarg);
+                break;
+            case 'p':
+                if(strcmp(optarg, "rm") == 0) policy=SA_RM;
+                else if(strcmp(optarg, "dm") == 0) policy=SA_DM;
+                else if(strcmp(optarg, "edf") == 0) policy=-1;
+                else { printf("unknown policy %s\n", optarg); usage(); exit(-1); }
+                break;
+            case 'u':
+                random_mode=TRUE;
+                break;
+            case 'n':
+                nservices=atoi(optarg);
+                break;
+            case 'N':
+                nsets=strtoull(optarg, (char **)0, 10);
+                break;
+            case 'U':
+                if(sscanf(optarg, "%lf:%lf:%lf", &u_lo, &u_hi, &u_step) != 3 || u_step <= 0.0 || u_hi < u_lo)
+                {
+                    printf("bad utilization range %s, expected lo:hi:step\n", optarg);
+                    usage(); exit(-1);
+                }
+                break;
+            case 'T':
+                if(sscanf(optarg, "%u:%u", &t_min, &t_max) != 2 || t_min == 0 || t_max < t_min)
+                {
+                    printf("bad period range %s, expected min:max\n", optarg);
+                    usage(); exit(-1);
+                }
+                break;
+            case 'D':
+                constrained=TRUE;
+                break;
+            case 'S':
+                seed=strtoul(optarg, (char **)0, 10);
+                break;
+            default:
+                usage(); exit(-1);
+        }
+    }
+
+    if(nthreads < 1) nthreads=1;
+    if(nthreads > MAX_THREADS) nthreads=MAX_THREADS;
+
+    if(random_mode)
+    {
+        if(nservices == 0) nservices=5;
+        nbins=(int)floor((u_hi - u_lo)/u_step + 1e-9) + 1;
+
+        if(nservices < 1 || nservices > SA_MAX_TASKS || nbins > MAX_BINS || nsets == 0)
+        {
+            printf("expected 1 to %d services, at most %d U steps and some sets\n", SA_MAX_TASKS, MAX_BINS);
+            exit(-1);
+        }
+        nitems=nbins*nsets;
+    }
+    else
+    {
+        if(optind == argc) { usage(); exit(-1); }
+
+        ncombos=1;
+        for(i=optind; i<argc; i++)
+        {
+            if(nservices == SA_MAX_TASKS)
+            {
+                printf("at most %d services\n", SA_MAX_TASKS);
+                exit(-1);
+            }
+            if(parse_service(argv[i], nservices) != 0) { usage(); exit(-1); }
+
+            ncombos*=tmax[nservices] - base[nservices].T + 1;
+            nservices++;
+        }
+
+        report_base();
+        nitems=(ncombos > 1) ? ncombos : 0;
+    }
+
+    if(nitems == 0) return 0;
+
+    if((workers=(sweep_worker_t *)calloc(nthreads, sizeof(sweep_worker_t))) == NULL)
+    {
+        printf("no memory for %d workers\n", nthreads);
+        exit(-1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(i=0; i<nthreads; i++)
+    {
+        workers[i].grid.best=workers[i].grid.worst=~0ULL;
+
+        if(pthread_create(&workers[i].thread, (void *)0, sweep_worker, (void *)&workers[i]) != 0)
+        {
+            perror("sweep pthread_create");
+            exit(-1);
+        }
+    }
+
+    for(i=0; i<nthreads; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    sec=(stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec)/(double)NANOSEC_PER_SEC;
+
+    if(random_mode) report_random(nthreads);
+    else report_grid(nthreads);
+
+    printf("  %llu sets on %d threads in %.3lf sec, %.0lf per second\n", nitems, nthreads, sec, nitems/sec);
+
+    free(workers);
+    return 0;
+}
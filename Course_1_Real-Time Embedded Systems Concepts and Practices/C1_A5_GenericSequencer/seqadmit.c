@@ -0,0 +1,265 @@
+// Admission control for a running sequencer, see seqadmit.h
+//
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "seqadmit.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+
+// how often a waiting seqa_request() looks for seqa_close()
+#define SEQA_WAIT_NSEC (10000000)
+
+
+static unsigned long long ceil_div(unsigned long long a, unsigned long long b)
+{
+    return (a + b - 1) / b;
+}
+
+
+// response time of task k from seed w, 0 once it goes past min(D, T)
+static unsigned long long response(const sa_task_t *task, int n, int k, unsigned long long w)
+{
+    unsigned long long next, D;
+    int j;
+
+    D=(task[k].D < task[k].T) ? task[k].D : task[k].T;
+
+    while(1)
+    {
+        next=task[k].C + task[k].B;
+        for(j=0; j<n; j++)
+            if(j != k && task[j].priority >= task[k].priority)
+                next+=ceil_div(w, task[j].T) * task[j].C;
+
+        if(next > D) return 0;
+        if(next == w) return w;
+        w=next;
+    }
+}
+
+
+static int row_task(const service_desc_t *desc, sa_task_t *t)
+{
+    if(desc->wcet == 0 || desc->divisor == 0)
+    {
+        printf("seqa: %s needs T and C\n", desc->name);
+        return -1;
+    }
+
+    t->T=desc->divisor;
+    t->C=desc->wcet;
+    t->D=desc->deadline ? desc->deadline : desc->divisor;
+    t->priority=desc->priority;
+    t->B=0;
+
+    return 0;
+}
+
+
+// the active set with desc inserted after its equals, R[] of the new
+// order, returns the insert position or -1 if something misses
+static int incremental(const seqa_t *a, const service_desc_t *desc, sa_task_t *task, unsigned long long *R)
+{
+    int i, p, n=a->n+1;
+    unsigned long long w;
+
+    if(a->n == SA_MAX_TASKS) return -1;
+
+    for(p=0; p<a->n && a->task[p].priority >= desc->priority; p++);
+
+    memcpy(task, a->task, p*sizeof(sa_task_t));
+    memcpy(R, a->R, p*sizeof(unsigned long long));
+    if(row_task(desc, &task[p]) != 0) return -1;
+    memcpy(&task[p+1], &a->task[p], (a->n - p)*sizeof(sa_task_t));
+    memcpy(&R[p+1], &a->R[p], (a->n - p)*sizeof(unsigned long long));
+
+    // the new service, from the demand of everything at or above it
+    w=0;
+    for(i=0; i<n; i++)
+        if(task[i].priority >= task[p].priority) w+=task[i].C;
+    if((R[p]=response(task, n, p, w)) == 0) return -1;
+
+    // services at or below it, from where they were
+    for(i=0; i<n; i++)
+    {
+        if(i == p || task[i].priority > task[p].priority) continue;
+        if((R[i]=response(task, n, i, R[i])) == 0) return -1;
+    }
+
+    return p;
+}
+
+
+int seqa_init(seqa_t *a, sequencer_t *seq)
+{
+    unsigned long long w;
+    int i, j, k, t;
+
+    memset((void *)a, 0, sizeof(seqa_t));
+    a->seq=seq;
+    sem_init(&a->answered, 0, 0);
+    pthread_mutex_init(&a->lock, (void *)0);
+
+    if(seq->nservices > SA_MAX_TASKS)
+    {
+        printf("seqa_init: %d services, at most %d\n", seq->nservices, SA_MAX_TASKS);
+        return -1;
+    }
+
+    // decreasing priority, insertion sort of the table rows
+    for(i=0; i<seq->nservices; i++)
+    {
+        if(row_task(seq->services[i].desc, &a->task[i]) != 0) return -1;
+        a->svc[i]=i;
+
+        for(j=i; j>0 && a->task[j-1].priority < a->task[j].priority; j--)
+        {
+            sa_task_t tmp=a->task[j]; a->task[j]=a->task[j-1]; a->task[j-1]=tmp;
+            t=a->svc[j]; a->svc[j]=a->svc[j-1]; a->svc[j-1]=t;
+        }
+    }
+    a->n=seq->nservices;
+
+    for(k=0; k<a->n; k++)
+    {
+        w=0;
+        for(i=0; i<a->n; i++)
+            if(a->task[i].priority >= a->task[k].priority) w+=a->task[i].C;
+
+        if((a->R[k]=response(a->task, a->n, k, w)) == 0)
+        {
+            printf("seqa_init: %s misses its deadline already, nothing can be admitted\n", seq->services[a->svc[k]].desc->name);
+            a->n=SA_MAX_TASKS + 1;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+void seqa_destroy(seqa_t *a)
+{
+    sem_destroy(&a->answered);
+    pthread_mutex_destroy(&a->lock);
+}
+
+
+int seqa_check(seqa_t *a, const service_desc_t *desc)
+{
+    sa_task_t task[SA_MAX_TASKS];
+    unsigned long long R[SA_MAX_TASKS];
+
+    if(a->n > SA_MAX_TASKS) return 0;
+
+    return incremental(a, desc, task, R) >= 0;
+}
+
+
+int seqa_request(seqa_t *a, const service_desc_t *desc)
+{
+    const service_desc_t *expect;
+    struct timespec timeout;
+    int verdict;
+
+    pthread_mutex_lock(&a->lock);
+
+    if(a->closed)
+    {
+        pthread_mutex_unlock(&a->lock);
+        return -1;
+    }
+
+    __atomic_store_n(&a->request, desc, __ATOMIC_RELEASE);
+
+    while(1)
+    {
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_nsec+=SEQA_WAIT_NSEC;
+        if(timeout.tv_nsec >= NANOSEC_PER_SEC) { timeout.tv_sec++; timeout.tv_nsec-=NANOSEC_PER_SEC; }
+
+        if(sem_timedwait(&a->answered, &timeout) == 0) break;
+
+        // closed before it saw this request, take it back
+        expect=desc;
+        if(a->closed && __atomic_compare_exchange_n(&a->request, &expect, (const service_desc_t *)0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            a->verdict=-1;
+            break;
+        }
+    }
+    verdict=a->verdict;
+
+    pthread_mutex_unlock(&a->lock);
+
+    return verdict;
+}
+
+
+void seqa_close(seqa_t *a)
+{
+    const service_desc_t *desc;
+
+    a->closed=1;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if((desc=__atomic_exchange_n(&a->request, (const service_desc_t *)0, __ATOMIC_ACQ_REL)) != NULL)
+    {
+        a->verdict=-1;
+        sem_post(&a->answered);
+    }
+}
+
+
+int seqa_poll(seqa_t *a)
+{
+    const service_desc_t *desc;
+    sa_task_t task[SA_MAX_TASKS];
+    unsigned long long R[SA_MAX_TASKS];
+    struct timespec start, stop;
+    int p, idx=-1;
+
+    if((desc=__atomic_load_n(&a->request, __ATOMIC_ACQUIRE)) == NULL)
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if(a->n <= SA_MAX_TASKS && (p=incremental(a, desc, task, R)) >= 0 && (idx=seq_activate(a->seq, desc)) >= 0)
+    {
+        a->n++;
+        memcpy(a->task, task, a->n*sizeof(sa_task_t));
+        memcpy(a->R, R, a->n*sizeof(unsigned long long));
+        memmove(&a->svc[p+1], &a->svc[p], (a->n - 1 - p)*sizeof(int));
+        a->svc[p]=idx;
+        a->admitted++;
+    }
+    else
+        a->rejected++;
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    a->last_ns=(stop.tv_sec - start.tv_sec)*NANOSEC_PER_SEC + (stop.tv_nsec - start.tv_nsec);
+    if(a->last_ns > a->max_ns) a->max_ns=a->last_ns;
+
+    a->tick=a->seq->tick;
+    a->verdict=idx;
+    __atomic_store_n(&a->request, (const service_desc_t *)0, __ATOMIC_RELEASE);
+    sem_post(&a->answered);
+
+    return 1;
+}
+
+
+void seqa_report(const seqa_t *a)
+{
+    int i;
+
+    printf("\nAdmission: %llu admitted, %llu rejected, decided in at most %ld nsec\n", a->admitted, a->rejected, a->max_ns);
+    if(a->n > SA_MAX_TASKS) return;
+
+    printf("  %-12s %4s %4s %4s %4s %4s\n", "service", "T", "C", "D", "prio", "R");
+    for(i=0; i<a->n; i++)
+        printf("  %-12s %4u %4u %4u %4d %4llu\n", a->seq->services[a->svc[i]].desc->name,
+               a->task[i].T, a->task[i].C, a->task[i].D, a->task[i].priority, a->R[i]);
+}
@@ -0,0 +1,76 @@
+#ifndef _SEQADMIT_
+#define _SEQADMIT_
+
+// Admission control for services added to a running sequencer
+//
+// A new row is admitted only if every service, old and new, still meets
+// its deadline.  The response times of the active services are kept from
+// the last decision, sorted by priority, so a request only costs:
+//
+//    the new service's own RTA against the services at or above its
+//    priority, whose response times do not change
+//    the services at or below it, iterated again from their old response
+//    time, which stays a lower bound when interference is added
+//
+// SCHED_FIFO runs equal priorities in FIFO order, so services at the same
+// priority are counted as interfering with each other both ways.  A D
+// above T is taken as T, so admission is on the safe side for those rows.
+//
+// Any thread may ask with seqa_request(), which blocks until the sequencer
+// thread has decided in seqa_poll(), called once per tick before seq_tick().
+// An admitted row goes to a standby slot (seq_activate()), so the decision
+// and the thread switch happen inside that one tick, and a service asked
+// for at tick k is released on k itself when k is a multiple of its T.
+//
+
+#include <semaphore.h>
+
+#include "seqtable.h"
+#include "schedan.h"
+
+typedef struct
+{
+    sequencer_t *seq;
+
+    // active services in decreasing priority order
+    int n;
+    int svc[SA_MAX_TASKS];              // sequencer service index
+    sa_task_t task[SA_MAX_TASKS];
+    unsigned long long R[SA_MAX_TASKS];
+
+    // one request at a time, from seqa_request() to seqa_poll()
+    const service_desc_t *volatile request;
+    volatile int verdict;
+    volatile int closed;                // sequencer stopped polling
+    sem_t answered;
+    pthread_mutex_t lock;
+
+    unsigned long long admitted, rejected;
+    unsigned long long tick;            // of the last decision
+    long last_ns, max_ns;               // time to decide, in seqa_poll()
+} seqa_t;
+
+// Analyze the active services of seq, returns 0 or -1 if they are not
+// feasible to begin with, in which case nothing will be admitted
+int seqa_init(seqa_t *a, sequencer_t *seq);
+
+void seqa_destroy(seqa_t *a);
+
+// Ask for desc to be admitted and wait for the decision, returns the new
+// service index or -1 if rejected.  desc must stay valid while it runs.
+int seqa_request(seqa_t *a, const service_desc_t *desc);
+
+// Sequencer thread, decide a pending request if there is one, before the
+// seq_tick() of the current tick, returns 1 when one was decided
+int seqa_poll(seqa_t *a);
+
+// Sequencer thread, after its last seqa_poll(), reject anything pending or
+// still to come
+void seqa_close(seqa_t *a);
+
+// Incremental test alone, 1 if desc would be admitted, nothing changed
+int seqa_check(seqa_t *a, const service_desc_t *desc);
+
+void seqa_report(const seqa_t *a);
+
+#endif
@@ -0,0 +1,370 @@
+// Cyclic executive for a service table, see seqcyclic.h
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <syslog.h>
+
+#include "seqcyclic.h"
+#include "seqtimer.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(SEQT_CLOCK, &ts);
+    return (long long)ts.tv_sec*NANOSEC_PER_SEC + ts.tv_nsec;
+}
+
+
+static unsigned long long gcd(unsigned long long a, unsigned long long b)
+{
+    unsigned long long t;
+
+    while(b) { t=a%b; a=b; b=t; }
+    return a;
+}
+
+
+// D = T for D = 0 and for D > T, whose jobs would overlap the next one
+static unsigned int row_deadline(const service_desc_t *row)
+{
+    return (row->deadline && row->deadline < row->divisor) ? row->deadline : row->divisor;
+}
+
+
+// a whole frame between release and deadline of every job
+static int frame_ok(const service_desc_t *table, int n, unsigned int f)
+{
+    int i;
+
+    for(i=0; i<n; i++)
+        if(2ULL*f - gcd(f, table[i].divisor) > row_deadline(&table[i])) return 0;
+
+    return 1;
+}
+
+
+static int add_entry(seqc_table_t *tab, const seqc_entry_t *e)
+{
+    seqc_entry_t *grown;
+    int max;
+
+    if(tab->nentries == tab->max_entries)
+    {
+        max=tab->max_entries ? 2*tab->max_entries : 64;
+        if((grown=(seqc_entry_t *)realloc(tab->entry, max*sizeof(seqc_entry_t))) == NULL)
+            return -1;
+        tab->entry=grown;
+        tab->max_entries=max;
+    }
+
+    tab->entry[tab->nentries++]=*e;
+    return 0;
+}
+
+
+// Fill the frames of size f earliest deadline first, 1 if every job fit,
+// 0 if one did not, -1 with no memory.  With D <= T a service has at most
+// one job in its window at a time, the one released last.
+static int layout(const service_desc_t *table, int n, unsigned int f, int sliced, seqc_table_t *tab)
+{
+    unsigned int *rem, *rel, *dl, start, end, cap, t;
+    int *cur, *pending, *first, *cand;
+    int i, j, c, k, nc, ok=1;
+    seqc_entry_t e;
+
+    rem=(unsigned int *)malloc(3*n*sizeof(unsigned int));
+    cur=(int *)malloc(4*n*sizeof(int));
+    if(!rem || !cur) { free(rem); free(cur); return -1; }
+    rel=rem+n; dl=rel+n;
+    pending=cur+n; first=pending+n; cand=first+n;
+
+    for(i=0; i<n; i++) { cur[i]=-1; pending[i]=0; }
+
+    tab->nentries=0;
+    tab->nframes=tab->major/f;
+
+    for(k=0; ok && k<(int)tab->nframes; k++)
+    {
+        start=k*f;
+        end=start+f;
+        tab->frame[k]=tab->nentries;
+
+        nc=0;
+        for(i=0; i<n; i++)
+        {
+            j=start/table[i].divisor;
+
+            if(j != cur[i])
+            {
+                // the last job ran out of frames
+                if(pending[i] || j > cur[i]+1) { ok=0; break; }
+
+                cur[i]=j;
+                rem[i]=table[i].wcet;
+                rel[i]=j*table[i].divisor;
+                dl[i]=rel[i] + row_deadline(&table[i]);
+                pending[i]=1;
+                first[i]=1;
+            }
+
+            if(!pending[i] || dl[i] < end) continue;
+
+            // earliest deadline first, higher priority on a tie
+            for(c=nc; c>0 && (dl[cand[c-1]] > dl[i] ||
+                              (dl[cand[c-1]] == dl[i] && table[cand[c-1]].priority < table[i].priority)); c--)
+                cand[c]=cand[c-1];
+            cand[c]=i;
+            nc++;
+        }
+
+        for(cap=f, c=0; ok && c<nc; c++)
+        {
+            i=cand[c];
+
+            if(rem[i] > cap)
+            {
+                if(!sliced || cap == 0) continue;
+                t=cap;
+            }
+            else
+                t=rem[i];
+
+            e.svc=i;
+            e.ticks=t;
+            e.release=rel[i];
+            e.first=first[i];
+            e.last=(t == rem[i]);
+            if(add_entry(tab, &e) != 0) { ok=-1; break; }
+
+            rem[i]-=t;
+            cap-=t;
+            first[i]=0;
+            if(rem[i] == 0) pending[i]=0;
+        }
+    }
+
+    for(i=0; ok == 1 && i<n; i++)
+        if(pending[i]) ok=0;
+
+    tab->frame[tab->nframes]=tab->nentries;
+
+    free(rem); free(cur);
+    return ok;
+}
+
+
+int seqc_build(const service_desc_t *table, int n, seqc_table_t *tab)
+{
+    unsigned long long H=1;
+    unsigned int f, maxC=0;
+    int i, rc;
+
+    memset(tab, 0, sizeof(seqc_table_t));
+
+    for(i=0; i<n; i++)
+    {
+        if(table[i].divisor == 0)
+        {
+            printf("seqc_build: %s has a zero period\n", table[i].name);
+            return -1;
+        }
+
+        H=(H/gcd(H, table[i].divisor))*table[i].divisor;
+        if(H > SEQC_MAX_MAJOR)
+        {
+            printf("seqc_build: major frame above %d ticks\n", SEQC_MAX_MAJOR);
+            return -1;
+        }
+        if(table[i].wcet > maxC) maxC=table[i].wcet;
+    }
+
+    tab->major=(unsigned int)H;
+    if((tab->frame=(int *)malloc((H+1)*sizeof(int))) == NULL)
+    {
+        printf("seqc_build: no memory for %llu frames\n", H);
+        return -1;
+    }
+
+    // largest frame first, the fewer frame boundaries the less overhead
+    for(tab->sliced=0; tab->sliced < 2; tab->sliced++)
+    {
+        for(f=tab->major; f>=1; f--)
+        {
+            if(tab->major % f) continue;
+            if(!tab->sliced && f < maxC) break;
+            if(!frame_ok(table, n, f)) continue;
+
+            if((rc=layout(table, n, f, tab->sliced, tab)) < 0)
+            {
+                printf("seqc_build: no memory for the frame table\n");
+                seqc_free(tab);
+                return -1;
+            }
+            if(rc == 1)
+            {
+                tab->minor=f;
+                return 0;
+            }
+        }
+    }
+
+    printf("seqc_build: no minor frame of the %u tick major frame fits every job\n", tab->major);
+    seqc_free(tab);
+    return -1;
+}
+
+
+void seqc_free(seqc_table_t *tab)
+{
+    free(tab->frame);
+    free(tab->entry);
+    tab->frame=(int *)0;
+    tab->entry=(seqc_entry_t *)0;
+    tab->nentries=tab->max_entries=0;
+}
+
+
+void seqc_print(const service_desc_t *table, const seqc_table_t *tab)
+{
+    const seqc_entry_t *e;
+    unsigned int k, load;
+    int i;
+
+    printf("\nCyclic executive: major frame %u ticks, %u minor frames of %u ticks, jobs %s\n",
+           tab->major, tab->nframes, tab->minor, tab->sliced ? "sliced" : "whole");
+    printf("%6s %11s %6s  %s\n", "frame", "ticks", "load", "slices, + continues a job");
+
+    for(k=0; k<tab->nframes; k++)
+    {
+        load=0;
+        for(i=tab->frame[k]; i<tab->frame[k+1]; i++) load+=tab->entry[i].ticks;
+
+        printf("%6u %5u-%-5u %3u/%-2u ", k, k*tab->minor, (k+1)*tab->minor, load, tab->minor);
+        for(i=tab->frame[k]; i<tab->frame[k+1]; i++)
+        {
+            e=&tab->entry[i];
+            printf(" %s%s:%u", e->first ? "" : "+", table[e->svc].name, e->ticks);
+        }
+        printf("\n");
+    }
+}
+
+
+int seqc_exec_init(seqc_exec_t *x, const seqc_table_t *tab, sequencer_t *seq, long tick_ns)
+{
+    int i, n=seq->nservices;
+
+    memset(x, 0, sizeof(seqc_exec_t));
+    x->tab=tab;
+    x->seq=seq;
+    x->tick_ns=tick_ns;
+
+    x->start_min=(long long *)malloc(2*n*sizeof(long long));
+    if(!x->start_min)
+    {
+        printf("seqc_exec_init: no memory for %d services\n", n);
+        return -1;
+    }
+    x->start_max=x->start_min+n;
+
+    for(i=0; i<n; i++)
+    {
+        x->start_min[i]=LLONG_MAX;
+        x->start_max[i]=LLONG_MIN;
+    }
+
+    return 0;
+}
+
+
+void seqc_frame(seqc_exec_t *x)
+{
+    const seqc_table_t *tab=x->tab;
+    const seqc_entry_t *e;
+    unsigned int k=x->frames % tab->nframes;
+    long long begin, t, work=0, start;
+    service_t *svc;
+    int i;
+
+    begin=now_ns();
+    if(x->frames == 0) x->t0_ns=begin;
+
+    // the frame start stands in for the sem_post of every job begun in it
+    for(i=tab->frame[k]; i<tab->frame[k+1]; i++)
+    {
+        svc=&x->seq->services[tab->entry[i].svc];
+        if(tab->entry[i].first && svc->stats) svc_stats_post(svc->stats);
+    }
+
+    for(i=tab->frame[k]; i<tab->frame[k+1]; i++)
+    {
+        e=&tab->entry[i];
+        svc=&x->seq->services[e->svc];
+        t=now_ns();
+
+        if(e->first)
+        {
+            svc->releases++;
+            if(svc->stats) svc_stats_wake(svc->stats, svc->releases);
+
+            start=t - (x->t0_ns + ((long long)x->cycle*tab->major + e->release)*x->tick_ns);
+            if(start < x->start_min[e->svc]) x->start_min[e->svc]=start;
+            if(start > x->start_max[e->svc]) x->start_max[e->svc]=start;
+        }
+
+        svc->budget=e->ticks;
+        svc->resume=!e->first;
+        svc->desc->work(svc);
+
+        if(e->last && svc->stats) svc_stats_done(svc->stats);
+        work+=now_ns() - t;
+    }
+
+    t=now_ns() - begin - work;
+    x->sum_overhead_ns+=t;
+    if(t > x->max_overhead_ns) x->max_overhead_ns=t;
+
+    if(++x->frames % tab->nframes == 0) x->cycle++;
+}
+
+
+void seqc_report(const seqc_exec_t *x)
+{
+    const service_t *svc;
+    int i;
+
+    printf("\nCyclic executive: %llu minor frames of %u ticks run, %llu major frames\n",
+           x->frames, x->tab->minor, x->cycle);
+    printf("executor overhead per frame avg %.1lf max %.1lf usec\n",
+           x->frames ? (double)x->sum_overhead_ns/x->frames/1000.0 : 0.0, x->max_overhead_ns/1000.0);
+    syslog(LOG_CRIT, "Cyclic executive %llu frames, overhead avg %lld max %lld nsec\n", x->frames,
+           x->frames ? x->sum_overhead_ns/(long long)x->frames : 0LL, x->max_overhead_ns);
+
+    printf("\n%-12s %10s %10s %10s\n", "service", "start min", "start max", "jitter");
+    printf("%-12s %10s %10s %10s\n", "", "usec", "usec", "usec");
+
+    for(i=0; i<x->seq->nservices; i++)
+    {
+        svc=&x->seq->services[i];
+        if(x->start_max[i] < x->start_min[i]) continue;
+
+        printf("%-12s %10.1lf %10.1lf %10.1lf\n", svc->desc->name, x->start_min[i]/1000.0,
+               x->start_max[i]/1000.0, (x->start_max[i] - x->start_min[i])/1000.0);
+        syslog(LOG_CRIT, "%s cyclic start after release min %lld max %lld nsec\n", svc->desc->name,
+               x->start_min[i], x->start_max[i]);
+    }
+}
+
+
+void seqc_exec_free(seqc_exec_t *x)
+{
+    free(x->start_min);
+    x->start_min=x->start_max=(long long *)0;
+}
@@ -0,0 +1,88 @@
+#ifndef _SEQCYCLIC_
+#define _SEQCYCLIC_
+
+// Cyclic executive for a service table
+//
+// seqc_build() lays the jobs of one hyperperiod, the major frame, out over
+// fixed minor frames offline.  The minor frame f is the largest divisor of
+// the major frame that
+//
+//    divides the major frame         the table repeats exactly
+//    2f - gcd(f, T) <= D             a whole frame lies between the
+//                                    release and deadline of every job
+//                                    (Baker and Shaw)
+//
+// and for which every job fits in frames that lie wholly inside its
+// release to deadline window, filled earliest deadline first.  Jobs are
+// kept whole when some f >= max C works, otherwise they are sliced at tick
+// boundaries over several frames.  D > T rows are laid out with D = T.
+//
+// seqc_frame() then runs one minor frame on the calling thread, calling
+// the work function of each entry inline, with no release primitive, no
+// service threads and no context switch.  A sliced job gets one call per
+// slice with svc->budget set to the slice and svc->resume set on all but
+// the first.
+//
+// Next to the service stats (svcstats.h, the post is the frame start, so
+// latency is the dispatch delay inside the frame), the executor records
+// its own overhead per frame, the frame time not spent in work functions,
+// and each service's start jitter against its release tick.
+//
+
+#include "seqtable.h"
+
+// largest major frame that is laid out, in ticks
+#define SEQC_MAX_MAJOR (100000)
+
+typedef struct
+{
+    int svc;                    // table row
+    unsigned int ticks;         // slice of C run in this frame
+    unsigned int release;       // release tick of the job in the major frame
+    int first, last;            // first and last slice of the job
+} seqc_entry_t;
+
+typedef struct
+{
+    unsigned int major, minor, nframes;     // ticks, ticks, frames
+    int sliced;
+
+    int nentries, max_entries;
+    int *frame;                 // nframes+1 offsets into entry
+    seqc_entry_t *entry;
+} seqc_table_t;
+
+typedef struct
+{
+    const seqc_table_t *tab;
+    sequencer_t *seq;
+    long tick_ns;
+
+    unsigned long long frames;  // minor frames run
+    unsigned long long cycle;   // major frames completed
+    long long t0_ns;            // start of frame 0
+
+    long long sum_overhead_ns, max_overhead_ns;
+    long long *start_min, *start_max;       // per service, after release
+} seqc_exec_t;
+
+// Frame table for the n rows, returns 0 or -1 if no minor frame works
+int seqc_build(const service_desc_t *table, int n, seqc_table_t *tab);
+
+void seqc_free(seqc_table_t *tab);
+
+// One line per minor frame with the slices run in it
+void seqc_print(const service_desc_t *table, const seqc_table_t *tab);
+
+// Executor for tab over the services of seq, ticks of tick_ns
+int seqc_exec_init(seqc_exec_t *x, const seqc_table_t *tab, sequencer_t *seq, long tick_ns);
+
+// Run the next minor frame
+void seqc_frame(seqc_exec_t *x);
+
+// Frames run, overhead per frame and start jitter of each service
+void seqc_report(const seqc_exec_t *x);
+
+void seqc_exec_free(seqc_exec_t *x);
+
+#endif
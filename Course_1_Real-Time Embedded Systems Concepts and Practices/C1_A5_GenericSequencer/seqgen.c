@@ -95,6 +95,8 @@
 #include <sys/time.h>
 #include <sys/sysinfo.h>
 #include <errno.h>
+#include "rtstack.h"
+#include "rtstop.h"
 
 #define USEC_PER_MSEC (1000)
 #define NANOSEC_PER_SEC (1000000000)
@@ -104,8 +106,18 @@
 
 #define NUM_THREADS (7+1)
 
-int abortTest=FALSE;
-int abortS1=FALSE, abortS2=FALSE, abortS3=FALSE, abortS4=FALSE, abortS5=FALSE, abortS6=FALSE, abortS7=FALSE;
+// every thread on a SERVICE_STACK stack carved from one locked arena
+// instead of an 8 MB default one, high water marks printed at the end,
+// see rtstack.h
+#define STACK_ARENA
+#define SERVICE_STACK (64*1024)
+
+#ifdef STACK_ARENA
+rts_arena_t stacks;
+#endif
+
+// rtstop_request(&stop, RTSTOP_ABORT) from anywhere ends the run early
+rtstop_t stop;
 sem_t semS1, semS2, semS3, semS4, semS5, semS6, semS7;
 struct timeval start_time_val;
 
@@ -134,7 +146,11 @@ void main(void)
     struct timeval current_time_val;
     int i, rc, scope;
     cpu_set_t threadcpu;
+#ifdef STACK_ARENA
+    char stack_name[RTS_NAME_LEN];
+#endif
     pthread_t threads[NUM_THREADS];
+    int started[NUM_THREADS]={0};     // joined only if pthread_create succeeded
     threadParams_t threadParams[NUM_THREADS];
     pthread_attr_t rt_sched_attr[NUM_THREADS];
     int rt_max_prio, rt_min_prio;
@@ -169,6 +185,13 @@ void main(void)
     if (sem_init (&semS6, 0, 0)) { printf ("Failed to initialize S6 semaphore\n"); exit (-1); }
     if (sem_init (&semS7, 0, 0)) { printf ("Failed to initialize S7 semaphore\n"); exit (-1); }
 
+    // in service order, the index each service's rtstop_exit() takes
+    rtstop_init(&stop, CLOCK_MONOTONIC);
+    rtstop_add(&stop, &semS1, "S1"); rtstop_add(&stop, &semS2, "S2");
+    rtstop_add(&stop, &semS3, "S3"); rtstop_add(&stop, &semS4, "S4");
+    rtstop_add(&stop, &semS5, "S5"); rtstop_add(&stop, &semS6, "S6");
+    rtstop_add(&stop, &semS7, "S7");
+
     mainpid=getpid();
 
     rt_max_prio = sched_get_priority_max(SCHED_FIFO);
@@ -193,6 +216,10 @@ void main(void)
     printf("rt_max_prio=%d\n", rt_max_prio);
     printf("rt_min_prio=%d\n", rt_min_prio);
 
+#ifdef STACK_ARENA
+    rts_arena_init(&stacks, NUM_THREADS, NUM_THREADS*rts_span(SERVICE_STACK));
+#endif
+
     for(i=0; i < NUM_THREADS; i++)
     {
 
@@ -200,6 +227,11 @@ void main(void)
       CPU_SET(3, &threadcpu);
 
       rc=pthread_attr_init(&rt_sched_attr[i]);
+#ifdef STACK_ARENA
+      if(i == 0) snprintf(stack_name, sizeof(stack_name), "Sequencer");
+      else snprintf(stack_name, sizeof(stack_name), "Service_%d", i);
+      rts_attr_stack(&stacks, &rt_sched_attr[i], SERVICE_STACK, stack_name);
+#endif
       rc=pthread_attr_setinheritsched(&rt_sched_attr[i], PTHREAD_EXPLICIT_SCHED);
       rc=pthread_attr_setschedpolicy(&rt_sched_attr[i], SCHED_FIFO);
       //rc=pthread_attr_setaffinity_np(&rt_sched_attr[i], sizeof(cpu_set_t), &threadcpu);
@@ -225,10 +257,13 @@ void main(void)
                       Service_1,                 // thread function entry point
                       (void *)&(threadParams[1]) // parameters to pass in
                      );
-    if(rc < 0)
-        perror("pthread_create for service 1");
+    if(rc != 0)
+        printf("pthread_create for service 1 failed, rc=%d\n", rc);
     else
+    {
+        started[1]=1;
         printf("pthread_create successful for service 1\n");
+    }
 
 
     // Service_2 = RT_MAX-2	@ 1 Hz
@@ -236,10 +271,13 @@ void main(void)
     rt_param[2].sched_priority=rt_max_prio-2;
     pthread_attr_setschedparam(&rt_sched_attr[2], &rt_param[2]);
     rc=pthread_create(&threads[2], &rt_sched_attr[2], Service_2, (void *)&(threadParams[2]));
-    if(rc < 0)
-        perror("pthread_create for service 2");
+    if(rc != 0)
+        printf("pthread_create for service 2 failed, rc=%d\n", rc);
     else
+    {
+        started[2]=1;
         printf("pthread_create successful for service 2\n");
+    }
 
 
     // Service_3 = RT_MAX-3	@ 0.5 Hz
@@ -247,10 +285,13 @@ void main(void)
     rt_param[3].sched_priority=rt_max_prio-3;
     pthread_attr_setschedparam(&rt_sched_attr[3], &rt_param[3]);
     rc=pthread_create(&threads[3], &rt_sched_attr[3], Service_3, (void *)&(threadParams[3]));
-    if(rc < 0)
-        perror("pthread_create for service 3");
+    if(rc != 0)
+        printf("pthread_create for service 3 failed, rc=%d\n", rc);
     else
+    {
+        started[3]=1;
         printf("pthread_create successful for service 3\n");
+    }
 
 
     // Service_4 = RT_MAX-2	@ 1 Hz
@@ -258,10 +299,13 @@ void main(void)
     rt_param[4].sched_priority=rt_max_prio-3;
     pthread_attr_setschedparam(&rt_sched_attr[4], &rt_param[4]);
     rc=pthread_create(&threads[4], &rt_sched_attr[4], Service_4, (void *)&(threadParams[4]));
-    if(rc < 0)
-        perror("pthread_create for service 4");
+    if(rc != 0)
+        printf("pthread_create for service 4 failed, rc=%d\n", rc);
     else
+    {
+        started[4]=1;
         printf("pthread_create successful for service 4\n");
+    }
 
 
     // Service_5 = RT_MAX-3	@ 0.5 Hz
@@ -269,10 +313,13 @@ void main(void)
     rt_param[5].sched_priority=rt_max_prio-3;
     pthread_attr_setschedparam(&rt_sched_attr[5], &rt_param[5]);
     rc=pthread_create(&threads[5], &rt_sched_attr[5], Service_5, (void *)&(threadParams[5]));
-    if(rc < 0)
-        perror("pthread_create for service 5");
+    if(rc != 0)
+        printf("pthread_create for service 5 failed, rc=%d\n", rc);
     else
+    {
+        started[5]=1;
         printf("pthread_create successful for service 5\n");
+    }
 
 
     // Service_6 = RT_MAX-2	@ 1 Hz
@@ -280,10 +327,13 @@ void main(void)
     rt_param[6].sched_priority=rt_max_prio-2;
     pthread_attr_setschedparam(&rt_sched_attr[6], &rt_param[6]);
     rc=pthread_create(&threads[6], &rt_sched_attr[6], Service_6, (void *)&(threadParams[6]));
-    if(rc < 0)
-        perror("pthread_create for service 6");
+    if(rc != 0)
+        printf("pthread_create for service 6 failed, rc=%d\n", rc);
     else
+    {
+        started[6]=1;
         printf("pthread_create successful for service 6\n");
+    }
 
 
     // Service_7 = RT_MIN	0.1 Hz
@@ -291,10 +341,13 @@ void main(void)
     rt_param[7].sched_priority=rt_min_prio;
     pthread_attr_setschedparam(&rt_sched_attr[7], &rt_param[7]);
     rc=pthread_create(&threads[7], &rt_sched_attr[7], Service_7, (void *)&(threadParams[7]));
-    if(rc < 0)
-        perror("pthread_create for service 7");
+    if(rc != 0)
+        printf("pthread_create for service 7 failed, rc=%d\n", rc);
     else
+    {
+        started[7]=1;
         printf("pthread_create successful for service 7\n");
+    }
 
 
     // Wait for service threads to initialize and await relese by sequencer.
@@ -314,14 +367,29 @@ void main(void)
     rt_param[0].sched_priority=rt_max_prio;
     pthread_attr_setschedparam(&rt_sched_attr[0], &rt_param[0]);
     rc=pthread_create(&threads[0], &rt_sched_attr[0], Sequencer, (void *)&(threadParams[0]));
-    if(rc < 0)
-        perror("pthread_create for sequencer service 0");
+    if(rc != 0)
+    {
+        // nothing will release the services, stop the ones that started
+        printf("pthread_create for sequencer service 0 failed, rc=%d\n", rc);
+        rtstop_request(&stop, RTSTOP_ABORT);
+    }
     else
+    {
+        started[0]=1;
         printf("pthread_create successful for sequeencer service 0\n");
+    }
 
 
+   // a thread that never started has nothing to join
    for(i=0;i<NUM_THREADS;i++)
-       pthread_join(threads[i], NULL);
+       if(started[i]) pthread_join(threads[i], NULL);
+
+#ifdef STACK_ARENA
+   rts_report(&stacks);
+   rts_arena_free(&stacks);
+#endif
+
+   rtstop_report(&stop);
 
    printf("\nTEST COMPLETE\n");
 }
@@ -402,14 +470,10 @@ void *Sequencer(void *threadp)
         //gettimeofday(&current_time_val, (struct timezone *)0);
         //syslog(LOG_CRIT, "Sequencer release all sub-services @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
 
-    } while(!abortTest && (seqCnt < threadParams->sequencePeriods));
+    } while(!rtstop_stopped(&stop) && (seqCnt < threadParams->sequencePeriods));
 
-    sem_post(&semS1); sem_post(&semS2); sem_post(&semS3);
-    sem_post(&semS4); sem_post(&semS5); sem_post(&semS6);
-    sem_post(&semS7);
-    abortS1=TRUE; abortS2=TRUE; abortS3=TRUE;
-    abortS4=TRUE; abortS5=TRUE; abortS6=TRUE;
-    abortS7=TRUE;
+    // shutdown all services, a no-op after an abort request
+    rtstop_request(&stop, RTSTOP_DONE);
 
     pthread_exit((void *)0);
 }
@@ -427,15 +491,17 @@ void *Service_1(void *threadp)
     syslog(LOG_CRIT, "Frame Sampler thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     printf("Frame Sampler thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
 
-    while(!abortS1)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS1);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S1Cnt++;
 
         gettimeofday(&current_time_val, (struct timezone *)0);
         syslog(LOG_CRIT, "Frame Sampler release %llu @ sec=%d, msec=%d\n", S1Cnt, (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     }
 
+    rtstop_exit(&stop, 0);
     pthread_exit((void *)0);
 }
 
@@ -451,15 +517,17 @@ void *Service_2(void *threadp)
     syslog(LOG_CRIT, "Time-stamp with Image Analysis thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     printf("Time-stamp with Image Analysis thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
 
-    while(!abortS2)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS2);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S2Cnt++;
 
         gettimeofday(&current_time_val, (struct timezone *)0);
         syslog(LOG_CRIT, "Time-stamp with Image Analysis release %llu @ sec=%d, msec=%d\n", S2Cnt, (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     }
 
+    rtstop_exit(&stop, 1);
     pthread_exit((void *)0);
 }
 
@@ -474,15 +542,17 @@ void *Service_3(void *threadp)
     syslog(LOG_CRIT, "Difference Image Proc thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     printf("Difference Image Proc thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
 
-    while(!abortS3)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS3);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S3Cnt++;
 
         gettimeofday(&current_time_val, (struct timezone *)0);
         syslog(LOG_CRIT, "Difference Image Proc release %llu @ sec=%d, msec=%d\n", S3Cnt, (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     }
 
+    rtstop_exit(&stop, 2);
     pthread_exit((void *)0);
 }
 
@@ -497,15 +567,17 @@ void *Service_4(void *threadp)
     syslog(LOG_CRIT, "Time-stamp Image Save to File thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     printf("Time-stamp Image Save to File thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
 
-    while(!abortS4)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS4);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S4Cnt++;
 
         gettimeofday(&current_time_val, (struct timezone *)0);
         syslog(LOG_CRIT, "Time-stamp Image Save to File release %llu @ sec=%d, msec=%d\n", S4Cnt, (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     }
 
+    rtstop_exit(&stop, 3);
     pthread_exit((void *)0);
 }
 
@@ -520,15 +592,17 @@ void *Service_5(void *threadp)
     syslog(LOG_CRIT, "Processed Image Save to File thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     printf("Processed Image Save to File thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
 
-    while(!abortS5)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS5);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S5Cnt++;
 
         gettimeofday(&current_time_val, (struct timezone *)0);
         syslog(LOG_CRIT, "Processed Image Save to File release %llu @ sec=%d, msec=%d\n", S5Cnt, (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     }
 
+    rtstop_exit(&stop, 4);
     pthread_exit((void *)0);
 }
 
@@ -543,15 +617,17 @@ void *Service_6(void *threadp)
     syslog(LOG_CRIT, "Send Time-stamped Image to Remote thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     printf("Send Time-stamped Image to Remote thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
 
-    while(!abortS6)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS6);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S6Cnt++;
 
         gettimeofday(&current_time_val, (struct timezone *)0);
         syslog(LOG_CRIT, "Send Time-stamped Image to Remote release %llu @ sec=%d, msec=%d\n", S6Cnt, (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     }
 
+    rtstop_exit(&stop, 5);
     pthread_exit((void *)0);
 }
 
@@ -566,15 +642,17 @@ void *Service_7(void *threadp)
     syslog(LOG_CRIT, "10 sec Tick Debug thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     printf("10 sec Tick Debug thread @ sec=%d, msec=%d\n", (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
 
-    while(!abortS7)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS7);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S7Cnt++;
 
         gettimeofday(&current_time_val, (struct timezone *)0);
         syslog(LOG_CRIT, "10 Sec Tick Debug release %llu @ sec=%d, msec=%d\n", S7Cnt, (int)(current_time_val.tv_sec-start_time_val.tv_sec), (int)current_time_val.tv_usec/USEC_PER_MSEC);
     }
 
+    rtstop_exit(&stop, 6);
     pthread_exit((void *)0);
 }
 
@@ -23,10 +23,15 @@
 // default to 1 millisecond, 1000 Hz
 //#define RTSEQ_DELAY_NSEC 		( 1000000)
 
+// or at run time, "seqgenex0 -f 1000 -n 24000", within this range
+#define RTSEQ_MIN_HZ (2)
+#define RTSEQ_MAX_HZ (10000)
+
 typedef struct
 {
     int threadIdx;
     unsigned long long sequencePeriods;
+    long delayNsec;             // sequencer period, RTSEQ_DELAY_NSEC by default
 } threadParams_t;
 
 
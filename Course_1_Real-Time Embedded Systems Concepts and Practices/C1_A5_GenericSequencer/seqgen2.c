@@ -13,6 +13,10 @@
 // 2) Sequencer runs on core 1
 // 3) EVEN thread indexes run on core 2
 // 4) ODD thread indexes run on core 3
+//    That is the default core map of a 4 core board, set COREMAP, e.g.
+//    COREMAP="seq=1,svc=2-7", for any other, the services go round robin
+//    over its svc cores and boards with fewer cores fall back to the last
+//    one, see coremap.h
 // 5) Linux kernel mostly runs on core 0, but does load balance non-RT workload over all cores
 // 6) check for irqbalance [https://linux.die.net/man/1/irqbalance] which also distribute IRQ handlers
 //
@@ -108,6 +112,12 @@
 #include <sys/sysinfo.h>
 #include <errno.h>
 
+#include "evlog.h"
+#include "svcstats.h"
+#include "rtstack.h"
+#include "rtstop.h"
+#include "coremap.h"
+
 #define USEC_PER_MSEC (1000)
 #define NANOSEC_PER_MSEC (1000000)
 #define NANOSEC_PER_SEC (1000000000)
@@ -115,8 +125,26 @@
 #define TRUE (1)
 #define FALSE (0)
 
+// log releases to lock-free in-memory rings rather than calling syslog
+// from the SCHED_FIFO service threads
+#define EVENT_LOG
+
+// per-service latency, execution and response time histograms, summary
+// printed at TEST COMPLETE
+#define SERVICE_STATS
+
 #define NUM_THREADS (7+1)
 
+// every thread on a SERVICE_STACK stack carved from one locked arena
+// instead of an 8 MB default one, high water marks printed at the end,
+// see rtstack.h
+#define STACK_ARENA
+#define SERVICE_STACK (64*1024)
+
+#ifdef STACK_ARENA
+rts_arena_t stacks;
+#endif
+
 // Of the available user space clocks, CLOCK_MONONTONIC_RAW is typically most precise and not subject to 
 // updates from external timer adjustments
 //
@@ -128,9 +156,22 @@
 //#define MY_CLOCK_TYPE CLOCK_REALTIME_COARSE
 //#define MY_CLOCK_TYPE CLOCK_MONTONIC_COARSE
 
-int abortTest=FALSE;
-int abortS1=FALSE, abortS2=FALSE, abortS3=FALSE, abortS4=FALSE, abortS5=FALSE, abortS6=FALSE, abortS7=FALSE;
+// rtstop_request(&stop, RTSTOP_ABORT) from anywhere ends the run early
+rtstop_t stop;
 sem_t semS1, semS2, semS3, semS4, semS5, semS6, semS7;
+coremap_t coremap;
+
+#ifdef SERVICE_STATS
+svc_stats_t svcStats[7];
+#endif
+
+// sem_post a release, stamping the post time for the latency histogram
+#ifdef SERVICE_STATS
+#define SVC_RELEASE(i, sem) do { svc_stats_post(&svcStats[i]); sem_post(sem); } while(0)
+#else
+#define SVC_RELEASE(i, sem) sem_post(sem)
+#endif
+
 struct timespec start_time_val;
 double start_realtime;
 
@@ -202,8 +243,12 @@ void main(void)
 
     cpu_set_t threadcpu;
     cpu_set_t allcpuset;
+#ifdef STACK_ARENA
+    char stack_name[RTS_NAME_LEN];
+#endif
 
     pthread_t threads[NUM_THREADS];
+    int started[NUM_THREADS]={0};     // joined only if pthread_create succeeded
     threadParams_t threadParams[NUM_THREADS];
     pthread_attr_t rt_sched_attr[NUM_THREADS];
     int rt_max_prio, rt_min_prio, cpuidx;
@@ -216,6 +261,11 @@ void main(void)
 
     printf("Starting High Rate Sequencer Demo\n");
     clock_gettime(MY_CLOCK_TYPE, &start_time_val); start_realtime=realtime(&start_time_val);
+#ifdef EVENT_LOG
+    // services log to in-memory rings, a SCHED_OTHER thread on core 0 does the syslog calls
+    evlog_init(MY_CLOCK_TYPE, &start_time_val);
+    evlog_drain_start(0);
+#endif
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     clock_getres(MY_CLOCK_TYPE, &current_time_res); current_realtime_res=realtime(&current_time_res);
     printf("START High Rate Sequencer @ sec=%6.9lf with resolution %6.9lf\n", (current_realtime - start_realtime), current_realtime_res);
@@ -233,6 +283,10 @@ void main(void)
 
    printf("Using CPUS=%d from total available.\n", CPU_COUNT(&allcpuset));
 
+   coremap_init(&coremap);
+   if(coremap_parse(&coremap, (const char *)0) != 0) exit(-1);
+   coremap_check(&coremap);
+
 
     // initialize the sequencer semaphores
     //
@@ -244,6 +298,23 @@ void main(void)
     if (sem_init (&semS6, 0, 0)) { printf ("Failed to initialize S6 semaphore\n"); exit (-1); }
     if (sem_init (&semS7, 0, 0)) { printf ("Failed to initialize S7 semaphore\n"); exit (-1); }
 
+    // in service order, the index each service's rtstop_exit() takes
+    rtstop_init(&stop, MY_CLOCK_TYPE);
+    rtstop_add(&stop, &semS1, "S1 50 Hz"); rtstop_add(&stop, &semS2, "S2 20 Hz");
+    rtstop_add(&stop, &semS3, "S3 10 Hz"); rtstop_add(&stop, &semS4, "S4 5 Hz");
+    rtstop_add(&stop, &semS5, "S5 2 Hz"); rtstop_add(&stop, &semS6, "S6 1 Hz");
+    rtstop_add(&stop, &semS7, "S7 1 Hz");
+
+#ifdef SERVICE_STATS
+    svc_stats_init(&svcStats[0], "S1");
+    svc_stats_init(&svcStats[1], "S2");
+    svc_stats_init(&svcStats[2], "S3");
+    svc_stats_init(&svcStats[3], "S4");
+    svc_stats_init(&svcStats[4], "S5");
+    svc_stats_init(&svcStats[5], "S6");
+    svc_stats_init(&svcStats[6], "S7");
+#endif
+
     mainpid=getpid();
 
     rt_max_prio = sched_get_priority_max(SCHED_FIFO);
@@ -269,26 +340,24 @@ void main(void)
     printf("rt_min_prio=%d\n", rt_min_prio);
 
 
+#ifdef STACK_ARENA
+    rts_arena_init(&stacks, NUM_THREADS, NUM_THREADS*rts_span(SERVICE_STACK));
+#endif
+
     for(i=0; i < NUM_THREADS; i++)
     {
-
-      // run even indexed threads on core 2
-      if(i % 2 == 0)
-      {
-          CPU_ZERO(&threadcpu);
-          cpuidx=(2);
-          CPU_SET(cpuidx, &threadcpu);
-      }
-
-      // run odd indexed threads on core 3
-      else
-      {
-          CPU_ZERO(&threadcpu);
-          cpuidx=(3);
-          CPU_SET(cpuidx, &threadcpu);
-      }
+      // round robin over the service cores, even indexed threads on core 2
+      // and odd on core 3 with the default map of a 4 core board
+      CPU_ZERO(&threadcpu);
+      cpuidx=coremap.svc_cores[i % coremap.nsvc];
+      CPU_SET(cpuidx, &threadcpu);
 
       rc=pthread_attr_init(&rt_sched_attr[i]);
+#ifdef STACK_ARENA
+      if(i == 0) snprintf(stack_name, sizeof(stack_name), "Sequencer");
+      else snprintf(stack_name, sizeof(stack_name), "Service_%d", i);
+      rts_attr_stack(&stacks, &rt_sched_attr[i], SERVICE_STACK, stack_name);
+#endif
       rc=pthread_attr_setinheritsched(&rt_sched_attr[i], PTHREAD_EXPLICIT_SCHED);
       rc=pthread_attr_setschedpolicy(&rt_sched_attr[i], SCHED_FIFO);
       rc=pthread_attr_setaffinity_np(&rt_sched_attr[i], sizeof(cpu_set_t), &threadcpu);
@@ -314,10 +383,13 @@ void main(void)
                       Service_1,                 // thread function entry point
                       (void *)&(threadParams[1]) // parameters to pass in
                      );
-    if(rc < 0)
-        perror("pthread_create for service 1");
+    if(rc != 0)
+        printf("pthread_create for service 1 failed, rc=%d\n", rc);
     else
+    {
+        started[1]=1;
         printf("pthread_create successful for service 1\n");
+    }
 
 
     // Service_2 = RT_MAX-2	@ 20 Hz
@@ -325,10 +397,13 @@ void main(void)
     rt_param[2].sched_priority=rt_max_prio-2;
     pthread_attr_setschedparam(&rt_sched_attr[2], &rt_param[2]);
     rc=pthread_create(&threads[2], &rt_sched_attr[2], Service_2, (void *)&(threadParams[2]));
-    if(rc < 0)
-        perror("pthread_create for service 2");
+    if(rc != 0)
+        printf("pthread_create for service 2 failed, rc=%d\n", rc);
     else
+    {
+        started[2]=1;
         printf("pthread_create successful for service 2\n");
+    }
 
 
     // Service_3 = RT_MAX-3	@ 10 Hz
@@ -336,10 +411,13 @@ void main(void)
     rt_param[3].sched_priority=rt_max_prio-3;
     pthread_attr_setschedparam(&rt_sched_attr[3], &rt_param[3]);
     rc=pthread_create(&threads[3], &rt_sched_attr[3], Service_3, (void *)&(threadParams[3]));
-    if(rc < 0)
-        perror("pthread_create for service 3");
+    if(rc != 0)
+        printf("pthread_create for service 3 failed, rc=%d\n", rc);
     else
+    {
+        started[3]=1;
         printf("pthread_create successful for service 3\n");
+    }
 
 
     // Service_4 = RT_MAX-4	@ 5 Hz
@@ -347,10 +425,13 @@ void main(void)
     rt_param[4].sched_priority=rt_max_prio-4;
     pthread_attr_setschedparam(&rt_sched_attr[4], &rt_param[4]);
     rc=pthread_create(&threads[4], &rt_sched_attr[4], Service_4, (void *)&(threadParams[4]));
-    if(rc < 0)
-        perror("pthread_create for service 4");
+    if(rc != 0)
+        printf("pthread_create for service 4 failed, rc=%d\n", rc);
     else
+    {
+        started[4]=1;
         printf("pthread_create successful for service 4\n");
+    }
 
 
     // Service_5 = RT_MAX-5	@ 2 Hz
@@ -358,10 +439,13 @@ void main(void)
     rt_param[5].sched_priority=rt_max_prio-5;
     pthread_attr_setschedparam(&rt_sched_attr[5], &rt_param[5]);
     rc=pthread_create(&threads[5], &rt_sched_attr[5], Service_5, (void *)&(threadParams[5]));
-    if(rc < 0)
-        perror("pthread_create for service 5");
+    if(rc != 0)
+        printf("pthread_create for service 5 failed, rc=%d\n", rc);
     else
+    {
+        started[5]=1;
         printf("pthread_create successful for service 5\n");
+    }
 
 
     // Service_6 = RT_MAX-6	@ 1 Hz
@@ -369,10 +453,13 @@ void main(void)
     rt_param[6].sched_priority=rt_max_prio-6;
     pthread_attr_setschedparam(&rt_sched_attr[6], &rt_param[6]);
     rc=pthread_create(&threads[6], &rt_sched_attr[6], Service_6, (void *)&(threadParams[6]));
-    if(rc < 0)
-        perror("pthread_create for service 6");
+    if(rc != 0)
+        printf("pthread_create for service 6 failed, rc=%d\n", rc);
     else
+    {
+        started[6]=1;
         printf("pthread_create successful for service 6\n");
+    }
 
 
     // Service_7 = RT_MIN	@ 1 Hz
@@ -380,10 +467,13 @@ void main(void)
     rt_param[7].sched_priority=rt_min_prio;
     pthread_attr_setschedparam(&rt_sched_attr[7], &rt_param[7]);
     rc=pthread_create(&threads[7], &rt_sched_attr[7], Service_7, (void *)&(threadParams[7]));
-    if(rc < 0)
-        perror("pthread_create for service 7");
+    if(rc != 0)
+        printf("pthread_create for service 7 failed, rc=%d\n", rc);
     else
+    {
+        started[7]=1;
         printf("pthread_create successful for service 7\n");
+    }
 
 
     // Wait for service threads to initialize and await relese by sequencer.
@@ -398,9 +488,9 @@ void main(void)
     printf("Start sequencer\n");
     threadParams[0].sequencePeriods=2000;
 
-    // run sequencer on core 1
+    // run sequencer on its own core, core 1 by default
     CPU_ZERO(&threadcpu);
-    cpuidx=(1);
+    cpuidx=coremap.seq_core;
     CPU_SET(cpuidx, &threadcpu);
     rc=pthread_attr_setaffinity_np(&rt_sched_attr[0], sizeof(cpu_set_t), &threadcpu);
 
@@ -409,14 +499,37 @@ void main(void)
     rt_param[0].sched_priority=rt_max_prio;
     pthread_attr_setschedparam(&rt_sched_attr[0], &rt_param[0]);
     rc=pthread_create(&threads[0], &rt_sched_attr[0], Sequencer, (void *)&(threadParams[0]));
-    if(rc < 0)
-        perror("pthread_create for sequencer service 0");
+    if(rc != 0)
+    {
+        // nothing will release the services, stop the ones that started
+        printf("pthread_create for sequencer service 0 failed, rc=%d\n", rc);
+        rtstop_request(&stop, RTSTOP_ABORT);
+    }
     else
+    {
+        started[0]=1;
         printf("pthread_create successful for sequeencer service 0\n");
+    }
 
 
+   // a thread that never started has nothing to join
    for(i=0;i<NUM_THREADS;i++)
-       pthread_join(threads[i], NULL);
+       if(started[i]) pthread_join(threads[i], NULL);
+
+#ifdef EVENT_LOG
+   evlog_drain_stop();
+#endif
+
+#ifdef SERVICE_STATS
+   svc_stats_report(svcStats, 7);
+#endif
+
+#ifdef STACK_ARENA
+   rts_report(&stacks);
+   rts_arena_free(&stacks);
+#endif
+
+   rtstop_report(&stop);
 
    printf("\nTEST COMPLETE\n");
 }
@@ -461,35 +574,30 @@ void *Sequencer(void *threadp)
         // Release each service at a sub-rate of the generic sequencer rate
 
         // Servcie_1 = RT_MAX-1	@ 50 Hz
-        if((seqCnt % 2) == 0) sem_post(&semS1);
+        if((seqCnt % 2) == 0) SVC_RELEASE(0, &semS1);
 
         // Service_2 = RT_MAX-2	@ 20 Hz
-        if((seqCnt % 5) == 0) sem_post(&semS2);
+        if((seqCnt % 5) == 0) SVC_RELEASE(1, &semS2);
 
         // Service_3 = RT_MAX-3	@ 10 Hz
-        if((seqCnt % 10) == 0) sem_post(&semS3);
+        if((seqCnt % 10) == 0) SVC_RELEASE(2, &semS3);
 
         // Service_4 = RT_MAX-4	@ 5 Hz
-        if((seqCnt % 20) == 0) sem_post(&semS4);
+        if((seqCnt % 20) == 0) SVC_RELEASE(3, &semS4);
 
         // Service_5 = RT_MAX-5	@ 2 Hz
-        if((seqCnt % 50) == 0) sem_post(&semS5);
+        if((seqCnt % 50) == 0) SVC_RELEASE(4, &semS5);
 
         // Service_6 = RT_MAX-6	@ 1 Hz
-        if((seqCnt % 100) == 0) sem_post(&semS6);
+        if((seqCnt % 100) == 0) SVC_RELEASE(5, &semS6);
 
         // Service_7 = RT_MIN	1 Hz
-        if((seqCnt % 100) == 0) sem_post(&semS7);
-
-    } while(!abortTest && (seqCnt < threadParams->sequencePeriods));
+        if((seqCnt % 100) == 0) SVC_RELEASE(6, &semS7);
 
-    sem_post(&semS1); sem_post(&semS2); sem_post(&semS3);
-    sem_post(&semS4); sem_post(&semS5); sem_post(&semS6);
-    sem_post(&semS7);
+    } while(!rtstop_stopped(&stop) && (seqCnt < threadParams->sequencePeriods));
 
-    abortS1=TRUE; abortS2=TRUE; abortS3=TRUE;
-    abortS4=TRUE; abortS5=TRUE; abortS6=TRUE;
-    abortS7=TRUE;
+    // shutdown all services, a no-op after an abort request
+    rtstop_request(&stop, RTSTOP_DONE);
 
     pthread_exit((void *)0);
 }
@@ -502,27 +610,42 @@ void *Service_1(void *threadp)
     double current_realtime;
     unsigned long long S1Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(1, "S1 50 Hz");
+#endif
 
     // Start up processing and resource initialization
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S1 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS1) // check for synchronous abort request
+    while(!rtstop_stopped(&stop)) // check for synchronous abort request
     {
 	// wait for service request from the sequencer, a signal handler or ISR in kernel
         sem_wait(&semS1);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
 
         S1Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[0], S1Cnt);
+#endif
 
 	// DO WORK
 
 	// on order of up to milliseconds of latency to get time
+#ifdef EVENT_LOG
+        evlog_record(ring, S1Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S1 50 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S1Cnt, current_realtime-start_realtime);
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[0]);
+#endif
     }
 
     // Resource shutdown here
     //
+    rtstop_exit(&stop, 0);
     pthread_exit((void *)0);
 }
 
@@ -533,19 +656,34 @@ void *Service_2(void *threadp)
     double current_realtime;
     unsigned long long S2Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(2, "S2 20 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S2 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS2)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS2);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S2Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[1], S2Cnt);
+#endif
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S2Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S2 20 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S2Cnt, current_realtime-start_realtime);
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[1]);
+#endif
     }
 
+    rtstop_exit(&stop, 1);
     pthread_exit((void *)0);
 }
 
@@ -556,19 +694,34 @@ void *Service_3(void *threadp)
     double current_realtime;
     unsigned long long S3Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(3, "S3 10 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S3 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS3)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS3);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S3Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[2], S3Cnt);
+#endif
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S3Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S3 10 Hz on core %d forrelease %llu @ sec=%6.9lf\n", sched_getcpu(), S3Cnt, current_realtime-start_realtime);
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[2]);
+#endif
     }
 
+    rtstop_exit(&stop, 2);
     pthread_exit((void *)0);
 }
 
@@ -579,19 +732,34 @@ void *Service_4(void *threadp)
     double current_realtime;
     unsigned long long S4Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(4, "S4 5 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S4 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS4)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS4);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S4Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[3], S4Cnt);
+#endif
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S4Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S4 5 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S4Cnt, current_realtime-start_realtime);
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[3]);
+#endif
     }
 
+    rtstop_exit(&stop, 3);
     pthread_exit((void *)0);
 }
 
@@ -602,19 +770,34 @@ void *Service_5(void *threadp)
     double current_realtime;
     unsigned long long S5Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(5, "S5 2 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S5 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS5)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS5);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S5Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[4], S5Cnt);
+#endif
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S5Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S5 2 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S5Cnt, current_realtime-start_realtime);
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[4]);
+#endif
     }
 
+    rtstop_exit(&stop, 4);
     pthread_exit((void *)0);
 }
 
@@ -624,19 +807,34 @@ void *Service_6(void *threadp)
     double current_realtime;
     unsigned long long S6Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(6, "S6 1 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S6 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS6)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS6);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S6Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[5], S6Cnt);
+#endif
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S6Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S6 1 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S6Cnt, current_realtime-start_realtime);
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[5]);
+#endif
     }
 
+    rtstop_exit(&stop, 5);
     pthread_exit((void *)0);
 }
 
@@ -646,19 +844,34 @@ void *Service_7(void *threadp)
     double current_realtime;
     unsigned long long S7Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(7, "S7 1 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S7 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS7)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS7);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S7Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[6], S7Cnt);
+#endif
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S7Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S7 1 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S7Cnt, current_realtime-start_realtime);
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[6]);
+#endif
     }
 
+    rtstop_exit(&stop, 6);
     pthread_exit((void *)0);
 }
 
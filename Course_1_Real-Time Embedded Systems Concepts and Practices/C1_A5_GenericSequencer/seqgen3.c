@@ -13,6 +13,10 @@
 // 2) Sequencer runs on core 1
 // 3) EVEN thread indexes run on core 2
 // 4) ODD thread indexes run on core 3
+//    That is the default core map of a 4 core board, set COREMAP, e.g.
+//    COREMAP="seq=1,svc=2-7", for any other, the services go round robin
+//    over its svc cores and boards with fewer cores fall back to the last
+//    one, see coremap.h
 // 5) Linux kernel mostly runs on core 0, but does load balance non-RT workload over all cores
 // 6) check for irqbalance [https://linux.die.net/man/1/irqbalance] which also distribute IRQ handlers
 //
@@ -90,6 +94,20 @@
 //
 // 5) For determinism, you should use CPU affinity for AMP scheduling.  Note that without specific affinity,
 //    threads will be SMP by default, annd will be migrated to the least busy core, so be careful.
+//
+// The interval timer rate and the length of the run are options, so a 1 kHz soak needs no rebuild:
+//
+//    seqgen3 [-c coremap] [-f hz] [-n periods]
+//
+//    -c  core map, e.g. "seq=1,svc=2-7", see coremap.h, default $COREMAP
+//    -f  sequencer rate, default 100 Hz, the services stay at the same sub-rates of it
+//    -n  sequencer periods, default 2000
+//
+// The event log rings are sized for the run at start, see evlog.h.
+//
+// The services stop on one shared stop word, see rtstop.h.  The sequencer
+// sets it without printing, since without TIMER_THREAD it runs as the
+// SIGALRM handler, and main prints the stop once it has happened.
 
 // This is necessary for CPU affinity macros in Linux
 #define _GNU_SOURCE
@@ -108,7 +126,14 @@
 #include <sys/sysinfo.h>
 #include <errno.h>
 
+#include "evlog.h"
+#include "rtstack.h"
+#include "rtstop.h"
+#include "coremap.h"
+
 #include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
 
 #define USEC_PER_MSEC (1000)
 #define NANOSEC_PER_MSEC (1000000)
@@ -117,8 +142,36 @@
 #define TRUE (1)
 #define FALSE (0)
 
+// log releases to lock-free in-memory rings rather than calling syslog
+// from the SCHED_FIFO service threads
+#define EVENT_LOG
+
 #define NUM_THREADS (7)
 
+// every thread on a SERVICE_STACK stack carved from one locked arena
+// instead of an 8 MB default one, high water marks printed at the end,
+// see rtstack.h
+#define STACK_ARENA
+#define SERVICE_STACK (64*1024)
+
+#ifdef STACK_ARENA
+rts_arena_t stacks;
+#endif
+
+// default interval timer, 10 msec, 100 Hz, and run length
+#define SEQ_PERIOD_NSEC (10000000)
+#define SEQ_PERIODS (2000)
+#define SEQ_MAX_HZ (10000)
+
+// Take the interval timer signal with sigwaitinfo in a dedicated SCHED_FIFO
+// RT_MAX sequencer thread on core 1, instead of running Sequencer() as a
+// SIGALRM handler on whichever thread the signal happens to interrupt
+#define TIMER_THREAD
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
 // Of the available user space clocks, CLOCK_MONONTONIC_RAW is typically most precise and not subject to 
 // updates from external timer adjustments
 //
@@ -130,14 +183,20 @@
 //#define MY_CLOCK_TYPE CLOCK_REALTIME_COARSE
 //#define MY_CLOCK_TYPE CLOCK_MONTONIC_COARSE
 
-int abortTest=FALSE;
-int abortS1=FALSE, abortS2=FALSE, abortS3=FALSE, abortS4=FALSE, abortS5=FALSE, abortS6=FALSE, abortS7=FALSE;
+// rtstop_request(&stop, RTSTOP_ABORT) from anywhere ends the run early
+rtstop_t stop;
 sem_t semS1, semS2, semS3, semS4, semS5, semS6, semS7;
+coremap_t coremap;
+const char *coremap_spec=(const char *)0;
 struct timespec start_time_val;
 double start_realtime;
-unsigned long long sequencePeriods;
+unsigned long long sequencePeriods=SEQ_PERIODS;
+long seq_period_nsec=SEQ_PERIOD_NSEC;
 
 static timer_t timer_1;
+#ifdef TIMER_THREAD
+static unsigned long long timerOverruns=0;
+#endif
 static struct itimerspec itime = {{1,0}, {1,0}};
 static struct itimerspec last_itime;
 
@@ -150,6 +209,9 @@ typedef struct
 
 
 void Sequencer(int id);
+#ifdef TIMER_THREAD
+void *SequencerThread(void *threadp);
+#endif
 
 void *Service_1(void *threadp);
 void *Service_2(void *threadp);
@@ -202,17 +264,21 @@ static inline unsigned ccnt_read (void)
 
 
 
-void main(void)
+int main(int argc, char *argv[])
 {
     struct timespec current_time_val, current_time_res;
-    double current_realtime, current_realtime_res;
+    double current_realtime, current_realtime_res, hz;
 
-    int i, rc, scope, flags=0;
+    int i, rc, scope, opt;
 
     cpu_set_t threadcpu;
     cpu_set_t allcpuset;
+#ifdef STACK_ARENA
+    char stack_name[RTS_NAME_LEN];
+#endif
 
     pthread_t threads[NUM_THREADS];
+    int started[NUM_THREADS]={0};     // joined only if pthread_create succeeded
     threadParams_t threadParams[NUM_THREADS];
     pthread_attr_t rt_sched_attr[NUM_THREADS];
     int rt_max_prio, rt_min_prio, cpuidx;
@@ -223,11 +289,51 @@ void main(void)
     pthread_attr_t main_attr;
     pid_t mainpid;
 
+#ifdef TIMER_THREAD
+    sigset_t alarmset;
+    pthread_t seq_thread;
+    pthread_attr_t seq_attr;
+    struct sched_param seq_param;
+#else
+    int flags=0;
+#endif
+
+    while((opt=getopt(argc, argv, "c:f:n:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'c':
+                coremap_spec=optarg;
+                break;
+            case 'f':
+                hz=atof(optarg);
+                if(hz < 1.0 || hz > SEQ_MAX_HZ)
+                {
+                    printf("sequencer rate %s Hz, 1 to %d\n", optarg, SEQ_MAX_HZ);
+                    exit(-1);
+                }
+                seq_period_nsec=(long)((double)NANOSEC_PER_SEC/hz + 0.5);
+                break;
+            case 'n':
+                sequencePeriods=strtoull(optarg, (char **)0, 10);
+                break;
+            default:
+                printf("usage: seqgen3 [-c coremap] [-f hz] [-n periods]\n");
+                exit(-1);
+        }
+    }
+
     system("echo > /dev/null | sudo tee /var/log/syslog");
     openlog("[COURSE:1][ASSIGNMENT:5] seqgen3:", LOG_NDELAY, LOG_DAEMON);
 
-    printf("Starting High Rate Sequencer Demo\n");
+    printf("Starting High Rate Sequencer Demo, %llu periods at %.1lf Hz\n", sequencePeriods, (double)NANOSEC_PER_SEC/seq_period_nsec);
     clock_gettime(MY_CLOCK_TYPE, &start_time_val); start_realtime=realtime(&start_time_val);
+#ifdef EVENT_LOG
+    // services log to in-memory rings, a SCHED_OTHER thread on core 0 does the syslog calls
+    // Service_1 is released every other period, the fastest ring
+    evlog_init_size(MY_CLOCK_TYPE, &start_time_val, evlog_ring_events((double)NANOSEC_PER_SEC/seq_period_nsec/2, sequencePeriods/2 + 1));
+    evlog_drain_start(0);
+#endif
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     clock_getres(MY_CLOCK_TYPE, &current_time_res); current_realtime_res=realtime(&current_time_res);
     printf("START High Rate Sequencer @ sec=%6.9lf with resolution %6.9lf\n", (current_realtime - start_realtime), current_realtime_res);
@@ -245,6 +351,10 @@ void main(void)
 
    printf("Using CPUS=%d from total available.\n", CPU_COUNT(&allcpuset));
 
+   coremap_init(&coremap);
+   if(coremap_parse(&coremap, coremap_spec) != 0) exit(-1);
+   coremap_check(&coremap);
+
 
     // initialize the sequencer semaphores
     //
@@ -256,8 +366,23 @@ void main(void)
     if (sem_init (&semS6, 0, 0)) { printf ("Failed to initialize S6 semaphore\n"); exit (-1); }
     if (sem_init (&semS7, 0, 0)) { printf ("Failed to initialize S7 semaphore\n"); exit (-1); }
 
+    // in service order, the index each service's rtstop_exit() takes
+    rtstop_init(&stop, MY_CLOCK_TYPE);
+    rtstop_add(&stop, &semS1, "S1 50 Hz"); rtstop_add(&stop, &semS2, "S2 10 Hz");
+    rtstop_add(&stop, &semS3, "S3 6.66 Hz"); rtstop_add(&stop, &semS4, "S4 5 Hz");
+    rtstop_add(&stop, &semS5, "S5 2 Hz"); rtstop_add(&stop, &semS6, "S6 1 Hz");
+    rtstop_add(&stop, &semS7, "S7 1 Hz");
+
     mainpid=getpid();
 
+#ifdef TIMER_THREAD
+    // block SIGALRM before any thread is created so every thread inherits
+    // the mask, only the sequencer thread ever takes it with sigwaitinfo
+    sigemptyset(&alarmset);
+    sigaddset(&alarmset, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alarmset, NULL);
+#endif
+
     rt_max_prio = sched_get_priority_max(SCHED_FIFO);
     rt_min_prio = sched_get_priority_min(SCHED_FIFO);
 
@@ -281,26 +406,23 @@ void main(void)
     printf("rt_min_prio=%d\n", rt_min_prio);
 
 
+#ifdef STACK_ARENA
+    rts_arena_init(&stacks, NUM_THREADS+1, (NUM_THREADS+1)*rts_span(SERVICE_STACK));
+#endif
+
     for(i=0; i < NUM_THREADS; i++)
     {
-
-      // run even indexed threads on core 2
-      if(i % 2 == 0)
-      {
-          CPU_ZERO(&threadcpu);
-          cpuidx=(2);
-          CPU_SET(cpuidx, &threadcpu);
-      }
-
-      // run odd indexed threads on core 3
-      else
-      {
-          CPU_ZERO(&threadcpu);
-          cpuidx=(3);
-          CPU_SET(cpuidx, &threadcpu);
-      }
+      // round robin over the service cores, even indexed threads on core 2
+      // and odd on core 3 with the default map of a 4 core board
+      CPU_ZERO(&threadcpu);
+      cpuidx=coremap.svc_cores[i % coremap.nsvc];
+      CPU_SET(cpuidx, &threadcpu);
 
       rc=pthread_attr_init(&rt_sched_attr[i]);
+#ifdef STACK_ARENA
+      snprintf(stack_name, sizeof(stack_name), "Service_%d", i+1);
+      rts_attr_stack(&stacks, &rt_sched_attr[i], SERVICE_STACK, stack_name);
+#endif
       rc=pthread_attr_setinheritsched(&rt_sched_attr[i], PTHREAD_EXPLICIT_SCHED);
       rc=pthread_attr_setschedpolicy(&rt_sched_attr[i], SCHED_FIFO);
       rc=pthread_attr_setaffinity_np(&rt_sched_attr[i], sizeof(cpu_set_t), &threadcpu);
@@ -326,10 +448,13 @@ void main(void)
                       Service_1,                 // thread function entry point
                       (void *)&(threadParams[0]) // parameters to pass in
                      );
-    if(rc < 0)
-        perror("pthread_create for service 1");
+    if(rc != 0)
+        printf("pthread_create for service 1 failed, rc=%d\n", rc);
     else
+    {
+        started[0]=1;
         printf("pthread_create successful for service 1\n");
+    }
 
 
     // Service_2 = RT_MAX-2	@ 20 Hz
@@ -337,10 +462,13 @@ void main(void)
     rt_param[1].sched_priority=rt_max_prio-2;
     pthread_attr_setschedparam(&rt_sched_attr[1], &rt_param[1]);
     rc=pthread_create(&threads[1], &rt_sched_attr[1], Service_2, (void *)&(threadParams[1]));
-    if(rc < 0)
-        perror("pthread_create for service 2");
+    if(rc != 0)
+        printf("pthread_create for service 2 failed, rc=%d\n", rc);
     else
+    {
+        started[1]=1;
         printf("pthread_create successful for service 2\n");
+    }
 
 
     // Service_3 = RT_MAX-3	@ 10 Hz
@@ -348,10 +476,13 @@ void main(void)
     rt_param[2].sched_priority=rt_max_prio-3;
     pthread_attr_setschedparam(&rt_sched_attr[2], &rt_param[2]);
     rc=pthread_create(&threads[2], &rt_sched_attr[2], Service_3, (void *)&(threadParams[2]));
-    if(rc < 0)
-        perror("pthread_create for service 3");
+    if(rc != 0)
+        printf("pthread_create for service 3 failed, rc=%d\n", rc);
     else
+    {
+        started[2]=1;
         printf("pthread_create successful for service 3\n");
+    }
 
 
     // Service_4 = RT_MAX-4	@ 5 Hz
@@ -359,10 +490,13 @@ void main(void)
     rt_param[3].sched_priority=rt_max_prio-4;
     pthread_attr_setschedparam(&rt_sched_attr[3], &rt_param[3]);
     rc=pthread_create(&threads[3], &rt_sched_attr[3], Service_4, (void *)&(threadParams[3]));
-    if(rc < 0)
-        perror("pthread_create for service 4");
+    if(rc != 0)
+        printf("pthread_create for service 4 failed, rc=%d\n", rc);
     else
+    {
+        started[3]=1;
         printf("pthread_create successful for service 4\n");
+    }
 
 
     // Service_5 = RT_MAX-5	@ 2 Hz
@@ -370,10 +504,13 @@ void main(void)
     rt_param[4].sched_priority=rt_max_prio-5;
     pthread_attr_setschedparam(&rt_sched_attr[4], &rt_param[4]);
     rc=pthread_create(&threads[4], &rt_sched_attr[4], Service_5, (void *)&(threadParams[4]));
-    if(rc < 0)
-        perror("pthread_create for service 5");
+    if(rc != 0)
+        printf("pthread_create for service 5 failed, rc=%d\n", rc);
     else
+    {
+        started[4]=1;
         printf("pthread_create successful for service 5\n");
+    }
 
 
     // Service_6 = RT_MAX-6	@ 1 Hz
@@ -381,10 +518,13 @@ void main(void)
     rt_param[5].sched_priority=rt_max_prio-6;
     pthread_attr_setschedparam(&rt_sched_attr[5], &rt_param[5]);
     rc=pthread_create(&threads[5], &rt_sched_attr[5], Service_6, (void *)&(threadParams[5]));
-    if(rc < 0)
-        perror("pthread_create for service 6");
+    if(rc != 0)
+        printf("pthread_create for service 6 failed, rc=%d\n", rc);
     else
+    {
+        started[5]=1;
         printf("pthread_create successful for service 6\n");
+    }
 
 
     // Service_7 = RT_MIN	@ 1 Hz
@@ -392,10 +532,13 @@ void main(void)
     rt_param[6].sched_priority=rt_min_prio;
     pthread_attr_setschedparam(&rt_sched_attr[6], &rt_param[6]);
     rc=pthread_create(&threads[6], &rt_sched_attr[6], Service_7, (void *)&(threadParams[6]));
-    if(rc < 0)
-        perror("pthread_create for service 7");
+    if(rc != 0)
+        printf("pthread_create for service 7 failed, rc=%d\n", rc);
     else
+    {
+        started[6]=1;
         printf("pthread_create successful for service 7\n");
+    }
 
 
     // Wait for service threads to initialize and await relese by sequencer.
@@ -408,8 +551,29 @@ void main(void)
  
     // Create Sequencer thread, which like a cyclic executive, is highest prio
     printf("Start sequencer\n");
-    sequencePeriods=2000;
 
+#ifdef TIMER_THREAD
+    // Sequencer = RT_MAX	@ 100 Hz, creates and arms its own timer
+    //
+    CPU_ZERO(&threadcpu);
+    CPU_SET(coremap.seq_core, &threadcpu);
+
+    pthread_attr_init(&seq_attr);
+    pthread_attr_setinheritsched(&seq_attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&seq_attr, SCHED_FIFO);
+    pthread_attr_setaffinity_np(&seq_attr, sizeof(cpu_set_t), &threadcpu);
+    seq_param.sched_priority=rt_max_prio;
+    pthread_attr_setschedparam(&seq_attr, &seq_param);
+#ifdef STACK_ARENA
+    rts_attr_stack(&stacks, &seq_attr, SERVICE_STACK, "Sequencer");
+#endif
+
+    if((rc=pthread_create(&seq_thread, &seq_attr, SequencerThread, (void *)0)) != 0)
+    {
+        printf("pthread_create for sequencer failed, rc=%d\n", rc);
+        exit(-1);
+    }
+#else
     // Sequencer = RT_MAX	@ 100 Hz
     //
     /* set up to signal SIGALRM if timer expires */
@@ -419,32 +583,113 @@ void main(void)
 
 
     /* arm the interval timer */
-    itime.it_interval.tv_sec = 0;
-    itime.it_interval.tv_nsec = 10000000;
-    itime.it_value.tv_sec = 0;
-    itime.it_value.tv_nsec = 10000000;
+    itime.it_interval.tv_sec = seq_period_nsec / NANOSEC_PER_SEC;
+    itime.it_interval.tv_nsec = seq_period_nsec % NANOSEC_PER_SEC;
+    itime.it_value=itime.it_interval;
     //itime.it_interval.tv_sec = 1;
     //itime.it_interval.tv_nsec = 0;
     //itime.it_value.tv_sec = 1;
     //itime.it_value.tv_nsec = 0;
 
     timer_settime(timer_1, flags, &itime, &last_itime);
+#endif
 
+    // the sequencer only sets the stop word, the message is printed here
+    rc=rtstop_wait(&stop);
+    printf("Disabling sequencer interval timer with %s at %llu of %llu\n", rtstop_reason(rc), seqCnt, sequencePeriods);
 
     for(i=0;i<NUM_THREADS;i++)
     {
-        if(rc=pthread_join(threads[i], NULL) < 0)
-		perror("main pthread_join");
-	else
-		printf("joined thread %d\n", i);
+        // a thread that never started has nothing to join
+        if(!started[i])
+            continue;
+
+        if((rc=pthread_join(threads[i], NULL)) != 0)
+            printf("main pthread_join thread %d failed, rc=%d\n", i, rc);
+        else
+            printf("joined thread %d\n", i);
     }
 
+#ifdef TIMER_THREAD
+    pthread_join(seq_thread, NULL);
+    printf("Sequencer timer overruns %llu\n", timerOverruns);
+    syslog(LOG_CRIT, "Sequencer timer overruns %llu\n", timerOverruns);
+#endif
+
+#ifdef EVENT_LOG
+   evlog_drain_stop();
+#endif
+
+#ifdef STACK_ARENA
+   rts_report(&stacks);
+   rts_arena_free(&stacks);
+#endif
+
+   rtstop_report(&stop);
+
    printf("\nTEST COMPLETE\n");
    closelog();
 }
 
 
 
+#ifdef TIMER_THREAD
+void *SequencerThread(void *threadp)
+{
+    struct sigevent sev;
+    sigset_t alarmset;
+    siginfo_t info;
+    int overrun, flags=0;
+
+    sigemptyset(&alarmset);
+    sigaddset(&alarmset, SIGALRM);
+
+    // timer expiry is queued to this thread only, never to a service
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify=SIGEV_THREAD_ID;
+    sev.sigev_signo=SIGALRM;
+    sev.sigev_notify_thread_id=syscall(SYS_gettid);
+
+    if(timer_create(CLOCK_REALTIME, &sev, &timer_1) != 0)
+    {
+        perror("timer_create SIGEV_THREAD_ID");
+        exit(-1);
+    }
+
+    /* arm the interval timer */
+    itime.it_interval.tv_sec = seq_period_nsec / NANOSEC_PER_SEC;
+    itime.it_interval.tv_nsec = seq_period_nsec % NANOSEC_PER_SEC;
+    itime.it_value=itime.it_interval;
+
+    timer_settime(timer_1, flags, &itime, &last_itime);
+
+    while(!rtstop_stopped(&stop) && (seqCnt < sequencePeriods))
+    {
+        if(sigwaitinfo(&alarmset, &info) < 0)
+        {
+            if(errno == EINTR) continue;
+            perror("sigwaitinfo");
+            break;
+        }
+
+        // expirations that came and went while the signal was pending are
+        // merged into it, release for them too so seqCnt stays locked to time
+        overrun=timer_getoverrun(timer_1);
+        if(overrun > 0) timerOverruns+=overrun;
+
+        do
+        {
+            Sequencer(info.si_signo);
+        } while((overrun-- > 0) && (seqCnt < sequencePeriods));
+    }
+
+    timer_delete(timer_1);
+
+    pthread_exit((void *)0);
+}
+#endif
+
+
 void Sequencer(int id)
 {
     struct timespec current_time_val;
@@ -484,7 +729,7 @@ void Sequencer(int id)
     //if((seqCnt % 100) == 0) sem_post(&semS7);
 
     
-    if(abortTest || (seqCnt >= sequencePeriods))
+    if(rtstop_stopped(&stop) || (seqCnt >= sequencePeriods))
     {
         // disable interval timer
         itime.it_interval.tv_sec = 0;
@@ -492,16 +737,9 @@ void Sequencer(int id)
         itime.it_value.tv_sec = 0;
         itime.it_value.tv_nsec = 0;
         timer_settime(timer_1, flags, &itime, &last_itime);
-	printf("Disabling sequencer interval timer with abort=%d and %llu of %d\n", abortTest, seqCnt, sequencePeriods);
-
-	// shutdown all services
-        sem_post(&semS1); sem_post(&semS2); sem_post(&semS3);
-        sem_post(&semS4); sem_post(&semS5); sem_post(&semS6);
-        sem_post(&semS7);
 
-        abortS1=TRUE; abortS2=TRUE; abortS3=TRUE;
-        abortS4=TRUE; abortS5=TRUE; abortS6=TRUE;
-        abortS7=TRUE;
+	// shutdown all services, signal safe, a no-op after an abort request
+        rtstop_request(&stop, RTSTOP_DONE);
     }
 
 }
@@ -514,28 +752,37 @@ void *Service_1(void *threadp)
     double current_realtime;
     unsigned long long S1Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(1, "S1 50 Hz");
+#endif
 
     // Start up processing and resource initialization
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S1 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S1 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS1) // check for synchronous abort request
+    while(!rtstop_stopped(&stop)) // check for synchronous abort request
     {
 	// wait for service request from the sequencer, a signal handler or ISR in kernel
         sem_wait(&semS1);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
 
         S1Cnt++;
 
 	// DO WORK
 
 	// on order of up to milliseconds of latency to get time
+#ifdef EVENT_LOG
+        evlog_record(ring, S1Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S1 50 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S1Cnt, current_realtime-start_realtime);
+#endif
     }
 
     // Resource shutdown here
     //
+    rtstop_exit(&stop, 0);
     pthread_exit((void *)0);
 }
 
@@ -546,20 +793,29 @@ void *Service_2(void *threadp)
     double current_realtime;
     unsigned long long S2Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(2, "S2 10 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S2 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S2 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS2)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS2);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S2Cnt++;
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S2Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S2 10 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S2Cnt, current_realtime-start_realtime);
+#endif
     }
 
+    rtstop_exit(&stop, 1);
     pthread_exit((void *)0);
 }
 
@@ -570,20 +826,29 @@ void *Service_3(void *threadp)
     double current_realtime;
     unsigned long long S3Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(3, "S3 6.66 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S3 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S3 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS3)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS3);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S3Cnt++;
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S3Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S3 6.66 Hz on core %d forrelease %llu @ sec=%6.9lf\n", sched_getcpu(), S3Cnt, current_realtime-start_realtime);
+#endif
     }
 
+    rtstop_exit(&stop, 2);
     pthread_exit((void *)0);
 }
 
@@ -594,20 +859,29 @@ void *Service_4(void *threadp)
     double current_realtime;
     unsigned long long S4Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(4, "S4 5 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S4 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S4 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS4)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS4);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S4Cnt++;
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S4Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S4 5 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S4Cnt, current_realtime-start_realtime);
+#endif
     }
 
+    rtstop_exit(&stop, 3);
     pthread_exit((void *)0);
 }
 
@@ -618,20 +892,29 @@ void *Service_5(void *threadp)
     double current_realtime;
     unsigned long long S5Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(5, "S5 2 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S5 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S5 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS5)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS5);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S5Cnt++;
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S5Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S5 2 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S5Cnt, current_realtime-start_realtime);
+#endif
     }
 
+    rtstop_exit(&stop, 4);
     pthread_exit((void *)0);
 }
 
@@ -641,20 +924,29 @@ void *Service_6(void *threadp)
     double current_realtime;
     unsigned long long S6Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(6, "S6 1 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S6 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S6 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS6)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS6);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S6Cnt++;
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S6Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S6 1 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S6Cnt, current_realtime-start_realtime);
+#endif
     }
 
+    rtstop_exit(&stop, 5);
     pthread_exit((void *)0);
 }
 
@@ -664,20 +956,29 @@ void *Service_7(void *threadp)
     double current_realtime;
     unsigned long long S7Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(7, "S7 1 Hz");
+#endif
 
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     syslog(LOG_CRIT, "S7 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S7 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS7)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS7);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S7Cnt++;
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S7Cnt);
+#else
         clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
         syslog(LOG_CRIT, "S7 1 Hz on core %d for release %llu @ sec=%6.9lf\n", sched_getcpu(), S7Cnt, current_realtime-start_realtime);
+#endif
     }
 
+    rtstop_exit(&stop, 6);
     pthread_exit((void *)0);
 }
 
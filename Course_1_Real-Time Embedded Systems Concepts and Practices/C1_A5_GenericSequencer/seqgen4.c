@@ -0,0 +1,1361 @@
+// Table-driven version of seqgen2
+//
+// Same 100 Hz sequencer and SCHED_FIFO services as seqgen2.c, but the
+// services are rows of a scenario table (see seqtable.h) run by one generic
+// service body, so adding a service is adding a row.
+//
+// Besides the seqgen2 seven service demo, the Course 2 assignment scenarios
+// are built in so they all run from the one binary:
+//
+//    seqgen4 [-s scenario] [-F file] [-n periods] [-d sec] [-f hz] [-m fifo|deadline] [-t abs|timerfd|hybrid|adaptive|adaptive-sleep] [-j usec] [-r sem|futex|eventfd] [-w pct] [-c coremap] [-P ff|wf|ll] [-x file] [-A T:C[:D][@tick]] [-e] [-S inherit|ceiling|seqlock[:pct]] [-G] [-L file] [-H hyperperiods] [-E] [-a] [-g rm|dm|edf|llf|fp] [-l]
+//
+//    -s  scenario name, default seqgen2
+//    -F  run the service table in a text file instead of a scenario, one
+//        "name T C [D [priority [core [stack]]]]" row per line, T, C and D
+//        in ticks, # starts a comment; D 0 is D=T, priority 0 or left out
+//        is the rate monotonic rank, core -1 or left out alternates 2 and
+//        3, and stack is the service thread's stack in K, 0 or left out
+//        for the 64 K default, seq_shutdown() reports how much each used
+//    -n  number of sequencer periods, default the scenario's own or one
+//        hyperperiod (LCM of the service periods)
+//    -d  run for sec seconds of ticks instead of -n periods
+//    -f  sequencer tick rate in Hz, default 100, e.g. 1000 for a 1 kHz soak;
+//        T, C and D of every row are in these ticks.  The event log rings
+//        are sized from the rate and run length at start (evlog.h) and, with
+//        the stats histograms, faulted in before tick 0, so a long run does
+//        not allocate anything once it is releasing
+//    -m  fifo, the default, releases SCHED_FIFO services from the sequencer;
+//        deadline runs every service under SCHED_DEADLINE with C/D/T from
+//        its row and no sequencer, so EDF-feasible sets above the RM bound
+//        (c2a7) can be compared against the fixed priority run
+//    -t  sequencer timing backend, see seqtimer.h, default abs
+//    -j  hybrid mode spin window in usec, default 100, and the adaptive
+//        modes' first guess before they have measured the board
+//    -r  service release primitive, see seqrelease.h, default sem
+//    -w  burn pct% of each service's C as calibrated busy work on every
+//        release (see busywork.h), default 0; give SCHED_DEADLINE runs some
+//        headroom below 100 or the jobs get throttled at their budget
+//    -c  core map, e.g. "seq=1,svc=2-7", see coremap.h; the services are
+//        then bin-packed onto the svc cores by decreasing utilization C/T
+//        instead of using the core column of the table.  $COREMAP is used
+//        without -c.
+//    -P  how the services are packed with a core map: ff, the default, and
+//        wf are first and worst fit against the exact test of each core
+//        (schedmc.h), RTA or EDF with -m deadline; ll is first fit against
+//        the Liu and Layland bound (coremap_pack)
+//    -x  run the task set of a Cheddar XML model (see cheddar.h), e.g. one of
+//        the C1_A6_CheddarAnalysisSchedules files, instead of a scenario;
+//        Cheddar time units are taken as ticks and the services are ranked
+//        by the scheduler of the model's core
+//    -A  ask for one more service with period T, C and D in ticks to be
+//        admitted while the scenario runs, at the given tick, default 1; may
+//        be repeated.  Admission control (seqadmit.h) accepts or rejects it
+//        within the tick, and an accepted one takes a standby thread made
+//        at start.  It is first released on that tick when the tick is a
+//        multiple of T, otherwise on the next multiple.  It gets the
+//        priority below the rows of period T or less.
+//    -e  run the scenario as a cyclic executive instead (seqcyclic.h): a
+//        frame table is laid out offline, printed, and run by the
+//        sequencer thread, which calls every service inline on its own
+//        core once per minor frame; compare its overhead, jitter and
+//        service stats with the same scenario released by -r
+//    -S  every scenario row shares one camera frame buffer (seqshare.h):
+//        the highest priority row writes a frame each release, the others
+//        copy it, and pct% of each release's -w busy work, default 25, is
+//        done inside the critical section.  inherit and ceiling guard it
+//        with a PTHREAD_PRIO_INHERIT or PTHREAD_PRIO_PROTECT mutex and add
+//        the blocking bound to the analysis; seqlock lets the readers copy
+//        without a lock.
+//    -G  run the services with the same period and core as one rate group
+//        thread each (seq_group_rates), one wake-up per group per period
+//        instead of one per service, e.g. the three T=30 rows of -s seqgen
+//    -L  write the release events to a binary evlog file instead of syslog,
+//        for logcheck to go through after a long run; the file also keeps
+//        each row's T, C, D and priority, the time of tick 0 and when each
+//        job finished, so seqreplay can line it up against the simulator
+//    -H  run for that many hyperperiods instead of -n periods
+//    -E  pin every CPU to the performance governor for the run (root) and
+//        count cycles, instructions, cache misses and context switches of
+//        each service thread (rtenv.h); without it the governor, clocks and
+//        temperatures are still checked and printed before and after
+//    -a  only run the feasibility analysis (schedan.h) of the scenario and
+//        exit 0 if it is feasible under the -m policy, 1 if not
+//    -g  simulate the scenario offline under the policy for the -n periods
+//        (schedsim.h), fp for the table's own priorities, print the timeline
+//        and exit 0 if no deadline was missed, 1 if one was; nothing is run
+//        in real time
+//    -l  list the scenarios
+//
+// The analysis is printed before anything starts either way, with a
+// warning when the run is expected to miss deadlines.  Like the Course 2
+// assignments it treats the services as sharing one core.
+//
+// With SERVICE_STATS the sequencer-to-service release latency of each
+// service is printed at the end, to compare the release primitives.
+//
+// Ticks the sequencer wakes too late for are counted as missed, and the
+// services due on them are released in the same wake-up so the tick count
+// stays locked to time.
+//
+// Service_1 = RT_MAX-1, Service_2 = RT_MAX-2, ... as in seqgen2, so the
+// tables are in rate monotonic order.  Without a core map, services on
+// even rows run on core 2, odd rows on core 3, the sequencer on core 1, and
+// cores that are not online are replaced by the last online core.
+//
+
+// This is necessary for CPU affinity macros in Linux
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <semaphore.h>
+
+#include <syslog.h>
+#include <sys/time.h>
+#include <sys/sysinfo.h>
+#include <errno.h>
+
+#include "evlog.h"
+#include "seqtable.h"
+#include "seqtimer.h"
+#include "busywork.h"
+#include "coremap.h"
+#include "schedan.h"
+#include "cheddar.h"
+#include "schedsim.h"
+#include "schedmc.h"
+#include "seqadmit.h"
+#include "seqcyclic.h"
+#include "seqshare.h"
+#include "rtinit.h"
+#include "rttrace.h"
+#include "rtenv.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+#define TRUE (1)
+#define FALSE (0)
+
+// log releases to lock-free in-memory rings rather than calling syslog
+// from the SCHED_FIFO service threads
+#define EVENT_LOG
+
+// per-service release latency, execution and response time histograms
+#define SERVICE_STATS
+
+// lock and prefault all memory before the first release, see rtinit.h
+#define MEMORY_LOCK
+
+// default sequencer tick, 10 msec, 100 Hz, -f to change it
+#define SEQ_PERIOD_NSEC (10000000)
+#define SEQ_MAX_HZ (10000)
+
+// Linux SCHED_FIFO priority range, checked against the scheduler in main
+#define RT_MAX (99)
+#define RT_MIN (1)
+
+#define MY_CLOCK_TYPE CLOCK_MONOTONIC_RAW
+
+// -A requests, each gets a standby service thread
+#define MAX_ADMIT (8)
+
+// -S shared camera frame, and the part of C spent on it by default
+#define FRAME_BYTES (320*240)
+#define SHARE_PCT (25)
+#define SHARE_SEQLOCK (2)
+
+typedef struct
+{
+    const char *name;
+    const service_desc_t *services;
+    int nservices;
+    unsigned long long periods;     // 0 for one hyperperiod
+} scenario_t;
+
+static void log_release(service_t *svc);
+
+// seqgen2.c, 100 Hz sequencer with 7 sub-rate services
+static const service_desc_t seqgen2_services[] =
+{
+    {"S1 50 Hz",  2,   1, 0, RT_MAX-1, 3, log_release, 0},
+    {"S2 20 Hz",  5,   1, 0, RT_MAX-2, 2, log_release, 0},
+    {"S3 10 Hz",  10,  1, 0, RT_MAX-3, 3, log_release, 0},
+    {"S4 5 Hz",   20,  1, 0, RT_MAX-4, 2, log_release, 0},
+    {"S5 2 Hz",   50,  1, 0, RT_MAX-5, 3, log_release, 0},
+    {"S6 1 Hz",   100, 1, 0, RT_MAX-6, 2, log_release, 0},
+    {"S7 1 Hz",   100, 1, 0, RT_MIN,   3, log_release, 0},
+};
+
+// seqgen.c, the 30 Hz sequencer's rates as ticks, all on core 3 and in RM
+// order, so T=30 and T=60 are rate groups with -G
+static const service_desc_t seqgen_services[] =
+{
+    {"S1 T=10",  10,  1, 0, RT_MAX-1, 3, log_release, 0},
+    {"S2 T=30",  30,  1, 0, RT_MAX-2, 3, log_release, 0},
+    {"S4 T=30",  30,  1, 0, RT_MAX-3, 3, log_release, 0},
+    {"S6 T=30",  30,  1, 0, RT_MAX-4, 3, log_release, 0},
+    {"S3 T=60",  60,  1, 0, RT_MAX-5, 3, log_release, 0},
+    {"S5 T=60",  60,  1, 0, RT_MAX-6, 3, log_release, 0},
+    {"S7 T=300", 300, 1, 0, RT_MIN,   3, log_release, 0},
+};
+
+// Course 2 assignment scenarios, T, C and D in sequencer ticks
+static const service_desc_t c2a1_services[] =
+{
+    {"S1 T=2",  2,  1, 0, RT_MAX-1, 2, log_release, 0},
+    {"S2 T=10", 10, 1, 0, RT_MAX-2, 3, log_release, 0},
+    {"S3 T=15", 15, 2, 0, RT_MAX-3, 2, log_release, 0},
+};
+
+static const service_desc_t c2a2_services[] =
+{
+    {"S1 T=2",  2,  1, 0, RT_MAX-1, 2, log_release, 0},
+    {"S2 T=5",  5,  1, 0, RT_MAX-2, 3, log_release, 0},
+    {"S3 T=15", 15, 2, 0, RT_MAX-3, 2, log_release, 0},
+};
+
+static const service_desc_t c2a3_services[] =
+{
+    {"S1 T=2",  2,  1, 0, RT_MAX-1, 2, log_release, 0},
+    {"S2 T=5",  5,  1, 0, RT_MAX-2, 3, log_release, 0},
+    {"S3 T=10", 10, 2, 0, RT_MAX-3, 2, log_release, 0},
+    {"S4 T=20", 20, 2, 0, RT_MAX-4, 3, log_release, 0},
+};
+
+static const service_desc_t c2a4_services[] =
+{
+    {"S1 T=2",  2,  1, 0, RT_MAX-1, 2, log_release, 0},
+    {"S2 T=5",  5,  1, 0, RT_MAX-2, 3, log_release, 0},
+    {"S3 T=7",  7,  1, 0, RT_MAX-3, 2, log_release, 0},
+    {"S4 T=13", 13, 2, 0, RT_MAX-4, 3, log_release, 0},
+};
+
+static const service_desc_t c2a5_services[] =
+{
+    {"S1 T=2",  2,  1, 0, RT_MAX-1, 2, log_release, 0},
+    {"S2 T=5",  5,  2, 0, RT_MAX-2, 3, log_release, 0},
+    {"S3 T=10", 10, 1, 0, RT_MAX-3, 2, log_release, 0},
+};
+
+// same task set as c2a4 with the deadlines of the assignment sheet, S2 due
+// early and S4 late (D > T), fails RM against D=T but is DM feasible
+static const service_desc_t c2a6_services[] =
+{
+    {"S1 T=2",  2,  1, 2,  RT_MAX-1, 2, log_release, 0},
+    {"S2 T=5",  5,  1, 4,  RT_MAX-2, 3, log_release, 0},
+    {"S3 T=7",  7,  1, 7,  RT_MAX-3, 2, log_release, 0},
+    {"S4 T=13", 13, 2, 20, RT_MAX-4, 3, log_release, 0},
+};
+
+static const service_desc_t c2a7_services[] =
+{
+    {"S1 T=3",  3,  1, 0, RT_MAX-1, 2, log_release, 0},
+    {"S2 T=6",  6,  2, 0, RT_MAX-2, 3, log_release, 0},
+    {"S3 T=9",  9,  3, 0, RT_MAX-3, 2, log_release, 0},
+};
+
+#define NUM_ROWS(t) ((int)(sizeof(t)/sizeof((t)[0])))
+
+static const scenario_t scenarios[] =
+{
+    {"seqgen2", seqgen2_services, NUM_ROWS(seqgen2_services), 2000},
+    {"seqgen",  seqgen_services,  NUM_ROWS(seqgen_services),  0},
+    {"c2a1",    c2a1_services,    NUM_ROWS(c2a1_services),    0},
+    {"c2a2",    c2a2_services,    NUM_ROWS(c2a2_services),    0},
+    {"c2a3",    c2a3_services,    NUM_ROWS(c2a3_services),    0},
+    {"c2a4",    c2a4_services,    NUM_ROWS(c2a4_services),    0},
+    {"c2a5",    c2a5_services,    NUM_ROWS(c2a5_services),    0},
+    {"c2a6",    c2a6_services,    NUM_ROWS(c2a6_services),    0},
+    {"c2a7",    c2a7_services,    NUM_ROWS(c2a7_services),    0},
+};
+
+// -x model, built by load_cheddar
+static ch_model_t cheddar_model;
+static service_desc_t cheddar_services[CH_MAX_TASKS];
+static scenario_t cheddar_scenario;
+
+// -F table, built by load_table
+#define TABLE_MAX_ROWS (SA_MAX_TASKS)
+static service_desc_t file_services[TABLE_MAX_ROWS];
+static char file_names[TABLE_MAX_ROWS][32];
+static scenario_t file_scenario;
+
+sequencer_t seq;
+seqtimer_t seq_timer;
+seqt_mode_t timer_mode=SEQT_ABS;
+seqr_mode_t release_mode=SEQR_SEM;
+int deadline_mode=FALSE;
+int work_pct=0;
+int analyze_only=FALSE;
+int simulate_policy=-1;
+long spin_nsec=SEQT_SPIN_NSEC;
+long seq_period_nsec=SEQ_PERIOD_NSEC;
+coremap_t coremap;
+const char *coremap_spec=(const char *)0;
+int pack_mode=SMC_FIRST_FIT;            // -1 for the Liu and Layland bound
+int abortTest=FALSE;
+
+// -e frame table and its executor
+int cyclic_mode=FALSE;
+static seqc_table_t cyclic;
+static seqc_exec_t executive;
+
+// -G rate groups
+int group_rates=FALSE;
+
+// -L binary event log, NULL for syslog
+static const char *evlog_path=(const char *)0;
+
+// job completions are logged too with -L, except from a cyclic executive
+// whose jobs run in slices
+static int log_done=FALSE;
+
+// -E pinned governor and per-thread counters
+int env_pin=FALSE;
+
+#ifdef MEMORY_LOCK
+// sampled once tick 0 released everything, reported when the last tick is done
+static rti_faults_t run_faults;
+#endif
+
+// -S frame buffer, SHR_INHERIT, SHR_CEILING or SHARE_SEQLOCK
+int share_mode=-1;
+int share_pct=SHARE_PCT;
+static int share_rows=0, share_writer=0;
+static shr_resource_t frame_lock;
+static shr_seqlock_t frame_seqlock;
+static unsigned char *frame_buf, *frame_copy;
+
+// -A rows, asked for by the admission thread at their tick
+static service_desc_t admit_services[MAX_ADMIT];
+static unsigned long long admit_tick[MAX_ADMIT];
+static char admit_names[MAX_ADMIT][32];
+static int nadmit=0;
+static seqa_t admission;
+unsigned long long sequencePeriods;
+struct timespec start_time_val;
+double start_realtime;
+
+#ifdef EVENT_LOG
+static evlog_ring_t *rings[EVLOG_MAX_RINGS];
+#endif
+
+#ifdef SERVICE_STATS
+static svc_stats_t *svcStats;
+#endif
+
+void *Sequencer(void *threadp);
+void *Executive(void *threadp);
+double realtime(struct timespec *tsptr);
+void print_scheduler(void);
+
+
+// one release's work on the shared frame, writer or reader, with the
+// critical section share of the busy work done holding the frame
+static void share_frame(service_t *svc)
+{
+    long usec=(long)svc->budget*(seq_period_nsec/1000)*work_pct/100;
+    long cs_usec=usec*share_pct/100;
+    unsigned char *mine=frame_copy + (size_t)svc->idx*FRAME_BYTES;
+
+    if(usec > cs_usec) busy_work_usec(usec - cs_usec);
+
+    if(share_mode == SHARE_SEQLOCK)
+    {
+        if(svc->idx == share_writer)
+        {
+            memset(mine, (int)svc->releases, FRAME_BYTES);
+            if(cs_usec) busy_work_usec(cs_usec);
+            shr_sl_write(&frame_seqlock, mine);
+        }
+        else
+        {
+            shr_sl_read(&frame_seqlock, mine);
+            if(cs_usec) busy_work_usec(cs_usec);
+        }
+        return;
+    }
+
+    if(shr_lock(&frame_lock) != 0) return;
+
+    if(svc->idx == share_writer)
+        memset(frame_buf, (int)svc->releases, FRAME_BYTES);
+    else
+        memcpy(mine, frame_buf, FRAME_BYTES);
+    if(cs_usec) busy_work_usec(cs_usec);
+
+    shr_unlock(&frame_lock);
+}
+
+
+static void log_release(service_t *svc)
+{
+#ifdef EVENT_LOG
+    if(!svc->resume && svc->idx+1 < EVLOG_MAX_RINGS)
+        evlog_record(rings[svc->idx+1], svc->releases);
+#else
+    struct timespec current_time_val;
+    double current_realtime;
+
+    if(!svc->resume)
+    {
+        clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
+        syslog(LOG_CRIT, "%s on core %d for release %llu @ sec=%6.9lf\n", svc->desc->name, sched_getcpu(), svc->releases, current_realtime-start_realtime);
+    }
+#endif
+
+    // a cyclic executive slice only burns its share of C
+    if(svc->idx < share_rows)
+        share_frame(svc);
+    else if(work_pct)
+        busy_work_usec((long)svc->budget*(seq_period_nsec/1000)*work_pct/100);
+
+#ifdef EVENT_LOG
+    if(log_done && svc->idx+1 < EVLOG_MAX_RINGS)
+        evlog_record_done(rings[svc->idx+1], svc->releases);
+#endif
+}
+
+
+static unsigned long long gcd(unsigned long long a, unsigned long long b)
+{
+    unsigned long long t;
+
+    while(b) { t=a%b; a=b; b=t; }
+    return a;
+}
+
+
+static unsigned long long hyperperiod(const scenario_t *sc)
+{
+    unsigned long long lcm=1;
+    int i;
+
+    for(i=0; i<sc->nservices; i++)
+        lcm=(lcm/gcd(lcm, sc->services[i].divisor))*sc->services[i].divisor;
+
+    return lcm;
+}
+
+
+// Feasibility of the scenario under the policy it will run with, 1 if
+// feasible, 0 if not, -1 if it cannot be analyzed
+static int analyze_scenario(const scenario_t *scp)
+{
+    sa_task_t task[SA_MAX_TASKS];
+    sa_result_t result;
+
+    sa_cs_t cs[SA_MAX_TASKS];
+    int i;
+
+    if(sa_from_table(scp->services, scp->nservices, task) < 0)
+        return -1;
+
+    // every row holds the frame for its share of C, at least a tick
+    if(share_mode == SHR_INHERIT || share_mode == SHR_CEILING)
+    {
+        for(i=0; i<scp->nservices; i++)
+        {
+            cs[i].task=i;
+            cs[i].resource=0;
+            cs[i].ticks=(task[i].C*share_pct + 99)/100;
+        }
+        if(sa_blocking(task, scp->nservices, cs, scp->nservices, (share_mode == SHR_CEILING) ? SA_CEILING : SA_INHERIT) != 0)
+            return -1;
+        printf("\nframe buffer shared with %s, blocking B from %d%% of C in the critical section\n", shr_protocol_name(share_mode), share_pct);
+    }
+
+    if(sa_analyze(task, scp->nservices, &result) != 0)
+        return -1;
+
+    sa_report(task, &result, scp->name);
+
+    return deadline_mode ? result.edf_ok : result.rta_ok[SA_FP];
+}
+
+
+// Scenario from a Cheddar model, rows alternate cores 2 and 3 like the
+// built in tables
+static const scenario_t *load_cheddar(const char *path)
+{
+    const char *name=strrchr(path, '/');
+    int i, n;
+
+    if((n=ch_load(path, &cheddar_model)) < 0) return (const scenario_t *)0;
+
+    if(cheddar_model.skipped)
+        printf("%s: %d tasks that are not periodic skipped\n", path, cheddar_model.skipped);
+
+    ch_to_services(&cheddar_model, cheddar_services, RT_MAX-1, log_release);
+    for(i=0; i<n; i++)
+    {
+        if(cheddar_services[i].priority < RT_MIN) cheddar_services[i].priority=RT_MIN;
+        cheddar_services[i].core=(i & 1) ? 3 : 2;
+    }
+
+    cheddar_scenario.name=name ? name+1 : path;
+    cheddar_scenario.services=cheddar_services;
+    cheddar_scenario.nservices=n;
+    cheddar_scenario.periods=0;
+
+    return &cheddar_scenario;
+}
+
+
+// rows of "name T C [D [priority [core]]]", priorities left at 0 are filled
+// in by rate, shortest T first, ties in file order
+static const scenario_t *load_table(const char *path)
+{
+    const char *name=strrchr(path, '/');
+    char line[256], label[32];
+    int i, j, n=0, lineno=0, fields, rank, core;
+    unsigned int T, C, D, stack_k;
+    int prio;
+    service_desc_t *row;
+    FILE *fp;
+
+    if((fp=fopen(path, "r")) == NULL)
+    {
+        perror(path);
+        return (const scenario_t *)0;
+    }
+
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        lineno++;
+        if(strchr(line, '#')) *strchr(line, '#')='\0';
+
+        D=0; prio=0; core=-1; stack_k=0;
+        if((fields=sscanf(line, "%31s %u %u %u %d %d %u", label, &T, &C, &D, &prio, &core, &stack_k)) <= 0)
+            continue;
+
+        if(fields < 3 || T == 0 || C == 0 || C > T || prio < 0 || prio > RT_MAX-1)
+        {
+            printf("%s:%d: expected name T C [D [priority [core [stack]]]] with 0 < C <= T\n", path, lineno);
+            fclose(fp);
+            return (const scenario_t *)0;
+        }
+        if(n == TABLE_MAX_ROWS)
+        {
+            printf("%s: more than %d services\n", path, TABLE_MAX_ROWS);
+            fclose(fp);
+            return (const scenario_t *)0;
+        }
+
+        strcpy(file_names[n], label);
+        row=&file_services[n];
+        row->name=file_names[n];
+        row->divisor=T;
+        row->wcet=C;
+        row->deadline=D;
+        row->priority=prio;
+        row->core=(core >= 0) ? core : ((n & 1) ? 3 : 2);
+        row->work=log_release;
+        row->stack=(size_t)stack_k*1024;
+        n++;
+    }
+    fclose(fp);
+
+    if(n == 0)
+    {
+        printf("%s: no services\n", path);
+        return (const scenario_t *)0;
+    }
+
+    for(i=0; i<n; i++)
+    {
+        if(file_services[i].priority) continue;
+
+        for(rank=0, j=0; j<n; j++)
+            rank+=(file_services[j].divisor < file_services[i].divisor) ||
+                  (file_services[j].divisor == file_services[i].divisor && j < i);
+        file_services[i].priority=(RT_MAX-1-rank < RT_MIN) ? RT_MIN : RT_MAX-1-rank;
+    }
+
+    file_scenario.name=name ? name+1 : path;
+    file_scenario.services=file_services;
+    file_scenario.nservices=n;
+    file_scenario.periods=0;
+
+    return &file_scenario;
+}
+
+
+// Offline timeline of the scenario, 1 if it missed no deadline, 0 if it
+// did, -1 if it cannot be simulated
+static int simulate_scenario(const scenario_t *scp, int policy, unsigned long long periods)
+{
+    sa_task_t task[SA_MAX_TASKS];
+    ss_trace_t trace;
+    int ok;
+
+    if(sa_from_table(scp->services, scp->nservices, task) < 0 ||
+       ss_simulate(task, scp->nservices, policy, periods, TRUE, &trace) != 0)
+        return -1;
+
+    ss_report(&trace, scp->name, policy);
+    printf("\n");
+    ss_gantt(task, &trace, stdout);
+
+    ok=(trace.total_misses == 0);
+    ss_free(&trace);
+
+    return ok;
+}
+
+
+// -S inherit|ceiling|seqlock[:pct]
+static int parse_share(const char *arg)
+{
+    char name[16];
+    const char *colon=strchr(arg, ':');
+    size_t len=colon ? (size_t)(colon-arg) : strlen(arg);
+
+    if(len >= sizeof(name)) return -1;
+    memcpy(name, arg, len);
+    name[len]='\0';
+
+    if(strcmp(name, "seqlock") == 0)
+        share_mode=SHARE_SEQLOCK;
+    else if((share_mode=shr_protocol(name)) < 0)
+        return -1;
+
+    if(colon)
+    {
+        share_pct=atoi(colon+1);
+        if(share_pct < 0 || share_pct > 100) return -1;
+    }
+
+    return 0;
+}
+
+
+// -S frame buffer and a private copy for each row, ceiling at the highest
+// row priority, which is also the row that writes
+static int share_init(const scenario_t *scp)
+{
+    int i, ceiling=RT_MIN;
+
+    for(i=0; i<scp->nservices; i++)
+    {
+        if(scp->services[i].priority > ceiling)
+        {
+            ceiling=scp->services[i].priority;
+            share_writer=i;
+        }
+    }
+
+    // -e runs every row inline on the executive, at RT_MAX
+    if(cyclic_mode) ceiling=RT_MAX;
+
+    frame_buf=(unsigned char *)calloc(1, FRAME_BYTES);
+    frame_copy=(unsigned char *)calloc(scp->nservices, FRAME_BYTES);
+    if(!frame_buf || !frame_copy)
+    {
+        printf("no memory for %d frame buffers\n", scp->nservices+1);
+        return -1;
+    }
+
+    if(share_mode == SHARE_SEQLOCK)
+        shr_sl_init(&frame_seqlock, "frame", frame_buf, FRAME_BYTES);
+    else if(shr_init(&frame_lock, "frame", share_mode, ceiling) != 0)
+        return -1;
+
+    printf("%s writes the shared frame, %d rows %s it\n", scp->services[share_writer].name, scp->nservices,
+           (share_mode == SHARE_SEQLOCK) ? "seqlock" : shr_protocol_name(share_mode));
+    share_rows=scp->nservices;
+
+    return 0;
+}
+
+
+// -A T:C[:D][@tick]
+static int parse_admit(const char *arg)
+{
+    service_desc_t *d=&admit_services[nadmit];
+    char *end;
+
+    if(nadmit == MAX_ADMIT)
+    {
+        printf("at most %d services to admit\n", MAX_ADMIT);
+        return -1;
+    }
+
+    d->divisor=strtoul(arg, &end, 10);
+    d->wcet=(*end == ':') ? strtoul(end+1, &end, 10) : 0;
+    d->deadline=(*end == ':') ? strtoul(end+1, &end, 10) : 0;
+    admit_tick[nadmit]=(*end == '@') ? strtoull(end+1, &end, 10) : 1;
+
+    if(*end != '\0' || d->divisor == 0 || d->wcet == 0)
+    {
+        printf("bad service to admit \"%s\", expected T:C[:D][@tick]\n", arg);
+        return -1;
+    }
+
+    snprintf(admit_names[nadmit], sizeof(admit_names[nadmit]), "A%d T=%u", nadmit+1, d->divisor);
+    d->name=admit_names[nadmit];
+    d->work=log_release;
+    nadmit++;
+
+    return 0;
+}
+
+
+// rate monotonic slot for each -A row below the rows of period T or less,
+// on the service cores of the map in turn
+static void place_admits(const scenario_t *scp)
+{
+    int i, j, prio;
+
+    for(i=0; i<nadmit; i++)
+    {
+        prio=RT_MAX;
+        for(j=0; j<scp->nservices; j++)
+            if(scp->services[j].divisor <= admit_services[i].divisor && scp->services[j].priority <= prio)
+                prio=scp->services[j].priority;
+        for(j=0; j<i; j++)
+            if(admit_services[j].divisor <= admit_services[i].divisor && admit_services[j].priority <= prio)
+                prio=admit_services[j].priority;
+
+        admit_services[i].priority=(prio-1 < RT_MIN) ? RT_MIN : prio-1;
+        admit_services[i].core=coremap.svc_cores[(scp->nservices + i) % coremap.nsvc];
+    }
+}
+
+
+// SCHED_OTHER, asks for each -A row once the sequencer reaches its tick
+static void *Admitter(void *threadp)
+{
+    sequencer_t *seqp=(sequencer_t *)threadp;
+    struct timespec poll={0, 1000000};
+    int i, idx;
+
+    for(i=0; i<nadmit; i++)
+    {
+        while(!abortTest && seqp->tick < admit_tick[i] && seqp->tick < sequencePeriods)
+            nanosleep(&poll, (struct timespec *)0);
+
+        idx=seqa_request(&admission, &admit_services[i]);
+        printf("%s C=%u prio %d %s at tick %llu, decided in %ld nsec\n", admit_services[i].name, admit_services[i].wcet,
+               admit_services[i].priority, (idx >= 0) ? "admitted" : "rejected", admission.tick, admission.last_ns);
+        syslog(LOG_CRIT, "%s %s at tick %llu\n", admit_services[i].name, (idx >= 0) ? "admitted" : "rejected", admission.tick);
+    }
+
+    // a return, pthread_exit unwinds and maps libgcc_s while ticks still run
+    return (void *)0;
+}
+
+
+// Pin services from the core map when one is given, otherwise keep the table
+// cores that are online
+static int assign_cores(sequencer_t *seqp)
+{
+    sa_task_t task[SA_MAX_TASKS];
+    double *util;
+    int *core;
+    int i, n=seqp->nservices;
+    const char *spec=coremap_spec ? coremap_spec : getenv(COREMAP_ENV);
+
+    coremap_init(&coremap);
+    if(coremap_parse(&coremap, spec) != 0) return -1;
+
+    if(spec == NULL || *spec == '\0')
+    {
+        // the traditional layout needs core 1 for the sequencer
+        if(coremap.ncores > 1) coremap.seq_core=1;
+
+        for(i=0; i<n; i++)
+            if(seqp->services[i].core != SEQ_ANY_CORE)
+                seqp->services[i].core=coremap_online(seqp->services[i].core);
+
+        coremap_check(&coremap);
+        return 0;
+    }
+
+    coremap_check(&coremap);
+
+    util=(double *)malloc(n*sizeof(double));
+    core=(int *)malloc(n*sizeof(int));
+    if(!util || !core)
+    {
+        printf("no memory to plan %d services\n", n);
+        free(util); free(core);
+        return -1;
+    }
+
+    for(i=0; i<n; i++)
+        util[i]=(double)seqp->services[i].desc->wcet / seqp->services[i].desc->divisor;
+
+    if(pack_mode < 0)
+    {
+        if((i=coremap_pack(&coremap, util, n, core)) > 0)
+            printf("%d services did not fit a core under the RM bound\n", i);
+    }
+    else
+    {
+        for(i=0; i<n; i++)
+            if(sa_from_table(seqp->services[i].desc, 1, &task[i]) < 0) { free(util); free(core); return -1; }
+
+        if((i=smc_partition(task, n, coremap.svc_cores, coremap.nsvc, pack_mode, deadline_mode ? SMC_EDF : SMC_FP, core)) < 0)
+        {
+            free(util); free(core);
+            return -1;
+        }
+        if(i > 0)
+            printf("%d services did not fit a core under %s %s\n", i, smc_heuristic_name(pack_mode), deadline_mode ? "EDF" : "RTA");
+        smc_report(task, n, coremap.svc_cores, coremap.nsvc, core);
+    }
+
+    for(i=0; i<n; i++)
+    {
+        seqp->services[i].core=core[i];
+        printf("%s U=%.3lf on core %d\n", seqp->services[i].desc->name, util[i], core[i]);
+    }
+
+    free(util); free(core);
+    return 0;
+}
+
+
+static void usage(void)
+{
+    int i;
+
+    printf("usage: seqgen4 [-s scenario] [-F file] [-n periods] [-d sec] [-f hz] [-m fifo|deadline] [-t abs|timerfd|hybrid|adaptive|adaptive-sleep] [-j usec] [-r sem|futex|eventfd] [-w pct] [-c coremap] [-P ff|wf|ll] [-x file] [-A T:C[:D][@tick]] [-e] [-S inherit|ceiling|seqlock[:pct]] [-G] [-L file] [-H hyperperiods] [-E] [-a] [-g rm|dm|edf|llf|fp] [-l]\n");
+    printf("scenarios:");
+    for(i=0; i<NUM_ROWS(scenarios); i++)
+        printf(" %s", scenarios[i].name);
+    printf("\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct timespec current_time_val, current_time_res;
+    double current_realtime, current_realtime_res;
+    const scenario_t *sc=&scenarios[0];
+    unsigned long long periods=0, hyperperiods=0;
+    double run_sec=0.0, tick_hz;
+#ifdef EVENT_LOG
+    unsigned int min_div, per_release;
+#endif
+    int i, rc, opt;
+
+    pthread_t seq_thread, admit_thread;
+    pthread_attr_t seq_attr;
+    struct sched_param seq_param, main_param;
+    cpu_set_t threadcpu;
+
+    while((opt=getopt(argc, argv, "s:F:n:d:f:m:t:j:r:w:c:P:x:A:eS:GL:H:Eag:l")) != -1)
+    {
+        switch(opt)
+        {
+            case 's':
+                for(i=0; i<NUM_ROWS(scenarios); i++)
+                    if(strcmp(optarg, scenarios[i].name) == 0) break;
+
+                if(i == NUM_ROWS(scenarios))
+                {
+                    printf("unknown scenario %s\n", optarg);
+                    usage(); exit(-1);
+                }
+                sc=&scenarios[i];
+                break;
+            case 'F':
+                if((sc=load_table(optarg)) == NULL) exit(-1);
+                break;
+            case 'n':
+                periods=strtoull(optarg, (char **)0, 10);
+                break;
+            case 'd':
+                run_sec=atof(optarg);
+                break;
+            case 'f':
+                tick_hz=atof(optarg);
+                if(tick_hz < 1.0 || tick_hz > SEQ_MAX_HZ)
+                {
+                    printf("tick rate %s Hz, 1 to %d\n", optarg, SEQ_MAX_HZ);
+                    usage(); exit(-1);
+                }
+                seq_period_nsec=(long)((double)NANOSEC_PER_SEC/tick_hz + 0.5);
+                break;
+            case 'm':
+                if(strcmp(optarg, "deadline") == 0)
+                    deadline_mode=TRUE;
+                else if(strcmp(optarg, "fifo") == 0)
+                    deadline_mode=FALSE;
+                else
+                {
+                    printf("unknown mode %s\n", optarg);
+                    usage(); exit(-1);
+                }
+                break;
+            case 't':
+                if((rc=seqt_mode(optarg)) < 0)
+                {
+                    printf("unknown timer mode %s\n", optarg);
+                    usage(); exit(-1);
+                }
+                timer_mode=(seqt_mode_t)rc;
+                break;
+            case 'c':
+                coremap_spec=optarg;
+                break;
+            case 'P':
+                if(strcmp(optarg, "ll") == 0)
+                    pack_mode=-1;
+                else if((pack_mode=smc_heuristic(optarg)) < 0)
+                {
+                    printf("unknown packing %s\n", optarg);
+                    usage(); exit(-1);
+                }
+                break;
+            case 'x':
+                if((sc=load_cheddar(optarg)) == NULL) exit(-1);
+                break;
+            case 'j':
+                spin_nsec=atol(optarg)*1000;
+                break;
+            case 'r':
+                if((rc=seqr_mode(optarg)) < 0)
+                {
+                    printf("unknown release mode %s\n", optarg);
+                    usage(); exit(-1);
+                }
+                release_mode=(seqr_mode_t)rc;
+                break;
+            case 'w':
+                work_pct=atoi(optarg);
+                break;
+            case 'A':
+                if(parse_admit(optarg) != 0) { usage(); exit(-1); }
+                break;
+            case 'G':
+                group_rates=TRUE;
+                break;
+            case 'L':
+                evlog_path=optarg;
+                break;
+            case 'H':
+                hyperperiods=strtoull(optarg, (char **)0, 10);
+                break;
+            case 'E':
+                env_pin=TRUE;
+                break;
+            case 'a':
+                analyze_only=TRUE;
+                break;
+            case 'e':
+                cyclic_mode=TRUE;
+                break;
+            case 'S':
+                if(parse_share(optarg) != 0)
+                {
+                    printf("bad frame sharing %s, expected inherit, ceiling or seqlock with an optional :pct\n", optarg);
+                    usage(); exit(-1);
+                }
+                break;
+            case 'g':
+                if((simulate_policy=ss_policy(optarg)) < 0)
+                {
+                    printf("unknown simulation policy %s\n", optarg);
+                    usage(); exit(-1);
+                }
+                break;
+            case 'l':
+                for(i=0; i<NUM_ROWS(scenarios); i++)
+                    printf("%-8s %d services, hyperperiod %llu ticks\n", scenarios[i].name, scenarios[i].nservices, hyperperiod(&scenarios[i]));
+                exit(0);
+            default:
+                usage(); exit(-1);
+        }
+    }
+
+    if(run_sec > 0.0)
+        periods=(unsigned long long)(run_sec*NANOSEC_PER_SEC/seq_period_nsec + 0.5);
+    if(hyperperiods)
+        periods=hyperperiods*hyperperiod(sc);
+    if(periods == 0)
+        periods = sc->periods ? sc->periods : hyperperiod(sc);
+    sequencePeriods=periods;
+
+    if(simulate_policy >= 0)
+    {
+        rc=simulate_scenario(sc, simulate_policy, periods);
+        exit((rc == 1) ? 0 : 1);
+    }
+
+    rc=analyze_scenario(sc);
+
+    if(cyclic_mode)
+    {
+        if(deadline_mode)
+        {
+            printf("-e runs the services from the sequencer, not with -m deadline\n");
+            exit(-1);
+        }
+
+        if(seqc_build(sc->services, sc->nservices, &cyclic) != 0)
+        {
+            printf("%s has no cyclic executive frame table\n", sc->name);
+            exit(analyze_only ? 1 : -1);
+        }
+        seqc_print(sc->services, &cyclic);
+        printf("\n");
+
+        // the table itself is the schedule, nothing in it can miss
+        rc=1;
+    }
+
+    if(analyze_only) exit((rc == 1) ? 0 : 1);
+
+    if(share_mode >= 0)
+    {
+        if(deadline_mode)
+        {
+            printf("-S shares the frame between SCHED_FIFO services, not with -m deadline\n");
+            exit(-1);
+        }
+        if(nadmit && share_mode != SHARE_SEQLOCK)
+            printf("NOTE: -A admission tests leave out the frame blocking of the scenario rows\n");
+    }
+
+    if(rc == 0)
+        printf("WARNING: %s is not feasible under %s, expect missed deadlines\n", sc->name, deadline_mode ? "EDF" : "its fixed priorities");
+
+    if(sched_get_priority_max(SCHED_FIFO) != RT_MAX || sched_get_priority_min(SCHED_FIFO) != RT_MIN)
+    {
+        printf("SCHED_FIFO range %d..%d does not match the tables\n", sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+        exit(-1);
+    }
+
+    // the clock and temperature every result below was taken at
+    rte_begin(env_pin, env_pin);
+
+    printf("Starting Table Driven Sequencer Demo, scenario %s, %llu periods at %.1lf Hz, %s\n", sc->name, periods,
+           (double)NANOSEC_PER_SEC/seq_period_nsec, deadline_mode ? "SCHED_DEADLINE" : seqt_mode_name(timer_mode));
+    clock_gettime(MY_CLOCK_TYPE, &start_time_val); start_realtime=realtime(&start_time_val);
+#ifdef EVENT_LOG
+    // services log to in-memory rings, a SCHED_OTHER thread on core 0 does the syslog calls
+    // every ring sized for the fastest service, the whole run if it fits,
+    // two events a release when the file keeps the completions
+    for(i=0, min_div=sc->services[0].divisor; i<sc->nservices; i++)
+        if(sc->services[i].divisor < min_div) min_div=sc->services[i].divisor;
+    for(i=0; i<nadmit; i++)
+        if(admit_services[i].divisor < min_div) min_div=admit_services[i].divisor;
+    per_release=(evlog_path && !cyclic_mode) ? 2 : 1;
+    evlog_init_size(MY_CLOCK_TYPE, &start_time_val,
+                    evlog_ring_events(per_release*(double)NANOSEC_PER_SEC/seq_period_nsec/min_div, per_release*(periods/min_div + 1)));
+    for(i=0; i<sc->nservices && i+1 < EVLOG_MAX_RINGS; i++)
+    {
+        rings[i+1]=evlog_ring(i+1, sc->services[i].name);
+        evlog_ring_task(rings[i+1], sc->services[i].divisor, sc->services[i].wcet, sc->services[i].deadline, sc->services[i].priority,
+                        seq_period_nsec, (long long)sc->services[i].wcet*(seq_period_nsec/1000)*work_pct/100*1000);
+    }
+    for(i=0; i<nadmit && sc->nservices+i+1 < EVLOG_MAX_RINGS; i++)
+        rings[sc->nservices+i+1]=evlog_ring(sc->nservices+i+1, admit_services[i].name);
+    if(evlog_path && evlog_file(evlog_path) != 0) exit(-1);
+    log_done=(per_release == 2);
+    evlog_drain_start(0);
+#endif
+    clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
+    clock_getres(MY_CLOCK_TYPE, &current_time_res); current_realtime_res=realtime(&current_time_res);
+    printf("START Table Driven Sequencer @ sec=%6.9lf with resolution %6.9lf\n", (current_realtime - start_realtime), current_realtime_res);
+    syslog(LOG_CRIT, "START Table Driven Sequencer %s @ sec=%6.9lf with resolution %6.9lf\n", sc->name, (current_realtime - start_realtime), current_realtime_res);
+
+    printf("System has %d processors configured and %d available.\n", get_nprocs_conf(), get_nprocs());
+
+    rc=sched_getparam(getpid(), &main_param);
+    main_param.sched_priority=RT_MAX;
+    rc=sched_setscheduler(getpid(), SCHED_FIFO, &main_param);
+    if(rc < 0) perror("main_param");
+    print_scheduler();
+
+#ifdef MEMORY_LOCK
+    rti_init(0);
+#endif
+
+#ifdef RT_TRACE
+    // ticks, releases and service wake/done on the kernel trace timeline
+    rtt_open();
+#endif
+
+    if(work_pct)
+        printf("Busy work calibrated to %.1lf iterations/usec\n", busy_calibrate());
+
+    if(share_mode >= 0 && share_init(sc) != 0) exit(-1);
+
+    if(seq_init_spare(&seq, sc->services, sc->nservices, deadline_mode ? 0 : nadmit, release_mode) != 0) exit(-1);
+
+    if(deadline_mode)
+    {
+        if(nadmit) printf("-A needs the sequencer, ignored with -m deadline\n");
+        if(group_rates) printf("-G needs the sequencer, ignored with -m deadline\n");
+
+        // services release themselves, nothing for a sequencer to do
+        if(seq_start_deadline(&seq, seq_period_nsec, periods) != 0) exit(-1);
+
+        seq_join(&seq);
+        seq_shutdown(&seq);
+
+#ifdef EVENT_LOG
+        evlog_drain_stop();
+#endif
+
+        if(work_pct) busy_report();
+        rte_end();
+
+        printf("\nTEST COMPLETE\n");
+        return 0;
+    }
+
+#ifdef SERVICE_STATS
+    if((svcStats=(svc_stats_t *)calloc(sc->nservices, sizeof(svc_stats_t))) == NULL)
+    {
+        printf("no memory for service stats\n");
+        exit(-1);
+    }
+
+    for(i=0; i<sc->nservices; i++)
+    {
+        svc_stats_init(&svcStats[i], sc->services[i].name);
+        svc_stats_deadline(&svcStats[i], (long long)(sc->services[i].deadline ? sc->services[i].deadline : sc->services[i].divisor)*seq_period_nsec);
+        seq.services[i].stats=&svcStats[i];
+    }
+#endif
+
+    if(cyclic_mode)
+    {
+        if(nadmit) printf("-A needs service threads, ignored with -e\n");
+        if(group_rates) printf("-G needs service threads, ignored with -e\n");
+        nadmit=0;
+
+        // the core map only places the sequencer, which runs every service
+        coremap_init(&coremap);
+        if(coremap_parse(&coremap, coremap_spec ? coremap_spec : getenv(COREMAP_ENV)) != 0) exit(-1);
+        if(coremap_spec == NULL && getenv(COREMAP_ENV) == NULL && coremap.ncores > 1) coremap.seq_core=1;
+        coremap_check(&coremap);
+
+        if(seqc_exec_init(&executive, &cyclic, &seq, seq_period_nsec) != 0) exit(-1);
+        printf("Running services inline from the cyclic executive on core %d\n", coremap.seq_core);
+    }
+    else
+    {
+        printf("Releasing services with %s\n", seqr_mode_name(release_mode));
+
+        if(assign_cores(&seq) != 0) { seq_shutdown(&seq); exit(-1); }
+
+        // after the cores are known, a group is the rows of one period on one core
+        if(group_rates)
+        {
+            i=seq_group_rates(&seq);
+            printf("%d services folded into %d rate group threads\n", i, seq.ngroups);
+        }
+
+        if(nadmit)
+        {
+            place_admits(sc);
+            if(seqa_init(&admission, &seq) != 0)
+                printf("WARNING: %s is not feasible, every service asked for will be rejected\n", sc->name);
+        }
+
+        if(seq_start(&seq) != 0) { seq_shutdown(&seq); exit(-1); }
+    }
+
+    // Create Sequencer thread, which like a cyclic executive, is highest prio
+    printf("Start sequencer\n");
+
+    CPU_ZERO(&threadcpu);
+    CPU_SET(coremap.seq_core, &threadcpu);
+
+    pthread_attr_init(&seq_attr);
+    pthread_attr_setinheritsched(&seq_attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&seq_attr, SCHED_FIFO);
+    pthread_attr_setaffinity_np(&seq_attr, sizeof(cpu_set_t), &threadcpu);
+    seq_param.sched_priority=RT_MAX;
+    pthread_attr_setschedparam(&seq_attr, &seq_param);
+#ifdef MEMORY_LOCK
+    rti_attr_stack(&seq_attr);
+#endif
+
+    // the admitter first, so its stack is faulted in before tick 0
+    if(nadmit && pthread_create(&admit_thread, (void *)0, Admitter, (void *)&seq) != 0)
+    {
+        perror("admission pthread_create");
+        nadmit=0;
+    }
+
+    if((rc=pthread_create(&seq_thread, &seq_attr, cyclic_mode ? Executive : Sequencer, (void *)&seq)) != 0)
+    {
+        printf("pthread_create for sequencer failed, rc=%d\n", rc);
+        seq_shutdown(&seq);
+        exit(-1);
+    }
+
+    pthread_join(seq_thread, NULL);
+    if(nadmit)
+    {
+        pthread_join(admit_thread, NULL);
+        seqa_report(&admission);
+    }
+    // the executor report names the services, so before they are freed
+    if(cyclic_mode) seqc_report(&executive);
+    seq_shutdown(&seq);
+
+    seqt_report(&seq_timer);
+
+    if(share_mode == SHARE_SEQLOCK)
+        shr_sl_report(&frame_seqlock);
+    else if(share_mode >= 0)
+    {
+        shr_report(&frame_lock);
+        shr_destroy(&frame_lock);
+    }
+    if(share_mode >= 0)
+    {
+        free(frame_buf);
+        free(frame_copy);
+    }
+
+    if(cyclic_mode)
+    {
+        seqc_exec_free(&executive);
+        seqc_free(&cyclic);
+    }
+
+#ifdef SERVICE_STATS
+    svc_stats_report(svcStats, sc->nservices);
+    free(svcStats);
+#endif
+    syslog(LOG_CRIT, "Sequencer %s timer: %llu ticks, %llu missed, max wake-up late %lld nsec\n",
+           seqt_mode_name(timer_mode), seq_timer.ticks, seq_timer.missed, seq_timer.max_late_ns);
+
+#ifdef EVENT_LOG
+    evlog_drain_stop();
+#endif
+
+    if(work_pct) busy_report();
+    rte_end();
+
+    printf("\nTEST COMPLETE\n");
+    return 0;
+}
+
+
+void *Sequencer(void *threadp)
+{
+    sequencer_t *seqp=(sequencer_t *)threadp;
+    int n, perf;
+
+    perf=rte_perf_begin("sequencer", -1);
+
+    if(seqt_init(&seq_timer, timer_mode, seq_period_nsec, spin_nsec) != 0)
+        exit(-1);
+
+    // tick 0 releases every service at the critical instant
+#ifdef EVENT_LOG
+    evlog_tick0();
+#endif
+    seq_tick(seqp);
+#ifdef MEMORY_LOCK
+    rti_faults(&run_faults);
+#endif
+
+    while(!abortTest && (seqp->tick < sequencePeriods))
+    {
+        n=seqt_wait(&seq_timer);
+
+        // a service asked for since the last tick is decided before this
+        // one's releases, so it can be released on the tick it asked for
+        if(nadmit) seqa_poll(&admission);
+
+        // one tick per elapsed period, so services due on a missed tick
+        // are still released
+        while(n-- > 0 && seqp->tick < sequencePeriods)
+            seq_tick(seqp);
+    }
+#ifdef MEMORY_LOCK
+    rti_report("steady state after tick 0", &run_faults);
+#endif
+
+    if(nadmit) seqa_close(&admission);
+    seqt_close(&seq_timer);
+
+    rte_perf_end(perf);
+    pthread_exit((void *)0);
+}
+
+
+// Sequencer thread as a cyclic executive, one timer period per minor
+// frame, each frame's services called inline
+void *Executive(void *threadp)
+{
+    int n, perf;
+
+    // every service runs inline, so this is all of them
+    perf=rte_perf_begin("executive", -1);
+
+    if(seqt_init(&seq_timer, timer_mode, (long)cyclic.minor*seq_period_nsec, spin_nsec) != 0)
+        exit(-1);
+
+    // frame 0 starts at the critical instant
+    seqc_frame(&executive);
+#ifdef MEMORY_LOCK
+    rti_faults(&run_faults);
+#endif
+
+    while(!abortTest && (executive.frames*cyclic.minor < sequencePeriods))
+    {
+        n=seqt_wait(&seq_timer);
+
+        // a frame that overran its boundary pushes the next ones late, they
+        // still run so the table stays in step with time
+        while(n-- > 0 && executive.frames*cyclic.minor < sequencePeriods)
+            seqc_frame(&executive);
+    }
+#ifdef MEMORY_LOCK
+    rti_report("steady state after frame 0", &run_faults);
+#endif
+
+    seqt_close(&seq_timer);
+    rte_perf_end(perf);
+
+    pthread_exit((void *)0);
+}
+
+
+double realtime(struct timespec *tsptr)
+{
+    return ((double)(tsptr->tv_sec) + (((double)tsptr->tv_nsec)/1000000000.0));
+}
+
+
+void print_scheduler(void)
+{
+   int schedType;
+
+   schedType = sched_getscheduler(getpid());
+
+   switch(schedType)
+   {
+       case SCHED_FIFO:
+           printf("Pthread Policy is SCHED_FIFO\n");
+           break;
+       case SCHED_OTHER:
+           printf("Pthread Policy is SCHED_OTHER\n"); exit(-1);
+         break;
+       case SCHED_RR:
+           printf("Pthread Policy is SCHED_RR\n"); exit(-1);
+           break;
+       case SCHED_DEADLINE:
+           printf("Pthread Policy is SCHED_DEADLINE\n"); exit(-1);
+           break;
+       default:
+           printf("Pthread Policy is UNKNOWN\n"); exit(-1);
+   }
+}
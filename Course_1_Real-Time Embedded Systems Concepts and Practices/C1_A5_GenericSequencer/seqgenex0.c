@@ -34,6 +34,16 @@
 //    timing.  They should be replaced with an in-memory event logger or at
 //    least calls to syslog.
 //
+// The rate and length of the run can be changed without a rebuild:
+//
+//    seqgenex0 [-f hz] [-n periods]
+//
+//    -f  sequencer rate, default 100 Hz (RTSEQ_DELAY_NSEC), the services
+//        stay at every 2nd, 10th and 15th cycle of it
+//    -n  sequencer cycles, default RTSEQ_PERIODS
+//
+// The event log rings are sized for the run at start, see evlog.h.
+//
 
 // This is necessary for CPU affinity macros in Linux
 #define _GNU_SOURCE
@@ -51,18 +61,38 @@
 #include <sys/time.h>
 #include <errno.h>
 #include "seqgen.h"
+#include "evlog.h"
+#include "rtstack.h"
+#include "coremap.h"
+#include "rtstop.h"
 #include <sys/sysinfo.h>
 
 #define ABS_DELAY
 #define DRIFT_CONTROL
+
+// log cycles and releases to lock-free in-memory rings rather than calling
+// syslog from the SCHED_FIFO threads
+#define EVENT_LOG
+
 #define NUM_THREADS (3+1)
 
-int abortTest=FALSE;
-int abortS1=FALSE, abortS2=FALSE, abortS3=FALSE;
+// every thread on a SERVICE_STACK stack carved from one locked arena
+// instead of an 8 MB default one, high water marks printed at the end,
+// see rtstack.h
+#define STACK_ARENA
+#define SERVICE_STACK (64*1024)
+
+#ifdef STACK_ARENA
+rts_arena_t stacks;
+#endif
+
+// rtstop_request(&stop, RTSTOP_ABORT) from anywhere ends the run early
+rtstop_t stop;
 sem_t semS1, semS2, semS3;
 static double start_time = 0;
 
 pthread_t threads[NUM_THREADS];
+int started[NUM_THREADS];           // joined only if pthread_create succeeded
 pthread_attr_t rt_sched_attr[NUM_THREADS];
 pthread_attr_t main_attr;
 int rt_max_prio, rt_min_prio;
@@ -71,21 +101,53 @@ threadParams_t threadParams[NUM_THREADS];
 
 
 
-void main(void)
+int main(int argc, char *argv[])
 {
-    double current_time;
+    double current_time, hz;
     struct timespec rt_res, monotonic_res;
-    int i, rc, cpuidx;
+    int i, rc, cpuidx, opt;
     cpu_set_t threadcpu;
+#ifdef STACK_ARENA
+    char stack_name[RTS_NAME_LEN];
+#endif
     struct sched_param main_param;
     pid_t mainpid;
+    long delay_nsec=RTSEQ_DELAY_NSEC;
+    unsigned long long periods=RTSEQ_PERIODS;
+
+    while((opt=getopt(argc, argv, "f:n:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'f':
+                hz=atof(optarg);
+                if(hz < RTSEQ_MIN_HZ || hz > RTSEQ_MAX_HZ)
+                {
+                    printf("sequencer rate %s Hz, %d to %d\n", optarg, RTSEQ_MIN_HZ, RTSEQ_MAX_HZ);
+                    exit(-1);
+                }
+                delay_nsec=(long)((double)NANOSEC_PER_SEC/hz + 0.5);
+                break;
+            case 'n':
+                periods=strtoull(optarg, (char **)0, 10);
+                break;
+            default:
+                printf("usage: seqgenex0 [-f hz] [-n periods]\n");
+                exit(-1);
+        }
+    }
 
     start_time=getTimeMsec();
+#ifdef EVENT_LOG
+    // the sequencer ring logs every cycle, the fastest of all
+    evlog_init_size(CLOCK_REALTIME, (struct timespec *)0, evlog_ring_events((double)NANOSEC_PER_SEC/delay_nsec, periods));
+    evlog_drain_start(0);
+#endif
 
     // delay start for a second
     usleep(1000000);
 
-    printf("Starting High Rate Sequencer Example\n");
+    printf("Starting High Rate Sequencer Example, %llu cycles at %.1lf Hz\n", periods, (double)NANOSEC_PER_SEC/delay_nsec);
     get_cpu_core_config();
 
     clock_getres(CLOCK_REALTIME, &rt_res);
@@ -102,6 +164,11 @@ void main(void)
     if (sem_init (&semS3, 0, 0)) 
         { printf ("Failed to initialize S3 semaphore\n"); exit (-1); }
 
+    // in service order, the index each service's rtstop_exit() takes
+    rtstop_init(&stop, CLOCK_MONOTONIC);
+    rtstop_add(&stop, &semS1, "S1"); rtstop_add(&stop, &semS2, "S2");
+    rtstop_add(&stop, &semS3, "S3");
+
     mainpid=getpid();
 
     rt_max_prio = sched_get_priority_max(SCHED_FIFO);
@@ -117,14 +184,25 @@ void main(void)
     printf("rt_max_prio=%d\n", rt_max_prio);
     printf("rt_min_prio=%d\n", rt_min_prio);
 
+#ifdef STACK_ARENA
+    rts_arena_init(&stacks, NUM_THREADS, NUM_THREADS*rts_span(SERVICE_STACK));
+#endif
+
+    // every thread on core 3, or the last online core of a smaller host
+    cpuidx=coremap_online(3);
+
     for(i=0; i < NUM_THREADS; i++)
     {
 
       CPU_ZERO(&threadcpu);
-      cpuidx=(3);
       CPU_SET(cpuidx, &threadcpu);
 
       rc=pthread_attr_init(&rt_sched_attr[i]);
+#ifdef STACK_ARENA
+      if(i == 0) snprintf(stack_name, sizeof(stack_name), "Sequencer");
+      else snprintf(stack_name, sizeof(stack_name), "Service_%d", i);
+      rts_attr_stack(&stacks, &rt_sched_attr[i], SERVICE_STACK, stack_name);
+#endif
       rc=pthread_attr_setinheritsched(&rt_sched_attr[i], PTHREAD_EXPLICIT_SCHED);
       rc=pthread_attr_setschedpolicy(&rt_sched_attr[i], SCHED_FIFO);
       rc=pthread_attr_setaffinity_np(&rt_sched_attr[i], sizeof(cpu_set_t), &threadcpu);
@@ -154,10 +232,13 @@ void main(void)
                       Service_1,                 // thread function entry point
                       (void *)&(threadParams[1]) // parameters to pass in
                      );
-    if(rc < 0)
-        perror("pthread_create for service 1");
+    if(rc != 0)
+        printf("pthread_create for service 1 failed, rc=%d\n", rc);
     else
+    {
+        started[1]=1;
         printf("pthread_create successful for service 1\n");
+    }
 
 
     // Service_2 = RT_MAX-2	@ 10 Hz
@@ -165,10 +246,13 @@ void main(void)
     rt_param[2].sched_priority=rt_max_prio-2;
     pthread_attr_setschedparam(&rt_sched_attr[2], &rt_param[2]);
     rc=pthread_create(&threads[2], &rt_sched_attr[2], Service_2, (void *)&(threadParams[2]));
-    if(rc < 0)
-        perror("pthread_create for service 2");
+    if(rc != 0)
+        printf("pthread_create for service 2 failed, rc=%d\n", rc);
     else
+    {
+        started[2]=1;
         printf("pthread_create successful for service 2\n");
+    }
 
 
     // Service_3 = RT_MAX-3	@ 6.67 Hz
@@ -176,29 +260,52 @@ void main(void)
     rt_param[3].sched_priority=rt_max_prio-3;
     pthread_attr_setschedparam(&rt_sched_attr[3], &rt_param[3]);
     rc=pthread_create(&threads[3], &rt_sched_attr[3], Service_3, (void *)&(threadParams[3]));
-    if(rc < 0)
-        perror("pthread_create for service 3");
+    if(rc != 0)
+        printf("pthread_create for service 3 failed, rc=%d\n", rc);
     else
+    {
+        started[3]=1;
         printf("pthread_create successful for service 3\n");
+    }
 
 
     // Create Sequencer thread, which like a cyclic executive, is highest prio
     printf("Start sequencer\n");
-    threadParams[0].sequencePeriods=RTSEQ_PERIODS;
+    threadParams[0].sequencePeriods=periods;
+    threadParams[0].delayNsec=delay_nsec;
 
     // Sequencer = RT_MAX	@ 1000 Hz
     //
     rt_param[0].sched_priority=rt_max_prio;
     pthread_attr_setschedparam(&rt_sched_attr[0], &rt_param[0]);
     rc=pthread_create(&threads[0], &rt_sched_attr[0], Sequencer, (void *)&(threadParams[0]));
-    if(rc < 0)
-        perror("pthread_create for sequencer service 0");
+    if(rc != 0)
+    {
+        // nothing will release the services, stop the ones that started
+        printf("pthread_create for sequencer service 0 failed, rc=%d\n", rc);
+        rtstop_request(&stop, RTSTOP_ABORT);
+    }
     else
+    {
+        started[0]=1;
         printf("pthread_create successful for sequeencer service 0\n");
+    }
 
 
+   // a thread that never started has nothing to join
    for(i=0;i<NUM_THREADS;i++)
-       pthread_join(threads[i], NULL);
+       if(started[i]) pthread_join(threads[i], NULL);
+
+#ifdef EVENT_LOG
+   evlog_drain_stop();
+#endif
+
+#ifdef STACK_ARENA
+   rts_report(&stacks);
+   rts_arena_free(&stacks);
+#endif
+
+   rtstop_report(&stop);
 
    printf("\nTEST COMPLETE\n");
 }
@@ -206,17 +313,20 @@ void main(void)
 
 void *Sequencer(void *threadp)
 {
-    struct timespec delay_time = {0, RTSEQ_DELAY_NSEC};
-    struct timespec std_delay_time = {0, RTSEQ_DELAY_NSEC};
+    threadParams_t *threadParams = (threadParams_t *)threadp;
+    struct timespec delay_time = {0, threadParams->delayNsec};
+    struct timespec std_delay_time = {0, threadParams->delayNsec};
     struct timespec current_time_val={0,0};
 
     struct timespec remaining_time;
     double current_time, last_time, scaleDelay;
-    double delta_t=(RTSEQ_DELAY_NSEC/(double)NANOSEC_PER_SEC);
+    double delta_t=(threadParams->delayNsec/(double)NANOSEC_PER_SEC);
     double scale_dt;
     int rc, delay_cnt=0;
     unsigned long long seqCnt=0;
-    threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(0, "RTSEQ cycle");
+#endif
 
     current_time=getTimeMsec(); last_time=current_time-delta_t;
 
@@ -274,7 +384,11 @@ void *Sequencer(void *threadp)
         } while(rc == EINTR);
 
 
+#ifdef EVENT_LOG
+        evlog_record(ring, seqCnt);
+#else
         syslog(LOG_CRIT, "RTSEQ: cycle %08llu @ sec=%lf, last=%lf, dt=%lf, sdt=%lf\n", seqCnt, current_time, last_time, (current_time-last_time), scale_dt);
+#endif
 
         // Release each service at a sub-rate of the generic sequencer rate
 
@@ -290,10 +404,10 @@ void *Sequencer(void *threadp)
         seqCnt++;
         last_time=current_time;
 
-    } while(!abortTest && (seqCnt < threadParams->sequencePeriods));
+    } while(!rtstop_stopped(&stop) && (seqCnt < threadParams->sequencePeriods));
 
-    sem_post(&semS1); sem_post(&semS2); sem_post(&semS3);
-    abortS1=TRUE; abortS2=TRUE; abortS3=TRUE;
+    // shutdown all services, a no-op after an abort request
+    rtstop_request(&stop, RTSTOP_DONE);
 
     pthread_exit((void *)0);
 }
@@ -305,19 +419,28 @@ void *Service_1(void *threadp)
     double current_time;
     unsigned long long S1Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(1, "S1");
+#endif
 
     current_time=getTimeMsec();
     //syslog(LOG_CRIT, "S1: start on cpu=%d @ sec=%lf\n", sched_getcpu(), current_time);
 
-    while(!abortS1)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS1);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S1Cnt++;
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S1Cnt);
+#else
         current_time=getTimeMsec();
         syslog(LOG_CRIT, "S1: release %llu @ sec=%lf\n", S1Cnt, current_time);
+#endif
     }
 
+    rtstop_exit(&stop, 0);
     pthread_exit((void *)0);
 }
 
@@ -327,19 +450,28 @@ void *Service_2(void *threadp)
     double current_time;
     unsigned long long S2Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(2, "S2");
+#endif
 
     current_time=getTimeMsec();
     //syslog(LOG_CRIT, "S2: start on cpu=%d @ sec=%lf\n", sched_getcpu(), current_time);
 
-    while(!abortS2)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS2);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S2Cnt++;
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S2Cnt);
+#else
         current_time=getTimeMsec();
         syslog(LOG_CRIT, "S2: release %llu @ sec=%lf\n", S2Cnt, current_time);
+#endif
     }
 
+    rtstop_exit(&stop, 1);
     pthread_exit((void *)0);
 }
 
@@ -349,19 +481,28 @@ void *Service_3(void *threadp)
     double current_time;
     unsigned long long S3Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
+#ifdef EVENT_LOG
+    evlog_ring_t *ring=evlog_ring(3, "S3");
+#endif
 
     current_time=getTimeMsec();
     //syslog(LOG_CRIT, "S3: start on cpu=%d @ sec=%lf\n", sched_getcpu(), current_time);
 
-    while(!abortS3)
+    while(!rtstop_stopped(&stop))
     {
         sem_wait(&semS3);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
         S3Cnt++;
 
+#ifdef EVENT_LOG
+        evlog_record(ring, S3Cnt);
+#else
         current_time=getTimeMsec();
         syslog(LOG_CRIT, "S3: release %llu @ sec=%lf\n", S3Cnt, current_time);
+#endif
     }
 
+    rtstop_exit(&stop, 2);
     pthread_exit((void *)0);
 }
 
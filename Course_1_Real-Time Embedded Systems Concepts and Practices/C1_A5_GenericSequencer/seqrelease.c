@@ -0,0 +1,162 @@
+// Service release primitive for the sequencer, see seqrelease.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <semaphore.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "seqrelease.h"
+
+static const char *mode_names[] = {"sem", "futex", "eventfd"};
+
+
+static long futex(volatile unsigned int *uaddr, int op, unsigned int val)
+{
+    return syscall(SYS_futex, uaddr, op, val, (void *)0, (void *)0, 0);
+}
+
+
+int seqr_mode(const char *name)
+{
+    int i;
+
+    for(i=0; i<(int)(sizeof(mode_names)/sizeof(mode_names[0])); i++)
+        if(strcmp(name, mode_names[i]) == 0) return i;
+
+    return -1;
+}
+
+
+const char *seqr_mode_name(seqr_mode_t mode)
+{
+    return mode_names[mode];
+}
+
+
+int seqr_init(seqrel_t *r, seqr_mode_t mode)
+{
+    memset(r, 0, sizeof(seqrel_t));
+    r->mode=mode;
+    r->fd=-1;
+
+    switch(mode)
+    {
+        case SEQR_SEM:
+            if(sem_init(&r->sem, 0, 0))
+            {
+                perror("seqr_init sem_init");
+                return -1;
+            }
+            break;
+
+        case SEQR_EVENTFD:
+            if((r->fd=eventfd(0, EFD_SEMAPHORE)) < 0)
+            {
+                perror("seqr_init eventfd");
+                return -1;
+            }
+            break;
+
+        case SEQR_FUTEX:
+            break;
+    }
+
+    return 0;
+}
+
+
+void seqr_destroy(seqrel_t *r)
+{
+    if(r->mode == SEQR_SEM)
+        sem_destroy(&r->sem);
+    else if(r->mode == SEQR_EVENTFD && r->fd >= 0)
+        close(r->fd);
+
+    r->fd=-1;
+}
+
+
+void seqr_publish(seqrel_t *r)
+{
+    // seq_cst so the store is ordered before seqr_wake() reads sleeping
+    if(r->mode == SEQR_FUTEX)
+        __atomic_fetch_add(&r->seq, 1, __ATOMIC_SEQ_CST);
+}
+
+
+void seqr_wake(seqrel_t *r)
+{
+    uint64_t one=1;
+
+    switch(r->mode)
+    {
+        case SEQR_SEM:
+            sem_post(&r->sem);
+            break;
+
+        case SEQR_EVENTFD:
+            if(write(r->fd, &one, sizeof(one)) != sizeof(one))
+                perror("seqr_wake eventfd write");
+            break;
+
+        case SEQR_FUTEX:
+            // a service still running its last release will see the new
+            // sequence number without a system call
+            if(__atomic_load_n(&r->sleeping, __ATOMIC_SEQ_CST))
+                futex(&r->seq, FUTEX_WAKE_PRIVATE, 1);
+            break;
+    }
+}
+
+
+void seqr_post(seqrel_t *r)
+{
+    seqr_publish(r);
+    seqr_wake(r);
+}
+
+
+long long seqr_wait(seqrel_t *r)
+{
+    uint64_t count;
+
+    switch(r->mode)
+    {
+        case SEQR_SEM:
+            while(sem_wait(&r->sem) != 0)
+            {
+                if(errno != EINTR) { perror("seqr_wait sem_wait"); return -1; }
+            }
+            break;
+
+        case SEQR_EVENTFD:
+            while(read(r->fd, &count, sizeof(count)) != sizeof(count))
+            {
+                if(errno != EINTR) { perror("seqr_wait eventfd read"); return -1; }
+            }
+            break;
+
+        case SEQR_FUTEX:
+            while(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) == r->seen)
+            {
+                // announce the sleep before the last check, FUTEX_WAIT
+                // returns at once if seq has moved on since
+                __atomic_store_n(&r->sleeping, 1, __ATOMIC_SEQ_CST);
+                if(__atomic_load_n(&r->seq, __ATOMIC_SEQ_CST) == r->seen)
+                    futex(&r->seq, FUTEX_WAIT_PRIVATE, r->seen);
+                __atomic_store_n(&r->sleeping, 0, __ATOMIC_RELAXED);
+            }
+
+            // one release at a time, like a semaphore
+            r->seen++;
+            break;
+    }
+
+    return (long long)++r->released;
+}
@@ -0,0 +1,60 @@
+#ifndef _SEQRELEASE_
+#define _SEQRELEASE_
+
+// Service release primitive for the sequencer
+//
+// All modes count releases like a semaphore, so a service that falls behind
+// still runs once per release:
+//
+//    sem      sem_post / sem_wait, as in seqgen2.c and seqgen3.c
+//    futex    a 32 bit release sequence number the sequencer increments;
+//             the service sleeps in FUTEX_WAIT only while it has caught up
+//             and the sequencer only calls FUTEX_WAKE when one is asleep
+//    eventfd  EFD_SEMAPHORE eventfd, write(1) to release, read() to wait
+//
+// seqr_post() is seqr_publish() followed by seqr_wake().  Split, the
+// sequencer can publish every service due on a tick first, so they all see
+// the same release instant, and then make the wake-up calls in one pass.
+//
+
+#include <semaphore.h>
+
+typedef enum
+{
+    SEQR_SEM,
+    SEQR_FUTEX,
+    SEQR_EVENTFD
+} seqr_mode_t;
+
+typedef struct
+{
+    seqr_mode_t mode;
+
+    // futex mode, seq is the futex word
+    volatile unsigned int seq;
+    volatile unsigned int sleeping;
+    unsigned int seen;              // service owned
+
+    sem_t sem;
+    int fd;
+
+    unsigned long long released;    // service owned, releases consumed
+} seqrel_t;
+
+int seqr_init(seqrel_t *r, seqr_mode_t mode);
+void seqr_destroy(seqrel_t *r);
+
+// sequencer side
+void seqr_publish(seqrel_t *r);
+void seqr_wake(seqrel_t *r);
+void seqr_post(seqrel_t *r);
+
+// service side, blocks for the next release and returns its number, 1 for
+// the first.  -1 on error.
+long long seqr_wait(seqrel_t *r);
+
+// "sem", "futex" or "eventfd" to a mode, -1 if unknown
+int seqr_mode(const char *name);
+const char *seqr_mode_name(seqr_mode_t mode);
+
+#endif
@@ -0,0 +1,593 @@
+// Hyperperiod replay of a sequencer run against its simulated schedule
+//
+// The schedan.h analysis and the schedsim.h timeline say when each job of
+// a service set starts and finishes on an ideal core; a seqgen4 run says
+// when it did.  seqreplay runs seqgen4 as a child process for a whole
+// number of hyperperiods with the binary event log (-L, evlog.h), then
+// reads the log back and lines every job up against the same set
+// simulated under the table's fixed priorities:
+//
+//    seqreplay [-H hyperperiods] [-w pct] [-L file] [-o csv] [-b seqgen4] [-- seqgen4 options]
+//    seqreplay -r file [-o csv]
+//
+//    -H  hyperperiods to run, default 4
+//    -w  busy work of each release as a percentage of its C, default 100,
+//        so the services take the time the analysis gives them
+//    -L  the event log, default seqreplay.evlog, kept for logcheck
+//    -o  write one CSV row per job: release, simulated and real start and
+//        finish and the differences, in usec from tick 0
+//    -b  the sequencer to run, default ./seqgen4
+//    -r  replay the log of an earlier run, e.g. one copied off a board,
+//        without running anything
+//
+// Everything after -- goes to seqgen4, e.g. "seqreplay -H 10 -- -s c2a7 -r
+// futex"; -L, -H and -w are put in front of it, so a -w of its own wins.
+// The sequencer runs in its own process, with its own locked memory and
+// SCHED_FIFO threads, and the replay only starts once it has exited, so
+// nothing here runs on its cores while it is being measured.
+//
+// The log carries everything the replay needs: each row's T, C, D and
+// priority, the tick length, the busy work per release, the time of tick
+// 0 and the start and finish of every job.  Each service is simulated
+// with the others that ran on the same core, in usec with C its busy work,
+// and job k, released on tick kT, is compared with release k+1 of the log:
+//
+//    start     how much later than simulated the job started, its release
+//              latency plus whatever else ran on the core first
+//    finish    how much later it finished, which adds the time the kernel,
+//              the sequencer and the drain took from it while it ran
+//    margin    D less the simulated worst response time, and how much of
+//              that margin the real worst response time used up
+//
+// Only -m fifo runs with service threads can be replayed, SCHED_DEADLINE
+// services have no tick 0 and cyclic executive jobs run in slices.  Exits
+// 0 when every job was logged and none missed a deadline the simulation
+// met, 1 when one did or jobs are missing, -1 on error.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "evlog.h"
+#include "schedan.h"
+#include "schedsim.h"
+
+#define TRUE (1)
+#define FALSE (0)
+
+#define MAX_CORES (64)
+#define DEFAULT_HYPERPERIODS (4)
+#define DEFAULT_LOG "seqreplay.evlog"
+#define DEFAULT_SEQUENCER "./seqgen4"
+
+typedef struct
+{
+    long long start_ns, finish_ns;      // from the log, -1 if not logged
+    int core;
+} job_t;
+
+typedef struct
+{
+    char label[EVLOG_LABEL_LEN];
+    int has_task;
+    unsigned int T, C, D;
+    int priority;
+    long long tick_ns, work_ns;
+    unsigned long long dropped;
+
+    job_t *job;
+    unsigned long long njobs, max_jobs; // njobs is the last release logged
+    unsigned long long on_core[MAX_CORES];
+    int core;                           // the one most jobs started on
+
+    // simulated, usec from tick 0, -1 for a job that did not finish
+    double *sim_start, *sim_finish;
+} replay_svc_t;
+
+static replay_svc_t svcs[EVLOG_MAX_RINGS];
+static long long tick0_ns=-1;
+
+
+static void usage(void)
+{
+    printf("usage: seqreplay [-H hyperperiods] [-w pct] [-L file] [-o csv] [-b seqgen4] [-- seqgen4 options]\n");
+    printf("       seqreplay -r file [-o csv]\n");
+}
+
+
+// job k of s, growing the array as releases come in
+static job_t *job_at(replay_svc_t *s, unsigned long long k)
+{
+    unsigned long long i, max;
+    job_t *j;
+
+    if(k >= s->max_jobs)
+    {
+        for(max=s->max_jobs ? s->max_jobs : 1024; max <= k; max*=2);
+        if((j=(job_t *)realloc(s->job, max*sizeof(job_t))) == NULL)
+        {
+            printf("seqreplay: no memory for %llu jobs of %s\n", max, s->label);
+            exit(-1);
+        }
+        for(i=s->max_jobs; i<max; i++)
+        {
+            j[i].start_ns=j[i].finish_ns=-1;
+            j[i].core=-1;
+        }
+        s->job=j;
+        s->max_jobs=max;
+    }
+
+    if(k+1 > s->njobs) s->njobs=k+1;
+
+    return &s->job[k];
+}
+
+
+static int read_log(const char *path)
+{
+    evlog_rec_t rec;
+    replay_svc_t *s;
+    job_t *j;
+    FILE *fp;
+    int rc=0;
+
+    if((fp=fopen(path, "rb")) == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    if(fread(&rec, sizeof(rec), 1, fp) != 1 || rec.type != EVLOG_REC_HEADER ||
+       strncmp(rec.u.label, EVLOG_FILE_MAGIC, sizeof(EVLOG_FILE_MAGIC)) != 0)
+    {
+        printf("%s: not an evlog file\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    while(rc == 0 && fread(&rec, sizeof(rec), 1, fp) == 1)
+    {
+        if(rec.id < 0 || rec.id >= EVLOG_MAX_RINGS)
+        {
+            printf("%s: ring %d out of range\n", path, rec.id);
+            rc=-1;
+            break;
+        }
+        s=&svcs[rec.id];
+
+        switch(rec.type)
+        {
+            case EVLOG_REC_LABEL:
+                memcpy(s->label, rec.u.label, EVLOG_LABEL_LEN);
+                s->label[EVLOG_LABEL_LEN-1]='\0';
+                break;
+            case EVLOG_REC_TASK:
+                s->T=rec.u.task.T;
+                s->C=rec.u.task.C;
+                s->D=rec.u.task.D ? rec.u.task.D : rec.u.task.T;
+                s->priority=rec.u.task.priority;
+                s->tick_ns=rec.u.task.tick_ns;
+                s->work_ns=rec.u.task.work_ns;
+                s->has_task=(s->T > 0 && s->tick_ns > 0);
+                break;
+            case EVLOG_REC_TICK0:
+                tick0_ns=rec.u.ev.t_ns;
+                break;
+            case EVLOG_REC_EVENT:
+            case EVLOG_REC_DONE:
+                // release numbers start at 1 for the job of tick 0
+                if(rec.u.ev.count == 0) break;
+                j=job_at(s, rec.u.ev.count-1);
+                if(rec.type == EVLOG_REC_DONE)
+                {
+                    j->finish_ns=rec.u.ev.t_ns;
+                    break;
+                }
+                j->start_ns=rec.u.ev.t_ns;
+                j->core=rec.core;
+                if(rec.core >= 0 && rec.core < MAX_CORES) s->on_core[rec.core]++;
+                break;
+            case EVLOG_REC_DROPPED:
+                s->dropped+=rec.u.ev.count;
+                break;
+            case EVLOG_REC_HEADER:
+                break;
+            default:
+                printf("%s: unknown record type %d\n", path, rec.type);
+                rc=-1;
+        }
+    }
+
+    fclose(fp);
+    return rc;
+}
+
+
+// Predicted start and finish of each of the first njobs jobs of service j,
+// from the slices it ran in, C usec each in release order
+static void sim_jobs(const ss_trace_t *tr, int j, unsigned long long C, double *start, double *finish, unsigned long long njobs)
+{
+    unsigned long long k, done=0, t, run;
+    int s;
+
+    for(k=0; k<njobs; k++)
+        start[k]=finish[k]=-1.0;
+
+    for(k=0, s=0; s<tr->nslices && k<njobs; s++)
+    {
+        if(tr->slice[s].task != j) continue;
+
+        // consecutive jobs of one service can share a slice
+        for(t=tr->slice[s].start; t<tr->slice[s].end && k<njobs; t+=run)
+        {
+            if(done == 0) start[k]=(double)t;
+
+            run=tr->slice[s].end - t;
+            if(run > C - done) run=C - done;
+            done+=run;
+
+            if(done == C)
+            {
+                finish[k++]=(double)(t + run);
+                done=0;
+            }
+        }
+    }
+}
+
+
+// Simulate the services that ran on core together, each its own njobs
+static int simulate_core(int core, unsigned long long horizon_us, const unsigned long long *njobs)
+{
+    sa_task_t task[SA_MAX_TASKS];
+    int ring[SA_MAX_TASKS];
+    ss_trace_t trace;
+    replay_svc_t *s;
+    double U;
+    int i, n=0;
+
+    for(i=0; i<EVLOG_MAX_RINGS; i++)
+    {
+        s=&svcs[i];
+        if(!njobs[i] || s->core != core) continue;
+
+        ring[n]=i;
+        task[n].T=(unsigned int)(s->T*s->tick_ns/1000);
+        task[n].D=(unsigned int)(s->D*s->tick_ns/1000);
+        // without -w a service does next to nothing, a usec
+        task[n].C=(s->work_ns >= 1000) ? (unsigned int)(s->work_ns/1000) : 1;
+        task[n].priority=s->priority;
+        task[n].B=0;
+        n++;
+    }
+
+    if(n == 0) return 0;
+
+    if(ss_simulate(task, n, SS_FP, horizon_us, TRUE, &trace) != 0)
+        return -1;
+
+    for(i=0; i<n; i++)
+    {
+        s=&svcs[ring[i]];
+        s->sim_start=(double *)malloc(njobs[ring[i]]*sizeof(double));
+        s->sim_finish=(double *)malloc(njobs[ring[i]]*sizeof(double));
+        if(!s->sim_start || !s->sim_finish)
+        {
+            printf("seqreplay: no memory for %llu simulated jobs\n", njobs[ring[i]]);
+            ss_free(&trace);
+            return -1;
+        }
+        sim_jobs(&trace, i, task[i].C, s->sim_start, s->sim_finish, njobs[ring[i]]);
+    }
+
+    for(i=0, U=0.0; i<n; i++)
+        U+=(double)task[i].C/task[i].T;
+    printf("core %d: %d services, U=%.3lf, %llu simulated preemptions, %llu simulated misses\n", core, n,
+           U, trace.preemptions, trace.total_misses);
+    ss_free(&trace);
+
+    return 0;
+}
+
+
+static int replay(const char *path, const char *csv_path)
+{
+    unsigned long long njobs[EVLOG_MAX_RINGS];
+    unsigned long long H=0, last_tick=0, horizon, k, c, matched, missing, missed, sim_missed, late;
+    sa_task_t hyper_task[SA_MAX_TASKS];
+    long long tick_ns=0;
+    double tick_us, rel, real_start, real_finish, d_start, d_finish;
+    double sum_start, sum_finish, max_start, max_finish, R_sim, R_real, D_us, margin;
+    int i, n=0, cores_done[MAX_CORES], rc=0;
+    replay_svc_t *s;
+    FILE *csv=(FILE *)0;
+
+    if(read_log(path) != 0) return -1;
+
+    if(tick0_ns < 0)
+    {
+        printf("%s: no tick 0, only a -m fifo run with service threads can be replayed\n", path);
+        return -1;
+    }
+
+    // the services with parameters, each on the core most of its jobs ran on
+    for(i=0; i<EVLOG_MAX_RINGS; i++)
+    {
+        s=&svcs[i];
+        njobs[i]=0;
+        if(!s->has_task || s->njobs == 0) continue;
+
+        for(c=0, s->core=0; c<MAX_CORES; c++)
+            if(s->on_core[c] > s->on_core[s->core]) s->core=(int)c;
+
+        if(n == SA_MAX_TASKS)
+        {
+            printf("%s: more than %d services\n", path, SA_MAX_TASKS);
+            return -1;
+        }
+        hyper_task[n].T=s->T;
+        n++;
+
+        if(tick_ns == 0) tick_ns=s->tick_ns;
+        if(s->tick_ns != tick_ns)
+        {
+            printf("%s: %s has a %lld nsec tick, not %lld\n", path, s->label, s->tick_ns, tick_ns);
+            return -1;
+        }
+        if((s->njobs-1)*s->T > last_tick) last_tick=(s->njobs-1)*s->T;
+    }
+
+    if(n == 0)
+    {
+        printf("%s: no service with release parameters, not a seqgen4 -L log\n", path);
+        return -1;
+    }
+
+    // the run was whole hyperperiods, the last release is in the last one
+    if((H=ss_hyperperiod(hyper_task, n)) == 0)
+    {
+        printf("%s: hyperperiod does not fit 64 bits\n", path);
+        return -1;
+    }
+    horizon=(last_tick/H + 1)*H;
+    tick_us=tick_ns/1000.0;
+
+    printf("%s: %d services, %.1lf usec tick, %llu ticks, %llu hyperperiods of %llu\n", path, n, tick_us, horizon, horizon/H, H);
+
+    for(i=0; i<EVLOG_MAX_RINGS; i++)
+        if(svcs[i].has_task && svcs[i].njobs) njobs[i]=horizon/svcs[i].T;
+
+    memset(cores_done, 0, sizeof(cores_done));
+    for(i=0; i<EVLOG_MAX_RINGS; i++)
+    {
+        if(!njobs[i] || cores_done[svcs[i].core]) continue;
+        cores_done[svcs[i].core]=1;
+        if(simulate_core(svcs[i].core, (unsigned long long)(horizon*tick_us), njobs) != 0) return -1;
+    }
+
+    if(csv_path)
+    {
+        if((csv=fopen(csv_path, "w")) == NULL)
+        {
+            perror(csv_path);
+            return -1;
+        }
+        fprintf(csv, "service,job,core,release,sim_start,real_start,start_dev,sim_finish,real_finish,finish_dev\n");
+    }
+
+    printf("\nusec from the simulated schedule, R the worst response time, margin D-R of the simulation\n");
+    printf("%-16s %4s %7s %10s %10s %10s %10s %10s %10s %10s %6s %6s\n", "service", "core", "jobs",
+           "start avg", "start max", "finish avg", "finish max", "R sim", "R real", "margin", "used", "missed");
+
+    for(i=0; i<EVLOG_MAX_RINGS; i++)
+    {
+        s=&svcs[i];
+        if(!njobs[i]) continue;
+
+        D_us=s->D*tick_us;
+        matched=missing=missed=sim_missed=late=0;
+        sum_start=sum_finish=0.0;
+        max_start=max_finish=R_sim=R_real=0.0;
+
+        for(k=0; k<njobs[i]; k++)
+        {
+            rel=k*s->T*tick_us;
+
+            if(s->sim_finish[k] < 0.0 || s->sim_finish[k] - rel > D_us)
+                sim_missed++;
+            else if(s->sim_finish[k] - rel > R_sim)
+                R_sim=s->sim_finish[k] - rel;
+
+            if(k >= s->njobs || s->job[k].start_ns < 0 || s->job[k].finish_ns < 0)
+            {
+                missing++;
+                if(csv) fprintf(csv, "%s,%llu,,%.3lf,%.3lf,,,%.3lf,,\n", s->label, k, rel, s->sim_start[k], s->sim_finish[k]);
+                continue;
+            }
+
+            real_start=(s->job[k].start_ns - tick0_ns)/1000.0;
+            real_finish=(s->job[k].finish_ns - tick0_ns)/1000.0;
+
+            if(real_finish - rel > D_us)
+            {
+                missed++;
+                if(s->sim_finish[k] >= 0.0 && s->sim_finish[k] - rel <= D_us) late++;
+            }
+            if(real_finish - rel > R_real) R_real=real_finish - rel;
+
+            if(csv)
+                fprintf(csv, "%s,%llu,%d,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf\n", s->label, k, s->job[k].core, rel,
+                        s->sim_start[k], real_start, real_start - s->sim_start[k], s->sim_finish[k], real_finish, real_finish - s->sim_finish[k]);
+
+            if(s->sim_finish[k] < 0.0) continue;
+
+            d_start=real_start - s->sim_start[k];
+            d_finish=real_finish - s->sim_finish[k];
+            if(matched++ == 0 || d_start > max_start) max_start=d_start;
+            if(matched == 1 || d_finish > max_finish) max_finish=d_finish;
+            sum_start+=d_start;
+            sum_finish+=d_finish;
+        }
+
+        margin=D_us - R_sim;
+        printf("%-16.16s %4d %7llu %10.1lf %10.1lf %10.1lf %10.1lf %10.1lf %10.1lf %10.1lf", s->label, s->core, njobs[i] - missing,
+               matched ? sum_start/matched : 0.0, max_start, matched ? sum_finish/matched : 0.0, max_finish, R_sim, R_real, margin);
+        if(margin > 0.0)
+            printf(" %5.1lf%%", 100.0*(R_real - R_sim)/margin);
+        else
+            printf(" %6s", "-");
+        printf(" %6llu\n", missed);
+
+        if(missing)
+        {
+            printf("    %llu of %llu jobs not in the log%s\n", missing, njobs[i], s->dropped ? ", the ring dropped some" : "");
+            rc=1;
+        }
+        if(sim_missed)
+            printf("    %llu jobs miss their deadline in the simulation too\n", sim_missed);
+        if(late)
+        {
+            printf("    %llu jobs missed a deadline the simulation met\n", late);
+            rc=1;
+        }
+    }
+
+    if(csv)
+    {
+        fclose(csv);
+        printf("\nper job timeline in %s\n", csv_path);
+    }
+
+    for(i=0; i<EVLOG_MAX_RINGS; i++)
+    {
+        free(svcs[i].job);
+        free(svcs[i].sim_start);
+        free(svcs[i].sim_finish);
+    }
+
+    return rc;
+}
+
+
+// seqgen4 -L log -H hyperperiods -w pct, then the caller's options
+static int run_sequencer(const char *bin, const char *log, unsigned long long hyperperiods, int pct, int argc, char *argv[])
+{
+    char hyper_arg[32], pct_arg[16];
+    char **args;
+    pid_t pid;
+    int i, n=0, status;
+
+    if((args=(char **)malloc((argc+8)*sizeof(char *))) == NULL)
+    {
+        printf("seqreplay: no memory for %d arguments\n", argc);
+        return -1;
+    }
+
+    snprintf(hyper_arg, sizeof(hyper_arg), "%llu", hyperperiods);
+    snprintf(pct_arg, sizeof(pct_arg), "%d", pct);
+    args[n++]=(char *)bin;
+    args[n++]="-L"; args[n++]=(char *)log;
+    args[n++]="-H"; args[n++]=hyper_arg;
+    args[n++]="-w"; args[n++]=pct_arg;
+    for(i=0; i<argc; i++)
+        args[n++]=argv[i];
+    args[n]=(char *)0;
+
+    printf("running");
+    for(i=0; i<n; i++) printf(" %s", args[i]);
+    printf("\n");
+
+    // the child's output would otherwise repeat whatever is still buffered
+    fflush(stdout);
+
+    if((pid=fork()) < 0)
+    {
+        perror("fork");
+        free(args);
+        return -1;
+    }
+
+    if(pid == 0)
+    {
+        execv(bin, args);
+        perror(bin);
+        _exit(127);
+    }
+
+    free(args);
+
+    if(waitpid(pid, &status, 0) < 0)
+    {
+        perror("waitpid");
+        return -1;
+    }
+
+    if(WIFSIGNALED(status))
+    {
+        printf("%s killed by signal %d\n", bin, WTERMSIG(status));
+        return -1;
+    }
+    if(WEXITSTATUS(status) != 0)
+    {
+        printf("%s exited with %d\n", bin, WEXITSTATUS(status));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *log=DEFAULT_LOG, *csv_path=(const char *)0, *bin=DEFAULT_SEQUENCER;
+    unsigned long long hyperperiods=DEFAULT_HYPERPERIODS;
+    int opt, pct=100, replay_only=FALSE;
+
+    while((opt=getopt(argc, argv, "H:w:L:o:b:r:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'H':
+                if((hyperperiods=strtoull(optarg, (char **)0, 10)) == 0)
+                {
+                    printf("hyperperiods %s, at least 1\n", optarg);
+                    usage(); exit(-1);
+                }
+                break;
+            case 'w':
+                pct=atoi(optarg);
+                if(pct < 0 || pct > 100)
+                {
+                    printf("busy work %s%%, 0 to 100\n", optarg);
+                    usage(); exit(-1);
+                }
+                break;
+            case 'L':
+                log=optarg;
+                break;
+            case 'o':
+                csv_path=optarg;
+                break;
+            case 'b':
+                bin=optarg;
+                break;
+            case 'r':
+                log=optarg;
+                replay_only=TRUE;
+                break;
+            default:
+                usage(); exit(-1);
+        }
+    }
+
+    if(!replay_only && run_sequencer(bin, log, hyperperiods, pct, argc-optind, &argv[optind]) != 0)
+        exit(-1);
+
+    printf("\n");
+    exit(replay(log, csv_path));
+}
@@ -0,0 +1,181 @@
+// Shared resources for services, see seqshare.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <syslog.h>
+
+#include "seqshare.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+
+static const char *protocol_names[] = {"inherit", "ceiling"};
+
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*NANOSEC_PER_SEC + ts.tv_nsec;
+}
+
+
+int shr_protocol(const char *name)
+{
+    if(strcmp(name, "inherit") == 0) return SHR_INHERIT;
+    if(strcmp(name, "ceiling") == 0) return SHR_CEILING;
+    return -1;
+}
+
+
+const char *shr_protocol_name(int protocol)
+{
+    return protocol_names[protocol];
+}
+
+
+int shr_init(shr_resource_t *r, const char *name, int protocol, int ceiling)
+{
+    pthread_mutexattr_t attr;
+    int rc;
+
+    memset(r, 0, sizeof(shr_resource_t));
+    r->name=name;
+    r->protocol=protocol;
+    r->ceiling=ceiling;
+
+    pthread_mutexattr_init(&attr);
+
+    if(protocol == SHR_CEILING)
+    {
+        if((rc=pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_PROTECT)) == 0)
+            rc=pthread_mutexattr_setprioceiling(&attr, ceiling);
+    }
+    else
+        rc=pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+
+    if(rc == 0) rc=pthread_mutex_init(&r->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    if(rc != 0)
+    {
+        printf("shr_init: %s %s mutex, rc=%d\n", name, shr_protocol_name(protocol), rc);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void shr_destroy(shr_resource_t *r)
+{
+    pthread_mutex_destroy(&r->lock);
+}
+
+
+int shr_lock(shr_resource_t *r)
+{
+    long long start=now_ns(), wait;
+    int rc;
+
+    // EINVAL from a ceiling mutex is a caller above the ceiling
+    if((rc=pthread_mutex_lock(&r->lock)) != 0)
+    {
+        printf("shr_lock: %s, rc=%d\n", r->name, rc);
+        return -1;
+    }
+
+    r->acquired_ns=now_ns();
+    wait=r->acquired_ns - start;
+    if(wait > r->max_wait_ns) r->max_wait_ns=wait;
+    r->locks++;
+
+    return 0;
+}
+
+
+void shr_unlock(shr_resource_t *r)
+{
+    long long hold=now_ns() - r->acquired_ns;
+
+    if(hold > r->max_hold_ns) r->max_hold_ns=hold;
+    pthread_mutex_unlock(&r->lock);
+}
+
+
+void shr_sl_init(shr_seqlock_t *s, const char *name, void *data, size_t size)
+{
+    memset(s, 0, sizeof(shr_seqlock_t));
+    s->name=name;
+    s->data=data;
+    s->size=size;
+}
+
+
+void shr_sl_write(shr_seqlock_t *s, const void *src)
+{
+    // odd before any byte changes, even after the last one
+    __atomic_store_n(&s->seq, s->seq+1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(s->data, src, s->size);
+
+    __atomic_store_n(&s->seq, s->seq+1, __ATOMIC_RELEASE);
+    s->writes++;
+}
+
+
+unsigned int shr_sl_read_begin(const shr_seqlock_t *s)
+{
+    unsigned int seq;
+
+    while((seq=__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE)) & 1)
+        ;
+
+    return seq;
+}
+
+
+int shr_sl_read_retry(const shr_seqlock_t *s, unsigned int seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&s->seq, __ATOMIC_RELAXED) != seq;
+}
+
+
+int shr_sl_read(shr_seqlock_t *s, void *dst)
+{
+    unsigned int seq;
+    int retries=0;
+
+    while(1)
+    {
+        seq=shr_sl_read_begin(s);
+        memcpy(dst, s->data, s->size);
+        if(!shr_sl_read_retry(s, seq)) break;
+        retries++;
+    }
+
+    __atomic_fetch_add(&s->reads, 1, __ATOMIC_RELAXED);
+    if(retries) __atomic_fetch_add(&s->retries, retries, __ATOMIC_RELAXED);
+
+    return retries;
+}
+
+
+void shr_report(const shr_resource_t *r)
+{
+    printf("%s %s mutex: %llu locks, wait max %.1lf usec, hold max %.1lf usec\n", r->name,
+           shr_protocol_name(r->protocol), r->locks, r->max_wait_ns/1000.0, r->max_hold_ns/1000.0);
+    syslog(LOG_CRIT, "%s %s mutex %llu locks wait max %lld hold max %lld nsec\n", r->name,
+           shr_protocol_name(r->protocol), r->locks, r->max_wait_ns, r->max_hold_ns);
+}
+
+
+void shr_sl_report(const shr_seqlock_t *s)
+{
+    printf("%s seqlock: %llu writes, %llu reads, %llu retried\n", s->name, s->writes, s->reads, s->retries);
+    syslog(LOG_CRIT, "%s seqlock %llu writes %llu reads %llu retries\n", s->name, s->writes, s->reads, s->retries);
+}
@@ -0,0 +1,93 @@
+#ifndef _SEQSHARE_
+#define _SEQSHARE_
+
+// Shared state between SCHED_FIFO services without unbounded inversion
+//
+// A plain pthread mutex lets a medium priority service preempt a low
+// priority one that holds a lock a high priority one is waiting for, for
+// as long as it likes.  Two ways around it:
+//
+//    shr_resource_t   a mutex with a priority protocol
+//                     inherit   PTHREAD_PRIO_INHERIT, the holder runs at
+//                               the priority of its highest waiter
+//                     ceiling   PTHREAD_PRIO_PROTECT, the holder runs at
+//                               the ceiling, the highest priority of any
+//                               user, from lock to unlock, so at most one
+//                               lower priority critical section blocks
+//                     Either way a service is blocked for a bounded time,
+//                     sa_blocking() (schedan.h) puts that bound into RTA.
+//
+//    shr_seqlock_t    one writer that never waits and any number of
+//                     readers: the writer bumps a sequence count to odd,
+//                     copies, bumps it to even; a reader that saw it odd
+//                     or changed copies again.  For sensor samples and frames where
+//                     the newest copy is all a reader wants.  A reader
+//                     spins while a write is in progress, so on a shared
+//                     core the writer must be the highest priority user.
+//
+// Each resource keeps its lock count and its longest wait and hold time,
+// measured with the lock held, so the blocking seen at run time can be set
+// against the analysis.
+//
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define SHR_INHERIT (0)
+#define SHR_CEILING (1)
+
+typedef struct
+{
+    const char *name;
+    int protocol;
+    int ceiling;                // SHR_CEILING only
+    pthread_mutex_t lock;
+
+    // written with the lock held
+    unsigned long long locks;
+    long long max_wait_ns, max_hold_ns;
+    long long acquired_ns;
+} shr_resource_t;
+
+typedef struct
+{
+    const char *name;
+    volatile unsigned int seq;  // odd while a write is in progress
+    void *data;
+    size_t size;
+
+    unsigned long long writes;  // writer owned
+    unsigned long long reads, retries;
+} shr_seqlock_t;
+
+// Mutex with protocol SHR_INHERIT or SHR_CEILING, ceiling is the highest
+// SCHED_FIFO priority that will lock it, returns 0 or -1
+int shr_init(shr_resource_t *r, const char *name, int protocol, int ceiling);
+void shr_destroy(shr_resource_t *r);
+
+int shr_lock(shr_resource_t *r);
+void shr_unlock(shr_resource_t *r);
+
+// Seqlock over size bytes at data, which it then owns
+void shr_sl_init(shr_seqlock_t *s, const char *name, void *data, size_t size);
+
+// Writer side, copy size bytes from src in
+void shr_sl_write(shr_seqlock_t *s, const void *src);
+
+// Reader side, copy the last complete write out to dst, returns how many
+// times it had to copy again
+int shr_sl_read(shr_seqlock_t *s, void *dst);
+
+// Reader side without a copy: begin returns the count to hand to retry
+// once done with s->data, retry is 1 if a write got in the way
+unsigned int shr_sl_read_begin(const shr_seqlock_t *s);
+int shr_sl_read_retry(const shr_seqlock_t *s, unsigned int seq);
+
+// "inherit" or "ceiling" to a protocol, -1 if unknown
+int shr_protocol(const char *name);
+const char *shr_protocol_name(int protocol);
+
+void shr_report(const shr_resource_t *r);
+void shr_sl_report(const shr_seqlock_t *s);
+
+#endif
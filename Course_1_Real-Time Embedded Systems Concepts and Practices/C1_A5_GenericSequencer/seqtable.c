@@ -0,0 +1,586 @@
+// Table-driven generic sequencer, see seqtable.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#include "seqtable.h"
+#include "rttrace.h"
+#include "rtenv.h"
+
+// sched_setattr(2) argument, not exported by older C libraries
+typedef struct
+{
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+} seq_sched_attr_t;
+
+
+// earlier release first, ties go to the higher priority service so the
+// release order on a shared tick matches the old if() chain
+static int due_before(sequencer_t *seq, int a, int b)
+{
+    service_t *sa=&seq->services[a], *sb=&seq->services[b];
+
+    if(sa->next_release != sb->next_release)
+        return sa->next_release < sb->next_release;
+
+    return sa->desc->priority > sb->desc->priority;
+}
+
+
+static void sift_down(sequencer_t *seq, int i)
+{
+    int child, tmp, n=seq->nheap;
+    int *heap=seq->heap;
+
+    while((child=2*i+1) < n)
+    {
+        if(child+1 < n && due_before(seq, heap[child+1], heap[child]))
+            child++;
+
+        if(!due_before(seq, heap[child], heap[i]))
+            break;
+
+        tmp=heap[i]; heap[i]=heap[child]; heap[child]=tmp;
+        i=child;
+    }
+}
+
+
+static void sift_up(sequencer_t *seq, int i)
+{
+    int parent, tmp;
+    int *heap=seq->heap;
+
+    while(i > 0)
+    {
+        parent=(i-1)/2;
+        if(!due_before(seq, heap[i], heap[parent]))
+            break;
+
+        tmp=heap[i]; heap[i]=heap[parent]; heap[parent]=tmp;
+        i=parent;
+    }
+}
+
+
+static void run_release(service_t *svc, long long release)
+{
+    if(svc->stats) svc_stats_wake(svc->stats, release);
+    RTT_WAKE(svc->desc->name, release);
+
+    svc->releases=release;
+    svc->desc->work(svc);
+
+    RTT_DONE(svc->desc->name, release);
+    if(svc->stats) svc_stats_done(svc->stats);
+}
+
+
+static void *service_body(void *threadp)
+{
+    service_t *svc=(service_t *)threadp, *member;
+    long long release;
+    int perf;
+
+    // a spare slot has no desc until seq_activate() hands it one
+    perf=svc->desc ? rte_perf_begin(svc->desc->name, -1) : rte_perf_begin("standby", svc->idx);
+
+    while(1)
+    {
+        // wait for service request from the sequencer
+        release=seqr_wait(&svc->rel);
+
+        if(release < 0 || svc->abort) break;
+
+        // the leader of a rate group, then its members in priority order
+        for(member=svc; member != NULL; member=member->group_next)
+            run_release(member, release);
+    }
+
+    rte_perf_end(perf);
+    pthread_exit((void *)0);
+}
+
+
+int seq_init(sequencer_t *seq, const service_desc_t *table, int n, seqr_mode_t mode)
+{
+    return seq_init_spare(seq, table, n, 0, mode);
+}
+
+
+int seq_init_spare(sequencer_t *seq, const service_desc_t *table, int n, int nspare, seqr_mode_t mode)
+{
+    int i, slots=n+nspare;
+
+    if(n < 1 || nspare < 0)
+    {
+        printf("seq_init: no services\n");
+        return -1;
+    }
+
+    seq->nservices=n;
+    seq->nslots=slots;
+    seq->nstarted=0;
+    seq->ngroups=0;
+    seq->nheap=n;
+    seq->tick=0;
+    memset(&seq->stacks, 0, sizeof(seq->stacks));
+    seq->services=(service_t *)calloc(slots, sizeof(service_t));
+    seq->heap=(int *)malloc(slots*sizeof(int));
+    seq->due=(int *)malloc(slots*sizeof(int));
+
+    if(!seq->services || !seq->heap || !seq->due)
+    {
+        printf("seq_init: no memory for %d services\n", slots);
+        return -1;
+    }
+
+    for(i=0; i<n; i++)
+    {
+        if(table[i].divisor == 0)
+        {
+            printf("seq_init: service %s has a zero period\n", table[i].name);
+            return -1;
+        }
+
+        seq->services[i].desc=&table[i];
+        seq->services[i].idx=i;
+        seq->services[i].core=table[i].core;
+        seq->services[i].seq=seq;
+        seq->services[i].next_release=0;
+        seq->services[i].budget=table[i].wcet;
+
+        if(seqr_init(&seq->services[i].rel, mode))
+        {
+            printf("Failed to initialize %s %s release\n", table[i].name, seqr_mode_name(mode));
+            return -1;
+        }
+
+        seq->heap[i]=i;
+    }
+
+    // standby slots have no row until seq_activate()
+    for(i=n; i<slots; i++)
+    {
+        seq->services[i].idx=i;
+        seq->services[i].core=SEQ_ANY_CORE;
+        seq->services[i].seq=seq;
+
+        if(seqr_init(&seq->services[i].rel, mode))
+        {
+            printf("Failed to initialize standby slot %d %s release\n", i, seqr_mode_name(mode));
+            return -1;
+        }
+    }
+
+    // every service starts due on tick 0, so only the priority order matters
+    for(i=n/2-1; i>=0; i--)
+        sift_down(seq, i);
+
+    return 0;
+}
+
+
+int seq_group_rates(sequencer_t *seq)
+{
+    int i, j, k, folded=0;
+    int *order=seq->due;      // free until the first seq_tick()
+    service_t *a, *b, *tail;
+
+    // rows by decreasing priority, so a group's leader is its first member
+    for(i=0; i<seq->nservices; i++)
+    {
+        for(j=i; j > 0 && seq->services[order[j-1]].desc->priority < seq->services[i].desc->priority; j--)
+            order[j]=order[j-1];
+        order[j]=i;
+    }
+
+    for(i=0; i<seq->nservices; i++)
+    {
+        a=&seq->services[order[i]];
+        if(a->grouped) continue;
+
+        tail=a;
+        for(k=i+1; k<seq->nservices; k++)
+        {
+            b=&seq->services[order[k]];
+            if(b->grouped || b->desc->divisor != a->desc->divisor || b->core != a->core)
+                continue;
+
+            tail->group_next=b;
+            tail=b;
+            b->grouped=1;
+            folded++;
+        }
+
+        if(tail != a)
+        {
+            seq->ngroups++;
+            printf("rate group T=%u on core %d:", a->desc->divisor, a->core);
+            for(b=a; b != NULL; b=b->group_next)
+                printf(" %s", b->desc->name);
+            printf("\n");
+        }
+    }
+
+    // only the leaders are released from the heap
+    seq->nheap=0;
+    for(i=0; i<seq->nservices; i++)
+        if(!seq->services[i].grouped)
+            seq->heap[seq->nheap++]=i;
+
+    for(i=seq->nheap/2-1; i>=0; i--)
+        sift_down(seq, i);
+
+    return folded;
+}
+
+
+static size_t stack_size(const service_t *svc)
+{
+    return (svc->desc && svc->desc->stack) ? svc->desc->stack : SEQ_STACK_SIZE;
+}
+
+
+// One arena for the threads of the first n slots, rate group members
+// left out
+static void map_stacks(sequencer_t *seq, int n)
+{
+    size_t span=0;
+    int i;
+
+    for(i=0; i<n; i++)
+        if(!seq->services[i].grouped)
+            span+=rts_span(stack_size(&seq->services[i]));
+
+    rts_arena_init(&seq->stacks, n, span);
+}
+
+
+int seq_start(sequencer_t *seq)
+{
+    int i, rc;
+    pthread_attr_t attr;
+    struct sched_param param;
+    cpu_set_t cpuset;
+    service_t *svc;
+
+    map_stacks(seq, seq->nslots);
+
+    for(i=0; i<seq->nslots; i++)
+    {
+        svc=&seq->services[i];
+
+        // run by its rate group leader's thread
+        if(svc->grouped) continue;
+
+        pthread_attr_init(&attr);
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        param.sched_priority=svc->desc ? svc->desc->priority : sched_get_priority_min(SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+        rts_attr_stack(&seq->stacks, &attr, stack_size(svc), svc->desc ? svc->desc->name : (const char *)0);
+
+        if(svc->core != SEQ_ANY_CORE)
+        {
+            CPU_ZERO(&cpuset);
+            CPU_SET(svc->core, &cpuset);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        }
+
+        rc=pthread_create(&svc->thread, &attr, service_body, (void *)svc);
+        pthread_attr_destroy(&attr);
+
+        if(rc != 0)
+        {
+            printf("pthread_create for %s on core %d failed, rc=%d\n", svc->desc ? svc->desc->name : "standby", svc->core, rc);
+            return -1;
+        }
+        else if(svc->desc)
+            printf("pthread_create successful for %s\n", svc->desc->name);
+        else
+            printf("pthread_create successful for standby slot %d\n", i);
+
+        svc->started=1;
+        seq->nstarted++;
+    }
+
+    return 0;
+}
+
+
+int seq_activate(sequencer_t *seq, const service_desc_t *desc)
+{
+    service_t *svc;
+    struct sched_param param;
+    cpu_set_t cpuset;
+    int rc;
+
+    if(seq->nservices == seq->nslots || desc->divisor == 0)
+        return -1;
+
+    svc=&seq->services[seq->nservices];
+
+    if(svc->started)
+    {
+        param.sched_priority=desc->priority;
+        if((rc=pthread_setschedparam(svc->thread, SCHED_FIFO, &param)) != 0)
+        {
+            printf("seq_activate: %s priority %d, rc=%d\n", desc->name, desc->priority, rc);
+            return -1;
+        }
+
+        if(desc->core != SEQ_ANY_CORE)
+        {
+            CPU_ZERO(&cpuset);
+            CPU_SET(desc->core, &cpuset);
+            pthread_setaffinity_np(svc->thread, sizeof(cpu_set_t), &cpuset);
+        }
+    }
+
+    svc->desc=desc;
+    svc->core=desc->core;
+    svc->budget=desc->wcet;
+    svc->next_release=((seq->tick + desc->divisor - 1) / desc->divisor) * desc->divisor;
+
+    seq->heap[seq->nheap++]=svc->idx;
+    seq->nservices++;
+    sift_up(seq, seq->nheap-1);
+
+    return svc->idx;
+}
+
+
+static void *deadline_body(void *threadp)
+{
+    service_t *svc=(service_t *)threadp;
+    const service_desc_t *desc=svc->desc;
+    sequencer_t *seq=svc->seq;
+    seq_sched_attr_t attr;
+    unsigned long long n;
+    int perf;
+
+    // releases on ticks 0, T, 2T, ... below periods
+    n=(seq->periods + desc->divisor - 1) / desc->divisor;
+
+    attr.size=sizeof(attr);
+    attr.sched_policy=SCHED_DEADLINE;
+    attr.sched_flags=0;
+    attr.sched_nice=0;
+    attr.sched_priority=0;
+    attr.sched_runtime=(uint64_t)desc->wcet * seq->tick_ns;
+    // the kernel wants runtime <= deadline <= period, so D > T rows run with D=T
+    attr.sched_deadline=(uint64_t)((desc->deadline && desc->deadline < desc->divisor) ? desc->deadline : desc->divisor) * seq->tick_ns;
+    attr.sched_period=(uint64_t)desc->divisor * seq->tick_ns;
+
+    // held until seq_start_deadline() has created every thread, so one that
+    // fails to start leaves none of the others stuck in the barrier
+    if(seqr_wait(&svc->rel) < 0 || svc->abort)
+        pthread_exit((void *)0);
+
+    // line every service up on the same critical instant
+    pthread_barrier_wait(&seq->dl_start);
+
+    if(syscall(SYS_sched_setattr, 0, &attr, 0) != 0)
+    {
+        perror("sched_setattr SCHED_DEADLINE");
+        printf("%s: runtime %llu, deadline %llu, period %llu nsec not admitted\n", desc->name,
+               (unsigned long long)attr.sched_runtime, (unsigned long long)attr.sched_deadline, (unsigned long long)attr.sched_period);
+        pthread_exit((void *)0);
+    }
+
+    perf=rte_perf_begin(desc->name, -1);
+
+    while(!svc->abort && svc->releases < n)
+    {
+        svc->releases++;
+        RTT_WAKE(desc->name, svc->releases);
+        desc->work(svc);
+        RTT_DONE(desc->name, svc->releases);
+
+        // done with this job, sleep until the next period starts
+        sched_yield();
+    }
+
+    rte_perf_end(perf);
+    pthread_exit((void *)0);
+}
+
+
+// seq_start_deadline() failed part way, the threads it did start leave
+// before the barrier and are joined, and the barrier is taken down
+static void abort_deadline(sequencer_t *seq)
+{
+    int i;
+
+    for(i=0; i<seq->nservices; i++)
+    {
+        if(!seq->services[i].started) continue;
+
+        seq->services[i].abort=1;
+        seqr_post(&seq->services[i].rel);
+    }
+
+    seq_join(seq);
+    pthread_barrier_destroy(&seq->dl_start);
+}
+
+
+int seq_start_deadline(sequencer_t *seq, long tick_ns, unsigned long long periods)
+{
+    int i, rc;
+    pthread_attr_t attr;
+    struct sched_param param;
+    service_t *svc;
+
+    if(seq->ngroups)
+    {
+        printf("seq_start_deadline: rate groups need the sequencer\n");
+        return -1;
+    }
+
+    // before any thread is created, so there is nothing to undo
+    for(i=0; i<seq->nservices; i++)
+    {
+        if(seq->services[i].desc->wcet == 0)
+        {
+            printf("%s has no WCET for a SCHED_DEADLINE runtime\n", seq->services[i].desc->name);
+            return -1;
+        }
+    }
+
+    seq->tick_ns=tick_ns;
+    seq->periods=periods;
+    pthread_barrier_init(&seq->dl_start, (void *)0, seq->nservices);
+    map_stacks(seq, seq->nservices);
+
+    for(i=0; i<seq->nservices; i++)
+    {
+        svc=&seq->services[i];
+
+        // created SCHED_OTHER and unpinned, the thread switches itself to
+        // SCHED_DEADLINE, which needs the whole root domain in its affinity
+        pthread_attr_init(&attr);
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+        param.sched_priority=0;
+        pthread_attr_setschedparam(&attr, &param);
+        rts_attr_stack(&seq->stacks, &attr, stack_size(svc), svc->desc->name);
+
+        rc=pthread_create(&svc->thread, &attr, deadline_body, (void *)svc);
+        pthread_attr_destroy(&attr);
+
+        if(rc != 0)
+        {
+            printf("pthread_create for %s failed, rc=%d\n", svc->desc->name, rc);
+            abort_deadline(seq);
+            return -1;
+        }
+        else
+            printf("pthread_create successful for SCHED_DEADLINE %s\n", svc->desc->name);
+
+        svc->started=1;
+        seq->nstarted++;
+    }
+
+    // every thread exists, all of them can reach the barrier
+    for(i=0; i<seq->nservices; i++)
+        seqr_post(&seq->services[i].rel);
+
+    return 0;
+}
+
+
+int seq_tick(sequencer_t *seq)
+{
+    int i, released=0;
+    service_t *svc, *member;
+
+    RTT_TICK(seq->tick);
+
+    // nothing due is one compare of the heap root, and a service is due at
+    // most once a tick so due[] never holds more than nservices
+    while((svc=&seq->services[seq->heap[0]])->next_release <= seq->tick)
+    {
+        // a rate group is one release of its leader's thread, each
+        // member still stamped as released on this tick
+        for(member=svc; member != NULL; member=member->group_next)
+        {
+            if(member->stats) svc_stats_post(member->stats);
+            RTT_POST(member->desc->name, seq->tick);
+            member->next_release+=member->desc->divisor;
+        }
+        seqr_publish(&svc->rel);
+
+        seq->due[released++]=svc->idx;
+        sift_down(seq, 0);
+    }
+
+    // wake-ups in priority order, after every release is visible
+    for(i=0; i<released; i++)
+        seqr_wake(&seq->services[seq->due[i]].rel);
+
+    seq->tick++;
+
+    return released;
+}
+
+
+void seq_join(sequencer_t *seq)
+{
+    int i;
+
+    for(i=0; i<seq->nslots; i++)
+    {
+        if(!seq->services[i].started) continue;
+
+        if(pthread_join(seq->services[i].thread, (void **)0) != 0)
+            perror("seq_join pthread_join");
+        seq->services[i].started=0;
+    }
+
+    seq->nstarted=0;
+}
+
+
+void seq_shutdown(sequencer_t *seq)
+{
+    int i;
+
+    for(i=0; i<seq->nslots; i++)
+    {
+        seq->services[i].abort=1;
+        seqr_post(&seq->services[i].rel);
+    }
+
+    for(i=0; i<seq->nslots; i++)
+    {
+        if(seq->services[i].started && pthread_join(seq->services[i].thread, (void **)0) != 0)
+            perror("seq_shutdown pthread_join");
+    }
+
+    for(i=0; i<seq->nslots; i++)
+        seqr_destroy(&seq->services[i].rel);
+
+    // every thread is joined, so nothing runs on the arena any more
+    rts_report(&seq->stacks);
+    rts_arena_free(&seq->stacks);
+
+    free(seq->due);
+    free(seq->heap);
+    free(seq->services);
+}
@@ -0,0 +1,182 @@
+#ifndef _SEQTABLE_
+#define _SEQTABLE_
+
+// Table-driven generic sequencer
+//
+// Services are rows of a service_desc_t table rather than hand written
+// Service_N functions with their own semS/abortS globals.  Every service
+// thread runs the same body: wait for release, count it, call the row's
+// work function.
+//
+// Each service keeps the sequencer tick of its next release and the
+// services sit in a min-heap on that tick, so seq_tick() only looks at the
+// root when nothing is due and costs O(log N) per service it releases,
+// instead of a modulo per service per tick.
+//
+// Service i is released on every tick that is a multiple of its divisor,
+// starting with tick 0, the same releases as "if((seqCnt % k) == 0)".
+// Releases use the seqrelease.h primitive picked at seq_init(), and
+// seq_tick() publishes every release due on the tick before making any of
+// the wake-up calls.
+//
+// A service with its stats pointer set gets its release latency, execution
+// and response times recorded in it, see svcstats.h.
+//
+// Standby slots reserved with seq_init_spare() get their threads from
+// seq_start() like the table rows, blocked on their release at the lowest
+// SCHED_FIFO priority.  seq_activate() hands the next one a row at run
+// time, so a service added by admission control (seqadmit.h) never waits
+// on pthread_create.
+//
+// seq_start_deadline() runs the same table with no sequencer at all: each
+// service asks for SCHED_DEADLINE with runtime C, deadline D and period T
+// taken from its row, and gives up the rest of each period with
+// sched_yield(), which the kernel treats as the end of that job.
+//
+// seq_group_rates() folds the services that share a period and a core into
+// rate groups, as the "if((seqCnt % 100) == 0)" services of seqgen2.c or
+// the three "% 30" ones of seqgen.c.  The highest priority service of a
+// group keeps its thread and heap entry and runs every member's work back
+// to back on each release, in priority order, so a group costs one
+// wake-up and one context switch per period instead of one per service.
+// The members are still released, stamped and counted one by one, so
+// their svcstats latency is from the tick to the start of their own work.
+// Under RM the members of a group have the same rate and so the same
+// place in the priority order; services of other rates still preempt the
+// group, and the group runs at the priority of its first member.
+//
+// Every service thread, standby slots included, runs on a stack of its
+// row's size, SEQ_STACK_SIZE if it has none, carved from one arena that
+// seq_start() maps for all of them (rtstack.h), so a table of hundreds of
+// services locks a few megabytes rather than 8 MB a thread.  A service
+// admitted into a standby slot runs on the slot's SEQ_STACK_SIZE stack.
+// seq_shutdown() prints how deep each stack went.
+//
+
+#include <pthread.h>
+
+#include "seqrelease.h"
+#include "svcstats.h"
+#include "rtstack.h"
+
+#define SEQ_ANY_CORE (-1)
+
+// stack of a row with none, and of every standby slot
+#define SEQ_STACK_SIZE (64*1024)
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE (6)
+#endif
+
+struct service;
+struct sequencer;
+
+typedef void (*service_fn_t)(struct service *svc);
+
+typedef struct
+{
+    const char *name;           // used in log lines, e.g. "S1 50 Hz"
+    unsigned int divisor;       // period T in sequencer ticks
+    unsigned int wcet;          // C in ticks, the SCHED_DEADLINE runtime
+    unsigned int deadline;      // D in ticks, 0 for D=T
+    int priority;               // SCHED_FIFO priority
+    int core;                   // default core, SEQ_ANY_CORE for none
+    service_fn_t work;          // called once per release
+    size_t stack;               // thread stack bytes, 0 for SEQ_STACK_SIZE
+} service_desc_t;
+
+typedef struct service
+{
+    const service_desc_t *desc;
+    int idx;
+    int core;                   // desc->core unless changed before seq_start
+
+    seqrel_t rel;
+    volatile int abort;
+    svc_stats_t *stats;         // NULL for none
+
+    unsigned long long next_release;    // sequencer owned
+    unsigned long long releases;        // service owned
+
+    // ticks of C this work call is for, all of it except in a sliced
+    // cyclic executive job (seqcyclic.h), which also sets resume on every
+    // slice after the first
+    unsigned int budget;
+    int resume;
+
+    // rate group, see seq_group_rates(); a member has no thread of its
+    // own and is run by the leader, next is the following lower priority
+    // member of the group
+    struct service *group_next;
+    int grouped;
+
+    pthread_t thread;
+    int started;
+    struct sequencer *seq;
+} service_t;
+
+typedef struct sequencer
+{
+    service_t *services;
+    int nservices;              // active, rows and activated standby slots
+    int nslots;                 // nservices plus standby slots left
+    int nstarted;               // threads created by seq_start
+    int ngroups;                // rate groups of more than one service
+
+    int *heap;                  // service indices ordered by next_release
+    int nheap;                  // nservices less the rate group members
+    int *due;                   // services released on the current tick
+    unsigned long long tick;
+
+    // SCHED_DEADLINE mode only
+    long tick_ns;
+    unsigned long long periods;
+    pthread_barrier_t dl_start;
+
+    rts_arena_t stacks;         // of every thread seq_start created
+} sequencer_t;
+
+// Build the services and release heap for n table rows, released with
+// mode, returns 0 or -1
+int seq_init(sequencer_t *seq, const service_desc_t *table, int n, seqr_mode_t mode);
+
+// Same with nspare standby slots after the n rows
+int seq_init_spare(sequencer_t *seq, const service_desc_t *table, int n, int nspare, seqr_mode_t mode);
+
+// Fold the table rows that have the same period and core into rate groups
+// run by one thread each, see above.  Call after the cores are set and
+// before seq_start(); standby slots are never grouped.  Returns the number
+// of services that were folded into another's thread.
+int seq_group_rates(sequencer_t *seq);
+
+// Create one SCHED_FIFO thread per service and standby slot, each blocked
+// awaiting release, none for rate group members
+int seq_start(sequencer_t *seq);
+
+// Give the next standby slot row desc, its thread switched to the row's
+// priority and core, first released on the first tick from the current
+// one on that is a multiple of its divisor.  Call from the sequencer thread between seq_tick()
+// calls.  Returns the service index, -1 with no slot left.
+int seq_activate(sequencer_t *seq, const service_desc_t *desc);
+
+// Create one SCHED_DEADLINE thread per service instead, each releasing
+// itself every period until periods ticks of tick_ns have gone by, i.e. the
+// same number of releases as seq_start() plus periods seq_tick() calls.
+// Needs root, and SCHED_DEADLINE threads cannot be pinned to one core.
+// Not with rate groups, every service has its own deadline server.  When a
+// thread cannot be created, the ones already started are joined before it
+// returns -1.
+int seq_start_deadline(sequencer_t *seq, long tick_ns, unsigned long long periods);
+
+// Release every service due on the current tick, then advance the tick,
+// returns how many service threads were released, a rate group being one
+int seq_tick(sequencer_t *seq);
+
+// Join service threads that end on their own, i.e. SCHED_DEADLINE mode
+void seq_join(sequencer_t *seq);
+
+// Abort and join all service threads, report their stacks and free the
+// tables
+void seq_shutdown(sequencer_t *seq);
+
+#endif
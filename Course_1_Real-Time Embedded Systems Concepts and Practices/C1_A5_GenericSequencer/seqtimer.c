@@ -0,0 +1,241 @@
+// Periodic timing backend for the sequencer, see seqtimer.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "seqtimer.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+
+static const char *mode_names[] = {"abs", "timerfd", "hybrid", "adaptive", "adaptive-sleep"};
+
+
+static long long ts_nsec(const struct timespec *ts)
+{
+    return (long long)ts->tv_sec*NANOSEC_PER_SEC + ts->tv_nsec;
+}
+
+
+static void ts_add(struct timespec *ts, long long nsec)
+{
+    nsec+=ts->tv_nsec;
+    ts->tv_sec+=nsec/NANOSEC_PER_SEC;
+    ts->tv_nsec=nsec%NANOSEC_PER_SEC;
+
+    if(ts->tv_nsec < 0)
+    {
+        ts->tv_nsec+=NANOSEC_PER_SEC;
+        ts->tv_sec--;
+    }
+}
+
+
+int seqt_mode(const char *name)
+{
+    int i;
+
+    for(i=0; i<(int)(sizeof(mode_names)/sizeof(mode_names[0])); i++)
+        if(strcmp(name, mode_names[i]) == 0) return i;
+
+    return -1;
+}
+
+
+const char *seqt_mode_name(seqt_mode_t mode)
+{
+    return mode_names[mode];
+}
+
+
+int seqt_init(seqtimer_t *t, seqt_mode_t mode, long period_ns, long spin_ns)
+{
+    struct itimerspec itime;
+
+    memset(t, 0, sizeof(seqtimer_t));
+    t->mode=mode;
+    t->period_ns=period_ns;
+    t->spin_ns=(spin_ns < period_ns) ? spin_ns : period_ns;
+    t->fd=-1;
+
+    clock_gettime(SEQT_CLOCK, &t->next);
+    ts_add(&t->next, period_ns);
+
+    // spin_ns is only the first guess, the first sleeps measure the rest
+    t->over_mean_ns=(mode == SEQT_ADAPTIVE_SLEEP) ? 0 : t->spin_ns/2;
+    t->over_dev_ns=(mode == SEQT_ADAPTIVE_SLEEP) ? 0 : t->spin_ns/8;
+    t->offset_ns=(mode == SEQT_ADAPTIVE_SLEEP) ? 0 : t->spin_ns;
+    t->min_late_ns=period_ns;
+
+    if(mode == SEQT_TIMERFD)
+    {
+        if((t->fd=timerfd_create(SEQT_CLOCK, 0)) < 0)
+        {
+            perror("seqt_init timerfd_create");
+            return -1;
+        }
+
+        itime.it_value=t->next;
+        itime.it_interval.tv_sec=period_ns/NANOSEC_PER_SEC;
+        itime.it_interval.tv_nsec=period_ns%NANOSEC_PER_SEC;
+
+        if(timerfd_settime(t->fd, TFD_TIMER_ABSTIME, &itime, (struct itimerspec *)0) < 0)
+        {
+            perror("seqt_init timerfd_settime");
+            close(t->fd);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static void sleep_until(const struct timespec *ts)
+{
+    int rc;
+
+    // restart on signals, the deadline is absolute so nothing drifts
+    while((rc=clock_nanosleep(SEQT_CLOCK, TIMER_ABSTIME, ts, (struct timespec *)0)) == EINTR);
+
+    if(rc != 0)
+    {
+        printf("seqt clock_nanosleep failed, rc=%d\n", rc);
+        exit(-1);
+    }
+}
+
+
+// fold the overshoot of the last sleep into the estimate and set the
+// offset for the next one, at most half a period early
+static void adapt(seqtimer_t *t, long long over)
+{
+    long long err, limit=t->period_ns/2, cap=2*t->offset_ns + SEQT_ADAPT_GUARD_NSEC;
+
+    // one preempted wake-up should not cost many periods of spinning, so a
+    // sample counts for at most twice the offset; a board that really got
+    // slower still doubles the offset every tick or so until it fits
+    if(over > cap) over=cap;
+    if(over < 0) over=0;
+
+    err=over - t->over_mean_ns;
+    t->over_mean_ns+=err >> SEQT_ADAPT_MEAN_SHIFT;
+    t->over_dev_ns+=((err < 0 ? -err : err) - t->over_dev_ns) >> SEQT_ADAPT_DEV_SHIFT;
+
+    if(t->mode == SEQT_ADAPTIVE)
+        t->offset_ns=t->over_mean_ns + 4*t->over_dev_ns + SEQT_ADAPT_GUARD_NSEC;
+    else
+        t->offset_ns=t->over_mean_ns;
+
+    if(t->offset_ns > limit) t->offset_ns=limit;
+    if(t->offset_ns > t->max_offset_ns) t->max_offset_ns=t->offset_ns;
+}
+
+
+int seqt_wait(seqtimer_t *t)
+{
+    struct timespec now, early;
+    unsigned long long expirations;
+    long long late;
+    int n=1;
+
+    switch(t->mode)
+    {
+        case SEQT_TIMERFD:
+            while(read(t->fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+            {
+                if(errno != EINTR)
+                {
+                    perror("seqt read timerfd");
+                    exit(-1);
+                }
+            }
+            n=(int)expirations;
+
+            // keep next in step with the kernel so lateness is measured
+            // against the tick just taken
+            ts_add(&t->next, (long long)(n-1)*t->period_ns);
+            clock_gettime(SEQT_CLOCK, &now);
+            break;
+
+        case SEQT_HYBRID:
+            early=t->next;
+            ts_add(&early, -t->spin_ns);
+            sleep_until(&early);
+
+            do
+                clock_gettime(SEQT_CLOCK, &now);
+            while(ts_nsec(&now) < ts_nsec(&t->next));
+            break;
+
+        case SEQT_ADAPTIVE:
+        case SEQT_ADAPTIVE_SLEEP:
+            early=t->next;
+            ts_add(&early, -t->offset_ns);
+            sleep_until(&early);
+
+            clock_gettime(SEQT_CLOCK, &now);
+            adapt(t, ts_nsec(&now) - ts_nsec(&early));
+
+            if(t->mode == SEQT_ADAPTIVE)
+                while(ts_nsec(&now) < ts_nsec(&t->next))
+                    clock_gettime(SEQT_CLOCK, &now);
+            break;
+
+        case SEQT_ABS:
+        default:
+            sleep_until(&t->next);
+            clock_gettime(SEQT_CLOCK, &now);
+            break;
+    }
+
+    late=ts_nsec(&now) - ts_nsec(&t->next);
+
+    // woke a period or more late, those ticks are gone, step past them
+    // rather than sleeping zero times to catch up
+    if(t->mode != SEQT_TIMERFD && late >= t->period_ns)
+    {
+        n+=(int)(late/t->period_ns);
+        ts_add(&t->next, (late/t->period_ns)*t->period_ns);
+    }
+
+    if(late > t->max_late_ns) t->max_late_ns=late;
+    if(late < t->min_late_ns) t->min_late_ns=late;
+    t->sum_late_ns+=late;
+
+    ts_add(&t->next, t->period_ns);
+    t->ticks+=n;
+    t->missed+=n-1;
+
+    return n;
+}
+
+
+void seqt_close(seqtimer_t *t)
+{
+    if(t->fd >= 0)
+        close(t->fd);
+
+    t->fd=-1;
+}
+
+
+void seqt_report(seqtimer_t *t)
+{
+    unsigned long long waits=t->ticks - t->missed;
+
+    printf("timer %s: %llu ticks, %llu missed, wake-up late avg %.3lf usec, max %.3lf usec\n",
+           seqt_mode_name(t->mode), t->ticks, t->missed,
+           waits ? (double)t->sum_late_ns/waits/1000.0 : 0.0, (double)t->max_late_ns/1000.0);
+
+    if(t->mode == SEQT_ADAPTIVE || t->mode == SEQT_ADAPTIVE_SLEEP)
+        printf("timer %s: wake-up %.3lf .. %.3lf usec from the tick, sleep overshoot %.3lf +/- %.3lf usec, early by %.3lf usec (max %.3lf)\n",
+               seqt_mode_name(t->mode), (double)t->min_late_ns/1000.0, (double)t->max_late_ns/1000.0,
+               (double)t->over_mean_ns/1000.0, (double)t->over_dev_ns/1000.0,
+               (double)t->offset_ns/1000.0, (double)t->max_offset_ns/1000.0);
+}
@@ -0,0 +1,95 @@
+#ifndef _SEQTIMER_
+#define _SEQTIMER_
+
+// Periodic timing backend for the sequencer
+//
+// All modes keep an absolute next-tick time advanced by next += period, so
+// a late wake-up never shifts the following ticks:
+//
+//    abs     clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, next)
+//    timerfd periodic timerfd, the kernel counts expirations for us
+//    hybrid  abs sleep to spin_ns before next, then spin on clock_gettime,
+//            for jitter below the timer slack at the cost of a busy core
+//    adaptive
+//            hybrid with the early wake-up learned instead of set: the
+//            overshoot of every abs sleep (timer slack, IRQ and scheduling
+//            latency) is tracked as an EWMA mean and mean deviation, gains
+//            1/8 and 1/4 as in TCP's RTT estimator, and the next sleep
+//            ends mean + 4 deviations + SEQT_ADAPT_GUARD_NSEC early, so
+//            the spin that follows is only as long as this board needs
+//    adaptive-sleep
+//            the same estimate with no spin, every sleep ends the mean
+//            overshoot early, so wake-ups centre on the tick at no CPU cost
+//            and the jitter is the spread of the overshoot
+//
+// Neither adaptive mode needs a per-board constant like seqgen.h's
+// CLOCK_BIAS_NANOSEC or the -j spin window; the first sleeps use spin_ns
+// as the offset and the estimate takes over within a few dozen ticks.
+//
+// seqt_wait() returns how many periods have elapsed since the previous
+// call, normally 1.  Anything more is counted as missed ticks.
+//
+
+#include <time.h>
+
+#define SEQT_CLOCK CLOCK_MONOTONIC
+
+// default hybrid spin window, 100 usec
+#define SEQT_SPIN_NSEC (100000)
+
+// adaptive spins at least this long, 2 usec, so a wake-up right at the
+// estimate is still early
+#define SEQT_ADAPT_GUARD_NSEC (2000)
+
+// EWMA gains as shifts, 1/8 for the mean and 1/4 for the deviation
+#define SEQT_ADAPT_MEAN_SHIFT (3)
+#define SEQT_ADAPT_DEV_SHIFT (2)
+
+typedef enum
+{
+    SEQT_ABS,
+    SEQT_TIMERFD,
+    SEQT_HYBRID,
+    SEQT_ADAPTIVE,
+    SEQT_ADAPTIVE_SLEEP
+} seqt_mode_t;
+
+typedef struct
+{
+    seqt_mode_t mode;
+    long period_ns;
+    long spin_ns;
+    int fd;
+
+    struct timespec next;
+
+    unsigned long long ticks;       // periods elapsed
+    unsigned long long missed;      // periods that were not waited for
+    long long max_late_ns;          // worst wake-up after the tick
+    long long sum_late_ns;
+
+    // adaptive modes, sleep overshoot estimate and the offset it gives
+    long long min_late_ns;          // earliest, negative when before the tick
+    long long over_mean_ns, over_dev_ns;
+    long long offset_ns;
+    long long max_offset_ns;
+} seqtimer_t;
+
+// Start a timer whose first tick is one period from now, returns 0 or -1
+int seqt_init(seqtimer_t *t, seqt_mode_t mode, long period_ns, long spin_ns);
+
+// Block until the next tick, returns the number of periods elapsed
+int seqt_wait(seqtimer_t *t);
+
+void seqt_close(seqtimer_t *t);
+
+// Print ticks, missed ticks and wake-up lateness, and for the adaptive
+// modes the early wake-up offset they settled on
+void seqt_report(seqtimer_t *t);
+
+// "abs", "timerfd", "hybrid", "adaptive" or "adaptive-sleep" to a mode,
+// -1 if unknown
+int seqt_mode(const char *name);
+const char *seqt_mode_name(seqt_mode_t mode);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef _SVCSTATS_
+#define _SVCSTATS_
+
+// Per-service release latency, execution time and response time
+//
+//    latency   sem_post by the sequencer -> service wakes from sem_wait
+//    exec      wake -> release work done
+//    response  sem_post -> release work done
+//
+// Each is kept in a fixed log-scale histogram, 4 buckets per power of two
+// of nanoseconds (at most 25% bucket width), so recording is a few integer
+// ops with no allocation or locking.  The sequencer side only stamps the
+// post time into a small ring indexed by release number, which the service
+// reads after sem_wait, so a service that falls behind by less than
+// SVC_POST_RING releases still gets the latency of its own release.
+//
+// Stamps are cycle counter reads (tstamp.h), a few ns each where there is
+// a usable counter, calibrated by the first svc_stats_init().
+//
+// A service given a relative deadline with svc_stats_deadline() also counts
+// the releases whose response time went past it, so a run shows directly
+// whether a workload fits its period, not just how close its WCET came.
+//
+
+#include "tstamp.h"
+
+#define SVC_HIST_SUB (4)
+#define SVC_HIST_BUCKETS (40*SVC_HIST_SUB)
+#define SVC_POST_RING (16)
+
+typedef struct
+{
+    unsigned long long count[SVC_HIST_BUCKETS];
+    unsigned long long n;
+    long long sum, max;
+} svc_hist_t;
+
+typedef struct
+{
+    const char *name;
+
+    // sequencer side
+    volatile unsigned long long posts;
+    ts_t post_ts[SVC_POST_RING];
+
+    // service side
+    unsigned long long release;
+    ts_t wake_ts;
+    int valid;
+
+    svc_hist_t latency, exec, response;
+
+    long long deadline_ns;              // 0 for none
+    unsigned long long misses;          // responses past deadline_ns
+} svc_stats_t;
+
+void svc_stats_init(svc_stats_t *st, const char *name);
+
+// relative deadline D of every release, from sem_post, 0 for none
+void svc_stats_deadline(svc_stats_t *st, long long deadline_ns);
+
+// sequencer, call just before sem_post for the release
+void svc_stats_post(svc_stats_t *st);
+
+// service, call right after sem_wait returns with its release count,
+// then once the release work is done
+void svc_stats_wake(svc_stats_t *st, unsigned long long release);
+void svc_stats_done(svc_stats_t *st);
+
+// value below which fraction p of the samples fall, to bucket resolution
+long long svc_hist_percentile(const svc_hist_t *h, double p);
+
+// print a latency / execution (WCET) / response p99 and max table, and
+// the deadline misses of the services that have a deadline
+void svc_stats_report(svc_stats_t *st, int n);
+
+#endif
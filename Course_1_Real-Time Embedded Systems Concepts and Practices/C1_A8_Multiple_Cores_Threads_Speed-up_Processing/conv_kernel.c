@@ -0,0 +1,318 @@
+// NxN convolution engine - see conv_kernel.h
+//
+// The rows functions come from conv_kernel_tmpl.h, included once for each
+// specialized size and once more for the generic one.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "conv_kernel.h"
+
+// output pixels per column strip, int accumulators for a strip and the
+// separable ring of CONV_MAX_N rows fit in L1 and on a worker stack
+#define CONV_CHUNK (128)
+
+#define CONV_CAT_(a, b) a##b
+#define CONV_CAT(a, b) CONV_CAT_(a, b)
+
+#define K_INT ((int)(K))
+
+
+static inline void conv_store(UINT8 *dst, const int *acc, int n, int shift)
+{
+    int x, t;
+
+    for(x=0; x<n; x++)
+    {
+        t=acc[x] >> shift;
+        dst[x]=(t < 0) ? 0 : ((t > 255) ? 255 : t);
+    }
+}
+
+
+#define CONV_N 3
+#define CONV_SUFFIX 3
+#include "conv_kernel_tmpl.h"
+#undef CONV_N
+#undef CONV_SUFFIX
+
+#define CONV_N 5
+#define CONV_SUFFIX 5
+#include "conv_kernel_tmpl.h"
+#undef CONV_N
+#undef CONV_SUFFIX
+
+#define CONV_N 7
+#define CONV_SUFFIX 7
+#include "conv_kernel_tmpl.h"
+#undef CONV_N
+#undef CONV_SUFFIX
+
+// any odd size up to CONV_MAX_N, taken from the filter at run time
+#define CONV_N (f->n)
+#define CONV_SUFFIX _n
+#include "conv_kernel_tmpl.h"
+#undef CONV_N
+#undef CONV_SUFFIX
+
+
+// [impl][size], size 0 the generic one, then 3, 5, 7
+static const conv_rows_fn_t conv_rows[4][4]=
+{
+    {NULL, NULL, NULL, NULL},
+    {conv_rows_direct_n, conv_rows_direct3, conv_rows_direct5, conv_rows_direct7},
+    {conv_rows_symmetric_n, conv_rows_symmetric3, conv_rows_symmetric5, conv_rows_symmetric7},
+    {conv_rows_separable_n, conv_rows_separable3, conv_rows_separable5, conv_rows_separable7},
+};
+
+static const char *impl_name[4]={"auto", "direct", "symmetric", "separable"};
+
+
+// sharpen3 is the integer PSF, (8(K+1)c - K*sum8) >> 3
+static void fill_sharpen3(conv_filter_t *f)
+{
+    int i;
+
+    for(i=0; i<9; i++)
+        f->taps[i]=-K_INT;
+    f->taps[4]=8*(K_INT+1);
+}
+
+
+// outer product of the binomial row of n, sums to 4^(n-1)
+static void fill_binomial(conv_filter_t *f)
+{
+    int b[CONV_MAX_N], i, j;
+
+    for(b[0]=1, i=1; i<f->n; i++)
+        for(b[i]=0, j=i; j>0; j--)
+            b[j]+=b[j-1];
+    for(i=0; i<f->n; i++)
+        for(j=0; j<f->n; j++)
+            f->taps[i*f->n + j]=b[i]*b[j];
+}
+
+
+// Gaussians as binomial taps, unsharp as 2 x centre - Gaussian over the
+// same power of two, larger ones are filled in by conv_filter_find()
+#define G3 {1,2,1, 2,4,2, 1,2,1}
+#define G5 {1,4,6,4,1, 4,16,24,16,4, 6,24,36,24,6, 4,16,24,16,4, 1,4,6,4,1}
+#define G7 {1,6,15,20,15,6,1, 6,36,90,120,90,36,6, 15,90,225,300,225,90,15, 20,120,300,400,300,120,20, \
+            15,90,225,300,225,90,15, 6,36,90,120,90,36,6, 1,6,15,20,15,6,1}
+#define U5 {-1,-4,-6,-4,-1, -4,-16,-24,-16,-4, -6,-24,476,-24,-6, -4,-16,-24,-16,-4, -1,-4,-6,-4,-1}
+#define U7 {-1,-6,-15,-20,-15,-6,-1, -6,-36,-90,-120,-90,-36,-6, -15,-90,-225,-300,-225,-90,-15, \
+            -20,-120,-300,7792,-300,-120,-20, \
+            -15,-90,-225,-300,-225,-90,-15, -6,-36,-90,-120,-90,-36,-6, -1,-6,-15,-20,-15,-6,-1}
+
+conv_filter_t conv_filters[]=
+{
+    {.name="sharpen3", .n=3, .bias=0, .shift=3, .fill=fill_sharpen3},
+    {.name="gauss3", .n=3, .taps=G3, .bias=8, .shift=4},
+    {.name="gauss5", .n=5, .taps=G5, .bias=128, .shift=8},
+    {.name="gauss7", .n=7, .taps=G7, .bias=2048, .shift=12},
+    {.name="gauss9", .n=9, .bias=32768, .shift=16, .fill=fill_binomial},
+    {.name="unsharp5", .n=5, .taps=U5, .bias=128, .shift=8},
+    {.name="unsharp7", .n=7, .taps=U7, .bias=2048, .shift=12},
+    {.name=NULL}
+};
+
+
+static int gcd(int a, int b)
+{
+    int t;
+
+    if(a < 0) a=-a;
+    if(b < 0) b=-b;
+    while(b)
+    {
+        t=a % b; a=b; b=t;
+    }
+    return a;
+}
+
+
+// taps = col x row / pivot, exactly, with the common factors taken out of
+// col and row into the pivot so it is 1 whenever it can be
+static int find_separable(conv_filter_t *f)
+{
+    int n=f->n, i, j, pi=0, pj=0, g;
+
+    // the largest tap as the pivot
+    for(i=0; i<n*n; i++)
+        if(abs(f->taps[i]) > abs(f->taps[pi*n + pj]))
+        {
+            pi=i / n; pj=i % n;
+        }
+    if((f->pivot=f->taps[pi*n + pj]) == 0)
+        return 0;
+
+    // rank one: every 2x2 minor through the pivot vanishes
+    for(i=0; i<n; i++)
+        for(j=0; j<n; j++)
+            if((long long)f->taps[i*n + j]*f->pivot != (long long)f->taps[i*n + pj]*f->taps[pi*n + j])
+                return 0;
+
+    for(i=0; i<n; i++)
+    {
+        f->col[i]=f->taps[i*n + pj];
+        f->row[i]=f->taps[pi*n + i];
+    }
+
+    for(g=0, i=0; i<n; i++) g=gcd(g, f->col[i]);
+    if(g > 1 && f->pivot % g == 0)
+    {
+        for(i=0; i<n; i++) f->col[i]/=g;
+        f->pivot/=g;
+    }
+    for(g=0, i=0; i<n; i++) g=gcd(g, f->row[i]);
+    if(g > 1 && f->pivot % g == 0)
+    {
+        for(i=0; i<n; i++) f->row[i]/=g;
+        f->pivot/=g;
+    }
+    if(f->pivot < 0)
+    {
+        for(i=0; i<n; i++) f->col[i]=-f->col[i];
+        f->pivot=-f->pivot;
+    }
+    return 1;
+}
+
+
+int conv_filter_init(conv_filter_t *f, int impl)
+{
+    int n=f->n, i, j, size;
+
+    if(n < 1 || n > CONV_MAX_N || (n & 1) == 0)
+    {
+        printf("%s: %dx%d, filters are odd sizes up to %d\n", f->name, n, n, CONV_MAX_N);
+        return -1;
+    }
+
+    for(f->symmetric=1, i=0; i<n; i++)
+        for(j=0; j<n; j++)
+            if(f->taps[i*n + j] != f->taps[(n-1-i)*n + j] || f->taps[i*n + j] != f->taps[i*n + (n-1-j)])
+                f->symmetric=0;
+    f->separable=find_separable(f);
+
+    if(impl == CONV_AUTO)
+        impl=f->separable ? CONV_SEPARABLE : (f->symmetric ? CONV_SYMMETRIC : CONV_DIRECT);
+    if((impl == CONV_SEPARABLE && !f->separable) || (impl == CONV_SYMMETRIC && !f->symmetric))
+    {
+        printf("%s taps are not %s\n", f->name, impl_name[impl]);
+        return -1;
+    }
+
+    size=(n == 3) ? 1 : ((n == 5) ? 2 : ((n == 7) ? 3 : 0));
+    f->impl=impl;
+    f->rows=conv_rows[impl][size];
+    return 0;
+}
+
+
+const char *conv_impl_name(int impl)
+{
+    return (impl >= 0 && impl < 4) ? impl_name[impl] : "unknown";
+}
+
+
+conv_filter_t *conv_filter_find(const char *spec)
+{
+    char name[32], *sep;
+    int i, impl=CONV_AUTO;
+
+    snprintf(name, sizeof(name), "%s", spec);
+    if((sep=strchr(name, ':')) != NULL)
+    {
+        *sep++='\0';
+        for(impl=1; impl<4; impl++)
+            if(strcmp(sep, impl_name[impl]) == 0) break;
+        if(impl == 4)
+        {
+            printf("unknown implementation %s, direct, symmetric or separable\n", sep);
+            return NULL;
+        }
+    }
+
+    for(i=0; conv_filters[i].name != NULL; i++)
+    {
+        if(strcmp(name, conv_filters[i].name) != 0)
+            continue;
+        if(conv_filters[i].fill != NULL)
+            conv_filters[i].fill(&conv_filters[i]);
+        return (conv_filter_init(&conv_filters[i], impl) == 0) ? &conv_filters[i] : NULL;
+    }
+
+    printf("unknown filter %s:", name);
+    for(i=0; conv_filters[i].name != NULL; i++)
+        printf(" %s", conv_filters[i].name);
+    printf("\n");
+    return NULL;
+}
+
+
+static int plane_diff(const UINT8 *a, const UINT8 *b, int width, int height, int r)
+{
+    int i, j, diff=0;
+
+    for(i=r; i<height-r; i++)
+        for(j=r; j<width-r; j++)
+            if(a[i*width + j] != b[i*width + j]) diff++;
+    return diff;
+}
+
+
+int conv_filter_verify(const UINT8 *plane, int width, int height)
+{
+    UINT8 *ref, *out;
+    conv_filter_t *f;
+    int i, y, impl, r, diff, failed=0;
+
+    ref=calloc((size_t)width*height, 1);
+    out=calloc((size_t)width*height, 1);
+    if(ref == NULL || out == NULL)
+    {
+        printf("Error allocating verify planes\n");
+        free(ref); free(out);
+        return 1;
+    }
+
+    for(i=0; conv_filters[i].name != NULL; i++)
+    {
+        if((f=conv_filter_find(conv_filters[i].name)) == NULL || height < f->n || width < f->n)
+            continue;
+        r=f->n/2;
+
+        conv_filter_init(f, CONV_DIRECT);
+        conv_plane_tile(f, plane, ref, width, r, r, height-2*r, width-2*r);
+
+        for(impl=CONV_SYMMETRIC; impl<=CONV_SEPARABLE; impl++)
+        {
+            if(impl == CONV_SYMMETRIC ? !f->symmetric : !f->separable)
+                continue;
+            conv_filter_init(f, impl);
+            memset(out, 0, (size_t)width*height);
+            conv_plane_tile(f, plane, out, width, r, r, height-2*r, width-2*r);
+            diff=plane_diff(ref, out, width, height, r);
+            printf("%-9s %-10s %8d pixels differ from direct\n", f->name, impl_name[impl], diff);
+            if(diff) failed++;
+        }
+
+        // the engine's PSF against the double reference
+        if(strcmp(f->name, "sharpen3") == 0 && K == (FLOAT)K_INT)
+        {
+            for(y=1; y<height-1; y++)
+                sharpen_row_psf(&plane[(y-1)*width + 1], &plane[y*width + 1], &plane[(y+1)*width + 1], &out[y*width + 1], width-2);
+            diff=plane_diff(ref, out, width, height, 1);
+            printf("%-9s %-10s %8d pixels differ from psf\n", f->name, "direct", diff);
+            if(diff) failed++;
+        }
+
+        conv_filter_init(f, CONV_AUTO);
+    }
+
+    free(ref);
+    free(out);
+    return failed;
+}
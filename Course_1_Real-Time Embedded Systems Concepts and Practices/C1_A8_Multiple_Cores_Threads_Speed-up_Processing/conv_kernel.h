@@ -0,0 +1,87 @@
+#ifndef _CONV_KERNEL_
+#define _CONV_KERNEL_
+
+// NxN convolution of one colour plane, for filters other than the 3x3 PSF
+//
+// A filter is n x n integer taps, n odd, and
+//
+//     out = clamp((sum(taps * pixels) + bias) >> shift, 0, 255)
+//
+// so a Gaussian is its binomial taps over a power of two and the 3x3 PSF
+// is its integer form, (8(K+1)c - K*sum8) >> 3, the same as the sharpen
+// row kernels.  conv_filter_init() works out the shape of the taps and
+// picks the fastest exact implementation for it:
+//
+//    separable   taps = col x row, a horizontal then a vertical 1D pass,
+//                2n multiplies a pixel instead of n*n
+//    symmetric   mirror symmetric both ways, the rows and then the columns
+//                that share a tap are added first, (n/2+1)^2 multiplies
+//    direct      any taps
+//
+// Each exists for n = 3, 5 and 7 with n a compile time constant, generated
+// from conv_kernel_tmpl.h, so the tap loops unroll and the pixel loops
+// vectorize; other sizes up to CONV_MAX_N share one generic version.  All
+// of them give the same result bit for bit.
+//
+// Pixels within n/2 of the image edge are not convolved, the same as the
+// one pixel border of the 3x3 PSF.
+
+#include "sharpen_kernel.h"
+
+#define CONV_MAX_N (15)
+
+// conv_filter_init() implementation choice
+#define CONV_AUTO (0)
+#define CONV_DIRECT (1)
+#define CONV_SYMMETRIC (2)
+#define CONV_SEPARABLE (3)
+
+struct _conv_filter;
+
+// rows 0..h-1, columns 0..w-1 from src and dst, both already offset to the
+// first output pixel, stride bytes a row, halo read at negative offsets
+typedef void (*conv_rows_fn_t)(const struct _conv_filter *f, const UINT8 *src, UINT8 *dst, int stride, int h, int w);
+
+typedef struct _conv_filter
+{
+    const char *name;
+    int n;
+    int taps[CONV_MAX_N*CONV_MAX_N];    // n x n, row major
+    int bias, shift;
+    void (*fill)(struct _conv_filter *f);   // sets taps when not a constant table
+
+    // set by conv_filter_init()
+    int symmetric, separable;
+    int col[CONV_MAX_N], row[CONV_MAX_N], pivot;    // taps = col x row / pivot
+    int impl;
+    conv_rows_fn_t rows;
+} conv_filter_t;
+
+// built in filters, "sharpen3", "gauss3", "gauss5", "gauss7", "gauss9",
+// "unsharp5", "unsharp7", a NULL name ends the list
+extern conv_filter_t conv_filters[];
+
+// A built in filter by name, optionally "name:direct", ":symmetric" or
+// ":separable" to force an implementation, initialized, NULL if unknown or
+// the forced implementation does not fit its taps
+conv_filter_t *conv_filter_find(const char *spec);
+
+// Classify f's taps and select the rows function for impl, CONV_AUTO for
+// the fastest that fits, returns 0 or -1 if impl does not fit the taps
+int conv_filter_init(conv_filter_t *f, int impl);
+
+// "direct", "symmetric" or "separable"
+const char *conv_impl_name(int impl);
+
+// Convolve rows i0..i0+h-1, columns j0..j0+w-1 of a plane img_w pixels wide
+static inline void conv_plane_tile(const conv_filter_t *f, const UINT8 *src, UINT8 *dst, int img_w, int i0, int j0, int h, int w)
+{
+    f->rows(f, &src[(size_t)i0*img_w + j0], &dst[(size_t)i0*img_w + j0], img_w, h, w);
+}
+
+// Every implementation of every built in filter over one width x height
+// plane diffed against direct, and sharpen3 against sharpen_row_psf, one
+// line each, returns how many differ
+int conv_filter_verify(const UINT8 *plane, int width, int height);
+
+#endif
@@ -0,0 +1,165 @@
+// NxN convolution rows functions for one kernel size, included by
+// conv_kernel.c once per size with
+//
+//    CONV_N        the size, a constant, or (f->n) for the generic version
+//    CONV_SUFFIX   what the function names end in, 5 -> conv_rows_direct5
+//
+// No include guard, it is meant to be included more than once.
+//
+// The functions sweep the output a CONV_CHUNK wide column strip at a time
+// with int accumulators on the stack, so the pixel loops are plain
+// multiply-adds over short arrays that the compiler vectorizes.
+
+#define CONV_FN(base) CONV_CAT(base, CONV_SUFFIX)
+
+
+// any taps, n*n multiplies a pixel, zero taps skipped
+static void CONV_FN(conv_rows_direct)(const conv_filter_t *f, const UINT8 *src, UINT8 *dst, int stride, int h, int w)
+{
+    int acc[CONV_CHUNK];
+    const int r=CONV_N/2;
+    const UINT8 *s;
+    int y, x0, cw, i, j, x, t;
+
+    for(y=0; y<h; y++)
+    {
+        for(x0=0; x0<w; x0+=CONV_CHUNK)
+        {
+            cw=(w-x0 < CONV_CHUNK) ? w-x0 : CONV_CHUNK;
+            for(x=0; x<cw; x++)
+                acc[x]=f->bias;
+
+            for(i=0; i<CONV_N; i++)
+            {
+                s=&src[(y+i-r)*stride + x0 - r];
+                for(j=0; j<CONV_N; j++)
+                {
+                    if((t=f->taps[i*CONV_N + j]) == 0)
+                        continue;
+                    for(x=0; x<cw; x++)
+                        acc[x]+=t*s[x+j];
+                }
+            }
+
+            conv_store(&dst[y*stride + x0], acc, cw, f->shift);
+        }
+    }
+}
+
+
+// mirror symmetric taps: rows i and n-1-i are added, then in that sum the
+// columns j and n-1-j, before the one multiply they share
+static void CONV_FN(conv_rows_symmetric)(const conv_filter_t *f, const UINT8 *src, UINT8 *dst, int stride, int h, int w)
+{
+    int acc[CONV_CHUNK], sum[CONV_CHUNK+CONV_MAX_N];
+    const int r=CONV_N/2;
+    const UINT8 *a, *b;
+    int y, x0, cw, i, j, x, t;
+
+    for(y=0; y<h; y++)
+    {
+        for(x0=0; x0<w; x0+=CONV_CHUNK)
+        {
+            cw=(w-x0 < CONV_CHUNK) ? w-x0 : CONV_CHUNK;
+            for(x=0; x<cw; x++)
+                acc[x]=f->bias;
+
+            for(i=0; i<=r; i++)
+            {
+                a=&src[(y+i-r)*stride + x0 - r];
+                b=&src[(y+r-i)*stride + x0 - r];
+                if(i < r)
+                    for(x=0; x<cw+CONV_N-1; x++)
+                        sum[x]=a[x]+b[x];
+                else
+                    for(x=0; x<cw+CONV_N-1; x++)
+                        sum[x]=a[x];
+
+                for(j=0; j<r; j++)
+                {
+                    if((t=f->taps[i*CONV_N + j]) == 0)
+                        continue;
+                    for(x=0; x<cw; x++)
+                        acc[x]+=t*(sum[x+j] + sum[x+CONV_N-1-j]);
+                }
+                if((t=f->taps[i*CONV_N + r]) != 0)
+                    for(x=0; x<cw; x++)
+                        acc[x]+=t*sum[x+r];
+            }
+
+            conv_store(&dst[y*stride + x0], acc, cw, f->shift);
+        }
+    }
+}
+
+
+// taps = col x row / pivot: each input row of the strip is filtered by row
+// once, into a ring of the last n, and every output row is col over the
+// ring, the result exactly pivot times the direct sum
+static void CONV_FN(conv_rows_separable)(const conv_filter_t *f, const UINT8 *src, UINT8 *dst, int stride, int h, int w)
+{
+    int acc[CONV_CHUNK], ring[CONV_MAX_N][CONV_CHUNK];
+    const int r=CONV_N/2;
+    const UINT8 *s;
+    int *hr;
+    int k, y, x0, cw, i, j, x, t;
+
+    for(x0=0; x0<w; x0+=CONV_CHUNK)
+    {
+        cw=(w-x0 < CONV_CHUNK) ? w-x0 : CONV_CHUNK;
+
+        // input row k-r of the strip goes to ring[k % n]
+        for(k=0; k < h+CONV_N-1; k++)
+        {
+            s=&src[(k-r)*stride + x0 - r];
+            hr=ring[k % CONV_N];
+
+            for(x=0; x<cw; x++)
+                hr[x]=f->row[r]*s[x+r];
+            for(j=0; j<r; j++)
+            {
+                if(f->symmetric)
+                {
+                    if((t=f->row[j]) != 0)
+                        for(x=0; x<cw; x++)
+                            hr[x]+=t*(s[x+j] + s[x+CONV_N-1-j]);
+                }
+                else
+                {
+                    if((t=f->row[j]) != 0)
+                        for(x=0; x<cw; x++)
+                            hr[x]+=t*s[x+j];
+                    if((t=f->row[CONV_N-1-j]) != 0)
+                        for(x=0; x<cw; x++)
+                            hr[x]+=t*s[x+CONV_N-1-j];
+                }
+            }
+
+            if(k < CONV_N-1)
+                continue;
+
+            // output row y reads input rows y-r .. y+r, ring[y .. y+n-1]
+            y=k-(CONV_N-1);
+            for(x=0; x<cw; x++)
+                acc[x]=0;
+            for(i=0; i<CONV_N; i++)
+            {
+                if((t=f->col[i]) == 0)
+                    continue;
+                hr=ring[(y+i) % CONV_N];
+                for(x=0; x<cw; x++)
+                    acc[x]+=t*hr[x];
+            }
+
+            if(f->pivot != 1)
+                for(x=0; x<cw; x++)
+                    acc[x]/=f->pivot;
+            for(x=0; x<cw; x++)
+                acc[x]+=f->bias;
+
+            conv_store(&dst[y*stride + x0], acc, cw, f->shift);
+        }
+    }
+}
+
+#undef CONV_FN
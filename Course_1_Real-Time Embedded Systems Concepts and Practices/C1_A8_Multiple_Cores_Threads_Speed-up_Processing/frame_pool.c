@@ -0,0 +1,131 @@
+// Persistent worker pool for frame-at-a-time image processing
+//
+// All workers plus the caller meet at frame_start, run their slice of the
+// frame, and meet again at frame_done.  Both are pthread barriers sized
+// nworkers+1, so the caller is the only thread that ever sees a frame boundary.
+//
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/sysinfo.h>
+
+#include "frame_pool.h"
+#include "rtinit.h"
+#include "rttrace.h"
+#include "rtenv.h"
+
+static void *frame_worker(void *threadp)
+{
+    frame_worker_t *w=(frame_worker_t *)threadp;
+    frame_pool_t *pool=w->pool;
+    int perf;
+
+    perf=rte_perf_begin("worker", w->idx);
+
+    while(1)
+    {
+        pthread_barrier_wait(&pool->frame_start);
+
+        if(pool->shutdown) break;
+
+        RTT_TILE_START(w->idx);
+        pool->fn(pool->args[w->idx]);
+        RTT_TILE_END(w->idx);
+
+        pthread_barrier_wait(&pool->frame_done);
+    }
+
+    rte_perf_end(perf);
+    return (void *)0;
+}
+
+
+int frame_pool_create(frame_pool_t *pool, int nworkers, frame_fn_t fn, void **args)
+{
+    return frame_pool_create_cores(pool, nworkers, fn, args, (const int *)0, get_nprocs());
+}
+
+
+int frame_pool_create_cores(frame_pool_t *pool, int nworkers, frame_fn_t fn, void **args, const int *cores, int ncores)
+{
+    int i, rc;
+    pthread_attr_t attr;
+    cpu_set_t cpuset;
+
+    if(nworkers < 1 || nworkers > FRAME_POOL_MAX_WORKERS)
+    {
+        printf("frame_pool: %d workers not supported\n", nworkers);
+        return -1;
+    }
+
+#ifdef RT_TRACE
+    rtt_open();
+#endif
+
+    pool->nworkers=nworkers;
+    pool->shutdown=0;
+    pool->fn=fn;
+
+    pthread_barrier_init(&pool->frame_start, (void *)0, nworkers+1);
+    pthread_barrier_init(&pool->frame_done, (void *)0, nworkers+1);
+
+    for(i=0; i<nworkers; i++)
+    {
+        pool->args[i]=args[i];
+        pool->workers[i].pool=pool;
+        pool->workers[i].idx=i;
+
+        CPU_ZERO(&cpuset);
+        CPU_SET(cores ? cores[i % ncores] : i % ncores, &cpuset);
+
+        pthread_attr_init(&attr);
+        rti_attr_stack(&attr);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+
+        // fall back to an unpinned worker if the core is not in our cpuset
+        if((rc=pthread_create(&pool->threads[i], &attr, frame_worker, (void *)&pool->workers[i])) != 0)
+        {
+            pthread_attr_destroy(&attr);
+            pthread_attr_init(&attr);
+            rti_attr_stack(&attr);
+            rc=pthread_create(&pool->threads[i], &attr, frame_worker, (void *)&pool->workers[i]);
+        }
+
+        pthread_attr_destroy(&attr);
+
+        if(rc != 0)
+        {
+            perror("frame_pool pthread_create");
+            exit(-1);
+        }
+    }
+
+    return 0;
+}
+
+
+void frame_pool_run(frame_pool_t *pool)
+{
+    pthread_barrier_wait(&pool->frame_start);
+    pthread_barrier_wait(&pool->frame_done);
+}
+
+
+void frame_pool_destroy(frame_pool_t *pool)
+{
+    int i;
+
+    pool->shutdown=1;
+    pthread_barrier_wait(&pool->frame_start);
+
+    for(i=0; i<pool->nworkers; i++)
+    {
+        if(pthread_join(pool->threads[i], (void **)0) != 0)
+            perror("frame_pool pthread_join");
+    }
+
+    pthread_barrier_destroy(&pool->frame_start);
+    pthread_barrier_destroy(&pool->frame_done);
+}
@@ -0,0 +1,51 @@
+#ifndef _FRAME_POOL_
+#define _FRAME_POOL_
+
+#include <pthread.h>
+
+// Persistent per-frame worker pool
+//
+// Workers are created once, each pinned to a core, and block on a barrier
+// between frames.  frame_pool_run() releases every worker for one frame and
+// returns when all of them are done, so a frame costs one wakeup per worker
+// instead of a pthread_create/pthread_join pair.
+
+#define FRAME_POOL_MAX_WORKERS (256)
+
+typedef void *(*frame_fn_t)(void *arg);
+
+typedef struct frame_pool frame_pool_t;
+
+typedef struct
+{
+    frame_pool_t *pool;
+    int idx;
+} frame_worker_t;
+
+struct frame_pool
+{
+    int nworkers;
+    int shutdown;
+    frame_fn_t fn;
+    void *args[FRAME_POOL_MAX_WORKERS];
+    pthread_t threads[FRAME_POOL_MAX_WORKERS];
+    pthread_barrier_t frame_start;
+    pthread_barrier_t frame_done;
+    frame_worker_t workers[FRAME_POOL_MAX_WORKERS];
+};
+
+// Create nworkers threads, worker i calls fn(args[i]) once per frame and is
+// pinned to core (i % online cores), returns 0 on success
+int frame_pool_create(frame_pool_t *pool, int nworkers, frame_fn_t fn, void **args);
+
+// Same with worker i pinned to cores[i % ncores] instead, e.g. the isolated
+// service cores of a core map, NULL cores for the online ones
+int frame_pool_create_cores(frame_pool_t *pool, int nworkers, frame_fn_t fn, void **args, const int *cores, int ncores);
+
+// Release all workers for one frame and wait for them to complete
+void frame_pool_run(frame_pool_t *pool);
+
+// Stop and join all workers
+void frame_pool_destroy(frame_pool_t *pool);
+
+#endif
@@ -0,0 +1,238 @@
+// Shared memory frame ring between processes, see frame_shm.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "frame_shm.h"
+
+#define PAGE_ROUND(x) (((x) + 4095) & ~(size_t)4095)
+
+
+// not _PRIVATE, the other side is another process
+static long futex(volatile unsigned int *uaddr, int op, unsigned int val)
+{
+    return syscall(SYS_futex, uaddr, op, val, (void *)0, (void *)0, 0);
+}
+
+
+long long frame_shm_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+
+static void shm_path(frame_shm_t *fs, const char *name)
+{
+    snprintf(fs->name, sizeof(fs->name), "%s%s", (name[0] == '/') ? "" : "/", name);
+}
+
+
+// sleep on *word while it still holds val, flag tells the other side to wake us
+static void ring_sleep(volatile unsigned int *word, volatile unsigned int *flag, unsigned int val)
+{
+    __atomic_store_n(flag, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(word, __ATOMIC_SEQ_CST) == val)
+        futex(word, FUTEX_WAIT, val);
+    __atomic_store_n(flag, 0, __ATOMIC_RELAXED);
+}
+
+
+// store the new count, then wake the other side only if it is asleep
+static void ring_advance(volatile unsigned int *word, volatile unsigned int *flag, unsigned int val)
+{
+    __atomic_store_n(word, val, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(flag, __ATOMIC_SEQ_CST))
+        futex(word, FUTEX_WAKE, 1);
+}
+
+
+int frame_shm_create(frame_shm_t *fs, const char *name, const ppm_header_t *header, int nslots)
+{
+    size_t slot_bytes=(size_t)header->width*header->height*3;
+    int fd;
+
+    memset(fs, 0, sizeof(frame_shm_t));
+    shm_path(fs, name);
+    fs->creator=1;
+
+    if(nslots < 2 || nslots > FRAME_SHM_MAX_SLOTS)
+    {
+        printf("frame_shm: %d slots, 2 to %d\n", nslots, FRAME_SHM_MAX_SLOTS);
+        return -1;
+    }
+
+    fs->size=PAGE_ROUND(sizeof(frame_shm_hdr_t)) + nslots*PAGE_ROUND(slot_bytes);
+
+    // a ring left by a run that did not get to close it is started over
+    shm_unlink(fs->name);
+    if((fd=shm_open(fs->name, O_CREAT|O_EXCL|O_RDWR, 0600)) < 0)
+    {
+        perror("frame_shm shm_open");
+        return -1;
+    }
+    if(ftruncate(fd, fs->size) < 0)
+    {
+        perror("frame_shm ftruncate");
+        close(fd);
+        shm_unlink(fs->name);
+        return -1;
+    }
+
+    fs->hdr=(frame_shm_hdr_t *)mmap(NULL, fs->size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, 0);
+    close(fd);
+    if(fs->hdr == MAP_FAILED)
+    {
+        perror("frame_shm mmap");
+        shm_unlink(fs->name);
+        fs->hdr=NULL;
+        return -1;
+    }
+
+    fs->hdr->nslots=nslots;
+    fs->hdr->slot_bytes=slot_bytes;
+    fs->hdr->slot_stride=PAGE_ROUND(slot_bytes);
+    fs->hdr->data_off=PAGE_ROUND(sizeof(frame_shm_hdr_t));
+    fs->hdr->header=*header;
+    fs->data=(UINT8 *)fs->hdr + fs->hdr->data_off;
+
+    // the consumer reads the rest only once it sees the magic
+    __atomic_store_n(&fs->hdr->magic, FRAME_SHM_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+
+int frame_shm_open(frame_shm_t *fs, const char *name)
+{
+    struct stat st;
+    int fd=-1, waited;
+
+    memset(fs, 0, sizeof(frame_shm_t));
+    shm_path(fs, name);
+
+    // the producer may not be up yet, or not have sized the ring
+    for(waited=0; waited < FRAME_SHM_OPEN_WAIT_MS; waited+=10)
+    {
+        if(fd < 0) fd=shm_open(fs->name, O_RDWR, 0);
+        if(fd >= 0 && fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(frame_shm_hdr_t))
+            break;
+        usleep(10000);
+    }
+    if(fd < 0 || waited >= FRAME_SHM_OPEN_WAIT_MS)
+    {
+        printf("frame_shm: no ring %s after %d msec\n", fs->name, FRAME_SHM_OPEN_WAIT_MS);
+        if(fd >= 0) close(fd);
+        return -1;
+    }
+
+    fs->size=st.st_size;
+    fs->hdr=(frame_shm_hdr_t *)mmap(NULL, fs->size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, 0);
+    close(fd);
+    if(fs->hdr == MAP_FAILED)
+    {
+        perror("frame_shm mmap");
+        fs->hdr=NULL;
+        return -1;
+    }
+
+    while(__atomic_load_n(&fs->hdr->magic, __ATOMIC_ACQUIRE) != FRAME_SHM_MAGIC)
+        usleep(1000);
+
+    fs->data=(UINT8 *)fs->hdr + fs->hdr->data_off;
+    fs->pos=__atomic_load_n(&fs->hdr->tail, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+
+UINT8 *frame_shm_acquire(frame_shm_t *fs)
+{
+    frame_shm_hdr_t *h=fs->hdr;
+    unsigned int tail;
+
+    while(fs->pos - (tail=__atomic_load_n(&h->tail, __ATOMIC_ACQUIRE)) >= (unsigned int)h->nslots)
+        ring_sleep(&h->tail, &h->tail_sleeping, tail);
+
+    return &fs->data[(fs->pos % h->nslots)*h->slot_stride];
+}
+
+
+void frame_shm_publish(frame_shm_t *fs, unsigned int frame, long long t_start_ns)
+{
+    frame_shm_hdr_t *h=fs->hdr;
+    frame_shm_slot_t *s=&h->slot[fs->pos % h->nslots];
+
+    s->frame=frame;
+    s->eos=0;
+    s->t_start_ns=t_start_ns ? t_start_ns : frame_shm_now();
+
+    // the frame and its slot info are visible before head moves past it
+    ring_advance(&h->head, &h->head_sleeping, ++fs->pos);
+}
+
+
+void frame_shm_end(frame_shm_t *fs)
+{
+    frame_shm_hdr_t *h=fs->hdr;
+
+    frame_shm_acquire(fs);
+    h->slot[fs->pos % h->nslots].eos=1;
+    ring_advance(&h->head, &h->head_sleeping, ++fs->pos);
+}
+
+
+UINT8 *frame_shm_next(frame_shm_t *fs, frame_shm_slot_t *meta)
+{
+    frame_shm_hdr_t *h=fs->hdr;
+    frame_shm_slot_t *s;
+
+    while(__atomic_load_n(&h->head, __ATOMIC_ACQUIRE) == fs->pos)
+        ring_sleep(&h->head, &h->head_sleeping, fs->pos);
+
+    s=&h->slot[fs->pos % h->nslots];
+    if(meta != NULL) *meta=*s;
+
+    // nothing to work on, the end slot goes straight back
+    if(s->eos)
+    {
+        frame_shm_release(fs);
+        return NULL;
+    }
+
+    return &fs->data[(fs->pos % h->nslots)*h->slot_stride];
+}
+
+
+void frame_shm_release(frame_shm_t *fs)
+{
+    ring_advance(&fs->hdr->tail, &fs->hdr->tail_sleeping, ++fs->pos);
+}
+
+
+void frame_shm_close(frame_shm_t *fs)
+{
+    unsigned int tail;
+
+    // the consumer may not have opened the ring yet, so it is only
+    // unlinked once everything up to the end slot has been released
+    if(fs->creator && fs->hdr != NULL)
+        while((tail=__atomic_load_n(&fs->hdr->tail, __ATOMIC_ACQUIRE)) != fs->pos)
+            ring_sleep(&fs->hdr->tail, &fs->hdr->tail_sleeping, tail);
+
+    if(fs->hdr != NULL)
+        munmap((void *)fs->hdr, fs->size);
+    if(fs->creator)
+        shm_unlink(fs->name);
+
+    fs->hdr=NULL;
+}
@@ -0,0 +1,111 @@
+#ifndef _FRAME_SHM_
+#define _FRAME_SHM_
+
+// Shared memory frame ring between processes
+//
+// A POSIX shared memory object, shm_open("/name") and mmap, holds a header
+// and nslots interleaved RGB frames of one size.  The producer process
+// fills a slot in place and publishes it, the consumer process works on it
+// in place and releases it, so a frame crosses from one process to the
+// next without a copy or any file I/O:
+//
+//    capture -> /sharpen_in -> sharpen -> /sharpen_out -> consumer
+//
+// Each ring has one producer and one consumer.  head counts frames
+// published and tail frames released, each written by one side only, so
+// the ring needs no lock: slot (n % nslots) is the producer's while
+// head - tail < nslots and the consumer's from head > n until tail > n.
+// head and tail are also the futex words a side sleeps on when the ring
+// is full or empty, shared futexes since the waiter and the waker are in
+// different processes, and a side only makes the FUTEX_WAKE call when
+// the other has said it is asleep, the same as the futex release in
+// C1_A5_GenericSequencer/seqrelease.c.
+//
+// The end of the stream is a slot published with eos set, so it is seen
+// in order after every frame before it.
+//
+// Slots are page aligned, so they map to whole pages, and every slot
+// carries its frame number and the CLOCK_MONOTONIC time the producer gave
+// it, so latency can be measured end to end across the processes.
+//
+
+#include <stddef.h>
+
+#include "ppm_io.h"
+
+#define FRAME_SHM_MAGIC (0x46534852)
+#define FRAME_SHM_MAX_SLOTS (64)
+
+// how long frame_shm_open() waits for the producer to create the ring
+#define FRAME_SHM_OPEN_WAIT_MS (10000)
+
+typedef struct
+{
+    unsigned int frame;
+    int eos;
+    long long t_start_ns;       // CLOCK_MONOTONIC, set by the producer
+} frame_shm_slot_t;
+
+typedef struct
+{
+    volatile unsigned int magic;    // set last, once the rest is valid
+    int nslots;
+    size_t slot_bytes, slot_stride, data_off;
+    ppm_header_t header;
+
+    // producer owned, published frames, and its sleep flag
+    volatile unsigned int head;
+    volatile unsigned int head_sleeping;
+    unsigned char pad0[64];
+
+    // consumer owned, released frames, and its sleep flag
+    volatile unsigned int tail;
+    volatile unsigned int tail_sleeping;
+    unsigned char pad1[64];
+
+    frame_shm_slot_t slot[FRAME_SHM_MAX_SLOTS];
+} frame_shm_hdr_t;
+
+typedef struct
+{
+    char name[64];
+    int creator;
+    size_t size;
+    frame_shm_hdr_t *hdr;
+    UINT8 *data;
+    unsigned int pos;           // this side's next frame
+} frame_shm_t;
+
+// Producer: create /name for nslots frames the size of header, replacing
+// a stale one left by an earlier run, returns 0 or -1
+int frame_shm_create(frame_shm_t *fs, const char *name, const ppm_header_t *header, int nslots);
+
+// Consumer: map /name, waiting up to FRAME_SHM_OPEN_WAIT_MS for the
+// producer to create it, returns 0 or -1
+int frame_shm_open(frame_shm_t *fs, const char *name);
+
+// Producer: the next free slot, blocking while the ring is full
+UINT8 *frame_shm_acquire(frame_shm_t *fs);
+
+// Producer: hand the acquired slot to the consumer as frame, stamped
+// t_start_ns, or 0 for the time now
+void frame_shm_publish(frame_shm_t *fs, unsigned int frame, long long t_start_ns);
+
+// Producer: publish the end of stream after the last frame
+void frame_shm_end(frame_shm_t *fs);
+
+// Consumer: the next published frame, blocking while the ring is empty,
+// NULL at the end of the stream; meta, if not NULL, gets its slot info
+UINT8 *frame_shm_next(frame_shm_t *fs, frame_shm_slot_t *meta);
+
+// Consumer: give the slot from frame_shm_next() back to the producer
+void frame_shm_release(frame_shm_t *fs);
+
+// Unmap, and unlink if this side created the ring, once the consumer has
+// released everything published, the end slot included
+void frame_shm_close(frame_shm_t *fs);
+
+// CLOCK_MONOTONIC now, in nsec
+long long frame_shm_now(void);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _PPM_IO_
+#define _PPM_IO_
+
+// Bulk PPM (P6) reader and writer shared by sharpen and sharpen_grid
+//
+// The input file is mapped with mmap (or read in large blocks when it can't be
+// mapped) and de-interleaved into separate R, G, B planes in a single pass.
+// Output is re-interleaved into one buffer and written with a single writev
+// of header + pixel data, so neither direction costs a syscall per byte.
+
+#define PPM_MAX_HEADER (256)
+
+typedef unsigned char UINT8;
+
+typedef struct
+{
+    int width;
+    int height;
+    int maxval;
+    int header_sz;                 // bytes of header, including the whitespace after maxval
+    UINT8 header[PPM_MAX_HEADER];  // raw header bytes, written back unmodified on output
+} ppm_header_t;
+
+// Parse a P6 header (comments allowed) from the start of buf, returns 0 on success
+int ppm_parse_header(const UINT8 *buf, int len, ppm_header_t *hdr);
+
+// Read just the header of a P6 file, to size buffers before reading it
+int ppm_read_header(const char *path, ppm_header_t *hdr);
+
+// Read a P6 file into planar R, G, B buffers of at least npixels bytes each,
+// returns 0 on success, -1 on error or if the image does not hold npixels
+int ppm_read_planar(const char *path, ppm_header_t *hdr, UINT8 *R, UINT8 *G, UINT8 *B, int npixels);
+
+// Write planar R, G, B buffers of npixels bytes as a P6 file with hdr, returns 0 on success
+int ppm_write_planar(const char *path, const ppm_header_t *hdr, const UINT8 *R, const UINT8 *G, const UINT8 *B, int npixels);
+
+// Read a P6 file as interleaved RGB into rgb (at least 3*npixels bytes)
+int ppm_read_rgb(const char *path, ppm_header_t *hdr, UINT8 *rgb, int npixels);
+
+// Write an interleaved RGB buffer of npixels as a P6 file with hdr, returns 0 on success
+int ppm_write_rgb(const char *path, const ppm_header_t *hdr, const UINT8 *rgb, int npixels);
+
+// Stream I/O on an open descriptor (pipe, stdin, camera FIFO) carrying
+// back-to-back P6 frames
+//
+// ppm_read_fd_header returns 0 for a header, 1 on a clean end of stream
+// before any byte of a new frame, -1 on error
+int ppm_read_fd_header(int fd, ppm_header_t *hdr);
+
+// Read exactly npixels of interleaved RGB following a header, returns 0 on success
+int ppm_read_fd_rgb(int fd, UINT8 *rgb, int npixels);
+
+// Write one frame, header + interleaved RGB, returns 0 on success
+int ppm_write_fd_rgb(int fd, const ppm_header_t *hdr, const UINT8 *rgb, int npixels);
+
+#endif
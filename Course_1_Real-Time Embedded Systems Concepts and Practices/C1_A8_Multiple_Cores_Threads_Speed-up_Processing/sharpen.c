@@ -9,26 +9,33 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <string.h>
 #include <time.h>
 
+#include "ppm_io.h"
+#include "sharpen_kernel.h"
+#include "conv_kernel.h"
+#include "rtinit.h"
 
+
+// largest image, the size of each one comes from its PPM header
 //#define IMG_HEIGHT (300)
 //#define IMG_WIDTH (400)
 #define IMG_HEIGHT (3000)
 #define IMG_WIDTH (4000)
 
 #define ITERATIONS (3000)
-#define HEADER_SZ (38) //not 21
 
-typedef double FLOAT;
+// lock memory and prefault the image planes before the timed loop, so it
+// takes no first-touch page faults, see rtinit.h
+#define MEMORY_LOCK
 
 typedef unsigned int UINT32;
 typedef unsigned long long int UINT64;
-typedef unsigned char UINT8;
 
 // PPM Edge Enhancement Code
 //
-UINT8 header[HEADER_SZ];
+ppm_header_t header;
 UINT8 R[IMG_HEIGHT*IMG_WIDTH];
 UINT8 G[IMG_HEIGHT*IMG_WIDTH];
 UINT8 B[IMG_HEIGHT*IMG_WIDTH];
@@ -36,141 +43,106 @@ UINT8 convR[IMG_HEIGHT*IMG_WIDTH];
 UINT8 convG[IMG_HEIGHT*IMG_WIDTH];
 UINT8 convB[IMG_HEIGHT*IMG_WIDTH];
 
-#define K 4.0
-
-FLOAT PSF[9] = {-K/8.0, -K/8.0, -K/8.0, -K/8.0, K+1.0, -K/8.0, -K/8.0, -K/8.0, -K/8.0};
-
 
 int main(int argc, char *argv[])
 {
-    int fdin, fdout, bytesRead=0, bytesLeft, i, j, iter;
+    int i, iter, opt, verify=0, frames=ITERATIONS, img_h, img_w;
     UINT64 microsecs=0, millisecs=0;
-    FLOAT temp, fstart, fnow;
+    FLOAT fstart, fnow;
+    char *kernel=NULL;
     struct timespec start, now;
+#ifdef MEMORY_LOCK
+    rti_faults_t run_faults;
+#endif
 
     clock_gettime(CLOCK_MONOTONIC, &start);
     fstart = (FLOAT)start.tv_sec  + (FLOAT)start.tv_nsec / 1000000000.0;
     
-    if(argc < 3)
+    while((opt=getopt(argc, argv, "k:n:V")) != -1)
     {
-       printf("Usage: sharpen input_file.ppm output_file.ppm\n");
-       exit(-1);
+        if(opt == 'k') kernel=optarg;
+        else if(opt == 'n') frames=atoi(optarg);
+        else if(opt == 'V') verify=1;
+        else argc=0;
     }
-    else
-    {
-        if((fdin = open(argv[1], O_RDONLY, 0644)) < 0)
-        {
-            printf("Error opening %s\n", argv[1]);
-        }
-        //else
-        //    printf("File opened successfully\n");
 
-        if((fdout = open(argv[2], (O_RDWR | O_CREAT), 0666)) < 0)
-        {
-            printf("Error opening %s\n", argv[1]);
-        }
-        //else
-        //    printf("Output file=%s opened successfully\n", "sharpen.ppm");
+    if((argc-optind) < 2 || frames < 1)
+    {
+       printf("Usage: sharpen [-k psf|box|sse2|avx2|neon] [-n frames] [-V] input_file.ppm output_file.ppm\n");
+       printf("       -V diffs every kernel against psf, and every NxN filter implementation against\n");
+       printf("          direct, on the input and exits\n");
+       exit(-1);
     }
 
-    bytesLeft=HEADER_SZ;
+    if(sharpen_kernel_init(kernel) < 0)
+        exit(-1);
+    printf("using %s PSF kernel\n", sharpen_row_name);
 
-    //printf("Reading header\n");
+#ifdef MEMORY_LOCK
+    rti_init(0);
+#endif
 
-    do
+    if(ppm_read_header(argv[optind], &header) < 0)
+        exit(-1);
+    img_h=header.height; img_w=header.width;
+    if(img_h < 3 || img_w < 3 || img_h*img_w > IMG_HEIGHT*IMG_WIDTH)
     {
-        //printf("bytesRead=%d, bytesLeft=%d\n", bytesRead, bytesLeft);
-        bytesRead=read(fdin, (void *)header, bytesLeft);
-        bytesLeft -= bytesRead;
-    } while(bytesLeft > 0);
-
-    header[HEADER_SZ]='\0';
+        printf("%dx%d image does not fit the %dx%d buffers\n", img_w, img_h, IMG_WIDTH, IMG_HEIGHT);
+        exit(-1);
+    }
 
-    //printf("header = %s\n", header); 
+    // Read RGB data - mapped and de-interleaved in one pass
+    if(ppm_read_planar(argv[optind], &header, R, G, B, img_h*img_w) < 0)
+        exit(-1);
 
-    // Read RGB data - Very slow one byte at time!
-    for(i=0; i<IMG_HEIGHT*IMG_WIDTH; i++)
+    if(verify)
     {
-        read(fdin, (void *)&R[i], 1); convR[i]=R[i];
-        read(fdin, (void *)&G[i], 1); convG[i]=G[i];
-        read(fdin, (void *)&B[i], 1); convB[i]=B[i];
+        i=0;
+        printf("R plane\n"); i+=sharpen_kernel_verify(R, img_w, img_h);
+        printf("G plane\n"); i+=sharpen_kernel_verify(G, img_w, img_h);
+        printf("B plane\n"); i+=sharpen_kernel_verify(B, img_w, img_h);
+        printf("R plane NxN filters\n"); i+=conv_filter_verify(R, img_w, img_h);
+        exit((i == 0) ? 0 : -1);
     }
 
+    // borders are not convolved, so start the output as a copy of the input
+    memcpy(convR, R, img_h*img_w);
+    memcpy(convG, G, img_h*img_w);
+    memcpy(convB, B, img_h*img_w);
+
+#ifdef MEMORY_LOCK
+    // every page the loop reads or writes, in case mlockall was refused
+    rti_touch(R, img_h*img_w); rti_touch(G, img_h*img_w); rti_touch(B, img_h*img_w);
+    rti_touch(convR, img_h*img_w); rti_touch(convG, img_h*img_w); rti_touch(convB, img_h*img_w);
+    rti_faults(&run_faults);
+#endif
+
     clock_gettime(CLOCK_MONOTONIC, &now);
     fnow = (FLOAT)now.tv_sec  + (FLOAT)now.tv_nsec / 1000000000.0;
     printf("start test at %lf\n", fnow-fstart);
 
-    for(iter=0; iter < ITERATIONS; iter++)
+    for(iter=0; iter < frames; iter++)
     {
         // Skip first and last row, no neighbors to convolve with
-        for(i=1; i<((IMG_HEIGHT)-1); i++)
+        for(i=1; i<((img_h)-1); i++)
         {
-
             // Skip first and last column, no neighbors to convolve with
-            for(j=1; j<((IMG_WIDTH)-1); j++)
-            {
-                temp=0;
-                temp += (PSF[0] * (FLOAT)R[((i-1)*IMG_WIDTH)+j-1]);
-                temp += (PSF[1] * (FLOAT)R[((i-1)*IMG_WIDTH)+j]);
-                temp += (PSF[2] * (FLOAT)R[((i-1)*IMG_WIDTH)+j+1]);
-                temp += (PSF[3] * (FLOAT)R[((i)*IMG_WIDTH)+j-1]);
-                temp += (PSF[4] * (FLOAT)R[((i)*IMG_WIDTH)+j]);
-                temp += (PSF[5] * (FLOAT)R[((i)*IMG_WIDTH)+j+1]);
-                temp += (PSF[6] * (FLOAT)R[((i+1)*IMG_WIDTH)+j-1]);
-                temp += (PSF[7] * (FLOAT)R[((i+1)*IMG_WIDTH)+j]);
-                temp += (PSF[8] * (FLOAT)R[((i+1)*IMG_WIDTH)+j+1]);
-	        if(temp<0.0) temp=0.0;
-	        if(temp>255.0) temp=255.0;
-	        convR[(i*IMG_WIDTH)+j]=(UINT8)temp;
-
-                temp=0;
-                temp += (PSF[0] * (FLOAT)G[((i-1)*IMG_WIDTH)+j-1]);
-                temp += (PSF[1] * (FLOAT)G[((i-1)*IMG_WIDTH)+j]);
-                temp += (PSF[2] * (FLOAT)G[((i-1)*IMG_WIDTH)+j+1]);
-                temp += (PSF[3] * (FLOAT)G[((i)*IMG_WIDTH)+j-1]);
-                temp += (PSF[4] * (FLOAT)G[((i)*IMG_WIDTH)+j]);
-                temp += (PSF[5] * (FLOAT)G[((i)*IMG_WIDTH)+j+1]);
-                temp += (PSF[6] * (FLOAT)G[((i+1)*IMG_WIDTH)+j-1]);
-                temp += (PSF[7] * (FLOAT)G[((i+1)*IMG_WIDTH)+j]);
-                temp += (PSF[8] * (FLOAT)G[((i+1)*IMG_WIDTH)+j+1]);
-	        if(temp<0.0) temp=0.0;
-	        if(temp>255.0) temp=255.0;
-	        convG[(i*IMG_WIDTH)+j]=(UINT8)temp;
-
-                temp=0;
-                temp += (PSF[0] * (FLOAT)B[((i-1)*IMG_WIDTH)+j-1]);
-                temp += (PSF[1] * (FLOAT)B[((i-1)*IMG_WIDTH)+j]);
-                temp += (PSF[2] * (FLOAT)B[((i-1)*IMG_WIDTH)+j+1]);
-                temp += (PSF[3] * (FLOAT)B[((i)*IMG_WIDTH)+j-1]);
-                temp += (PSF[4] * (FLOAT)B[((i)*IMG_WIDTH)+j]);
-                temp += (PSF[5] * (FLOAT)B[((i)*IMG_WIDTH)+j+1]);
-                temp += (PSF[6] * (FLOAT)B[((i+1)*IMG_WIDTH)+j-1]);
-                temp += (PSF[7] * (FLOAT)B[((i+1)*IMG_WIDTH)+j]);
-                temp += (PSF[8] * (FLOAT)B[((i+1)*IMG_WIDTH)+j+1]);
-	        if(temp<0.0) temp=0.0;
-	        if(temp>255.0) temp=255.0;
-	        convB[(i*IMG_WIDTH)+j]=(UINT8)temp;
-            }
+            sharpen_row(&R[((i-1)*img_w)+1], &R[(i*img_w)+1], &R[((i+1)*img_w)+1], &convR[(i*img_w)+1], img_w-2);
+            sharpen_row(&G[((i-1)*img_w)+1], &G[(i*img_w)+1], &G[((i+1)*img_w)+1], &convG[(i*img_w)+1], img_w-2);
+            sharpen_row(&B[((i-1)*img_w)+1], &B[(i*img_w)+1], &B[((i+1)*img_w)+1], &convB[(i*img_w)+1], img_w-2);
         }
 
     }
 
     clock_gettime(CLOCK_MONOTONIC, &now);
     fnow = (FLOAT)now.tv_sec  + (FLOAT)now.tv_nsec / 1000000000.0;
-    printf("stop test at %lf for %d frames\n", fnow-fstart, ITERATIONS);
-
-    write(fdout, (void *)header, HEADER_SZ);
-
-    // Write RGB data - very slow 1 byte at a time!
-    for(i=0; i<IMG_HEIGHT*IMG_WIDTH; i++)
-    {
-        write(fdout, (void *)&convR[i], 1);
-        write(fdout, (void *)&convG[i], 1);
-        write(fdout, (void *)&convB[i], 1);
-    }
-
-
-    close(fdin);
-    close(fdout);
+    printf("stop test at %lf for %d frames\n", fnow-fstart, frames);
+#ifdef MEMORY_LOCK
+    rti_report("frames", &run_faults);
+#endif
+
+    // Write RGB data - interleaved into one buffer and written with one call
+    if(ppm_write_planar(argv[optind+1], &header, convR, convG, convB, img_h*img_w) < 0)
+        exit(-1);
  
 }
@@ -0,0 +1,544 @@
+// Batch sharpen - every PPM of a directory or a file list sharpened once
+//
+// sharpen and sharpen_grid convolve one image ITERATIONS times to measure
+// the kernel; a production batch is thousands of different images, each of
+// which is read, convolved and written once, so the disk is as much of the
+// run as the CPUs.  The same three stages as sharpen_stream, but with a
+// pool of threads on each I/O side:
+//
+//    readers -> convolve -> writers
+//
+// Readers take the next file from the list, read it into a free slot and
+// queue it for the convolve stage, so with more slots than readers they
+// run ahead of it and the next images are already in memory when the
+// workers finish one.  The convolve stage is this thread and the
+// frame_pool workers, pinned one per core as in sharpen_stream, and every
+// image is split into row bands over them.  Writers save the result and
+// give the slot back.  Images finish in the order they were read, not the
+// list order.
+//
+// Slot buffers grow to the largest image seen and are reused, so a batch
+// of same sized images allocates nothing after the first few.  Images
+// smaller than 3x3 or that can not be read are reported and skipped.
+//
+//    sharpen_batch [-k psf|box|sse2|avx2|neon] [-t threads] [-r readers] [-w writers] [-s slots] [-o dir] [-l list|-] dir|file ...
+//
+//    -o  write each image as dir/<name>, nothing is written without it
+//    -l  also take the files named one per line in list, or stdin for -
+//
+// A directory argument is every *.ppm in it, in name order.  The report
+// has the images per second and, to size -r, how long the convolve stage
+// sat waiting for a reader.
+//
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "ppm_io.h"
+#include "frame_pool.h"
+#include "sharpen_kernel.h"
+
+#define NUM_CONV_THREADS (4)
+#define NUM_READERS (2)
+#define NUM_WRITERS (2)
+
+// beyond one slot per reader and writer, one being convolved and one a
+// reader has already filled for the next
+#define SPARE_SLOTS (2)
+#define MAX_SLOTS (64)
+
+// end of the batch marker in a queue
+#define EOS_SLOT (-1)
+
+#define NSEC_PER_SEC (1000000000)
+
+typedef struct
+{
+    UINT8 *in;                  // interleaved RGB as read
+    UINT8 *out;                 // interleaved RGB sharpened
+    size_t size;                // bytes each buffer holds
+    ppm_header_t header;
+    int file;                   // index in in_files
+} batchSlotType;
+
+// slot indices handed from one stage to the next, several threads on
+// either side, so unlike the sharpen_stream ring it is locked
+typedef struct
+{
+    int idx[2*MAX_SLOTS];
+    int head, tail;
+    pthread_mutex_t lock;
+    sem_t count;
+} slotQueueType;
+
+typedef struct
+{
+    int i;
+    int h;
+} convArgsType;
+
+batchSlotType slot[MAX_SLOTS];
+slotQueueType q_free, q_read, q_conv;
+int nslots, nreaders=NUM_READERS, nwriters=NUM_WRITERS;
+
+// the convolve workers read the current slot, set before each frame_pool_run
+frame_pool_t pool;
+batchSlotType *conv_slot;
+convArgsType convarg[FRAME_POOL_MAX_WORKERS];
+void *convargs[FRAME_POOL_MAX_WORKERS];
+int nconv=NUM_CONV_THREADS;
+
+// input, claimed by the readers one at a time
+char **in_files;
+int num_in_files, max_in_files;
+int next_file=0, readers_left;
+
+char *out_dir=NULL;
+
+// images and bytes, counted by the stage that finishes with the slot
+int images_done=0, images_failed=0;
+double pixels_done=0.0, bytes_read=0.0;
+double conv_wait=0.0, conv_busy=0.0;
+
+
+static double ts_diff(struct timespec *stop, struct timespec *start)
+{
+    return (double)(stop->tv_sec - start->tv_sec) + ((double)(stop->tv_nsec - start->tv_nsec) / NSEC_PER_SEC);
+}
+
+
+static void queue_init(slotQueueType *q)
+{
+    q->head=q->tail=0;
+    pthread_mutex_init(&q->lock, NULL);
+    sem_init(&q->count, 0, 0);
+}
+
+
+static void queue_put(slotQueueType *q, int idx)
+{
+    pthread_mutex_lock(&q->lock);
+    q->idx[q->tail]=idx;
+    q->tail=(q->tail+1) % (2*MAX_SLOTS);
+    pthread_mutex_unlock(&q->lock);
+
+    sem_post(&q->count);
+}
+
+
+static int queue_get(slotQueueType *q)
+{
+    int idx;
+
+    sem_wait(&q->count);
+
+    pthread_mutex_lock(&q->lock);
+    idx=q->idx[q->head];
+    q->head=(q->head+1) % (2*MAX_SLOTS);
+    pthread_mutex_unlock(&q->lock);
+
+    return idx;
+}
+
+
+static void add_file(const char *path)
+{
+    char **files;
+
+    if(num_in_files == max_in_files)
+    {
+        max_in_files=max_in_files ? 2*max_in_files : 1024;
+        if((files=realloc(in_files, max_in_files*sizeof(char *))) == NULL)
+        {
+            printf("Error allocating a list of %d files\n", max_in_files);
+            exit(-1);
+        }
+        in_files=files;
+    }
+
+    if((in_files[num_in_files]=strdup(path)) == NULL)
+    {
+        printf("Error allocating a list of %d files\n", max_in_files);
+        exit(-1);
+    }
+    num_in_files++;
+}
+
+
+static int by_name(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+
+// every *.ppm in dir, in name order
+static void add_dir(const char *dir)
+{
+    DIR *d;
+    struct dirent *e;
+    char path[PATH_MAX];
+    size_t len;
+    int first=num_in_files;
+
+    if((d=opendir(dir)) == NULL)
+    {
+        perror(dir);
+        exit(-1);
+    }
+
+    while((e=readdir(d)) != NULL)
+    {
+        len=strlen(e->d_name);
+        if(len < 5 || strcasecmp(&e->d_name[len-4], ".ppm") != 0)
+            continue;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        add_file(path);
+    }
+    closedir(d);
+
+    qsort(&in_files[first], num_in_files-first, sizeof(char *), by_name);
+}
+
+
+// one path per line, blank lines skipped
+static void add_list(const char *list)
+{
+    FILE *fp=(strcmp(list, "-") == 0) ? stdin : fopen(list, "r");
+    char line[PATH_MAX];
+    size_t len;
+
+    if(fp == NULL)
+    {
+        perror(list);
+        exit(-1);
+    }
+
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        len=strlen(line);
+        while(len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) line[--len]='\0';
+        if(len > 0) add_file(line);
+    }
+
+    if(fp != stdin) fclose(fp);
+}
+
+
+// both buffers of s at least bytes, reused from one image to the next
+static int slot_fit(batchSlotType *s, size_t bytes)
+{
+    UINT8 *in, *out;
+
+    if(bytes <= s->size) return 0;
+
+    free(s->in); free(s->out);
+    in=malloc(bytes); out=malloc(bytes);
+    if(in == NULL || out == NULL)
+    {
+        free(in); free(out);
+        s->in=s->out=NULL; s->size=0;
+        return -1;
+    }
+
+    s->in=in; s->out=out; s->size=bytes;
+    return 0;
+}
+
+
+void *reader_thread(void *threadp)
+{
+    int idx, f, npixels;
+    batchSlotType *s;
+
+    (void)threadp;
+
+    while(1)
+    {
+        idx=queue_get(&q_free);
+        s=&slot[idx];
+
+        // the next file that reads, skipping the ones that do not
+        while((f=__atomic_fetch_add(&next_file, 1, __ATOMIC_RELAXED)) < num_in_files)
+        {
+            if(ppm_read_header(in_files[f], &s->header) < 0)
+            {
+                __atomic_fetch_add(&images_failed, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+
+            npixels=s->header.width*s->header.height;
+            if(s->header.width < 3 || s->header.height < 3)
+            {
+                printf("%s: %dx%d is too small to sharpen\n", in_files[f], s->header.width, s->header.height);
+                __atomic_fetch_add(&images_failed, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+            if(slot_fit(s, (size_t)npixels*3) < 0)
+            {
+                printf("%s: Error allocating a %dx%d slot\n", in_files[f], s->header.width, s->header.height);
+                __atomic_fetch_add(&images_failed, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+            if(ppm_read_rgb(in_files[f], &s->header, s->in, npixels) < 0)
+            {
+                __atomic_fetch_add(&images_failed, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+            break;
+        }
+
+        if(f >= num_in_files)
+        {
+            queue_put(&q_free, idx);
+            break;
+        }
+
+        s->file=f;
+        queue_put(&q_read, idx);
+    }
+
+    // the last reader out ends the batch, behind every image still queued
+    if(__atomic_sub_fetch(&readers_left, 1, __ATOMIC_ACQ_REL) == 0)
+        queue_put(&q_read, EOS_SLOT);
+
+    return (void *)0;
+}
+
+
+void *writer_thread(void *threadp)
+{
+    int idx;
+    batchSlotType *s;
+    const char *name;
+    char path[PATH_MAX], in_real[PATH_MAX], out_real[PATH_MAX];
+
+    (void)threadp;
+
+    while((idx=queue_get(&q_conv)) != EOS_SLOT)
+    {
+        s=&slot[idx];
+
+        if(out_dir != NULL)
+        {
+            name=strrchr(in_files[s->file], '/');
+            snprintf(path, sizeof(path), "%s/%s", out_dir, name ? name+1 : in_files[s->file]);
+
+            // -o the input directory would sharpen the originals in place
+            if(realpath(path, out_real) != NULL && realpath(in_files[s->file], in_real) != NULL &&
+               strcmp(in_real, out_real) == 0)
+            {
+                printf("%s: not overwriting the input\n", path);
+                __atomic_fetch_add(&images_failed, 1, __ATOMIC_RELAXED);
+                queue_put(&q_free, idx);
+                continue;
+            }
+
+            if(ppm_write_rgb(path, &s->header, s->out, s->header.width*s->header.height) < 0)
+            {
+                __atomic_fetch_add(&images_failed, 1, __ATOMIC_RELAXED);
+                queue_put(&q_free, idx);
+                continue;
+            }
+        }
+
+        __atomic_fetch_add(&images_done, 1, __ATOMIC_RELAXED);
+        queue_put(&q_free, idx);
+    }
+
+    return (void *)0;
+}
+
+
+void *conv_thread(void *threadp)
+{
+    convArgsType *a=(convArgsType *)threadp;
+    int img_w=conv_slot->header.width;
+
+    if(a->h > 0)
+        sharpen_rgb_tile(conv_slot->in, conv_slot->out, img_w, a->i, 1, a->h, img_w-2);
+
+    return (void *)0;
+}
+
+
+// the one pixel border is not convolved, and the workers split the rest
+static void convolve(batchSlotType *s)
+{
+    int i, img_w=s->header.width, img_h=s->header.height;
+
+    memcpy(s->out, s->in, (size_t)img_w*3);
+    memcpy(&s->out[(size_t)(img_h-1)*img_w*3], &s->in[(size_t)(img_h-1)*img_w*3], (size_t)img_w*3);
+    for(i=1; i<(img_h-1); i++)
+    {
+        memcpy(&s->out[(size_t)i*img_w*3], &s->in[(size_t)i*img_w*3], 3);
+        memcpy(&s->out[(((size_t)i*img_w)+img_w-1)*3], &s->in[(((size_t)i*img_w)+img_w-1)*3], 3);
+    }
+
+    // an image with fewer rows than workers leaves some with no band
+    for(i=0; i<nconv; i++)
+    {
+        convarg[i].i=1+((i*(img_h-2))/nconv);
+        convarg[i].h=(1+(((i+1)*(img_h-2))/nconv))-convarg[i].i;
+    }
+
+    conv_slot=s;
+    frame_pool_run(&pool);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int i, idx, opt, rc;
+    char *kernel=NULL;
+    pthread_t readers[MAX_SLOTS], writers[MAX_SLOTS];
+    batchSlotType *s;
+    struct timespec start, stop, t0, t1;
+    struct stat st;
+    double elapsed;
+
+    while((opt=getopt(argc, argv, "k:t:r:w:s:o:l:")) != -1)
+    {
+        if(opt == 'k') kernel=optarg;
+        else if(opt == 't') nconv=atoi(optarg);
+        else if(opt == 'r') nreaders=atoi(optarg);
+        else if(opt == 'w') nwriters=atoi(optarg);
+        else if(opt == 's') nslots=atoi(optarg);
+        else if(opt == 'o') out_dir=optarg;
+        else if(opt == 'l') add_list(optarg);
+        else argc=0;
+    }
+
+    if(nslots == 0) nslots=nreaders+nwriters+SPARE_SLOTS;
+
+    if(argc == 0 || nconv < 1 || nconv > FRAME_POOL_MAX_WORKERS || nreaders < 1 || nwriters < 1 ||
+       nslots < 2 || nslots > MAX_SLOTS || nreaders >= MAX_SLOTS || nwriters >= MAX_SLOTS)
+    {
+       printf("Usage: sharpen_batch [-k psf|box|sse2|avx2|neon] [-t threads] [-r readers] [-w writers] [-s slots] [-o dir] [-l list|-] dir|file ...\n");
+       exit(-1);
+    }
+
+    if(sharpen_kernel_init(kernel) < 0)
+        exit(-1);
+
+    for(i=optind; i<argc; i++)
+    {
+        if(stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode))
+            add_dir(argv[i]);
+        else
+            add_file(argv[i]);
+    }
+
+    if(num_in_files == 0)
+    {
+        printf("no images to sharpen\n");
+        exit(-1);
+    }
+
+    if(out_dir != NULL && mkdir(out_dir, 0777) != 0)
+    {
+        if(stat(out_dir, &st) != 0 || !S_ISDIR(st.st_mode))
+        {
+            perror(out_dir);
+            exit(-1);
+        }
+    }
+
+    queue_init(&q_free);
+    queue_init(&q_read);
+    queue_init(&q_conv);
+    for(i=0; i<nslots; i++)
+    {
+        memset(&slot[i], 0, sizeof(batchSlotType));
+        queue_put(&q_free, i);
+    }
+
+    for(i=0; i<nconv; i++)
+        convargs[i]=(void *)&convarg[i];
+    frame_pool_create(&pool, nconv, conv_thread, convargs);
+
+    printf("sharpening %d images with %s PSF kernel on %d threads, %d readers, %d writers, %d slots\n",
+           num_in_files, sharpen_row_name, nconv, nreaders, nwriters, nslots);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // the I/O threads block on the disk, so they are left to the scheduler
+    readers_left=nreaders;
+    for(i=0; i<nreaders; i++)
+    {
+        if((rc=pthread_create(&readers[i], (void *)0, reader_thread, (void *)0)) != 0)
+        {
+            printf("reader pthread_create failed, rc=%d\n", rc);
+            exit(-1);
+        }
+    }
+    for(i=0; i<nwriters; i++)
+    {
+        if((rc=pthread_create(&writers[i], (void *)0, writer_thread, (void *)0)) != 0)
+        {
+            printf("writer pthread_create failed, rc=%d\n", rc);
+            exit(-1);
+        }
+    }
+
+    // this thread is the convolve stage
+    while(1)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        idx=queue_get(&q_read);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        conv_wait+=ts_diff(&t1, &t0);
+
+        if(idx == EOS_SLOT) break;
+
+        s=&slot[idx];
+        convolve(s);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        conv_busy+=ts_diff(&t0, &t1);
+
+        pixels_done+=(double)s->header.width*s->header.height;
+        bytes_read+=(double)s->header.header_sz + 3.0*s->header.width*s->header.height;
+        queue_put(&q_conv, idx);
+    }
+
+    // one end marker for each writer, behind the last image
+    for(i=0; i<nwriters; i++)
+        queue_put(&q_conv, EOS_SLOT);
+
+    for(i=0; i<nreaders; i++)
+        pthread_join(readers[i], (void **)0);
+    for(i=0; i<nwriters; i++)
+        pthread_join(writers[i], (void **)0);
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    elapsed=ts_diff(&stop, &start);
+
+    frame_pool_destroy(&pool);
+
+    printf("%d images, %d skipped, in %lf sec, %.2lf images/sec, %.2lf MPix/s, %.1lf MB/s read\n",
+           images_done, images_failed, elapsed, images_done / elapsed, pixels_done / (elapsed * 1000000.0),
+           bytes_read / (elapsed * 1000000.0));
+    printf("convolve stage busy %lf sec, waited %lf sec for a reader, %.1lf%% of the run\n",
+           conv_busy, conv_wait, 100.0 * conv_wait / elapsed);
+
+    for(i=0; i<nslots; i++)
+    {
+        free(slot[i].in);
+        free(slot[i].out);
+    }
+    for(i=0; i<num_in_files; i++)
+        free(in_files[i]);
+    free(in_files);
+
+    return (images_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#ifndef _SHARPEN_GPU_
+#define _SHARPEN_GPU_
+
+// Frame level GPU backend for the 3x3 PSF, "-k cuda" or "-k opencl"
+//
+// Built only with "make GPU=cuda", for the Jetson/Tegra boards, or "make
+// GPU=opencl" as the portable fallback, either of which defines
+// SHARPEN_GPU.  The GPU works on whole interleaved RGB frames rather than
+// rows: every device thread sharpens one pixel, all three channels, with
+// the same integer form of the PSF as the SIMD row kernels, so the output
+// is bit for bit the same, and copies the one pixel border itself.
+//
+// Frames live in buffers from sharpen_gpu_alloc():
+//
+//    unified memory   (Tegra, integrated GPUs) mapped zero copy, the kernel
+//                     reads and writes the host buffer, nothing is copied
+//    discrete         page locked host memory, copied to and from device
+//                     buffers by DMA
+//
+// Each of nslots slots has its own stream (CUDA) or in-order queue
+// (OpenCL), so the upload, kernel and download of one frame overlap those
+// of the frames in the other slots; sharpen_stream keeps two in flight.
+//
+
+#include <stddef.h>
+#include <string.h>
+
+#include "sharpen_kernel.h"
+
+#define SHARPEN_GPU_MAX_SLOTS (8)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 1 if name is a GPU kernel name, built in or not
+static inline int sharpen_gpu_kernel(const char *name)
+{
+    return name != NULL && (strcmp(name, "cuda") == 0 || strcmp(name, "opencl") == 0);
+}
+
+#ifdef SHARPEN_GPU
+extern const char *sharpen_gpu_name;
+
+// device name and memory mode, set by sharpen_gpu_init() for the caller to
+// print, the backends keep stdout clear for sharpen_stream's "-o -"
+extern char sharpen_gpu_device[128];
+
+// Open the device for width x height RGB frames and nslots frames in
+// flight, name has to be the backend this was built with, returns 0 or -1
+int sharpen_gpu_init(const char *name, int width, int height, int nslots);
+
+// Host frame buffer of size bytes the device can reach, NULL on failure
+UINT8 *sharpen_gpu_alloc(size_t size);
+void sharpen_gpu_free(UINT8 *buf);
+
+// Queue the upload, kernel and download of in to out on slot and return,
+// both from sharpen_gpu_alloc(), returns 0 or -1
+int sharpen_gpu_submit(int slot, const UINT8 *in, UINT8 *out);
+
+// Wait for slot's frame, out holds it when this returns 0
+int sharpen_gpu_wait(int slot);
+
+void sharpen_gpu_close(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,335 @@
+// OpenCL backend for sharpen_gpu.h, "make GPU=opencl"
+//
+// The first GPU of the first platform that has one, else any device.  When
+// it reports CL_DEVICE_HOST_UNIFIED_MEMORY the frame buffers are page
+// aligned host memory wrapped CL_MEM_USE_HOST_PTR, which integrated GPUs
+// use in place; the unmap before the kernel and the map after it only keep
+// the host and device views coherent.  Otherwise they are CL_MEM_ALLOC_HOST_PTR
+// buffers kept mapped, the driver's pinned staging memory, and every slot
+// has a device in/out pair written and read non-blocking around the kernel.
+//
+#define CL_TARGET_OPENCL_VERSION 120
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "sharpen_gpu.h"
+
+#define K_INT ((int)(K))
+
+// host buffers, for the cl_mem behind each sharpen_gpu_alloc pointer
+#define MAX_BUFFERS (4*SHARPEN_GPU_MAX_SLOTS)
+
+#define BLOCK_W (32)
+#define BLOCK_H (8)
+
+typedef struct
+{
+    cl_command_queue queue;
+    cl_mem d_in, d_out;         // device frames, discrete GPUs only
+} gpu_slot_t;
+
+typedef struct
+{
+    UINT8 *host;
+    cl_mem mem;
+    size_t size;
+} gpu_buffer_t;
+
+const char *sharpen_gpu_name="opencl";
+char sharpen_gpu_device[128];
+
+static cl_context context;
+static cl_device_id device;
+static cl_program program;
+static cl_kernel kernel;
+static gpu_slot_t slots[SHARPEN_GPU_MAX_SLOTS];
+static gpu_buffer_t buffers[MAX_BUFFERS];
+static int nslots, width, height, zero_copy;
+static size_t frame_bytes;
+
+// same integer PSF as the row kernels, one work item per pixel
+static const char *kernel_src=
+    "__kernel void sharpen_rgb(__global const uchar *in, __global uchar *out, int w, int h)\n"
+    "{\n"
+    "    int x=get_global_id(0), y=get_global_id(1);\n"
+    "    int p, c, s8, t, stride=w*3;\n"
+    "    if(x >= w || y >= h) return;\n"
+    "    p=(y*w + x)*3;\n"
+    "    if(x == 0 || y == 0 || x == w-1 || y == h-1)\n"
+    "    {\n"
+    "        out[p]=in[p]; out[p+1]=in[p+1]; out[p+2]=in[p+2];\n"
+    "        return;\n"
+    "    }\n"
+    "    for(c=0; c<3; c++, p++)\n"
+    "    {\n"
+    "        s8=in[p-stride-3] + in[p-stride] + in[p-stride+3] + in[p-3] + in[p+3] +\n"
+    "           in[p+stride-3] + in[p+stride] + in[p+stride+3];\n"
+    "        t=((8*(K_INT+1) * in[p]) - (K_INT * s8)) >> 3;\n"
+    "        out[p]=(uchar)clamp(t, 0, 255);\n"
+    "    }\n"
+    "}\n";
+
+
+static int check(cl_int err, const char *what)
+{
+    if(err == CL_SUCCESS)
+        return 0;
+    printf("%s: OpenCL error %d\n", what, err);
+    return -1;
+}
+
+
+static gpu_buffer_t *find_buffer(const UINT8 *host)
+{
+    int i;
+
+    for(i=0; i<MAX_BUFFERS; i++)
+        if(buffers[i].host == host)
+            return &buffers[i];
+    return NULL;
+}
+
+
+// a GPU if any platform has one, otherwise the first device of any type
+static int pick_device(void)
+{
+    cl_platform_id platforms[8];
+    cl_uint n, i;
+
+    if(check(clGetPlatformIDs(8, platforms, &n), "clGetPlatformIDs") < 0 || n == 0)
+        return -1;
+    if(n > 8) n=8;
+
+    for(i=0; i<n; i++)
+        if(clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_GPU, 1, &device, NULL) == CL_SUCCESS)
+            return 0;
+    for(i=0; i<n; i++)
+        if(clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_ALL, 1, &device, NULL) == CL_SUCCESS)
+            return 0;
+
+    printf("no OpenCL device\n");
+    return -1;
+}
+
+
+int sharpen_gpu_init(const char *name, int w, int h, int n)
+{
+    char dev_name[96], options[64], log[4096];
+    cl_bool unified=CL_FALSE;
+    cl_int err;
+    int i;
+
+    if(strcmp(name, sharpen_gpu_name) != 0)
+    {
+        printf("built with GPU=%s, not %s\n", sharpen_gpu_name, name);
+        return -1;
+    }
+    if(K != (double)K_INT || n < 1 || n > SHARPEN_GPU_MAX_SLOTS)
+    {
+        printf("opencl kernel needs an integer K and 1..%d slots\n", SHARPEN_GPU_MAX_SLOTS);
+        return -1;
+    }
+
+    if(pick_device() < 0)
+        return -1;
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(dev_name), dev_name, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(unified), &unified, NULL);
+    zero_copy=(unified == CL_TRUE);
+
+    context=clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+    if(check(err, "clCreateContext") < 0)
+        return -1;
+
+    program=clCreateProgramWithSource(context, 1, &kernel_src, NULL, &err);
+    if(check(err, "clCreateProgramWithSource") < 0)
+        return -1;
+    snprintf(options, sizeof(options), "-DK_INT=%d", K_INT);
+    if(clBuildProgram(program, 1, &device, options, NULL, NULL) != CL_SUCCESS)
+    {
+        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, sizeof(log), log, NULL);
+        printf("sharpen_rgb build failed:\n%s\n", log);
+        return -1;
+    }
+    kernel=clCreateKernel(program, "sharpen_rgb", &err);
+    if(check(err, "clCreateKernel") < 0)
+        return -1;
+
+    width=w; height=h; nslots=n;
+    frame_bytes=(size_t)w*h*3;
+
+    // a queue per slot, each in order, so the slots overlap one another
+    for(i=0; i<nslots; i++)
+    {
+        slots[i].queue=clCreateCommandQueue(context, device, 0, &err);
+        if(check(err, "clCreateCommandQueue") < 0)
+            return -1;
+        if(!zero_copy)
+        {
+            slots[i].d_in=clCreateBuffer(context, CL_MEM_READ_ONLY, frame_bytes, NULL, &err);
+            if(check(err, "clCreateBuffer") < 0)
+                return -1;
+            slots[i].d_out=clCreateBuffer(context, CL_MEM_WRITE_ONLY, frame_bytes, NULL, &err);
+            if(check(err, "clCreateBuffer") < 0)
+                return -1;
+        }
+    }
+
+    snprintf(sharpen_gpu_device, sizeof(sharpen_gpu_device), "%s, %s", dev_name,
+             zero_copy ? "unified memory, zero copy" : "pinned host buffers");
+    return 0;
+}
+
+
+UINT8 *sharpen_gpu_alloc(size_t size)
+{
+    gpu_buffer_t *b;
+    void *host=NULL;
+    cl_int err;
+
+    if((b=find_buffer(NULL)) == NULL)
+    {
+        printf("more than %d GPU host buffers\n", MAX_BUFFERS);
+        return NULL;
+    }
+
+    if(zero_copy)
+    {
+        // page aligned and a whole number of cache lines, what drivers need
+        // to use the memory as is rather than shadow it
+        if(posix_memalign(&host, sysconf(_SC_PAGESIZE), (size+63) & ~(size_t)63) != 0)
+            return NULL;
+        b->mem=clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, size, host, &err);
+    }
+    else
+        b->mem=clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size, NULL, &err);
+    if(check(err, "clCreateBuffer") < 0)
+    {
+        free(host);
+        return NULL;
+    }
+
+    // the host owns a buffer while it is mapped, so it starts out mapped and
+    // submit hands it to the device and back; ALLOC_HOST_PTR memory mapped is
+    // the driver's pinned staging memory, USE_HOST_PTR maps to host itself
+    host=clEnqueueMapBuffer(slots[0].queue, b->mem, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size, 0, NULL, NULL, &err);
+    if(check(err, "clEnqueueMapBuffer") < 0)
+    {
+        clReleaseMemObject(b->mem);
+        return NULL;
+    }
+
+    b->host=(UINT8 *)host;
+    b->size=size;
+    return b->host;
+}
+
+
+void sharpen_gpu_free(UINT8 *buf)
+{
+    gpu_buffer_t *b;
+
+    if(buf == NULL || (b=find_buffer(buf)) == NULL)
+        return;
+
+    clEnqueueUnmapMemObject(slots[0].queue, b->mem, b->host, 0, NULL, NULL);
+    clFinish(slots[0].queue);
+    clReleaseMemObject(b->mem);
+    if(zero_copy)
+        free(b->host);
+    b->host=NULL;
+}
+
+
+int sharpen_gpu_submit(int slot, const UINT8 *in, UINT8 *out)
+{
+    gpu_slot_t *s=&slots[slot];
+    gpu_buffer_t *bin=find_buffer(in), *bout=find_buffer(out);
+    size_t local[2]={BLOCK_W, BLOCK_H};
+    size_t global[2];
+    cl_mem d_in, d_out;
+    cl_int err;
+
+    if(bin == NULL || bout == NULL)
+    {
+        printf("frame buffers not from sharpen_gpu_alloc\n");
+        return -1;
+    }
+
+    global[0]=((width+BLOCK_W-1)/BLOCK_W)*BLOCK_W;
+    global[1]=((height+BLOCK_H-1)/BLOCK_H)*BLOCK_H;
+
+    if(zero_copy)
+    {
+        d_in=bin->mem; d_out=bout->mem;
+        if(check(clEnqueueUnmapMemObject(s->queue, d_in, bin->host, 0, NULL, NULL), "unmap") < 0 ||
+           check(clEnqueueUnmapMemObject(s->queue, d_out, bout->host, 0, NULL, NULL), "unmap") < 0)
+            return -1;
+    }
+    else
+    {
+        d_in=s->d_in; d_out=s->d_out;
+        if(check(clEnqueueWriteBuffer(s->queue, d_in, CL_FALSE, 0, frame_bytes, in, 0, NULL, NULL), "upload") < 0)
+            return -1;
+    }
+
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_in);
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_out);
+    clSetKernelArg(kernel, 2, sizeof(int), &width);
+    clSetKernelArg(kernel, 3, sizeof(int), &height);
+    if(check(clEnqueueNDRangeKernel(s->queue, kernel, 2, NULL, global, local, 0, NULL, NULL), "sharpen_rgb") < 0)
+        return -1;
+
+    if(zero_copy)
+    {
+        // USE_HOST_PTR maps back to the same host pointers
+        clEnqueueMapBuffer(s->queue, d_in, CL_FALSE, CL_MAP_READ | CL_MAP_WRITE, 0, bin->size, 0, NULL, NULL, &err);
+        if(check(err, "map") < 0)
+            return -1;
+        clEnqueueMapBuffer(s->queue, d_out, CL_FALSE, CL_MAP_READ | CL_MAP_WRITE, 0, bout->size, 0, NULL, NULL, &err);
+        if(check(err, "map") < 0)
+            return -1;
+    }
+    else if(check(clEnqueueReadBuffer(s->queue, d_out, CL_FALSE, 0, frame_bytes, out, 0, NULL, NULL), "download") < 0)
+        return -1;
+
+    return check(clFlush(s->queue), "clFlush");
+}
+
+
+int sharpen_gpu_wait(int slot)
+{
+    return check(clFinish(slots[slot].queue), "clFinish");
+}
+
+
+void sharpen_gpu_close(void)
+{
+    int i;
+
+    for(i=0; i<nslots; i++)
+    {
+        clFinish(slots[i].queue);
+        if(!zero_copy)
+        {
+            clReleaseMemObject(slots[i].d_in);
+            clReleaseMemObject(slots[i].d_out);
+        }
+    }
+    // buffers still allocated are unmapped through slot 0's queue
+    for(i=0; i<MAX_BUFFERS; i++)
+        sharpen_gpu_free(buffers[i].host);
+    for(i=0; i<nslots; i++)
+        clReleaseCommandQueue(slots[i].queue);
+
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseContext(context);
+    nslots=0;
+}
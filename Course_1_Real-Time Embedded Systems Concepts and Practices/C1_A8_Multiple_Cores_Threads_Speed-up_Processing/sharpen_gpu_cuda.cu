@@ -0,0 +1,184 @@
+// CUDA backend for sharpen_gpu.h, "make GPU=cuda"
+//
+// On Tegra (Jetson) the GPU shares DRAM with the CPU, so frame buffers are
+// cudaHostAlloc()ed mapped and the kernel works on them in place through
+// their device alias, no copy at all.  On a discrete GPU they are page
+// locked and every slot has a device in/out pair, copied asynchronously on
+// the slot's stream around the kernel.
+//
+#include <stdio.h>
+#include <cuda_runtime.h>
+
+#include "sharpen_gpu.h"
+
+#define K_INT ((int)(K))
+#define PSF_C8 (8*(K_INT+1))
+#define PSF_N (K_INT)
+
+// 32 pixels wide matches a warp to a row, so the loads of a warp coalesce
+#define BLOCK_W (32)
+#define BLOCK_H (8)
+
+typedef struct
+{
+    cudaStream_t stream;
+    UINT8 *d_in, *d_out;        // device frames, discrete GPUs only
+} gpu_slot_t;
+
+extern "C" const char *sharpen_gpu_name="cuda";
+char sharpen_gpu_device[128];
+
+static gpu_slot_t slots[SHARPEN_GPU_MAX_SLOTS];
+static int nslots, width, height, zero_copy;
+static size_t frame_bytes;
+
+
+static int check(cudaError_t err, const char *what)
+{
+    if(err == cudaSuccess)
+        return 0;
+    printf("%s: %s\n", what, cudaGetErrorString(err));
+    return -1;
+}
+
+
+// one thread per pixel, all three channels, same integer PSF as the row kernels
+__global__ void sharpen_rgb_kernel(const UINT8 *in, UINT8 *out, int w, int h)
+{
+    int x=blockIdx.x*blockDim.x + threadIdx.x;
+    int y=blockIdx.y*blockDim.y + threadIdx.y;
+    int p, c, s8, t, stride=w*3;
+
+    if(x >= w || y >= h)
+        return;
+    p=(y*w + x)*3;
+
+    // the one pixel border is not convolved
+    if(x == 0 || y == 0 || x == w-1 || y == h-1)
+    {
+        out[p]=in[p]; out[p+1]=in[p+1]; out[p+2]=in[p+2];
+        return;
+    }
+
+    for(c=0; c<3; c++, p++)
+    {
+        s8=in[p-stride-3] + in[p-stride] + in[p-stride+3] +
+           in[p-3]                       + in[p+3] +
+           in[p+stride-3] + in[p+stride] + in[p+stride+3];
+        t=((PSF_C8 * in[p]) - (PSF_N * s8)) >> 3;
+        out[p]=(UINT8)(t < 0 ? 0 : (t > 255 ? 255 : t));
+    }
+}
+
+
+extern "C" int sharpen_gpu_init(const char *name, int w, int h, int n)
+{
+    cudaDeviceProp prop;
+    int i, dev;
+
+    if(strcmp(name, sharpen_gpu_name) != 0)
+    {
+        printf("built with GPU=%s, not %s\n", sharpen_gpu_name, name);
+        return -1;
+    }
+    if(K != (double)K_INT || n < 1 || n > SHARPEN_GPU_MAX_SLOTS)
+    {
+        printf("cuda kernel needs an integer K and 1..%d slots\n", SHARPEN_GPU_MAX_SLOTS);
+        return -1;
+    }
+
+    if(check(cudaGetDevice(&dev), "cudaGetDevice") < 0 || check(cudaGetDeviceProperties(&prop, dev), "cudaGetDeviceProperties") < 0)
+        return -1;
+
+    // integrated means the GPU and the CPU share the same DRAM
+    zero_copy=prop.integrated && prop.canMapHostMemory;
+    if(zero_copy && check(cudaSetDeviceFlags(cudaDeviceMapHost), "cudaSetDeviceFlags") < 0)
+        return -1;
+
+    width=w; height=h; nslots=n;
+    frame_bytes=(size_t)w*h*3;
+
+    for(i=0; i<nslots; i++)
+    {
+        if(check(cudaStreamCreateWithFlags(&slots[i].stream, cudaStreamNonBlocking), "cudaStreamCreate") < 0)
+            return -1;
+        if(!zero_copy &&
+           (check(cudaMalloc((void **)&slots[i].d_in, frame_bytes), "cudaMalloc") < 0 ||
+            check(cudaMalloc((void **)&slots[i].d_out, frame_bytes), "cudaMalloc") < 0))
+            return -1;
+    }
+
+    snprintf(sharpen_gpu_device, sizeof(sharpen_gpu_device), "%s, %s", prop.name,
+             zero_copy ? "unified memory, zero copy" : "pinned host buffers");
+    return 0;
+}
+
+
+extern "C" UINT8 *sharpen_gpu_alloc(size_t size)
+{
+    void *buf;
+
+    if(check(cudaHostAlloc(&buf, size, zero_copy ? cudaHostAllocMapped : cudaHostAllocDefault), "cudaHostAlloc") < 0)
+        return NULL;
+    return (UINT8 *)buf;
+}
+
+
+extern "C" void sharpen_gpu_free(UINT8 *buf)
+{
+    cudaFreeHost(buf);
+}
+
+
+extern "C" int sharpen_gpu_submit(int slot, const UINT8 *in, UINT8 *out)
+{
+    gpu_slot_t *s=&slots[slot];
+    dim3 block(BLOCK_W, BLOCK_H);
+    dim3 grid((width+BLOCK_W-1)/BLOCK_W, (height+BLOCK_H-1)/BLOCK_H);
+    UINT8 *d_in, *d_out;
+
+    if(zero_copy)
+    {
+        if(check(cudaHostGetDevicePointer((void **)&d_in, (void *)in, 0), "cudaHostGetDevicePointer") < 0 ||
+           check(cudaHostGetDevicePointer((void **)&d_out, (void *)out, 0), "cudaHostGetDevicePointer") < 0)
+            return -1;
+    }
+    else
+    {
+        d_in=s->d_in; d_out=s->d_out;
+        if(check(cudaMemcpyAsync(d_in, in, frame_bytes, cudaMemcpyHostToDevice, s->stream), "upload") < 0)
+            return -1;
+    }
+
+    sharpen_rgb_kernel<<<grid, block, 0, s->stream>>>(d_in, d_out, width, height);
+    if(check(cudaGetLastError(), "sharpen_rgb_kernel") < 0)
+        return -1;
+
+    if(!zero_copy && check(cudaMemcpyAsync(out, d_out, frame_bytes, cudaMemcpyDeviceToHost, s->stream), "download") < 0)
+        return -1;
+    return 0;
+}
+
+
+extern "C" int sharpen_gpu_wait(int slot)
+{
+    return check(cudaStreamSynchronize(slots[slot].stream), "cudaStreamSynchronize");
+}
+
+
+extern "C" void sharpen_gpu_close(void)
+{
+    int i;
+
+    for(i=0; i<nslots; i++)
+    {
+        cudaStreamSynchronize(slots[i].stream);
+        cudaStreamDestroy(slots[i].stream);
+        if(!zero_copy)
+        {
+            cudaFree(slots[i].d_in);
+            cudaFree(slots[i].d_out);
+        }
+    }
+    nslots=0;
+}
@@ -5,34 +5,59 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <sched.h>
+#include <string.h>
 #include <time.h>
+#include <sys/mman.h>
 
-
-#define IMG_HEIGHT (3000)
-#define IMG_WIDTH (4000)
-
-//#define IMG_HEIGHT (300)
-//#define IMG_WIDTH (400)
+#include "ppm_io.h"
+#include "frame_pool.h"
+#include "sharpen_kernel.h"
+#include "steal_sched.h"
+#include "sharpen_stats.h"
+#include "rtinit.h"
+#include "sharpen_gpu.h"
+#include "conv_kernel.h"
+#include "rtenv.h"
 
 
+// Image size comes from the PPM header, the grid defaults to 3x4 and can be
+// changed with -r rows -c cols, e.g. 6x8 or 12x16
 #define NUM_ROW_THREADS (3)
 #define NUM_COL_THREADS (4)
 
-//#define NUM_ROW_THREADS (6)
-//#define NUM_COL_THREADS (8)
+#define ITERATIONS (3000)
 
-//#define NUM_ROW_THREADS (12)
-//#define NUM_COL_THREADS (16)
+// image layouts, selected with -l, -b benchmarks all of them
+#define LAYOUT_PLANAR (0)       // separate R, G, B planes, one tile row of each per pass
+#define LAYOUT_INTERLEAVED (1)  // RGB interleaved, one stream in and one out
+#define LAYOUT_TILED (2)        // planar, cache blocked tiles of TILE_H x TILE_W
+#define LAYOUT_BANDED (3)       // planar, one full width row band per worker in
+                                // its own memory, only the halo rows shared
+#define NUM_LAYOUTS (4)
 
-#define IMG_H_SLICE (IMG_HEIGHT/NUM_ROW_THREADS)
-#define IMG_W_SLICE (IMG_WIDTH/NUM_COL_THREADS)
+// tile sized so the input rows plus halo and the output rows of one plane
+// stay in a 32K L1 on the Cortex-A cores
+#define TILE_H (32)
+#define TILE_W (256)
 
-#define ITERATIONS (3000)
-#define HEADER_SZ (38) //not 21
+// image buffers start on a cache line
+#define BUF_ALIGN (64)
 
-typedef double FLOAT;
+// with -s each worker tile is cut into this many row band tasks that idle
+// workers can steal
+#define STEAL_SPLIT (8)
 
-pthread_t threads[NUM_ROW_THREADS*NUM_COL_THREADS];
+// Release persistent pinned workers once per frame rather than creating and
+// joining rows*cols threads for every frame
+#define PERSISTENT_POOL
+
+// lock memory and prefault every image buffer before the first frame, see
+// rtinit.h, and with HUGE_BUFFERS back the buffers with 2 MB pages
+#define MEMORY_LOCK
+#define HUGE_BUFFERS
+
+pthread_t *threads;
+frame_pool_t pool;
 
 typedef struct _threadArgs
 {
@@ -43,224 +68,928 @@ typedef struct _threadArgs
     int w;
 } threadArgsType;
 
-threadArgsType threadarg[NUM_ROW_THREADS*NUM_COL_THREADS];
+threadArgsType *threadarg;
+void **poolargs;
+int num_threads;
+
+// work-stealing mode tasks, worker i starts with task_first[i] .. task_first[i+1]-1
+int steal_mode=0;
+steal_sched_t sched;
+threadArgsType *taskarg;
+void **taskargs;
+void **stealargs;
+int *task_first;
+
+// -i iterates: frame N's output is frame N+1's input, the input and output
+// buffers swapped by pointer between frames, nothing copied
+int iterate=0;
+
+// -d incremental: each worker tile is cut into DIRTY_H x DIRTY_W dirty
+// tiles, and a tile is only sharpened again when its input, one pixel
+// halo included, changed since the frame that last sharpened it,
+// otherwise that frame's output is left in conv*.  A tile has changed
+//
+//    -d hash   when the fingerprint of its input differs, which reads all
+//              of the input, so it pays off when the kernel is compute
+//              bound, psf, and not when it is memory bound, avx2
+//    -d mask   when whoever changed the input flagged it, -m below, reads
+//              nothing for an unchanged tile, as from a camera that
+//              reports its changed regions
+#define DIRTY_H (32)
+#define DIRTY_W (256)
+#define DIRTY_HASH (1)
+#define DIRTY_MASK (2)
+int dirty_mode=0, dirty_valid;
+UINT64 *dirty_fp;                   // per dirty tile, in worker order
+UINT8 *dirty_mask;
+int *dirty_first;                   // worker t's tiles start at dirty_first[t]
+unsigned long long *dirty_done;     // tiles sharpened per worker
+
+// -m pct: a full width band of pct% of the rows changes every frame, a
+// stand in for a low motion camera scene
+int motion_pct=0;
+
+// -k cuda|opencl sharpens whole interleaved frames on the GPU, one at a
+// time, in buffers from sharpen_gpu_alloc(), see sharpen_gpu.h
+int gpu=0;
+
+// -f runs an NxN filter from conv_kernel.h, planar, on the same tiles and
+// workers as the PSF, which then leave a border of n/2 pixels rather than 1
+conv_filter_t *filter=NULL;
+int border=1;
+
+// -T timing, per worker per frame, reported as CSV after the run
+char *stats_prefix=NULL;
+sharpen_stats_t stats;
+UINT64 read_ns, write_ns;
+
+// -E pins the performance governor and counts every worker, see rtenv.h,
+// the governor and clocks are checked around the frames either way
+int env_pin=0;
+
 pthread_attr_t fifo_sched_attr;
 pthread_attr_t orig_sched_attr;
 struct sched_param fifo_param;
 
 typedef unsigned int UINT32;
 typedef unsigned long long int UINT64;
-typedef unsigned char UINT8;
 
 // PPM Edge Enhancement Code
-UINT8 header[HEADER_SZ];
-UINT8 R[IMG_HEIGHT][IMG_WIDTH];
-UINT8 G[IMG_HEIGHT][IMG_WIDTH];
-UINT8 B[IMG_HEIGHT][IMG_WIDTH];
-UINT8 convR[IMG_HEIGHT][IMG_WIDTH];
-UINT8 convG[IMG_HEIGHT][IMG_WIDTH];
-UINT8 convB[IMG_HEIGHT][IMG_WIDTH];
-
-#define K 4.0
+ppm_header_t header;
+int img_h, img_w;
+UINT8 *R, *G, *B;
+UINT8 *convR, *convG, *convB;
+
+// interleaved copy, only allocated for LAYOUT_INTERLEAVED
+UINT8 *RGB, *convRGB;
+
+// LAYOUT_BANDED: every worker owns rows i .. i+h-1 of each plane in its
+// own buffers, in[] and out[] both with one halo row above and below so
+// they can swap for -i.
+// The worker maps and first touches them itself, so on a NUMA box they
+// sit on the node of the core frame_pool pins it to, and per frame it
+// only reads its two halo rows from the neighbouring bands.
+typedef struct _band
+{
+    int i, h;
+    UINT8 *in[3], *out[3];
+    struct _band *above, *below;
+} band_t;
 
-FLOAT PSF[9] = {-K/8.0, -K/8.0, -K/8.0, -K/8.0, K+1.0, -K/8.0, -K/8.0, -K/8.0, -K/8.0};
-//FLOAT PSF[9] = {-K/80.0, -K/80.0, -K/80.0, -K/80.0, K+10.0, -K/80.0, -K/80.0, -K/80.0, -K/80.0};
+band_t *bands;
+void **bandargs;
 
 
 void *sharpen_thread(void *threadptr)
 {
     threadArgsType thargs=*((threadArgsType *)threadptr);
-    int i=thargs.i;
-    int j=thargs.j;
-    FLOAT temp=0;
+    int i, p;
 
     //printf("i=%d, j=%d, h=%d, w=%d\n", thargs.i, thargs.j, thargs.h, thargs.w);
 
     for(i=thargs.i; i<(thargs.i+thargs.h); i++)
     {
-        for(j=thargs.j; j<(thargs.j+thargs.w); j++)
+        p=(i*img_w)+thargs.j;
+        sharpen_row(&R[p-img_w], &R[p], &R[p+img_w], &convR[p], thargs.w);
+        sharpen_row(&G[p-img_w], &G[p], &G[p+img_w], &convG[p], thargs.w);
+        sharpen_row(&B[p-img_w], &B[p], &B[p+img_w], &convB[p], thargs.w);
+    }
+
+    return (void *)0;
+}
+
+
+// Planar layout, -f - the NxN filter over the worker's tile of each plane
+void *filter_thread(void *threadptr)
+{
+    threadArgsType thargs=*((threadArgsType *)threadptr);
+
+    conv_plane_tile(filter, R, convR, img_w, thargs.i, thargs.j, thargs.h, thargs.w);
+    conv_plane_tile(filter, G, convG, img_w, thargs.i, thargs.j, thargs.h, thargs.w);
+    conv_plane_tile(filter, B, convB, img_w, thargs.i, thargs.j, thargs.h, thargs.w);
+
+    return (void *)0;
+}
+
+
+// Interleaved layout - see sharpen_rgb_tile(), main memory sees one stream
+// in and one stream out instead of three of each
+void *sharpen_thread_rgb(void *threadptr)
+{
+    threadArgsType thargs=*((threadArgsType *)threadptr);
+
+    sharpen_rgb_tile(RGB, convRGB, img_w, thargs.i, thargs.j, thargs.h, thargs.w);
+
+    return (void *)0;
+}
+
+
+// Tiled layout - planar data swept in TILE_H x TILE_W blocks, one plane at a
+// time, with the halo rows above and below each block
+void *sharpen_thread_tiled(void *threadptr)
+{
+    threadArgsType thargs=*((threadArgsType *)threadptr);
+    int i, p, ti, tj, th, tw;
+
+    for(ti=thargs.i; ti<(thargs.i+thargs.h); ti+=TILE_H)
+    {
+        th=((thargs.i+thargs.h)-ti < TILE_H) ? (thargs.i+thargs.h)-ti : TILE_H;
+
+        for(tj=thargs.j; tj<(thargs.j+thargs.w); tj+=TILE_W)
         {
-            temp=0;
-            temp += (PSF[0] * (FLOAT)R[(i-1)][j-1]);
-            temp += (PSF[1] * (FLOAT)R[(i-1)][j]);
-            temp += (PSF[2] * (FLOAT)R[(i-1)][j+1]);
-            temp += (PSF[3] * (FLOAT)R[(i)][j-1]);
-            temp += (PSF[4] * (FLOAT)R[(i)][j]);
-            temp += (PSF[5] * (FLOAT)R[(i)][j+1]);
-            temp += (PSF[6] * (FLOAT)R[(i+1)][j-1]);
-            temp += (PSF[7] * (FLOAT)R[(i+1)][j]);
-            temp += (PSF[8] * (FLOAT)R[(i+1)][j+1]);
-	    if(temp<0.0) temp=0.0;
-	    if(temp>255.0) temp=255.0;
-	    convR[i][j]=(UINT8)temp;
-
-            temp=0;
-            temp += (PSF[0] * (FLOAT)G[(i-1)][j-1]);
-            temp += (PSF[1] * (FLOAT)G[(i-1)][j]);
-            temp += (PSF[2] * (FLOAT)G[(i-1)][j+1]);
-            temp += (PSF[3] * (FLOAT)G[(i)][j-1]);
-            temp += (PSF[4] * (FLOAT)G[(i)][j]);
-            temp += (PSF[5] * (FLOAT)G[(i)][j+1]);
-            temp += (PSF[6] * (FLOAT)G[(i+1)][j-1]);
-            temp += (PSF[7] * (FLOAT)G[(i+1)][j]);
-            temp += (PSF[8] * (FLOAT)G[(i+1)][j+1]);
-	    if(temp<0.0) temp=0.0;
-	    if(temp>255.0) temp=255.0;
-	    convG[i][j]=(UINT8)temp;
-
-            temp=0;
-            temp += (PSF[0] * (FLOAT)B[(i-1)][j-1]);
-            temp += (PSF[1] * (FLOAT)B[(i-1)][j]);
-            temp += (PSF[2] * (FLOAT)B[(i-1)][j+1]);
-            temp += (PSF[3] * (FLOAT)B[(i)][j-1]);
-            temp += (PSF[4] * (FLOAT)B[(i)][j]);
-            temp += (PSF[5] * (FLOAT)B[(i)][j+1]);
-            temp += (PSF[6] * (FLOAT)B[(i+1)][j-1]);
-            temp += (PSF[7] * (FLOAT)B[(i+1)][j]);
-            temp += (PSF[8] * (FLOAT)B[(i+1)][j+1]);
-	    if(temp<0.0) temp=0.0;
-	    if(temp>255.0) temp=255.0;
-	    convB[i][j]=(UINT8)temp;
+            tw=((thargs.j+thargs.w)-tj < TILE_W) ? (thargs.j+thargs.w)-tj : TILE_W;
+
+            for(i=ti, p=(ti*img_w)+tj; i<(ti+th); i++, p+=img_w)
+                sharpen_row(&R[p-img_w], &R[p], &R[p+img_w], &convR[p], tw);
+            for(i=ti, p=(ti*img_w)+tj; i<(ti+th); i++, p+=img_w)
+                sharpen_row(&G[p-img_w], &G[p], &G[p+img_w], &convG[p], tw);
+            for(i=ti, p=(ti*img_w)+tj; i<(ti+th); i++, p+=img_w)
+                sharpen_row(&B[p-img_w], &B[p], &B[p+img_w], &convB[p], tw);
         }
-
     }
 
-    pthread_exit((void **)0);
+    return (void *)0;
 }
 
 
-int main(int argc, char *argv[])
+// Fingerprint of h rows of w >= 8 pixels at (i0, j0) of a plane, chained
+// on from fp: a multiply-xorshift per 8 bytes in four independent lanes,
+// so the multiplies overlap, and the row tail as its last 8 bytes
+#define FP_MIX(x, v, k) ((x)=((x) ^ (v))*(k), (x)^=(x) >> 29)
+
+UINT64 fingerprint(const UINT8 *plane, int i0, int j0, int h, int w, UINT64 fp)
 {
-    int fdin, fdout, bytesRead=0, bytesLeft, i, j, idx, jdx;
-    UINT64 microsecs=0, millisecs=0;
-    unsigned int thread_idx;
-    FLOAT temp, fnow, fstart;
-    int runs=0;
-    struct timespec now, start;
+    UINT64 a=fp, b=~fp, c=fp ^ 0x9E3779B97F4A7C15ULL, d=fp + 0x9E3779B97F4A7C15ULL, v[4];
+    const UINT8 *p;
+    int i, k;
 
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    fstart = (FLOAT)start.tv_sec + (FLOAT)start.tv_nsec / 1000000000.0;
-    
-    if(argc < 3)
+    for(i=i0; i<(i0+h); i++)
     {
-       printf("Usage: sharpen input_file.ppm output_file.ppm\n");
-       exit(-1);
+        p=&plane[(size_t)i*img_w + j0];
+        for(k=0; k+32 <= w; k+=32)
+        {
+            memcpy(v, p+k, 32);
+            FP_MIX(a, v[0], 0x9E3779B97F4A7C15ULL);
+            FP_MIX(b, v[1], 0xBF58476D1CE4E5B9ULL);
+            FP_MIX(c, v[2], 0x94D049BB133111EBULL);
+            FP_MIX(d, v[3], 0xD6E8FEB86659FD93ULL);
+        }
+        for(; k+8 <= w; k+=8)
+        {
+            memcpy(v, p+k, 8);
+            FP_MIX(a, v[0], 0x9E3779B97F4A7C15ULL);
+        }
+        if(k < w)
+        {
+            memcpy(v, p+w-8, 8);
+            FP_MIX(b, v[0], 0xBF58476D1CE4E5B9ULL);
+        }
     }
-    else
+
+    FP_MIX(a, b, 0x94D049BB133111EBULL);
+    FP_MIX(c, d, 0x94D049BB133111EBULL);
+    return a ^ (c*0xD6E8FEB86659FD93ULL);
+}
+
+
+// Planar layout, -d - only the dirty tiles whose input changed
+void *sharpen_thread_dirty(void *threadptr)
+{
+    threadArgsType thargs=*((threadArgsType *)threadptr);
+    UINT64 *fp=&dirty_fp[dirty_first[thargs.thread_idx]], f;
+    UINT8 *mask=&dirty_mask[dirty_first[thargs.thread_idx]];
+    unsigned long long done=0;
+    int i, p, ti, tj, th, tw;
+
+    for(ti=thargs.i; ti<(thargs.i+thargs.h); ti+=DIRTY_H)
     {
-        if((fdin = open(argv[1], O_RDONLY, 0644)) < 0)
+        th=((thargs.i+thargs.h)-ti < DIRTY_H) ? (thargs.i+thargs.h)-ti : DIRTY_H;
+
+        for(tj=thargs.j; tj<(thargs.j+thargs.w); tj+=DIRTY_W, fp++, mask++)
         {
-            printf("Error opening %s\n", argv[1]);
+            tw=((thargs.j+thargs.w)-tj < DIRTY_W) ? (thargs.j+thargs.w)-tj : DIRTY_W;
+
+            if(dirty_mode == DIRTY_MASK)
+            {
+                if(dirty_valid && !*mask)
+                    continue;
+                *mask=0;
+            }
+            else
+            {
+                // everything the tile's output depends on
+                f=fingerprint(R, ti-1, tj-1, th+2, tw+2, 0);
+                f=fingerprint(G, ti-1, tj-1, th+2, tw+2, f);
+                f=fingerprint(B, ti-1, tj-1, th+2, tw+2, f);
+                if(dirty_valid && f == *fp)
+                    continue;
+                *fp=f;
+            }
+            done++;
+
+            for(i=ti, p=(ti*img_w)+tj; i<(ti+th); i++, p+=img_w)
+            {
+                sharpen_row(&R[p-img_w], &R[p], &R[p+img_w], &convR[p], tw);
+                sharpen_row(&G[p-img_w], &G[p], &G[p+img_w], &convG[p], tw);
+                sharpen_row(&B[p-img_w], &B[p], &B[p+img_w], &convB[p], tw);
+            }
         }
-        //else
-        //    printf("File opened successfully\n");
+    }
+
+    dirty_done[thargs.thread_idx]+=done;
+    return (void *)0;
+}
+
+
+// Flag every dirty tile whose input, halo included, has a row in r0 .. r1-1
+void mark_dirty_rows(int r0, int r1)
+{
+    int t, ti, th, k;
+
+    for(t=0; t<num_threads; t++)
+    {
+        threadArgsType *tile=&threadarg[t];
+        int per_row=(tile->w+DIRTY_W-1)/DIRTY_W;
 
-        if((fdout = open(argv[2], (O_RDWR | O_CREAT), 0666)) < 0)
+        for(ti=tile->i, k=dirty_first[t]; ti<(tile->i+tile->h); ti+=DIRTY_H, k+=per_row)
         {
-            printf("Error opening %s\n", argv[1]);
+            th=((tile->i+tile->h)-ti < DIRTY_H) ? (tile->i+tile->h)-ti : DIRTY_H;
+            if(ti-1 < r1 && ti+th+1 > r0)
+                memset(&dirty_mask[k], 1, per_row);
         }
-        //else
-        //    printf("Output file=%s opened successfully\n", "sharpen.ppm");
     }
+}
 
-    bytesLeft=HEADER_SZ;
 
-    //printf("Reading header\n");
+// -m: add one to every pixel of the band, which moves down a band height
+// per frame
+void apply_motion(int frame)
+{
+    int bh=(img_h*motion_pct)/100, i0, i1, n;
+
+    if(bh < 1) return;
+    i0=(frame*bh) % img_h;
+    i1=(i0+bh < img_h) ? i0+bh : img_h;
 
-    do
+    for(n=i0*img_w; n<i1*img_w; n++)
     {
-        //printf("bytesRead=%d, bytesLeft=%d\n", bytesRead, bytesLeft);
-        bytesRead=read(fdin, (void *)header, bytesLeft);
-        bytesLeft -= bytesRead;
+        R[n]++; G[n]++; B[n]++;
+    }
 
-    } while(bytesLeft > 0);
+    if(dirty_mode == DIRTY_MASK)
+        mark_dirty_rows(i0, i1);
+}
 
-    header[HEADER_SZ]='\0';
 
-    //printf("header = %s\n", header); 
+// Banded layout - the worker's own rows, after refreshing its halo rows
+// from the first row of the band below and the last row of the band above
+void *sharpen_thread_banded(void *bandptr)
+{
+    band_t *band=(band_t *)bandptr;
+    int c, k, p, w=img_w;
 
-    // Read RGB data - very slow 1 byte at a time!
-    for(i=0; i<IMG_HEIGHT; i++)
+    for(c=0; c<3; c++)
     {
-        for(j=0; j<IMG_WIDTH; j++)
+        // the image border rows of the first and last band never change
+        if(band->above)
+            memcpy(band->in[c], &band->above->in[c][band->above->h*w], w);
+        if(band->below)
+            memcpy(&band->in[c][(band->h+1)*w], &band->below->in[c][w], w);
+
+        for(k=0, p=w+1; k<band->h; k++, p+=w)
+            sharpen_row(&band->in[c][p-w], &band->in[c][p], &band->in[c][p+w], &band->out[c][p], w-2);
+    }
+
+    return (void *)0;
+}
+
+
+const char *layout_name[NUM_LAYOUTS] = {"planar", "interleaved", "tiled", "banded"};
+frame_fn_t layout_fn[NUM_LAYOUTS] = {sharpen_thread, sharpen_thread_rgb, sharpen_thread_tiled, sharpen_thread_banded};
+FLOAT fstart;
+
+
+// fresh anonymous pages, so the first touch is the caller's
+UINT8 *band_buffer(size_t size)
+{
+    void *buf=mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(buf == MAP_FAILED)
+    {
+        printf("Error mapping %zu byte band buffer\n", size);
+        exit(-1);
+    }
+
+    return (UINT8 *)buf;
+}
+
+
+// run once by each band's own worker, copies the band and its halos in
+void *band_load(void *bandptr)
+{
+    band_t *band=(band_t *)bandptr;
+    UINT8 *src[3]={R, G, B};
+    int c;
+
+    for(c=0; c<3; c++)
+    {
+        band->in[c]=band_buffer((size_t)(band->h+2)*img_w);
+        band->out[c]=band_buffer((size_t)(band->h+2)*img_w);
+        memcpy(band->in[c], &src[c][(band->i-1)*img_w], (size_t)(band->h+2)*img_w);
+
+        // border columns and the image border rows are not convolved,
+        // start them as the input in both buffers
+        memcpy(band->out[c], band->in[c], (size_t)(band->h+2)*img_w);
+    }
+
+    return (void *)0;
+}
+
+
+// load every band from the worker that will own it, the same pinning as
+// the frame pool that runs the frames
+void bands_load(void)
+{
+    frame_pool_t loader;
+
+    if(frame_pool_create(&loader, num_threads, band_load, bandargs) != 0)
+        exit(-1);
+    frame_pool_run(&loader);
+    frame_pool_destroy(&loader);
+}
+
+
+// copy the bands back into the full size output planes and unmap them
+void bands_store(void)
+{
+    UINT8 *dst[3]={convR, convG, convB};
+    int t, c;
+
+    for(t=0; t<num_threads; t++)
+    {
+        for(c=0; c<3; c++)
         {
-            read(fdin, (void *)&R[i][j], 1); convR[i][j]=R[i][j];
-            read(fdin, (void *)&G[i][j], 1); convG[i][j]=G[i][j];
-            read(fdin, (void *)&B[i][j], 1); convB[i][j]=B[i][j];
+            memcpy(&dst[c][bands[t].i*img_w], &bands[t].out[c][img_w], (size_t)bands[t].h*img_w);
+            munmap(bands[t].in[c], (size_t)(bands[t].h+2)*img_w);
+            munmap(bands[t].out[c], (size_t)(bands[t].h+2)*img_w);
         }
     }
-    printf("source file %s read\n", argv[1]);
-    close(fdin);
+}
+
+
+// -i: last frame's output becomes this frame's input.  The border pixels
+// of both buffers were set once and are never written, so they stay valid.
+void swap_buffers(int layout)
+{
+    UINT8 *t;
+    int b, c;
+
+    if(layout == LAYOUT_INTERLEAVED)
+    {
+        t=RGB; RGB=convRGB; convRGB=t;
+    }
+    else if(layout == LAYOUT_BANDED)
+    {
+        for(b=0; b<num_threads; b++)
+            for(c=0; c<3; c++)
+            {
+                t=bands[b].in[c]; bands[b].in[c]=bands[b].out[c]; bands[b].out[c]=t;
+            }
+    }
+    else
+    {
+        t=R; R=convR; convR=t;
+        t=G; G=convG; convG=t;
+        t=B; B=convB; convB=t;
+    }
+}
+
+
+// Bytes a frame of layout moves: every input pixel read once, every
+// interior pixel written once, and for banded the halo rows copied
+void report_frame_bytes(int layout)
+{
+    size_t read=(size_t)img_h*img_w*3, written=(size_t)(img_h-2*border)*(img_w-2*border)*3, copied=0;
+
+    if(layout == LAYOUT_BANDED)
+        copied=(size_t)(num_threads-1)*2*img_w*3;
+
+    printf("%s per frame: %zu bytes read, %zu written, %zu copied, %s\n", layout_name[layout], read, written,
+           copied, iterate ? "buffers swapped" : "same input every frame");
+}
+
+
+// Run frames of one layout and return the elapsed seconds
+FLOAT run_layout(int layout, int frames)
+{
+#ifndef PERSISTENT_POOL
+    int thread_idx;
+#endif
+    int runs, idx;
+    unsigned long long done;
+    FLOAT fnow, ftest;
+    struct timespec now;
+#ifdef MEMORY_LOCK
+    rti_faults_t run_faults;
+#endif
+    frame_fn_t fn=(filter != NULL) ? filter_thread : layout_fn[layout];
+    void **args=(layout == LAYOUT_BANDED) ? bandargs : poolargs;
+
+    // bands are not split into row band tasks, each is its own memory
+    if(layout == LAYOUT_BANDED)
+        bands_load();
+    else if(dirty_mode)
+    {
+        fn=sharpen_thread_dirty;
+        dirty_valid=0;
+        memset(dirty_done, 0, num_threads*sizeof(unsigned long long));
+    }
+    else if(steal_mode)
+    {
+        steal_init(&sched, num_threads, fn, taskargs, task_first);
+        fn=steal_worker; args=stealargs;
+    }
+
+    if(stats_prefix != NULL)
+    {
+        if(stats_init(&stats, num_threads, frames, fn, args) < 0)
+            exit(-1);
+        fn=stats_worker; args=stats.args;
+    }
 
+#ifdef PERSISTENT_POOL
+    if(!gpu)
+        frame_pool_create(&pool, num_threads, fn, args);
+#endif
+#ifdef MEMORY_LOCK
+    rti_faults(&run_faults);
+#endif
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ftest = (FLOAT)now.tv_sec + (FLOAT)now.tv_nsec / 1000000000.0;
+    printf("start %s test at %lf\n", layout_name[layout], ftest - fstart);
+
+    for(runs=0; runs < frames; runs++)
+    {
+        // before the frame rather than after it, so the output of the last
+        // frame is left in the conv buffers for the write
+        if(iterate && runs > 0) swap_buffers(layout);
+        if(motion_pct && runs > 0) apply_motion(runs);
+        if(steal_mode) steal_reset(&sched);
+        if(stats_prefix != NULL) stats_frame_begin(&stats, runs);
+
+#ifdef SHARPEN_GPU
+        if(gpu)
+        {
+            // upload, kernel and download of the whole frame, border included
+            if(sharpen_gpu_submit(0, RGB, convRGB) < 0 || sharpen_gpu_wait(0) < 0)
+                exit(-1);
+        }
+        else
+#endif
+#ifdef PERSISTENT_POOL
+        frame_pool_run(&pool);
+#else
+        {
+            for(thread_idx=0; thread_idx<num_threads; thread_idx++)
+            {
+                //printf("create thread_idx=%d\n", thread_idx);
+                pthread_create(&threads[thread_idx], (void *)0, fn, args[thread_idx]);
+            }
+
+            for(thread_idx=0; thread_idx<num_threads; thread_idx++)
+            {
+                //printf("join thread_idx=%d\n", thread_idx);
+                if((pthread_join(threads[thread_idx], (void **)0)) < 0)
+                    perror("pthread_join");
+            }
+        }
+#endif
+
+        if(stats_prefix != NULL) stats_frame_end(&stats, runs);
+
+        // frame 0 sharpened every tile, later frames only the dirty ones
+        dirty_valid=1;
+
+        //printf("frame %d completed\n", runs);
+
+    }
 
     clock_gettime(CLOCK_MONOTONIC, &now);
     fnow = (FLOAT)now.tv_sec + (FLOAT)now.tv_nsec / 1000000000.0;
-    printf("start test at %lf\n", fnow - fstart);
+    printf("stop %s test at %lf for %d frames\n", layout_name[layout], fnow - fstart, runs);
+#ifdef MEMORY_LOCK
+    rti_report("frames", &run_faults);
+#endif
+    report_frame_bytes(layout);
+
+    if(layout == LAYOUT_BANDED)
+        bands_store();
+    else if(dirty_mode)
+    {
+        for(idx=0, done=0; idx<num_threads; idx++)
+            done+=dirty_done[idx];
+        printf("%.1lf of %d dirty tiles per frame sharpened, %.1lf%%\n", (double)done/runs,
+               dirty_first[num_threads], 100.0*done/((double)runs*dirty_first[num_threads]));
+    }
+    else if(steal_mode)
+        printf("%llu of %d tasks per frame stolen on average\n", steal_count(&sched)/runs, task_first[num_threads]);
+
+#ifdef PERSISTENT_POOL
+    if(!gpu)
+        frame_pool_destroy(&pool);
+#endif
+
+    return fnow - ftest;
+}
+
+
+// Copy only the border, which no layout convolves, b pixels wide, of a
+// w x h image of bpp bytes per pixel
+void copy_border(UINT8 *dst, const UINT8 *src, int w, int h, int bpp, int b)
+{
+    size_t row=(size_t)w*bpp, edge=(size_t)b*bpp;
+    int i;
 
-    for(runs=0; runs < ITERATIONS; runs++)
+    memcpy(dst, src, b*row);
+    memcpy(&dst[(h-b)*row], &src[(h-b)*row], b*row);
+
+    for(i=b; i<h-b; i++)
     {
+        memcpy(&dst[i*row], &src[i*row], edge);
+        memcpy(&dst[i*row + row-edge], &src[i*row + row-edge], edge);
+    }
+}
+
 
-        for(thread_idx=0; thread_idx<(NUM_ROW_THREADS*NUM_COL_THREADS); thread_idx++)
+// cache line aligned image buffer, exits on failure like the rest of main
+UINT8 *alloc_buffer(size_t size)
+{
+    void *buf;
+
+#ifdef SHARPEN_GPU
+    // the only buffers of a GPU run, RGB and convRGB, have to be ones the
+    // device can reach
+    if(gpu)
+    {
+        if((buf=sharpen_gpu_alloc(size)) == NULL)
         {
+            printf("Error allocating %zu byte GPU frame buffer\n", size);
+            exit(-1);
+        }
+        return (UINT8 *)buf;
+    }
+#endif
+
+#ifdef MEMORY_LOCK
+#ifdef HUGE_BUFFERS
+    // a 120K pixel plane is far below a huge page, round up only the big ones
+    if((buf=rti_alloc(size, BUF_ALIGN, size >= RTI_HUGE_PAGE)) == NULL)
+#else
+    if((buf=rti_alloc(size, BUF_ALIGN, 0)) == NULL)
+#endif
+#else
+    if(posix_memalign(&buf, BUF_ALIGN, size) != 0)
+#endif
+    {
+        printf("Error allocating %zu byte image buffer\n", size);
+        exit(-1);
+    }
 
-            if(thread_idx == 0) {idx=1; jdx=1;}
-            if(thread_idx == 1) {idx=1; jdx=(thread_idx*(IMG_W_SLICE-1));}
-            if(thread_idx == 2) {idx=1; jdx=(thread_idx*(IMG_W_SLICE-1));}
-            if(thread_idx == 3) {idx=1; jdx=(thread_idx*(IMG_W_SLICE-1));}
+    return (UINT8 *)buf;
+}
+
+
+// Split the interior (everything but the border) into rows x cols
+// tiles, spreading any remainder so tile sizes differ by at most one
+void decompose_grid(int rows, int cols)
+{
+    int r, c, idx, i0, i1, j0, j1, b=border;
 
-            if(thread_idx == 4) {idx=IMG_H_SLICE; jdx=(thread_idx*(IMG_W_SLICE-1));}
-            if(thread_idx == 5) {idx=IMG_H_SLICE; jdx=(thread_idx*(IMG_W_SLICE-1));}
-            if(thread_idx == 6) {idx=IMG_H_SLICE; jdx=(thread_idx*(IMG_W_SLICE-1));}
-            if(thread_idx == 7) {idx=IMG_H_SLICE; jdx=(thread_idx*(IMG_W_SLICE-1));}
+    for(r=0; r<rows; r++)
+    {
+        i0=b+((r*(img_h-2*b))/rows);
+        i1=b+(((r+1)*(img_h-2*b))/rows);
 
-            if(thread_idx == 8) {idx=(2*(IMG_H_SLICE-1)); jdx=(thread_idx*(IMG_W_SLICE-1));}
-            if(thread_idx == 9) {idx=(2*(IMG_H_SLICE-1)); jdx=(thread_idx*(IMG_W_SLICE-1));}
-            if(thread_idx == 10) {idx=(2*(IMG_H_SLICE-1)); jdx=(thread_idx*(IMG_W_SLICE-1));}
-            if(thread_idx == 11) {idx=(2*(IMG_H_SLICE-1)); jdx=(thread_idx*(IMG_W_SLICE-1));}
+        for(c=0; c<cols; c++)
+        {
+            j0=b+((c*(img_w-2*b))/cols);
+            j1=b+(((c+1)*(img_w-2*b))/cols);
 
-            //printf("idx=%d, jdx=%d\n", idx, jdx);
+            idx=(r*cols)+c;
 
-            threadarg[thread_idx].i=idx;      
-            threadarg[thread_idx].h=IMG_H_SLICE-1;        
-            threadarg[thread_idx].j=jdx;        
-            threadarg[thread_idx].w=IMG_W_SLICE-1;
+            //printf("idx=%d, i=%d, j=%d\n", idx, i0, j0);
 
-            //printf("create thread_idx=%d\n", thread_idx);    
-            pthread_create(&threads[thread_idx], (void *)0, sharpen_thread, (void *)&threadarg[thread_idx]);
+            threadarg[idx].thread_idx=idx;
+            threadarg[idx].i=i0;
+            threadarg[idx].h=i1-i0;
+            threadarg[idx].j=j0;
+            threadarg[idx].w=j1-j0;
 
+            poolargs[idx]=(void *)&threadarg[idx];
         }
+    }
+}
 
-        for(thread_idx=0; thread_idx<(NUM_ROW_THREADS*NUM_COL_THREADS); thread_idx++)
+
+// Cut each worker tile into up to STEAL_SPLIT row bands for -s, in worker
+// order so every worker starts the frame on its own tile
+void split_tasks(void)
+{
+    int t, b, nbands, ntasks=0;
+    threadArgsType *tile;
+
+    for(t=0; t<num_threads; t++)
+    {
+        tile=&threadarg[t];
+        nbands=(tile->h < STEAL_SPLIT) ? tile->h : STEAL_SPLIT;
+        task_first[t]=ntasks;
+
+        for(b=0; b<nbands; b++)
         {
-            //printf("join thread_idx=%d\n", thread_idx);    
-            if((pthread_join(threads[thread_idx], (void **)0)) < 0)
-                perror("pthread_join");
+            taskarg[ntasks]=*tile;
+            taskarg[ntasks].thread_idx=ntasks;
+            taskarg[ntasks].i=tile->i+((b*tile->h)/nbands);
+            taskarg[ntasks].h=(tile->i+(((b+1)*tile->h)/nbands))-taskarg[ntasks].i;
+            taskargs[ntasks]=(void *)&taskarg[ntasks];
+            ntasks++;
         }
 
-        //printf("frame %d completed\n", runs);
+        stealargs[t]=(void *)&sched.workers[t];
+    }
+
+    task_first[num_threads]=ntasks;
+}
+
+
+// One full width band per worker, whatever the grid shape, heights
+// differing by at most one
+void decompose_bands(void)
+{
+    int t;
 
+    for(t=0; t<num_threads; t++)
+    {
+        bands[t].i=1+((t*(img_h-2))/num_threads);
+        bands[t].h=1+(((t+1)*(img_h-2))/num_threads)-bands[t].i;
+        bands[t].above=(t > 0) ? &bands[t-1] : NULL;
+        bands[t].below=(t < num_threads-1) ? &bands[t+1] : NULL;
+        bandargs[t]=(void *)&bands[t];
     }
+}
 
-    clock_gettime(CLOCK_MONOTONIC, &now);
-    fnow = (FLOAT)now.tv_sec + (FLOAT)now.tv_nsec / 1000000000.0;
-    printf("start test at %lf for %d frames\n", fnow - fstart, runs);
 
-    printf("starting sink file %s write\n", argv[2]);
-    write(fdout, (void *)header, HEADER_SZ);
+int main(int argc, char *argv[])
+{
+    int idx, npixels;
+    int opt, layout=LAYOUT_PLANAR, bench=0, frames=ITERATIONS;
+    int rows=NUM_ROW_THREADS, cols=NUM_COL_THREADS;
+    char *kernel=NULL, prefix[256];
+    FLOAT elapsed;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    fstart = (FLOAT)start.tv_sec + (FLOAT)start.tv_nsec / 1000000000.0;
 
-    // Write RGB data - very slow 1 byte at a time!
-    for(i=0; i<IMG_HEIGHT; i++)
+    while((opt=getopt(argc, argv, "k:l:n:r:c:bsid:m:T:f:E")) != -1)
     {
-        for(j=0; j<IMG_WIDTH; j+=1)
+        if(opt == 'k') kernel=optarg;
+        else if(opt == 'f')
+        {
+            if((filter=conv_filter_find(optarg)) == NULL)
+                exit(-1);
+            border=filter->n/2;
+        }
+        else if(opt == 'd')
         {
-            write(fdout, (void *)&convR[i][j], 1);
-            write(fdout, (void *)&convG[i][j], 1);
-            write(fdout, (void *)&convB[i][j], 1);
+            if(strcmp(optarg, "hash") == 0) dirty_mode=DIRTY_HASH;
+            else if(strcmp(optarg, "mask") == 0) dirty_mode=DIRTY_MASK;
+            else argc=0;
         }
+        else if(opt == 'm') motion_pct=atoi(optarg);
+        else if(opt == 'i') iterate=1;
+        else if(opt == 'n') frames=atoi(optarg);
+        else if(opt == 'r') rows=atoi(optarg);
+        else if(opt == 'c') cols=atoi(optarg);
+        else if(opt == 'b') bench=1;
+        else if(opt == 's') steal_mode=1;
+        else if(opt == 'T') stats_prefix=optarg;
+        else if(opt == 'E') env_pin=1;
+        else if(opt == 'l')
+        {
+            for(layout=0; layout<NUM_LAYOUTS; layout++)
+                if(strcmp(optarg, layout_name[layout]) == 0) break;
+            if(layout == NUM_LAYOUTS) argc=0;
+        }
+        else argc=0;
     }
 
+    // the GPU kernels only take whole interleaved frames
+    if(sharpen_gpu_kernel(kernel))
+    {
+        gpu=1;
+        layout=LAYOUT_INTERLEAVED;
+    }
+
+    // -d and -m work on the planar input planes between frames
+    if((argc-optind) < 2 || frames < 1 || rows < 1 || cols < 1 || (iterate && bench) ||
+       (gpu && (bench || steal_mode || stats_prefix != NULL)) ||
+       (filter != NULL && (bench || gpu || dirty_mode || layout != LAYOUT_PLANAR)) ||
+       motion_pct < 0 || motion_pct > 100 ||
+       ((dirty_mode || motion_pct) && (bench || steal_mode || iterate || layout != LAYOUT_PLANAR)))
+    {
+       printf("Usage: sharpen_grid [-k psf|box|sse2|avx2|neon|cuda|opencl] [-l planar|interleaved|tiled|banded] [-b] [-n frames] [-r rows] [-c cols] [-s] [-i] [-d hash|mask] [-m pct] [-T prefix] [-f filter[:impl]] [-E] input_file.ppm output_file.ppm\n");
+       printf("       -b runs every layout and reports MPix/s, the -l layout is written\n");
+       printf("       -s splits each tile into row bands that idle workers steal, not for banded\n");
+       printf("       banded gives each of the rows*cols workers a full width band in its own memory\n");
+       printf("       -i sharpens each frame's output again, ping-pong buffers, one layout, not with -b\n");
+       printf("       -d only sharpens tiles whose input changed, by fingerprint or by the mask -m sets,\n");
+       printf("          -m pct changes a band of pct%% of the rows\n");
+       printf("          every frame, both planar only and not with -b, -s or -i\n");
+       printf("       -T times every worker and frame, writes prefix_{summary,frames,workers}.csv\n");
+       printf("       -k cuda|opencl sharpens interleaved frames on the GPU, with -i but not -b, -s, -d or -T\n");
+       printf("       -f sharpen3|gauss3|gauss5|gauss7|gauss9|unsharp5|unsharp7 runs that NxN filter instead,\n");
+       printf("          planar, :direct, :symmetric or :separable forces an implementation\n");
+       printf("       -E pins the performance governor, root only, and prints each worker's cycles, IPC,\n");
+       printf("          cache misses and context switches\n");
+       exit(-1);
+    }
+
+    num_threads=rows*cols;
+    if(num_threads > FRAME_POOL_MAX_WORKERS)
+    {
+        printf("%dx%d grid is more than %d threads\n", rows, cols, FRAME_POOL_MAX_WORKERS);
+        exit(-1);
+    }
+
+#ifdef MEMORY_LOCK
+    rti_init(0);
+#endif
+
+    if(filter != NULL)
+        printf("using %s %dx%d filter, %s\n", filter->name, filter->n, filter->n, conv_impl_name(filter->impl));
+    else if(!gpu)
+    {
+        if(sharpen_kernel_init(kernel) < 0)
+            exit(-1);
+        printf("using %s PSF kernel\n", sharpen_row_name);
+    }
+
+    // size everything from the header
+    if(ppm_read_header(argv[optind], &header) < 0)
+        exit(-1);
+
+    img_h=header.height; img_w=header.width;
+    npixels=img_h*img_w;
+
+    if(rows > (img_h-2*border) || cols > (img_w-2*border) || ((bench || layout == LAYOUT_BANDED) && num_threads > (img_h-2)))
+    {
+        printf("%dx%d grid does not fit a %dx%d image\n", rows, cols, img_w, img_h);
+        exit(-1);
+    }
+
+    if(gpu)
+    {
+#ifdef SHARPEN_GPU
+        if(sharpen_gpu_init(kernel, img_w, img_h, 1) < 0)
+            exit(-1);
+        printf("using %s PSF kernel on %s, the grid is not used\n", sharpen_gpu_name, sharpen_gpu_device);
+#else
+        printf("-k %s needs a build with make GPU=%s\n", kernel, kernel);
+        exit(-1);
+#endif
+    }
+
+    // Read RGB data - mapped and de-interleaved in one pass, or kept
+    // interleaved for that layout
+    read_ns=stats_now_ns();
+    if(bench || layout != LAYOUT_INTERLEAVED)
+    {
+        R=alloc_buffer(npixels); G=alloc_buffer(npixels); B=alloc_buffer(npixels);
+        convR=alloc_buffer(npixels); convG=alloc_buffer(npixels); convB=alloc_buffer(npixels);
+
+        if(ppm_read_planar(argv[optind], &header, R, G, B, npixels) < 0)
+            exit(-1);
+
+        // borders are not convolved, so start the output with the input's,
+        // every layout writes the whole interior each frame
+        copy_border(convR, R, img_w, img_h, 1, border);
+        copy_border(convG, G, img_w, img_h, 1, border);
+        copy_border(convB, B, img_w, img_h, 1, border);
+    }
+
+    if(bench || layout == LAYOUT_INTERLEAVED)
+    {
+        RGB=alloc_buffer((size_t)npixels*3); convRGB=alloc_buffer((size_t)npixels*3);
+
+        if(ppm_read_rgb(argv[optind], &header, RGB, npixels) < 0)
+            exit(-1);
+
+        copy_border(convRGB, RGB, img_w, img_h, 3, 1);
+    }
+    read_ns=stats_now_ns()-read_ns;
+    printf("source file %s read, %dx%d on a %dx%d grid\n", argv[optind], img_w, img_h, rows, cols);
+
+    threads=malloc(num_threads*sizeof(pthread_t));
+    threadarg=malloc(num_threads*sizeof(threadArgsType));
+    poolargs=malloc(num_threads*sizeof(void *));
+    taskarg=malloc(num_threads*STEAL_SPLIT*sizeof(threadArgsType));
+    taskargs=malloc(num_threads*STEAL_SPLIT*sizeof(void *));
+    stealargs=malloc(num_threads*sizeof(void *));
+    task_first=malloc((num_threads+1)*sizeof(int));
+    bands=calloc(num_threads, sizeof(band_t));
+    bandargs=malloc(num_threads*sizeof(void *));
+    if(threads == NULL || threadarg == NULL || poolargs == NULL || taskarg == NULL ||
+       taskargs == NULL || stealargs == NULL || task_first == NULL || bands == NULL || bandargs == NULL)
+    {
+        printf("Error allocating %d thread args\n", num_threads);
+        exit(-1);
+    }
+
+    // tile decomposition is the same for every frame
+    decompose_grid(rows, cols);
+    split_tasks();
+    decompose_bands();
+
+    // dirty tiles of each worker tile, row major
+    dirty_first=malloc((num_threads+1)*sizeof(int));
+    dirty_done=malloc(num_threads*sizeof(unsigned long long));
+    if(dirty_first == NULL || dirty_done == NULL)
+        exit(-1);
+    for(idx=0, dirty_first[0]=0; idx<num_threads; idx++)
+        dirty_first[idx+1]=dirty_first[idx] + ((threadarg[idx].h+DIRTY_H-1)/DIRTY_H)*((threadarg[idx].w+DIRTY_W-1)/DIRTY_W);
+    if((dirty_fp=calloc(dirty_first[num_threads], sizeof(UINT64))) == NULL ||
+       (dirty_mask=calloc(dirty_first[num_threads], 1)) == NULL)
+        exit(-1);
+
+    rte_begin(env_pin, env_pin);
+
+    if(bench)
+    {
+        for(idx=0; idx<NUM_LAYOUTS; idx++)
+        {
+            elapsed=run_layout(idx, frames);
+            printf("%-12s %8.2lf MPix/s\n", layout_name[idx],
+                   ((FLOAT)npixels*frames) / (elapsed*1000000.0));
+
+            if(stats_prefix != NULL)
+            {
+                stats.read_ns=read_ns;
+                snprintf(prefix, sizeof(prefix), "%s_%s", stats_prefix, layout_name[idx]);
+                stats_report(&stats, prefix);
+                stats_free(&stats);
+            }
+        }
+    }
+    else
+        run_layout(layout, frames);
+
+    // every pool is destroyed by now, so each worker has read its counters
+    rte_end();
+
+    printf("starting sink file %s write\n", argv[optind+1]);
+    write_ns=stats_now_ns();
+    // Write RGB data - interleaved into one buffer and written with one call
+    if(layout == LAYOUT_INTERLEAVED)
+    {
+        if(ppm_write_rgb(argv[optind+1], &header, convRGB, npixels) < 0)
+            exit(-1);
+    }
+    else if(ppm_write_planar(argv[optind+1], &header, convR, convG, convB, npixels) < 0)
+        exit(-1);
+
+    write_ns=stats_now_ns()-write_ns;
+    printf("sink file %s written\n", argv[optind+1]);
+
+    if(stats_prefix != NULL && !bench)
+    {
+        stats.read_ns=read_ns; stats.write_ns=write_ns;
+        stats_report(&stats, stats_prefix);
+        stats_free(&stats);
+    }
 
-    printf("sink file %s written\n", argv[2]);
-    close(fdout);
- 
+#ifdef SHARPEN_GPU
+    if(gpu)
+        sharpen_gpu_close();
+#endif
 }
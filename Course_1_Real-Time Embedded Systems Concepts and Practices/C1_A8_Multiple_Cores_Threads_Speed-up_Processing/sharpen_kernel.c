@@ -0,0 +1,462 @@
+// 3x3 PSF sharpen kernels - double reference plus vectorized integer versions
+//
+// The vector kernels widen to 16-bit lanes and compute
+//
+//     out = clamp((8(K+1)*centre - K*sum8) >> 3, 0, 255)
+//
+// which, for integer K up to 15, is exactly what the double PSF produces after
+// the clamp and truncation to UINT8.  The saturating pack does the clamp.
+//
+// x86 kernels are compiled with target attributes so no -m flags are needed and
+// the choice is made at run time.  NEON needs -mfpu=neon on 32-bit ARM.
+//
+// Building with -DSHARPEN_FIXED=8 or 16 adds a Q8/Q16 fixed-point kernel and
+// makes it the default, for boards where the FPU is the bottleneck.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sharpen_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHARPEN_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SHARPEN_NEON
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+#endif
+
+FLOAT PSF[9] = {-K/8.0, -K/8.0, -K/8.0, -K/8.0, K+1.0, -K/8.0, -K/8.0, -K/8.0, -K/8.0};
+//FLOAT PSF[9] = {-K/80.0, -K/80.0, -K/80.0, -K/80.0, K+10.0, -K/80.0, -K/80.0, -K/80.0, -K/80.0};
+
+// box form, PSF = (K+1+K/8)*centre - (K/8)*(3x3 box sum including the centre)
+#define PSF_BOX_C ((K)+1.0+((K)/8.0))
+#define PSF_BOX_N ((K)/8.0)
+
+// integer form of the PSF scaled by 8
+#define K_INT ((int)(K))
+#define PSF_C8 (8*(K_INT+1))
+#define PSF_N (K_INT)
+
+#ifdef SHARPEN_FIXED
+#if (SHARPEN_FIXED != 8) && (SHARPEN_FIXED != 16)
+#error "SHARPEN_FIXED must be 8 or 16"
+#endif
+
+// Qn coefficients folded from K at compile time - the eight neighbour taps
+// are equal, so the kernel is one centre multiply and one neighbour-sum multiply
+#define PSF_Q_ONE (1 << SHARPEN_FIXED)
+#define PSF_Q_CENTRE ((int)(((K)+1.0)*PSF_Q_ONE + 0.5))
+#define PSF_Q_NEIGH ((int)(((K)/8.0)*PSF_Q_ONE + 0.5))
+#endif
+
+sharpen_row_fn_t sharpen_row=sharpen_row_psf;
+const char *sharpen_row_name="psf";
+
+
+void sharpen_row_psf(const UINT8 *above, const UINT8 *row, const UINT8 *below, UINT8 *out, int n)
+{
+    int j;
+    FLOAT temp;
+
+    for(j=0; j<n; j++)
+    {
+        temp=0;
+        temp += (PSF[0] * (FLOAT)above[j-1]);
+        temp += (PSF[1] * (FLOAT)above[j]);
+        temp += (PSF[2] * (FLOAT)above[j+1]);
+        temp += (PSF[3] * (FLOAT)row[j-1]);
+        temp += (PSF[4] * (FLOAT)row[j]);
+        temp += (PSF[5] * (FLOAT)row[j+1]);
+        temp += (PSF[6] * (FLOAT)below[j-1]);
+        temp += (PSF[7] * (FLOAT)below[j]);
+        temp += (PSF[8] * (FLOAT)below[j+1]);
+        if(temp<0.0) temp=0.0;
+        if(temp>255.0) temp=255.0;
+        out[j]=(UINT8)temp;
+    }
+}
+
+
+// Box-decomposed kernel - one pass of column sums, then each box sum is three
+// of them, about 4 adds a pixel and two multiplies instead of nine.  Neither
+// pass carries a dependency from pixel to pixel, so both vectorize.
+void sharpen_row_box(const UINT8 *above, const UINT8 *row, const UINT8 *below, UINT8 *out, int n)
+{
+    unsigned short col[n+2];
+    int j, box, t;
+    FLOAT temp;
+
+    for(j=0; j<(n+2); j++)
+        col[j] = above[j-1] + row[j-1] + below[j-1];
+
+    for(j=0; j<n; j++)
+    {
+        box = col[j] + col[j+1] + col[j+2];
+
+        // K is a constant, so only one of these survives compilation
+        if((K == (FLOAT)K_INT) && (K_INT >= 0))
+        {
+            t = (((PSF_C8+PSF_N) * row[j]) - (PSF_N * box)) >> 3;
+            if(t < 0) t=0;
+            if(t > 255) t=255;
+            out[j]=(UINT8)t;
+        }
+        else
+        {
+            temp = (PSF_BOX_C * (FLOAT)row[j]) - (PSF_BOX_N * (FLOAT)box);
+            if(temp<0.0) temp=0.0;
+            if(temp>255.0) temp=255.0;
+            out[j]=(UINT8)temp;
+        }
+    }
+}
+
+
+#ifdef SHARPEN_FIXED
+
+// Fixed-point kernel, no FPU use at all.  Exact for integer K, within one
+// LSB of the PSF otherwise.
+void sharpen_row_fixed(const UINT8 *above, const UINT8 *row, const UINT8 *below, UINT8 *out, int n)
+{
+    int j, s8, t;
+
+    for(j=0; j<n; j++)
+    {
+        s8 = above[j-1] + above[j] + above[j+1] + row[j-1] + row[j+1] + below[j-1] + below[j] + below[j+1];
+        t = ((PSF_Q_CENTRE * row[j]) - (PSF_Q_NEIGH * s8)) >> SHARPEN_FIXED;
+
+        if(t < 0) t=0;
+        if(t > 255) t=255;
+        out[j]=(UINT8)t;
+    }
+}
+
+#endif
+
+
+// unpack n pixels of an interleaved row into three plane rows
+static void unpack_row(const UINT8 *rgb, UINT8 *r, UINT8 *g, UINT8 *b, int n)
+{
+    int j;
+
+    for(j=0; j<n; j++)
+    {
+        r[j]=rgb[0]; g[j]=rgb[1]; b[j]=rgb[2];
+        rgb+=3;
+    }
+}
+
+
+// Each source row is unpacked once into a three row ring of small plane rows
+// that stay in L1, then run through the selected row kernel
+void sharpen_rgb_tile(const UINT8 *rgb, UINT8 *out, int img_w, int i0, int j0, int h, int w)
+{
+    UINT8 ring[3][3][w+2];   // [ring row][plane][pixel with halo]
+    UINT8 conv[3][w];
+    const UINT8 *src;
+    UINT8 *dst;
+    int i, j, c;
+
+    for(i=i0-1; i<=i0; i++)
+    {
+        src=&rgb[((i*img_w)+j0-1)*3];
+        unpack_row(src, ring[i%3][0], ring[i%3][1], ring[i%3][2], w+2);
+    }
+
+    for(i=i0; i<(i0+h); i++)
+    {
+        src=&rgb[(((i+1)*img_w)+j0-1)*3];
+        unpack_row(src, ring[(i+1)%3][0], ring[(i+1)%3][1], ring[(i+1)%3][2], w+2);
+
+        for(c=0; c<3; c++)
+            sharpen_row(&ring[(i-1)%3][c][1], &ring[i%3][c][1], &ring[(i+1)%3][c][1], conv[c], w);
+
+        dst=&out[((i*img_w)+j0)*3];
+        for(j=0; j<w; j++)
+        {
+            dst[0]=conv[0][j]; dst[1]=conv[1][j]; dst[2]=conv[2][j];
+            dst+=3;
+        }
+    }
+}
+
+
+// scalar integer pixel used for the vector kernel tails
+static inline UINT8 sharpen_px_int(const UINT8 *a, const UINT8 *r, const UINT8 *b, int j)
+{
+    int s8, t;
+
+    s8 = a[j-1] + a[j] + a[j+1] + r[j-1] + r[j+1] + b[j-1] + b[j] + b[j+1];
+    t = ((PSF_C8 * r[j]) - (PSF_N * s8)) >> 3;
+
+    if(t < 0) t=0;
+    if(t > 255) t=255;
+    return (UINT8)t;
+}
+
+
+// the vector kernels are only exact when the PSF has this integer form
+static int psf_is_integer(void)
+{
+    return (K == (FLOAT)K_INT) && (K_INT >= 0) && (K_INT <= 15);
+}
+
+
+#ifdef SHARPEN_X86
+
+// SSE2, 16 pixels per iteration - nothing beyond SSE2 is needed for the
+// widen/multiply/saturating-pack sequence, so this covers every x86-64
+__attribute__((target("sse2")))
+static void sharpen_row_sse2(const UINT8 *a, const UINT8 *r, const UINT8 *b, UINT8 *out, int n)
+{
+    const __m128i zero=_mm_setzero_si128();
+    const __m128i cmul=_mm_set1_epi16(PSF_C8+PSF_N), nmul=_mm_set1_epi16(PSF_N);
+    const UINT8 *src[9] = {a-1, a, a+1, r-1, r, r+1, b-1, b, b+1};
+    __m128i v, slo, shi, clo, chi;
+    int j=0, k;
+
+    for(; j+16<=n; j+=16)
+    {
+        slo=zero; shi=zero;
+
+        for(k=0; k<9; k++)
+        {
+            v=_mm_loadu_si128((const __m128i *)(src[k]+j));
+            slo=_mm_add_epi16(slo, _mm_unpacklo_epi8(v, zero));
+            shi=_mm_add_epi16(shi, _mm_unpackhi_epi8(v, zero));
+        }
+
+        v=_mm_loadu_si128((const __m128i *)(r+j));
+        clo=_mm_unpacklo_epi8(v, zero);
+        chi=_mm_unpackhi_epi8(v, zero);
+
+        // C8*c - N*(sum9-c), wraps in the intermediate but the result fits int16
+        slo=_mm_srai_epi16(_mm_sub_epi16(_mm_mullo_epi16(clo, cmul), _mm_mullo_epi16(slo, nmul)), 3);
+        shi=_mm_srai_epi16(_mm_sub_epi16(_mm_mullo_epi16(chi, cmul), _mm_mullo_epi16(shi, nmul)), 3);
+
+        _mm_storeu_si128((__m128i *)(out+j), _mm_packus_epi16(slo, shi));
+    }
+
+    for(; j<n; j++) out[j]=sharpen_px_int(a, r, b, j);
+}
+
+
+// AVX2, 32 pixels per iteration - unpack and pack are both per 128-bit lane,
+// so the packed bytes come back out in source order
+__attribute__((target("avx2")))
+static void sharpen_row_avx2(const UINT8 *a, const UINT8 *r, const UINT8 *b, UINT8 *out, int n)
+{
+    const __m256i zero=_mm256_setzero_si256();
+    const __m256i cmul=_mm256_set1_epi16(PSF_C8+PSF_N), nmul=_mm256_set1_epi16(PSF_N);
+    const UINT8 *src[9] = {a-1, a, a+1, r-1, r, r+1, b-1, b, b+1};
+    __m256i v, slo, shi, clo, chi;
+    int j=0, k;
+
+    for(; j+32<=n; j+=32)
+    {
+        slo=zero; shi=zero;
+
+        for(k=0; k<9; k++)
+        {
+            v=_mm256_loadu_si256((const __m256i *)(src[k]+j));
+            slo=_mm256_add_epi16(slo, _mm256_unpacklo_epi8(v, zero));
+            shi=_mm256_add_epi16(shi, _mm256_unpackhi_epi8(v, zero));
+        }
+
+        v=_mm256_loadu_si256((const __m256i *)(r+j));
+        clo=_mm256_unpacklo_epi8(v, zero);
+        chi=_mm256_unpackhi_epi8(v, zero);
+
+        slo=_mm256_srai_epi16(_mm256_sub_epi16(_mm256_mullo_epi16(clo, cmul), _mm256_mullo_epi16(slo, nmul)), 3);
+        shi=_mm256_srai_epi16(_mm256_sub_epi16(_mm256_mullo_epi16(chi, cmul), _mm256_mullo_epi16(shi, nmul)), 3);
+
+        _mm256_storeu_si256((__m256i *)(out+j), _mm256_packus_epi16(slo, shi));
+    }
+
+    for(; j<n; j++) out[j]=sharpen_px_int(a, r, b, j);
+}
+
+
+static int have_sse2(void)
+{
+#ifdef __x86_64__
+    return 1;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static int have_avx2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+
+#ifdef SHARPEN_NEON
+
+// NEON, 16 pixels per iteration for the Cortex-A7/A53/A57 boards
+static void sharpen_row_neon(const UINT8 *a, const UINT8 *r, const UINT8 *b, UINT8 *out, int n)
+{
+    const UINT8 *src[9] = {a-1, a, a+1, r-1, r, r+1, b-1, b, b+1};
+    uint8x16_t v;
+    uint16x8_t slo, shi;
+    int16x8_t tlo, thi;
+    int j=0, k;
+
+    for(; j+16<=n; j+=16)
+    {
+        slo=vdupq_n_u16(0); shi=vdupq_n_u16(0);
+
+        for(k=0; k<9; k++)
+        {
+            v=vld1q_u8(src[k]+j);
+            slo=vaddw_u8(slo, vget_low_u8(v));
+            shi=vaddw_u8(shi, vget_high_u8(v));
+        }
+
+        v=vld1q_u8(r+j);
+
+        tlo=vsubq_s16(vreinterpretq_s16_u16(vmulq_n_u16(vmovl_u8(vget_low_u8(v)), PSF_C8+PSF_N)),
+                      vreinterpretq_s16_u16(vmulq_n_u16(slo, PSF_N)));
+        thi=vsubq_s16(vreinterpretq_s16_u16(vmulq_n_u16(vmovl_u8(vget_high_u8(v)), PSF_C8+PSF_N)),
+                      vreinterpretq_s16_u16(vmulq_n_u16(shi, PSF_N)));
+
+        vst1q_u8(out+j, vcombine_u8(vqmovun_s16(vshrq_n_s16(tlo, 3)), vqmovun_s16(vshrq_n_s16(thi, 3))));
+    }
+
+    for(; j<n; j++) out[j]=sharpen_px_int(a, r, b, j);
+}
+
+
+static int have_neon(void)
+{
+#ifdef __aarch64__
+    return 1;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+
+#endif
+
+
+static int have_always(void)
+{
+    return 1;
+}
+
+// fastest first, the first supported one is the default
+static const struct
+{
+    const char *name;
+    sharpen_row_fn_t fn;
+    int (*supported)(void);
+    int exact_integer;   // only valid for integer K
+} kernels[] =
+{
+#ifdef SHARPEN_FIXED
+    {"fixed", sharpen_row_fixed, have_always, 0},
+#endif
+#ifdef SHARPEN_X86
+    {"avx2", sharpen_row_avx2, have_avx2, 1},
+    {"sse2", sharpen_row_sse2, have_sse2, 1},
+#endif
+#ifdef SHARPEN_NEON
+    {"neon", sharpen_row_neon, have_neon, 1},
+#endif
+    {"box", sharpen_row_box, have_always, 0},
+    {"psf", sharpen_row_psf, have_always, 0},
+};
+
+#define NUM_KERNELS (sizeof(kernels)/sizeof(kernels[0]))
+
+
+int sharpen_kernel_init(const char *name)
+{
+    unsigned int i;
+
+    for(i=0; i<NUM_KERNELS; i++)
+    {
+        if(name != NULL && strcmp(name, kernels[i].name) != 0) continue;
+
+        if(!kernels[i].supported() || (kernels[i].exact_integer && !psf_is_integer()))
+        {
+            if(name != NULL) break;
+            continue;
+        }
+
+        sharpen_row=kernels[i].fn;
+        sharpen_row_name=kernels[i].name;
+        return 0;
+    }
+
+    printf("PSF kernel %s not available, choose from:", name);
+    for(i=0; i<NUM_KERNELS; i++) printf(" %s", kernels[i].name);
+    printf("\n");
+
+    return -1;
+}
+
+
+int sharpen_kernel_verify(const UINT8 *plane, int width, int height)
+{
+    unsigned int k;
+    int i, j, diff, ndiff, maxdiff, failed=0;
+    UINT8 *ref, *out;
+
+    ref=malloc((size_t)width*height);
+    out=malloc((size_t)width*height);
+    if(ref == NULL || out == NULL)
+    {
+        printf("Error allocating %dx%d verify buffers\n", width, height);
+        free(ref); free(out);
+        return -1;
+    }
+
+    for(i=1; i<(height-1); i++)
+        sharpen_row_psf(&plane[((i-1)*width)+1], &plane[(i*width)+1], &plane[((i+1)*width)+1], &ref[(i*width)+1], width-2);
+
+    for(k=0; k<NUM_KERNELS; k++)
+    {
+        if(kernels[k].fn == sharpen_row_psf) continue;
+
+        if(!kernels[k].supported() || (kernels[k].exact_integer && !psf_is_integer()))
+        {
+            printf("%-6s not available\n", kernels[k].name);
+            continue;
+        }
+
+        for(i=1; i<(height-1); i++)
+            kernels[k].fn(&plane[((i-1)*width)+1], &plane[(i*width)+1], &plane[((i+1)*width)+1], &out[(i*width)+1], width-2);
+
+        // interior only, the border is never convolved
+        ndiff=0; maxdiff=0;
+        for(i=1; i<(height-1); i++)
+        {
+            for(j=1; j<(width-1); j++)
+            {
+                diff=abs((int)out[(i*width)+j] - (int)ref[(i*width)+j]);
+                if(diff) ndiff++;
+                if(diff > maxdiff) maxdiff=diff;
+            }
+        }
+
+        printf("%-6s %d of %d pixels differ from psf, max diff %d\n", kernels[k].name, ndiff, (width-2)*(height-2), maxdiff);
+        if(ndiff) failed++;
+    }
+
+    free(ref); free(out);
+    return failed;
+}
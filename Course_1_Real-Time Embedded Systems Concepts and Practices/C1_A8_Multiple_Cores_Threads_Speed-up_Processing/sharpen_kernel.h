@@ -0,0 +1,54 @@
+#ifndef _SHARPEN_KERNEL_
+#define _SHARPEN_KERNEL_
+
+// 3x3 PSF sharpen row kernels
+//
+// Each kernel convolves n pixels of one colour plane starting at row[0],
+// reading one pixel of halo on each side of above/row/below, and writes the
+// clamped result to out[0..n-1].
+//
+// The PSF is {-K/8 x 8, K+1 centre}.  For integer K the double PSF result is
+// exactly (8(K+1)c - K*sum8)/8, so the integer/SIMD kernels reproduce the
+// double reference bit for bit.
+
+#ifndef K
+#define K 4.0
+#endif
+
+typedef double FLOAT;
+typedef unsigned char UINT8;
+
+typedef void (*sharpen_row_fn_t)(const UINT8 *above, const UINT8 *row, const UINT8 *below, UINT8 *out, int n);
+
+extern FLOAT PSF[9];
+
+// kernel selected by sharpen_kernel_init()
+extern sharpen_row_fn_t sharpen_row;
+extern const char *sharpen_row_name;
+
+// Select a kernel by name ("psf", "box", "sse2", "avx2", "neon", "fixed") or, for NULL, the
+// fastest one this CPU supports, returns 0 on success, -1 if unavailable
+int sharpen_kernel_init(const char *name);
+
+// double precision reference, same arithmetic as the original loops
+void sharpen_row_psf(const UINT8 *above, const UINT8 *row, const UINT8 *below, UINT8 *out, int n);
+
+// PSF rewritten as (K+1+K/8)*centre - (K/8)*box3x3, box sum from running
+// column sums
+void sharpen_row_box(const UINT8 *above, const UINT8 *row, const UINT8 *below, UINT8 *out, int n);
+
+// Run every available kernel over one width x height plane and diff it
+// against psf, prints one line per kernel, returns how many differ
+int sharpen_kernel_verify(const UINT8 *plane, int width, int height);
+
+// Sharpen rows i0..i0+h-1, columns j0..j0+w-1 of an interleaved RGB image
+// img_w pixels wide into out, using sharpen_row on an L1 sized row ring
+void sharpen_rgb_tile(const UINT8 *rgb, UINT8 *out, int img_w, int i0, int j0, int h, int w);
+
+#ifdef SHARPEN_FIXED
+// Q8/Q16 fixed point (SHARPEN_FIXED fraction bits), coefficients from K at
+// compile time
+void sharpen_row_fixed(const UINT8 *above, const UINT8 *row, const UINT8 *below, UINT8 *out, int n);
+#endif
+
+#endif
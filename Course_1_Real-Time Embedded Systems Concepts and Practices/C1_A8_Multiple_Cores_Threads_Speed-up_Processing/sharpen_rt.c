@@ -0,0 +1,295 @@
+// Sharpen as a periodic real-time service - the frame sharpen of
+// sharpen_stream released by the table driven sequencer of
+// C1_A5_GenericSequencer instead of by the arrival of frames
+//
+// One sequencer thread, SCHED_FIFO RT_MAX, ticks at the frame rate (30 Hz,
+// 33.33 msec, by default) and releases the one row service table below on
+// every tick.  The service sharpens the frame on the persistent worker pool,
+// one band of rows a worker, with the workers pinned to the service cores
+// of a core map, ideally isolcpus/nohz_full cores, and the service thread
+// itself waiting for them on the first of those.
+//
+// The service's svcstats monitor has D=T, so the report at the end is the
+// answer to whether the PSF fits the period on this board: WCET and worst
+// response as a percentage of the deadline, and how many releases missed
+// it.  The sequencer timer's missed ticks are reported too, a release the
+// sequencer itself was late for is not the service's fault.
+//
+// -E pins the performance governor for the run and counts the cycles,
+// IPC, cache misses and context switches of the service thread and each
+// worker (rtenv.h), so a WCET that does not fit can be told apart from a
+// clock that was ramping or throttled.
+//
+// Needs root for SCHED_FIFO, the same as the sequencer examples.
+//
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <syslog.h>
+
+#include "ppm_io.h"
+#include "frame_pool.h"
+#include "sharpen_kernel.h"
+#include "seqtable.h"
+#include "seqtimer.h"
+#include "svcstats.h"
+#include "coremap.h"
+#include "rtinit.h"
+#include "rtenv.h"
+
+#define RT_MAX (99)
+
+#define DEFAULT_FPS (30.0)
+#define DEFAULT_FRAMES (300)
+
+#define NUM_CONV_THREADS (4)
+
+#define NSEC_PER_SEC (1000000000)
+
+typedef struct
+{
+    int i;
+    int h;
+} convArgsType;
+
+frame_pool_t pool;
+convArgsType convarg[FRAME_POOL_MAX_WORKERS];
+void *convargs[FRAME_POOL_MAX_WORKERS];
+
+UINT8 *frame_in, *frame_out;
+ppm_header_t header;
+int img_h, img_w, npixels;
+
+coremap_t coremap;
+seqtimer_t seq_timer;
+seqt_mode_t timer_mode=SEQT_ABS;
+long period_ns;
+unsigned long long nframes=DEFAULT_FRAMES;
+svc_stats_t sharpen_stats;
+
+
+void *conv_thread(void *threadp)
+{
+    convArgsType *a=(convArgsType *)threadp;
+
+    sharpen_rgb_tile(frame_in, frame_out, img_w, a->i, 1, a->h, img_w-2);
+
+    return (void *)0;
+}
+
+
+// one release, one frame, the border was copied once at start up
+static void sharpen_frame(service_t *svc)
+{
+    (void)svc;
+    frame_pool_run(&pool);
+}
+
+
+// T is one tick and D=T, the core is set from the core map in main
+static service_desc_t sharpen_table[]=
+{
+    {"sharpen", 1, 1, 0, RT_MAX-1, SEQ_ANY_CORE, sharpen_frame, 0},
+};
+
+#define NUM_SERVICES ((int)(sizeof(sharpen_table)/sizeof(sharpen_table[0])))
+
+
+void *Sequencer(void *threadp)
+{
+    sequencer_t *seqp=(sequencer_t *)threadp;
+    int n;
+
+    if(seqt_init(&seq_timer, timer_mode, period_ns, SEQT_SPIN_NSEC) != 0)
+        exit(-1);
+
+    // tick 0 is the first frame
+    seq_tick(seqp);
+
+    while(seqp->tick < nframes)
+    {
+        n=seqt_wait(&seq_timer);
+
+        // a late tick still releases every frame, which is then late too
+        while(n-- > 0 && seqp->tick < nframes)
+            seq_tick(seqp);
+    }
+
+    seqt_close(&seq_timer);
+
+    return (void *)0;
+}
+
+
+static void set_fifo(int priority)
+{
+    struct sched_param param;
+
+    param.sched_priority=priority;
+    if(sched_setscheduler(getpid(), SCHED_FIFO, &param) < 0)
+    {
+        perror("sched_setscheduler, SCHED_FIFO needs root");
+        exit(-1);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    int i, rc, opt, nconv=NUM_CONV_THREADS, env_pin=0;
+    char *kernel=NULL, *out_file=NULL;
+    const char *coremap_spec=NULL;
+    double fps=DEFAULT_FPS;
+    sequencer_t seq;
+    pthread_t seq_thread;
+    pthread_attr_t seq_attr;
+    struct sched_param seq_param;
+    cpu_set_t cpuset;
+    rti_faults_t run_faults;
+    unsigned long long missed;
+
+    while((opt=getopt(argc, argv, "k:o:n:t:r:c:m:E")) != -1)
+    {
+        if(opt == 'k') kernel=optarg;
+        else if(opt == 'o') out_file=optarg;
+        else if(opt == 'n') nframes=strtoull(optarg, NULL, 0);
+        else if(opt == 't') nconv=atoi(optarg);
+        else if(opt == 'r') fps=atof(optarg);
+        else if(opt == 'c') coremap_spec=optarg;
+        else if(opt == 'E') env_pin=1;
+        else if(opt == 'm')
+        {
+            if((rc=seqt_mode(optarg)) < 0) argc=0;
+            else timer_mode=(seqt_mode_t)rc;
+        }
+        else argc=0;
+    }
+
+    if((argc-optind) != 1 || nframes < 1 || nconv < 1 || nconv > FRAME_POOL_MAX_WORKERS || fps <= 0.0)
+    {
+       printf("Usage: sharpen_rt [-k psf|box|sse2|avx2|neon] [-r fps] [-n frames] [-t threads] [-c seq=1,svc=2-3] [-m abs|timerfd|hybrid|adaptive|adaptive-sleep] [-E] [-o out.ppm] input.ppm\n");
+       exit(-1);
+    }
+
+    if(sharpen_kernel_init(kernel) < 0)
+        exit(-1);
+
+    period_ns=(long)(NSEC_PER_SEC / fps);
+
+    rti_init(0);
+
+    if(ppm_read_header(argv[optind], &header) < 0)
+        exit(-1);
+    img_h=header.height; img_w=header.width;
+    npixels=img_h*img_w;
+
+    if(img_h < 3 || img_w < 3 || nconv > (img_h-2))
+    {
+        printf("%dx%d frames can not be split over %d threads\n", img_w, img_h, nconv);
+        exit(-1);
+    }
+
+    // locked and prefaulted, so no release takes a page fault
+    if((frame_in=rti_alloc((size_t)npixels*3, 64, 1)) == NULL || (frame_out=rti_alloc((size_t)npixels*3, 64, 1)) == NULL)
+    {
+        printf("Error allocating %dx%d frames\n", img_w, img_h);
+        exit(-1);
+    }
+    if(ppm_read_rgb(argv[optind], &header, frame_in, npixels) < 0)
+        exit(-1);
+
+    // the one pixel border is not convolved and frames never change it
+    memcpy(frame_out, frame_in, (size_t)npixels*3);
+
+    coremap_init(&coremap);
+    if(coremap_parse(&coremap, coremap_spec) != 0)
+        exit(-1);
+    if(coremap_spec == NULL && getenv(COREMAP_ENV) == NULL && coremap.ncores > 1)
+        coremap.seq_core=1;
+    coremap_check(&coremap);
+    sharpen_table[0].core=coremap.svc_cores[0];
+
+    // workers each take a fixed band of rows, created from this thread at
+    // the service priority so they inherit it
+    for(i=0; i<nconv; i++)
+    {
+        convarg[i].i=1+((i*(img_h-2))/nconv);
+        convarg[i].h=(1+(((i+1)*(img_h-2))/nconv))-convarg[i].i;
+        convargs[i]=(void *)&convarg[i];
+    }
+    // before the pool, so its workers are counted
+    rte_begin(env_pin, env_pin);
+
+    set_fifo(sharpen_table[0].priority);
+    if(frame_pool_create_cores(&pool, nconv, conv_thread, convargs, coremap.svc_cores, coremap.nsvc) != 0)
+        exit(-1);
+
+    // one untimed frame, so the workers' stacks and caches are warm by tick 0
+    frame_pool_run(&pool);
+
+    printf("sharpen %dx%d with %s PSF on %d threads, released every %.3lf msec for %llu frames\n",
+           img_w, img_h, sharpen_row_name, nconv, period_ns/1000000.0, nframes);
+
+    if(seq_init(&seq, sharpen_table, NUM_SERVICES, SEQR_SEM) != 0)
+        exit(-1);
+
+    svc_stats_init(&sharpen_stats, sharpen_table[0].name);
+    svc_stats_deadline(&sharpen_stats, (long long)sharpen_table[0].divisor*period_ns);
+    seq.services[0].stats=&sharpen_stats;
+
+    if(seq_start(&seq) != 0) { seq_shutdown(&seq); exit(-1); }
+
+    CPU_ZERO(&cpuset);
+    CPU_SET(coremap.seq_core, &cpuset);
+
+    pthread_attr_init(&seq_attr);
+    pthread_attr_setinheritsched(&seq_attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&seq_attr, SCHED_FIFO);
+    pthread_attr_setaffinity_np(&seq_attr, sizeof(cpu_set_t), &cpuset);
+    seq_param.sched_priority=RT_MAX;
+    pthread_attr_setschedparam(&seq_attr, &seq_param);
+    rti_attr_stack(&seq_attr);
+
+    rti_faults(&run_faults);
+
+    if((rc=pthread_create(&seq_thread, &seq_attr, Sequencer, (void *)&seq)) != 0)
+    {
+        printf("pthread_create for sequencer failed, rc=%d\n", rc);
+        seq_shutdown(&seq);
+        exit(-1);
+    }
+    pthread_attr_destroy(&seq_attr);
+
+    pthread_join(seq_thread, NULL);
+    seq_shutdown(&seq);
+    rti_report("periodic frames", &run_faults);
+
+    frame_pool_destroy(&pool);
+
+    seqt_report(&seq_timer);
+    svc_stats_report(&sharpen_stats, 1);
+
+    // releases still queued at shutdown, or too far behind to be timed,
+    // never made their deadline either
+    missed=sharpen_stats.misses + (sharpen_stats.posts - sharpen_stats.exec.n);
+
+    printf("sharpen %s the %.3lf msec period: %llu of %llu frames late, WCET %.3lf msec, utilization %.1lf%% on %d threads\n",
+           (missed == 0 && sharpen_stats.exec.n > 0) ? "fits" : "DOES NOT FIT",
+           period_ns/1000000.0, missed, sharpen_stats.posts, sharpen_stats.exec.max/1000000.0,
+           sharpen_stats.exec.n ? 100.0*sharpen_stats.exec.sum/sharpen_stats.exec.n/period_ns : 0.0, nconv);
+    syslog(LOG_CRIT, "sharpen_rt %dx%d %s period %ld nsec WCET %lld nsec missed %llu of %llu\n",
+           img_w, img_h, sharpen_row_name, period_ns, sharpen_stats.exec.max, missed, sharpen_stats.posts);
+    rte_end();
+
+    if(out_file != NULL && ppm_write_rgb(out_file, &header, frame_out, npixels) < 0)
+        exit(-1);
+
+    free(frame_in);
+    free(frame_out);
+
+    return 0;
+}
@@ -0,0 +1,204 @@
+// sharpen_scale.c
+//
+// Multi-core scaling of the sharpen hot path as numbers rather than
+// screenshots.  Runs the single threaded sharpen and sharpen_grid with
+// 1 .. 2 x cores row band threads on each example image and writes CSV,
+// one row per run:
+//
+//    program,image,pixels,threads,frames,wall_s,mpix_s,speedup,efficiency,serial_fraction
+//
+//    wall_s            the best of -r runs, default 3, of the frame loop
+//                      alone, from the program's own start and stop lines,
+//                      so reading and writing the images is not counted
+//    speedup           sharpen_grid at 1 thread over this run, on the same
+//                      image, so the sharpen row shows what the grid and
+//                      the pool cost a single thread
+//    efficiency        speedup / threads
+//    serial_fraction   Karp-Flatt estimate (1/S - 1/p) / (1 - 1/p) of
+//                      Amdahl's serial fraction, p > 1 only
+//
+// and per image one "amdahl_fit" row, threads "all", with the serial
+// fraction f that best fits 1/S = f + (1-f)/p over every thread count,
+// least squares.  A hot path regression shows in mpix_s, a new lock or
+// imbalance in serial_fraction.
+//
+//    sharpen_scale [-r runs] [-m Mpix per run] [-t max threads] [-o out.csv] [image.ppm ...]
+//
+// Frames per run are -m, default 1200, MPix over the image size, so both
+// images run for about as long.  The images default to the two Cactus
+// examples; the programs are run from the current directory, so "make
+// bench" builds them and runs this.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/sysinfo.h>
+
+#include "ppm_io.h"
+
+#define NUM_RUNS (3)
+#define MPIX_PER_RUN (1200)
+#define MAX_THREADS (256)
+
+static const char *default_images[]={"Cactus-120kpixel.ppm", "Cactus-12mpixel.ppm"};
+
+typedef struct
+{
+    double wall_s;
+    int frames;
+} scale_run_t;
+
+
+// run cmd and take the frame loop time from its "start ... at" and
+// "stop ... at ... for N frames" lines, -1.0 on failure
+static double run_once(const char *cmd, int *frames)
+{
+    char line[512], *at;
+    double start=-1.0, stop=-1.0;
+    FILE *p;
+
+    if((p=popen(cmd, "r")) == NULL)
+    {
+        perror("popen");
+        return -1.0;
+    }
+
+    while(fgets(line, sizeof(line), p))
+    {
+        if((at=strstr(line, " test at ")) == NULL)
+            continue;
+        if(strncmp(line, "start", 5) == 0)
+            start=atof(at+9);
+        else if(strncmp(line, "stop", 4) == 0 && sscanf(at+9, "%lf for %d frames", &stop, frames) != 2)
+            stop=-1.0;
+    }
+
+    if(pclose(p) != 0 || start < 0.0 || stop < start)
+    {
+        printf("%s: failed or printed no test times\n", cmd);
+        return -1.0;
+    }
+
+    return stop - start;
+}
+
+
+// best of runs, -1.0 if any failed
+static double run_best(const char *cmd, int runs, int *frames)
+{
+    double best=-1.0, t;
+    int r;
+
+    for(r=0; r<runs; r++)
+    {
+        if((t=run_once(cmd, frames)) < 0.0)
+            return -1.0;
+        if(best < 0.0 || t < best)
+            best=t;
+    }
+
+    return best;
+}
+
+
+static void csv_row(FILE *out, const char *program, const char *image, int pixels, int threads, int frames,
+                    double wall_s, double t1)
+{
+    double speedup=(t1 > 0.0) ? t1/wall_s : 0.0;
+
+    fprintf(out, "%s,%s,%d,%d,%d,%.6lf,%.2lf,%.4lf,%.4lf,", program, image, pixels, threads, frames,
+            wall_s, (double)pixels*frames/wall_s/1.0e6, speedup, speedup/threads);
+    if(threads > 1 && speedup > 0.0)
+        fprintf(out, "%.4lf\n", (1.0/speedup - 1.0/threads)/(1.0 - 1.0/threads));
+    else
+        fprintf(out, "\n");
+    fflush(out);
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char **images=default_images;
+    char cmd[1024];
+    FILE *out=stdout;
+    ppm_header_t header;
+    double t1, t, x, y, sxy, sxx, mpix=MPIX_PER_RUN;
+    int nimages=2, runs=NUM_RUNS, max_threads=2*get_nprocs();
+    int opt, i, n, pixels, frames, got;
+
+    while((opt=getopt(argc, argv, "r:m:t:o:")) != -1)
+    {
+        if(opt == 'r') runs=atoi(optarg);
+        else if(opt == 'm') mpix=atof(optarg);
+        else if(opt == 't') max_threads=atoi(optarg);
+        else if(opt == 'o')
+        {
+            if((out=fopen(optarg, "w")) == NULL)
+            {
+                perror(optarg);
+                exit(-1);
+            }
+        }
+        else argc=0;
+    }
+
+    if(argc == 0 || runs < 1 || mpix <= 0.0 || max_threads < 1 || max_threads > MAX_THREADS)
+    {
+        printf("Usage: sharpen_scale [-r runs] [-m Mpix per run] [-t max threads] [-o out.csv] [image.ppm ...]\n");
+        exit(-1);
+    }
+
+    if(optind < argc)
+    {
+        images=(const char **)&argv[optind];
+        nimages=argc-optind;
+    }
+
+    fprintf(out, "program,image,pixels,threads,frames,wall_s,mpix_s,speedup,efficiency,serial_fraction\n");
+
+    for(i=0; i<nimages; i++)
+    {
+        if(ppm_read_header(images[i], &header) < 0)
+            exit(-1);
+        pixels=header.width*header.height;
+        frames=(int)(mpix*1.0e6/pixels);
+        if(frames < 1) frames=1;
+
+        // the baseline first, every speedup on this image is against it
+        snprintf(cmd, sizeof(cmd), "./sharpen_grid -n %d -r 1 -c 1 '%s' /dev/null", frames, images[i]);
+        if((t1=run_best(cmd, runs, &got)) < 0.0)
+            exit(-1);
+
+        snprintf(cmd, sizeof(cmd), "./sharpen -n %d '%s' /dev/null", frames, images[i]);
+        if((t=run_best(cmd, runs, &got)) > 0.0)
+            csv_row(out, "sharpen", images[i], pixels, 1, got, t, t1);
+
+        sxy=sxx=0.0;
+        for(n=1; n<=max_threads && n <= (int)header.height-2; n++)
+        {
+            if(n == 1)
+                t=t1;
+            else
+            {
+                snprintf(cmd, sizeof(cmd), "./sharpen_grid -n %d -r %d -c 1 '%s' /dev/null", frames, n, images[i]);
+                if((t=run_best(cmd, runs, &got)) < 0.0)
+                    continue;
+            }
+            csv_row(out, "sharpen_grid", images[i], pixels, n, frames, t, t1);
+
+            // 1/S - 1/p = f (1 - 1/p), through the origin
+            x=1.0 - 1.0/n;
+            y=t/t1 - 1.0/n;
+            sxy+=x*y;
+            sxx+=x*x;
+        }
+
+        if(sxx > 0.0)
+            fprintf(out, "amdahl_fit,%s,%d,all,%d,,,,,%.4lf\n", images[i], pixels, frames, sxy/sxx);
+    }
+
+    if(out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,358 @@
+// Multi-process sharpen pipeline over shared memory frame rings
+//
+// The reader -> convolve -> writer stages of sharpen_stream as three
+// processes, joined by frame_shm.h rings instead of file I/O:
+//
+//    sharpen_shm capture input.ppm ...|-    frames into /sharpen_in
+//    sharpen_shm sharpen                    /sharpen_in -> /sharpen_out
+//    sharpen_shm consume [-o out%04d.ppm]   frames out of /sharpen_out
+//
+// started in any order, each with its own SCHED_FIFO priority (-p) if
+// wanted.  capture reads every frame straight into its slot of the ring,
+// sharpen convolves from a slot of one ring into a slot of the next on the
+// worker pool, and consume writes or just times the slot, so a frame is
+// never copied between the processes.  The capture time stamp travels
+// with the frame, and consume reports latency from capture to its end of
+// the pipeline.
+//
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#include "ppm_io.h"
+#include "frame_pool.h"
+#include "frame_shm.h"
+#include "sharpen_kernel.h"
+#include "rtinit.h"
+
+#define NUM_SLOTS (4)
+#define NUM_CONV_THREADS (4)
+
+#define DEFAULT_IN_RING "/sharpen_in"
+#define DEFAULT_OUT_RING "/sharpen_out"
+
+#define NSEC_PER_SEC (1000000000)
+
+typedef struct
+{
+    int i;
+    int h;
+} convArgsType;
+
+// the convolve workers read the current slots, set before each frame_pool_run
+frame_pool_t pool;
+const UINT8 *conv_in;
+UINT8 *conv_out;
+convArgsType convarg[FRAME_POOL_MAX_WORKERS];
+void *convargs[FRAME_POOL_MAX_WORKERS];
+
+int img_h, img_w, npixels;
+
+char *kernel=NULL, *out_pattern=NULL;
+const char *in_ring=NULL, *out_ring=NULL;
+int loops=1, nconv=NUM_CONV_THREADS, nslots=NUM_SLOTS, priority=0;
+double frame_rate=0.0;
+
+
+static double ns_to_sec(long long ns)
+{
+    return (double)ns / NSEC_PER_SEC;
+}
+
+
+static void set_priority(const char *role)
+{
+    struct sched_param param;
+
+    if(priority == 0)
+        return;
+
+    param.sched_priority=priority;
+    if(sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+        perror("sched_setscheduler, SCHED_FIFO needs root");
+    else
+        printf("%s at SCHED_FIFO %d\n", role, priority);
+}
+
+
+// frame into slot from the next file, or from stdin where the first
+// frame's header has already been read, returns 0, 1 at end of stream, -1
+// on error
+static int capture_frame(char **files, int nfiles, int *f, int in_stdin, int frame, UINT8 *slot)
+{
+    ppm_header_t h;
+    int rc;
+
+    if(in_stdin)
+    {
+        if(frame > 0 && (rc=ppm_read_fd_header(STDIN_FILENO, &h)) != 0)
+            return rc;
+        if(frame > 0 && (h.width != img_w || h.height != img_h))
+        {
+            printf("frame %d is %dx%d, ring is %dx%d\n", frame, h.width, h.height, img_w, img_h);
+            return -1;
+        }
+        return ppm_read_fd_rgb(STDIN_FILENO, slot, npixels);
+    }
+
+    if(*f >= nfiles*loops)
+        return 1;
+    rc=ppm_read_rgb(files[*f % nfiles], &h, slot, npixels);
+    (*f)++;
+    return rc;
+}
+
+
+static int capture_main(char **files, int nfiles)
+{
+    frame_shm_t ring;
+    ppm_header_t hdr;
+    struct timespec release;
+    long long period_ns=(frame_rate > 0.0) ? (long long)(NSEC_PER_SEC / frame_rate) : 0;
+    int f=0, frame=0, rc, in_stdin=(strcmp(files[0], "-") == 0);
+    UINT8 *slot;
+
+    // the ring is sized from the first frame
+    if(in_stdin)
+    {
+        if(ppm_read_fd_header(STDIN_FILENO, &hdr) != 0)
+        {
+            printf("no P6 frame on stdin\n");
+            return -1;
+        }
+    }
+    else if(ppm_read_header(files[0], &hdr) < 0)
+        return -1;
+
+    img_h=hdr.height; img_w=hdr.width;
+    npixels=img_h*img_w;
+
+    if(frame_shm_create(&ring, out_ring, &hdr, nslots) < 0)
+        return -1;
+    printf("capture %dx%d frames into %s, %d slots\n", img_w, img_h, ring.name, nslots);
+
+    set_priority("capture");
+    clock_gettime(CLOCK_MONOTONIC, &release);
+
+    while(1)
+    {
+        // paced like a camera, otherwise as fast as the pipeline drains
+        if(period_ns)
+        {
+            release.tv_nsec+=period_ns;
+            while(release.tv_nsec >= NSEC_PER_SEC) { release.tv_nsec-=NSEC_PER_SEC; release.tv_sec++; }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &release, NULL);
+        }
+
+        slot=frame_shm_acquire(&ring);
+        if((rc=capture_frame(files, nfiles, &f, in_stdin, frame, slot)) != 0)
+        {
+            if(rc < 0) printf("frame %d read failed\n", frame);
+            break;
+        }
+        frame_shm_publish(&ring, frame, 0);
+        frame++;
+    }
+
+    frame_shm_end(&ring);
+    frame_shm_close(&ring);
+
+    printf("captured %d frames\n", frame);
+    return 0;
+}
+
+
+void *conv_thread(void *threadp)
+{
+    convArgsType *a=(convArgsType *)threadp;
+
+    sharpen_rgb_tile(conv_in, conv_out, img_w, a->i, 1, a->h, img_w-2);
+
+    return (void *)0;
+}
+
+
+static int sharpen_main(void)
+{
+    frame_shm_t rin, rout;
+    frame_shm_slot_t meta;
+    long long t_first=0, t_last=0;
+    int i, frames=0;
+
+    if(sharpen_kernel_init(kernel) < 0)
+        return -1;
+
+    if(frame_shm_open(&rin, in_ring) < 0)
+        return -1;
+
+    img_h=rin.hdr->header.height; img_w=rin.hdr->header.width;
+    npixels=img_h*img_w;
+
+    if(img_h < 3 || img_w < 3 || nconv > (img_h-2))
+    {
+        printf("%dx%d frames can not be split over %d threads\n", img_w, img_h, nconv);
+        return -1;
+    }
+    if(frame_shm_create(&rout, out_ring, &rin.hdr->header, nslots) < 0)
+        return -1;
+
+    // workers are created after the priority change so they inherit it
+    set_priority("sharpen");
+    for(i=0; i<nconv; i++)
+    {
+        convarg[i].i=1+((i*(img_h-2))/nconv);
+        convarg[i].h=(1+(((i+1)*(img_h-2))/nconv))-convarg[i].i;
+        convargs[i]=(void *)&convarg[i];
+    }
+    frame_pool_create(&pool, nconv, conv_thread, convargs);
+
+    printf("sharpen %dx%d frames %s -> %s with %s PSF kernel on %d threads\n", img_w, img_h,
+           rin.name, rout.name, sharpen_row_name, nconv);
+
+    while((conv_in=frame_shm_next(&rin, &meta)) != NULL)
+    {
+        conv_out=frame_shm_acquire(&rout);
+        if(frames == 0) t_first=frame_shm_now();
+
+        // the one pixel border is not convolved
+        memcpy(conv_out, conv_in, (size_t)img_w*3);
+        memcpy(&conv_out[(size_t)(img_h-1)*img_w*3], &conv_in[(size_t)(img_h-1)*img_w*3], (size_t)img_w*3);
+        for(i=1; i<(img_h-1); i++)
+        {
+            memcpy(&conv_out[(size_t)i*img_w*3], &conv_in[(size_t)i*img_w*3], 3);
+            memcpy(&conv_out[(((size_t)i*img_w)+img_w-1)*3], &conv_in[(((size_t)i*img_w)+img_w-1)*3], 3);
+        }
+
+        frame_pool_run(&pool);
+
+        // the capture time stamp goes on with the frame
+        frame_shm_publish(&rout, meta.frame, meta.t_start_ns);
+        frame_shm_release(&rin);
+        t_last=frame_shm_now();
+        frames++;
+    }
+
+    frame_pool_destroy(&pool);
+    frame_shm_end(&rout);
+    frame_shm_close(&rin);
+    frame_shm_close(&rout);
+
+    if(frames > 0)
+        printf("sharpened %d frames in %lf sec, %.2lf frames/sec\n", frames, ns_to_sec(t_last - t_first),
+               (t_last > t_first) ? frames / ns_to_sec(t_last - t_first) : 0.0);
+    return 0;
+}
+
+
+static int consume_main(void)
+{
+    frame_shm_t ring;
+    frame_shm_slot_t meta;
+    const UINT8 *frame;
+    char path[256];
+    long long now, latency, lat_min=0, lat_max=0, lat_sum=0, t_first=0, t_last=0;
+    unsigned int expect=0;
+    int frames=0, dropped=0;
+
+    if(frame_shm_open(&ring, in_ring) < 0)
+        return -1;
+
+    img_h=ring.hdr->header.height; img_w=ring.hdr->header.width;
+    npixels=img_h*img_w;
+    printf("consume %dx%d frames from %s\n", img_w, img_h, ring.name);
+
+    set_priority("consume");
+
+    while((frame=frame_shm_next(&ring, &meta)) != NULL)
+    {
+        if(out_pattern != NULL)
+        {
+            snprintf(path, sizeof(path), out_pattern, meta.frame);
+            if(ppm_write_rgb(path, &ring.hdr->header, frame, npixels) < 0)
+                printf("frame %u write failed\n", meta.frame);
+        }
+        frame_shm_release(&ring);
+
+        now=frame_shm_now();
+        latency=now - meta.t_start_ns;
+
+        // frame numbers are the capture order, a gap is a frame lost upstream
+        if(meta.frame != expect) dropped+=meta.frame - expect;
+        expect=meta.frame+1;
+
+        if(frames == 0) { t_first=meta.t_start_ns; lat_min=latency; }
+        t_last=now;
+        frames++;
+        lat_sum+=latency;
+        if(latency < lat_min) lat_min=latency;
+        if(latency > lat_max) lat_max=latency;
+    }
+
+    frame_shm_close(&ring);
+
+    if(frames > 0)
+    {
+        printf("%d frames in %lf sec, %.2lf frames/sec, %d missing\n", frames, ns_to_sec(t_last - t_first),
+               frames / ns_to_sec(t_last - t_first), dropped);
+        printf("capture to consume latency min=%lf avg=%lf max=%lf sec\n", ns_to_sec(lat_min),
+               ns_to_sec(lat_sum) / frames, ns_to_sec(lat_max));
+    }
+    else
+        printf("no frames consumed\n");
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    char *role=(argc > 1) ? argv[1] : "";
+
+    // the role goes first, options after it
+    optind=2;
+    while(argc > 1 && (opt=getopt(argc, argv, "k:t:n:r:s:p:I:O:o:")) != -1)
+    {
+        if(opt == 'k') kernel=optarg;
+        else if(opt == 't') nconv=atoi(optarg);
+        else if(opt == 'n') loops=atoi(optarg);
+        else if(opt == 'r') frame_rate=atof(optarg);
+        else if(opt == 's') nslots=atoi(optarg);
+        else if(opt == 'p') priority=atoi(optarg);
+        else if(opt == 'I') in_ring=optarg;
+        else if(opt == 'O') out_ring=optarg;
+        else if(opt == 'o') out_pattern=optarg;
+        else argc=0;
+    }
+
+    // the capture end of the pipeline writes /sharpen_in
+    if(strcmp(role, "capture") == 0 && (argc-optind) >= 1 && loops >= 1)
+    {
+        if(out_ring == NULL) out_ring=DEFAULT_IN_RING;
+        rti_init(0);
+        exit(capture_main(&argv[optind], argc-optind) == 0 ? 0 : -1);
+    }
+    if(strcmp(role, "sharpen") == 0 && (argc-optind) == 0 && nconv >= 1 && nconv <= FRAME_POOL_MAX_WORKERS)
+    {
+        if(in_ring == NULL) in_ring=DEFAULT_IN_RING;
+        if(out_ring == NULL) out_ring=DEFAULT_OUT_RING;
+        rti_init(0);
+        exit(sharpen_main() == 0 ? 0 : -1);
+    }
+    // and the consume end reads /sharpen_out
+    if(strcmp(role, "consume") == 0 && (argc-optind) == 0)
+    {
+        if(in_ring == NULL) in_ring=DEFAULT_OUT_RING;
+        rti_init(0);
+        exit(consume_main() == 0 ? 0 : -1);
+    }
+
+    printf("Usage: sharpen_shm capture [-O ring] [-s slots] [-r fps] [-n loops] [-p prio] input.ppm ...|-\n");
+    printf("       sharpen_shm sharpen [-I ring] [-O ring] [-s slots] [-k psf|box|sse2|avx2|neon] [-t threads] [-p prio]\n");
+    printf("       sharpen_shm consume [-I ring] [-o out%%04d.ppm] [-p prio]\n");
+    exit(-1);
+}
@@ -0,0 +1,215 @@
+// Per-worker, per-frame timing for sharpen_grid
+//
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/sysinfo.h>
+
+#include "sharpen_stats.h"
+#include "tstamp.h"
+
+#define NSEC_PER_SEC (1000000000ULL)
+#define NS_TO_MS(ns) ((double)(ns) / 1000000.0)
+
+
+// the first call calibrates the counter, before it reads it
+UINT64 stats_now_ns(void)
+{
+    ts_init();
+    return (UINT64)ts_ticks_ns(ts_now());
+}
+
+
+static UINT64 thread_cpu_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return ((UINT64)now.tv_sec * NSEC_PER_SEC) + now.tv_nsec;
+}
+
+
+int stats_init(sharpen_stats_t *stats, int nworkers, int nframes, frame_fn_t fn, void **args)
+{
+    int i;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->nworkers=nworkers;
+    stats->nframes=nframes;
+
+    stats->sample=calloc((size_t)nworkers*nframes, sizeof(stats_sample_t));
+    stats->frames=calloc(nframes, sizeof(stats_sample_t));
+    stats->workers=calloc(nworkers, sizeof(stats_worker_t));
+    stats->args=calloc(nworkers, sizeof(void *));
+
+    if(stats->sample == NULL || stats->frames == NULL || stats->workers == NULL || stats->args == NULL)
+    {
+        printf("Error allocating timing for %d workers x %d frames\n", nworkers, nframes);
+        stats_free(stats);
+        return -1;
+    }
+
+    for(i=0; i<nworkers; i++)
+    {
+        stats->workers[i].stats=stats;
+        stats->workers[i].idx=i;
+        stats->workers[i].fn=fn;
+        stats->workers[i].arg=args[i];
+        stats->args[i]=(void *)&stats->workers[i];
+    }
+
+    stats->t0_ns=stats_now_ns();
+    return 0;
+}
+
+
+void *stats_worker(void *arg)
+{
+    stats_worker_t *w=(stats_worker_t *)arg;
+    sharpen_stats_t *stats=w->stats;
+    stats_sample_t *s=&stats->sample[((size_t)stats->frame*stats->nworkers)+w->idx];
+    UINT64 cpu0;
+
+    s->start_ns=stats_now_ns()-stats->t0_ns;
+    s->cpu=sched_getcpu();
+    cpu0=thread_cpu_ns();
+
+    w->fn(w->arg);
+
+    s->cpu_ns=thread_cpu_ns()-cpu0;
+    s->end_ns=stats_now_ns()-stats->t0_ns;
+
+    return (void *)0;
+}
+
+
+void stats_frame_begin(sharpen_stats_t *stats, int frame)
+{
+    // workers pick this up after the pool's frame_start barrier
+    stats->frame=frame;
+    stats->frames[frame].start_ns=stats_now_ns()-stats->t0_ns;
+    stats->frames[frame].cpu=sched_getcpu();
+}
+
+
+void stats_frame_end(sharpen_stats_t *stats, int frame)
+{
+    stats->frames[frame].end_ns=stats_now_ns()-stats->t0_ns;
+}
+
+
+static int cmp_ull(const void *a, const void *b)
+{
+    UINT64 x=*(const UINT64 *)a, y=*(const UINT64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+
+int stats_report(sharpen_stats_t *stats, const char *prefix)
+{
+    int f, i, ncores=get_nprocs_conf();
+    UINT64 *lat, busy, max_busy, sum_busy, lat_sum=0, elapsed;
+    UINT64 *core_busy;
+    double imb, imb_sum=0.0, imb_max=0.0;
+    stats_sample_t *s;
+    char path[256];
+    FILE *fsum, *ffrm, *fwrk;
+
+    lat=malloc(stats->nframes*sizeof(UINT64));
+    core_busy=calloc(ncores, sizeof(UINT64));
+
+    snprintf(path, sizeof(path), "%s_frames.csv", prefix);
+    ffrm=fopen(path, "w");
+    snprintf(path, sizeof(path), "%s_workers.csv", prefix);
+    fwrk=fopen(path, "w");
+    snprintf(path, sizeof(path), "%s_summary.csv", prefix);
+    fsum=fopen(path, "w");
+
+    if(lat == NULL || core_busy == NULL || ffrm == NULL || fwrk == NULL || fsum == NULL)
+    {
+        perror("stats_report");
+        free(lat); free(core_busy);
+        if(ffrm) fclose(ffrm);
+        if(fwrk) fclose(fwrk);
+        if(fsum) fclose(fsum);
+        return -1;
+    }
+
+    fprintf(ffrm, "frame,start_ms,latency_ms,max_busy_ms,avg_busy_ms,imbalance\n");
+    fprintf(fwrk, "frame,worker,cpu,start_ms,end_ms,busy_ms,cpu_ms\n");
+
+    for(f=0; f<stats->nframes; f++)
+    {
+        max_busy=0; sum_busy=0;
+
+        for(i=0; i<stats->nworkers; i++)
+        {
+            s=&stats->sample[((size_t)f*stats->nworkers)+i];
+            busy=s->end_ns-s->start_ns;
+
+            if(busy > max_busy) max_busy=busy;
+            sum_busy+=busy;
+            if(s->cpu >= 0 && s->cpu < ncores) core_busy[s->cpu]+=s->cpu_ns;
+
+            fprintf(fwrk, "%d,%d,%d,%.6lf,%.6lf,%.6lf,%.6lf\n", f, i, s->cpu,
+                    NS_TO_MS(s->start_ns), NS_TO_MS(s->end_ns), NS_TO_MS(busy), NS_TO_MS(s->cpu_ns));
+        }
+
+        // slowest worker over the average, 1.0 is perfectly balanced, on wall
+        // time since that is what holds up the frame
+        imb=(sum_busy > 0) ? ((double)max_busy * stats->nworkers) / (double)sum_busy : 1.0;
+        imb_sum+=imb;
+        if(imb > imb_max) imb_max=imb;
+
+        lat[f]=stats->frames[f].end_ns-stats->frames[f].start_ns;
+        lat_sum+=lat[f];
+
+        fprintf(ffrm, "%d,%.6lf,%.6lf,%.6lf,%.6lf,%.4lf\n", f, NS_TO_MS(stats->frames[f].start_ns), NS_TO_MS(lat[f]),
+                NS_TO_MS(max_busy), NS_TO_MS(sum_busy) / stats->nworkers, imb);
+    }
+
+    qsort(lat, stats->nframes, sizeof(UINT64), cmp_ull);
+    elapsed=stats->frames[stats->nframes-1].end_ns-stats->frames[0].start_ns;
+
+    fprintf(fsum, "metric,value\n");
+    fprintf(fsum, "frames,%d\n", stats->nframes);
+    fprintf(fsum, "workers,%d\n", stats->nworkers);
+    fprintf(fsum, "frame_min_ms,%.6lf\n", NS_TO_MS(lat[0]));
+    fprintf(fsum, "frame_avg_ms,%.6lf\n", NS_TO_MS(lat_sum) / stats->nframes);
+    fprintf(fsum, "frame_max_ms,%.6lf\n", NS_TO_MS(lat[stats->nframes-1]));
+    fprintf(fsum, "frame_p99_ms,%.6lf\n", NS_TO_MS(lat[((stats->nframes*99)+99)/100 - 1]));
+    fprintf(fsum, "imbalance_avg,%.4lf\n", imb_sum / stats->nframes);
+    fprintf(fsum, "imbalance_max,%.4lf\n", imb_max);
+    fprintf(fsum, "read_ms,%.6lf\n", NS_TO_MS(stats->read_ns));
+    fprintf(fsum, "write_ms,%.6lf\n", NS_TO_MS(stats->write_ns));
+
+    for(i=0; i<ncores; i++)
+    {
+        if(core_busy[i] == 0) continue;
+        fprintf(fsum, "core%d_busy_ms,%.6lf\n", i, NS_TO_MS(core_busy[i]));
+        fprintf(fsum, "core%d_util,%.4lf\n", i, (elapsed > 0) ? (double)core_busy[i] / elapsed : 0.0);
+    }
+
+    printf("frame ms min=%.3lf avg=%.3lf max=%.3lf p99=%.3lf, imbalance avg=%.3lf max=%.3lf, read %.3lf ms, write %.3lf ms\n",
+           NS_TO_MS(lat[0]), NS_TO_MS(lat_sum) / stats->nframes, NS_TO_MS(lat[stats->nframes-1]),
+           NS_TO_MS(lat[((stats->nframes*99)+99)/100 - 1]), imb_sum / stats->nframes, imb_max,
+           NS_TO_MS(stats->read_ns), NS_TO_MS(stats->write_ns));
+    printf("timing written to %s_summary.csv, %s_frames.csv, %s_workers.csv\n", prefix, prefix, prefix);
+
+    fclose(ffrm); fclose(fwrk); fclose(fsum);
+    free(lat); free(core_busy);
+    return 0;
+}
+
+
+void stats_free(sharpen_stats_t *stats)
+{
+    free(stats->sample); stats->sample=NULL;
+    free(stats->frames); stats->frames=NULL;
+    free(stats->workers); stats->workers=NULL;
+    free(stats->args); stats->args=NULL;
+}
@@ -0,0 +1,66 @@
+#ifndef _SHARPEN_STATS_
+#define _SHARPEN_STATS_
+
+#include "frame_pool.h"
+
+// Per-worker, per-frame timing for sharpen_grid
+//
+// Each pool worker is wrapped so it stamps the cycle counter (tstamp.h), its thread CPU
+// time and its core before and after its part of a frame, into arrays sized for every frame up front,
+// so nothing is printed or allocated while frames are running.  The report
+// is written afterwards as CSV for plotting.
+
+typedef unsigned long long int UINT64;
+
+typedef struct
+{
+    UINT64 start_ns;    // relative to stats_init
+    UINT64 end_ns;
+    UINT64 cpu_ns;      // thread CPU time, excludes time preempted
+    int cpu;
+} stats_sample_t;
+
+typedef struct sharpen_stats sharpen_stats_t;
+
+typedef struct
+{
+    sharpen_stats_t *stats;
+    int idx;
+    frame_fn_t fn;
+    void *arg;
+} stats_worker_t;
+
+struct sharpen_stats
+{
+    int nworkers;
+    int nframes;
+    int frame;                  // frame being run, set by stats_frame_begin
+    UINT64 t0_ns;
+    stats_sample_t *sample;     // [frame][worker]
+    stats_sample_t *frames;     // [frame], whole frame as seen by the caller
+    stats_worker_t *workers;
+    void **args;                // wrapped args for frame_pool_create
+    UINT64 read_ns;             // I/O outside the frame loop, filled in by the caller
+    UINT64 write_ns;
+};
+
+// Wrap nworkers of fn(args[i]) for up to nframes frames, returns 0 on success
+int stats_init(sharpen_stats_t *stats, int nworkers, int nframes, frame_fn_t fn, void **args);
+
+// frame_fn_t to hand frame_pool_create with stats->args
+void *stats_worker(void *arg);
+
+// Bracket each frame_pool_run
+void stats_frame_begin(sharpen_stats_t *stats, int frame);
+void stats_frame_end(sharpen_stats_t *stats, int frame);
+
+// cycle counter in ns, for timing the I/O
+UINT64 stats_now_ns(void);
+
+// Print the summary and write prefix_summary.csv, prefix_frames.csv and
+// prefix_workers.csv, returns 0 on success
+int stats_report(sharpen_stats_t *stats, const char *prefix);
+
+void stats_free(sharpen_stats_t *stats);
+
+#endif
@@ -0,0 +1,485 @@
+// Streaming sharpen - a continuous sequence of frames through a three stage
+// pipeline instead of one image convolved ITERATIONS times
+//
+// reader -> convolve -> writer, each stage on its own core, handing frames
+// over through a ring of NUM_SLOTS buffers allocated once from the first
+// frame's header.  Counting semaphores carry the slots between stages the
+// same way the sequencer examples release services.
+//
+// Input is a list of PPM files, optionally looped, or "-" for back-to-back P6
+// frames on stdin (camera FIFO, ffmpeg -f image2pipe -vcodec ppm, cat *.ppm).
+// Output is a printf pattern for per-frame files, "-" for a P6 stream on
+// stdout, or nothing to just measure.
+//
+// With -k cuda or -k opencl, in a GPU=cuda|opencl build, the convolve stage
+// hands frames to the GPU instead of the worker pool, each slot on its own
+// stream, and keeps GPU_DEPTH of them in flight, so one frame's upload
+// overlaps the previous frame's kernel and download while the reader and
+// writer work on the other slots.
+//
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <string.h>
+#include <time.h>
+#include <sys/sysinfo.h>
+
+#include "ppm_io.h"
+#include "frame_pool.h"
+#include "sharpen_kernel.h"
+#include "sharpen_gpu.h"
+
+// frames in flight, one being read, one convolved, one written, one spare
+#define NUM_SLOTS (4)
+
+#define NUM_CONV_THREADS (4)
+
+// frames on the GPU at once, at most NUM_SLOTS-2 so the reader and the
+// writer each still have a slot
+#define GPU_DEPTH (2)
+
+// cores for the I/O stages, the convolve workers are pinned from core 0 up
+#define READER_CORE (1)
+#define WRITER_CORE (2)
+
+#define NSEC_PER_SEC (1000000000)
+
+typedef unsigned long long int UINT64;
+
+typedef struct
+{
+    UINT8 *in;                  // interleaved RGB as read
+    UINT8 *out;                 // interleaved RGB sharpened
+    ppm_header_t header;
+    struct timespec t_start;    // frame release, latency is measured from here
+    int frame;
+    int eos;                    // no frame, end of stream
+} frameSlotType;
+
+typedef struct
+{
+    int i;
+    int h;
+} convArgsType;
+
+frameSlotType slot[NUM_SLOTS];
+sem_t sem_free, sem_read, sem_conv;
+
+// the convolve workers read the current slot, set before each frame_pool_run
+frame_pool_t pool;
+frameSlotType *conv_slot;
+convArgsType convarg[FRAME_POOL_MAX_WORKERS];
+void *convargs[FRAME_POOL_MAX_WORKERS];
+
+int img_h, img_w, npixels, gpu=0;
+
+// input
+char **in_files;
+int num_in_files, loops=1, in_stdin=0;
+ppm_header_t first_header;
+double frame_rate=0.0;
+
+// output
+char *out_pattern=NULL;
+
+// writer statistics
+int frames_done=0;
+double lat_min=1.0e9, lat_max=0.0, lat_sum=0.0;
+struct timespec t_first, t_last;
+
+
+static double ts_diff(struct timespec *stop, struct timespec *start)
+{
+    return (double)(stop->tv_sec - start->tv_sec) + ((double)(stop->tv_nsec - start->tv_nsec) / NSEC_PER_SEC);
+}
+
+
+static void pin_thread(pthread_attr_t *attr, int core)
+{
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset);
+    CPU_SET(core % get_nprocs(), &cpuset);
+
+    pthread_attr_init(attr);
+    pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &cpuset);
+}
+
+
+// read one frame from fd into s, returns 0, 1 at end of stream, -1 on error
+static int read_frame(int fd, frameSlotType *s, int have_header)
+{
+    int rc;
+
+    if(!have_header && (rc=ppm_read_fd_header(fd, &s->header)) != 0)
+        return rc;
+
+    if(s->header.width != img_w || s->header.height != img_h)
+    {
+        printf("frame %d is %dx%d, stream is %dx%d\n", s->frame, s->header.width, s->header.height, img_w, img_h);
+        return -1;
+    }
+
+    return ppm_read_fd_rgb(fd, s->in, npixels);
+}
+
+
+void *reader_thread(void *threadp)
+{
+    int idx=0, frame=0, loop, f, fd, rc;
+    frameSlotType *s;
+    struct timespec release;
+    UINT64 period_ns=(frame_rate > 0.0) ? (UINT64)(NSEC_PER_SEC / frame_rate) : 0;
+
+    (void)threadp;
+
+    clock_gettime(CLOCK_MONOTONIC, &release);
+
+    for(loop=0; loop < loops; loop++)
+    {
+        for(f=0; f < (in_stdin ? 1 : num_in_files); f++)
+        {
+            if(in_stdin) fd=STDIN_FILENO;
+            else if((fd=open(in_files[f], O_RDONLY)) < 0)
+            {
+                printf("Error opening %s\n", in_files[f]);
+                continue;
+            }
+
+            // a file holds one frame, stdin holds frames until end of stream
+            do
+            {
+                // paced like a camera, otherwise as fast as the pipeline drains
+                if(period_ns)
+                {
+                    release.tv_nsec+=period_ns;
+                    while(release.tv_nsec >= NSEC_PER_SEC) { release.tv_nsec-=NSEC_PER_SEC; release.tv_sec++; }
+                    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &release, NULL);
+                }
+
+                sem_wait(&sem_free);
+                s=&slot[idx];
+                s->frame=frame; s->eos=0;
+                clock_gettime(CLOCK_MONOTONIC, &s->t_start);
+
+                if(in_stdin && frame == 0)
+                {
+                    s->header=first_header;
+                    rc=read_frame(fd, s, 1);
+                }
+                else
+                    rc=read_frame(fd, s, 0);
+
+                if(rc != 0)
+                {
+                    if(rc < 0) printf("frame %d read failed\n", frame);
+                    sem_post(&sem_free);
+                    break;
+                }
+
+                sem_post(&sem_read);
+                idx=(idx+1) % NUM_SLOTS;
+                frame++;
+            } while(in_stdin);
+
+            if(!in_stdin) close(fd);
+        }
+    }
+
+    sem_wait(&sem_free);
+    slot[idx].eos=1;
+    sem_post(&sem_read);
+
+    return (void *)0;
+}
+
+
+void *writer_thread(void *threadp)
+{
+    int idx=0, fd=-1;
+    frameSlotType *s;
+    char path[256];
+    struct timespec now;
+    double latency;
+
+    (void)threadp;
+
+    if(out_pattern != NULL && strcmp(out_pattern, "-") == 0)
+        fd=STDOUT_FILENO;
+
+    while(1)
+    {
+        sem_wait(&sem_conv);
+        s=&slot[idx];
+
+        if(s->eos) break;
+
+        if(fd >= 0)
+        {
+            if(ppm_write_fd_rgb(fd, &s->header, s->out, npixels) < 0)
+                printf("frame %d write failed\n", s->frame);
+        }
+        else if(out_pattern != NULL)
+        {
+            snprintf(path, sizeof(path), out_pattern, s->frame);
+            if(ppm_write_rgb(path, &s->header, s->out, npixels) < 0)
+                printf("frame %d write failed\n", s->frame);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        latency=ts_diff(&now, &s->t_start);
+
+        if(frames_done == 0) t_first=s->t_start;
+        t_last=now;
+        frames_done++;
+        lat_sum+=latency;
+        if(latency < lat_min) lat_min=latency;
+        if(latency > lat_max) lat_max=latency;
+
+        sem_post(&sem_free);
+        idx=(idx+1) % NUM_SLOTS;
+    }
+
+    return (void *)0;
+}
+
+
+void *conv_thread(void *threadp)
+{
+    convArgsType *a=(convArgsType *)threadp;
+
+    sharpen_rgb_tile(conv_slot->in, conv_slot->out, img_w, a->i, 1, a->h, img_w-2);
+
+    return (void *)0;
+}
+
+
+#ifdef SHARPEN_GPU
+// convolve stage on the GPU: every frame is submitted on its slot as soon
+// as it is read, and the oldest handed to the writer, in order, once
+// GPU_DEPTH are in flight, all of them at the end of the stream.  The
+// kernel writes the border too, so nothing is done on the CPU.
+static void gpu_convolve(void)
+{
+    int idx=0, oldest=0, pending=0;
+    frameSlotType *s;
+
+    while(1)
+    {
+        sem_wait(&sem_read);
+        s=&slot[idx];
+
+        if(!s->eos)
+        {
+            if(sharpen_gpu_submit(idx, s->in, s->out) < 0)
+                exit(-1);
+            pending++;
+        }
+
+        while(pending > (s->eos ? 0 : GPU_DEPTH-1))
+        {
+            if(sharpen_gpu_wait(oldest) < 0)
+                exit(-1);
+            sem_post(&sem_conv);
+            oldest=(oldest+1) % NUM_SLOTS;
+            pending--;
+        }
+
+        if(s->eos)
+        {
+            sem_post(&sem_conv);
+            break;
+        }
+        idx=(idx+1) % NUM_SLOTS;
+    }
+}
+#endif
+
+
+int main(int argc, char *argv[])
+{
+    int i, idx=0, opt, nconv=NUM_CONV_THREADS;
+    char *kernel=NULL;
+    pthread_t reader, writer;
+    pthread_attr_t attr;
+    frameSlotType *s;
+
+    while((opt=getopt(argc, argv, "k:o:n:t:f:")) != -1)
+    {
+        if(opt == 'k') kernel=optarg;
+        else if(opt == 'o') out_pattern=optarg;
+        else if(opt == 'n') loops=atoi(optarg);
+        else if(opt == 't') nconv=atoi(optarg);
+        else if(opt == 'f') frame_rate=atof(optarg);
+        else argc=0;
+    }
+
+    if((argc-optind) < 1 || loops < 1 || nconv < 1 || nconv > FRAME_POOL_MAX_WORKERS)
+    {
+       printf("Usage: sharpen_stream [-k psf|sse2|avx2|neon|cuda|opencl] [-o out%%04d.ppm|-] [-n loops] [-t threads] [-f fps] input.ppm ...|-\n");
+       exit(-1);
+    }
+
+    if(sharpen_gpu_kernel(kernel))
+    {
+#ifdef SHARPEN_GPU
+        gpu=1;
+#else
+        printf("-k %s needs a build with make GPU=%s\n", kernel, kernel);
+        exit(-1);
+#endif
+    }
+    else if(sharpen_kernel_init(kernel) < 0)
+        exit(-1);
+
+    in_files=&argv[optind];
+    num_in_files=argc-optind;
+    in_stdin=(strcmp(in_files[0], "-") == 0);
+
+    // every buffer is sized from the first frame
+    if(in_stdin)
+    {
+        if(ppm_read_fd_header(STDIN_FILENO, &first_header) != 0)
+        {
+            printf("no P6 frame on stdin\n");
+            exit(-1);
+        }
+    }
+    else if(ppm_read_header(in_files[0], &first_header) < 0)
+        exit(-1);
+
+    img_h=first_header.height; img_w=first_header.width;
+    npixels=img_h*img_w;
+
+    if(img_h < 3 || img_w < 3 || nconv > (img_h-2))
+    {
+        printf("%dx%d frames can not be split over %d threads\n", img_w, img_h, nconv);
+        exit(-1);
+    }
+
+#ifdef SHARPEN_GPU
+    // GPU slots are pinned, or zero copy on unified memory, frame buffers
+    if(gpu)
+    {
+        if(sharpen_gpu_init(kernel, img_w, img_h, NUM_SLOTS) < 0)
+            exit(-1);
+        for(i=0; i<NUM_SLOTS; i++)
+        {
+            if((slot[i].in=sharpen_gpu_alloc((size_t)npixels*3)) == NULL ||
+               (slot[i].out=sharpen_gpu_alloc((size_t)npixels*3)) == NULL)
+            {
+                printf("Error allocating %d GPU frame slots\n", NUM_SLOTS);
+                exit(-1);
+            }
+        }
+    }
+    else
+#endif
+    for(i=0; i<NUM_SLOTS; i++)
+    {
+        if((slot[i].in=malloc((size_t)npixels*3)) == NULL || (slot[i].out=malloc((size_t)npixels*3)) == NULL)
+        {
+            printf("Error allocating %d frame slots\n", NUM_SLOTS);
+            exit(-1);
+        }
+    }
+
+    sem_init(&sem_free, 0, NUM_SLOTS);
+    sem_init(&sem_read, 0, 0);
+    sem_init(&sem_conv, 0, 0);
+
+    // convolve workers each take a fixed band of rows of every frame
+    for(i=0; i<nconv; i++)
+    {
+        convarg[i].i=1+((i*(img_h-2))/nconv);
+        convarg[i].h=(1+(((i+1)*(img_h-2))/nconv))-convarg[i].i;
+        convargs[i]=(void *)&convarg[i];
+    }
+#ifdef SHARPEN_GPU
+    if(gpu)
+        fprintf(stderr, "streaming %dx%d frames with %s PSF kernel on %s, %d in flight\n", img_w, img_h,
+                sharpen_gpu_name, sharpen_gpu_device, GPU_DEPTH);
+    else
+#endif
+    {
+        frame_pool_create(&pool, nconv, conv_thread, convargs);
+        fprintf(stderr, "streaming %dx%d frames with %s PSF kernel on %d threads\n", img_w, img_h, sharpen_row_name, nconv);
+    }
+
+    pin_thread(&attr, WRITER_CORE);
+    if(pthread_create(&writer, &attr, writer_thread, (void *)0) != 0 &&
+       pthread_create(&writer, (void *)0, writer_thread, (void *)0) != 0)
+    {
+        perror("writer pthread_create");
+        exit(-1);
+    }
+    pthread_attr_destroy(&attr);
+
+    pin_thread(&attr, READER_CORE);
+    if(pthread_create(&reader, &attr, reader_thread, (void *)0) != 0 &&
+       pthread_create(&reader, (void *)0, reader_thread, (void *)0) != 0)
+    {
+        perror("reader pthread_create");
+        exit(-1);
+    }
+    pthread_attr_destroy(&attr);
+
+    // this thread is the convolve stage
+#ifdef SHARPEN_GPU
+    if(gpu)
+        gpu_convolve();
+    else
+#endif
+    while(1)
+    {
+        sem_wait(&sem_read);
+        s=&slot[idx];
+
+        if(!s->eos)
+        {
+            // the one pixel border is not convolved
+            memcpy(s->out, s->in, (size_t)img_w*3);
+            memcpy(&s->out[(size_t)(img_h-1)*img_w*3], &s->in[(size_t)(img_h-1)*img_w*3], (size_t)img_w*3);
+            for(i=1; i<(img_h-1); i++)
+            {
+                memcpy(&s->out[(size_t)i*img_w*3], &s->in[(size_t)i*img_w*3], 3);
+                memcpy(&s->out[(((size_t)i*img_w)+img_w-1)*3], &s->in[(((size_t)i*img_w)+img_w-1)*3], 3);
+            }
+
+            conv_slot=s;
+            frame_pool_run(&pool);
+        }
+
+        sem_post(&sem_conv);
+        if(s->eos) break;
+        idx=(idx+1) % NUM_SLOTS;
+    }
+
+    pthread_join(reader, (void **)0);
+    pthread_join(writer, (void **)0);
+#ifdef SHARPEN_GPU
+    if(gpu)
+        sharpen_gpu_close();
+    else
+#endif
+    frame_pool_destroy(&pool);
+
+    // stdout may be the frame stream, so the report goes to stderr
+    if(frames_done > 0)
+    {
+        fprintf(stderr, "%d frames in %lf sec, %.2lf frames/sec, %.2lf MPix/s\n",
+                frames_done, ts_diff(&t_last, &t_first), frames_done / ts_diff(&t_last, &t_first),
+                ((double)npixels * frames_done) / (ts_diff(&t_last, &t_first) * 1000000.0));
+        fprintf(stderr, "frame latency min=%lf avg=%lf max=%lf sec\n", lat_min, lat_sum / frames_done, lat_max);
+    }
+    else
+        fprintf(stderr, "no frames processed\n");
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Work-stealing task scheduler for frame_pool workers
+//
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "steal_sched.h"
+
+#define RANGE(head, tail) (((unsigned long long)(tail) << 32) | (unsigned long long)(head))
+#define HEAD(range) ((unsigned int)((range) & 0xFFFFFFFFULL))
+#define TAIL(range) ((unsigned int)((range) >> 32))
+
+
+// owner end, returns a task index or -1 when empty
+static int steal_pop(steal_deque_t *dq)
+{
+    unsigned long long r, next;
+
+    r=__atomic_load_n(&dq->range, __ATOMIC_ACQUIRE);
+    do
+    {
+        if(HEAD(r) >= TAIL(r)) return -1;
+        next=RANGE(HEAD(r), TAIL(r)-1);
+    } while(!__atomic_compare_exchange_n(&dq->range, &r, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    return (int)TAIL(r)-1;
+}
+
+
+// thief end, returns a task index or -1 when empty
+static int steal_take(steal_deque_t *dq)
+{
+    unsigned long long r, next;
+
+    r=__atomic_load_n(&dq->range, __ATOMIC_ACQUIRE);
+    do
+    {
+        if(HEAD(r) >= TAIL(r)) return -1;
+        next=RANGE(HEAD(r)+1, TAIL(r));
+    } while(!__atomic_compare_exchange_n(&dq->range, &r, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    return (int)HEAD(r);
+}
+
+
+int steal_init(steal_sched_t *sched, int nworkers, frame_fn_t fn, void **tasks, const int *first)
+{
+    int i;
+
+    if(nworkers < 1 || nworkers > STEAL_MAX_WORKERS)
+    {
+        printf("steal_sched: %d workers not supported\n", nworkers);
+        return -1;
+    }
+
+    sched->nworkers=nworkers;
+    sched->fn=fn;
+    sched->tasks=tasks;
+
+    for(i=0; i<nworkers; i++)
+    {
+        sched->deque[i].first=first[i];
+        sched->deque[i].last=first[i+1];
+        sched->workers[i].sched=sched;
+        sched->workers[i].idx=i;
+        sched->workers[i].stolen=0;
+    }
+
+    steal_reset(sched);
+    return 0;
+}
+
+
+void steal_reset(steal_sched_t *sched)
+{
+    int i;
+
+    for(i=0; i<sched->nworkers; i++)
+        __atomic_store_n(&sched->deque[i].range, RANGE(sched->deque[i].first, sched->deque[i].last), __ATOMIC_RELEASE);
+}
+
+
+void *steal_worker(void *arg)
+{
+    steal_worker_t *w=(steal_worker_t *)arg;
+    steal_sched_t *sched=w->sched;
+    int t, v, victim;
+
+    while((t=steal_pop(&sched->deque[w->idx])) >= 0)
+        sched->fn(sched->tasks[t]);
+
+    // no deque grows during a frame, so one pass over the others drains them
+    for(v=1; v<sched->nworkers; v++)
+    {
+        victim=(w->idx+v) % sched->nworkers;
+
+        while((t=steal_take(&sched->deque[victim])) >= 0)
+        {
+            sched->fn(sched->tasks[t]);
+            w->stolen++;
+        }
+    }
+
+    return (void *)0;
+}
+
+
+unsigned long long steal_count(steal_sched_t *sched)
+{
+    unsigned long long total=0;
+    int i;
+
+    for(i=0; i<sched->nworkers; i++)
+        total+=sched->workers[i].stolen;
+
+    return total;
+}
@@ -0,0 +1,54 @@
+#ifndef _STEAL_SCHED_
+#define _STEAL_SCHED_
+
+#include "frame_pool.h"
+
+// Work-stealing task scheduler for one frame at a time
+//
+// A frame is cut into many small tasks and each worker starts the frame with
+// its own contiguous run of them in a deque.  The owner pops from the tail and,
+// once its deque is empty, steals from the head of the others, so a worker on
+// a core busy with IRQs just ends up doing fewer tasks instead of holding up
+// the frame.  Tasks are never added during a frame, so a deque is a single
+// 64-bit (head, tail) word updated with CAS by owner and thieves alike.
+
+#define STEAL_MAX_WORKERS (FRAME_POOL_MAX_WORKERS)
+
+typedef struct steal_sched steal_sched_t;
+
+typedef struct
+{
+    unsigned long long range;   // head in the low 32 bits, tail in the high 32
+    unsigned int first;         // run of tasks owned at the start of a frame
+    unsigned int last;
+} __attribute__((aligned(64))) steal_deque_t;
+
+typedef struct
+{
+    steal_sched_t *sched;
+    int idx;
+    unsigned long long stolen;  // tasks taken from other workers, all frames
+} __attribute__((aligned(64))) steal_worker_t;
+
+struct steal_sched
+{
+    int nworkers;
+    frame_fn_t fn;
+    void **tasks;
+    steal_deque_t deque[STEAL_MAX_WORKERS];
+    steal_worker_t workers[STEAL_MAX_WORKERS];
+};
+
+// Worker i owns tasks[first[i]] .. tasks[first[i+1]-1], fn runs one task
+int steal_init(steal_sched_t *sched, int nworkers, frame_fn_t fn, void **tasks, const int *first);
+
+// Refill every deque for the next frame, only while no worker is running
+void steal_reset(steal_sched_t *sched);
+
+// frame_fn_t for a frame_pool worker, arg is &sched->workers[i]
+void *steal_worker(void *arg);
+
+// total tasks stolen so far
+unsigned long long steal_count(steal_sched_t *sched);
+
+#endif
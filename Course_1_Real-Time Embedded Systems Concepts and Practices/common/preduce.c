@@ -0,0 +1,153 @@
+// Parallel reduction with padded per-thread slots, see preduce.h
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "preduce.h"
+
+
+static void *prd_thread(void *slotp)
+{
+    prd_slot_t *slot=(prd_slot_t *)slotp;
+    prd_t *r=slot->r;
+    prd_slot_t *peer;
+    int s;
+
+    *slot->acc=0;
+    if(slot->lo <= slot->hi)
+        r->fn(slot->lo, slot->hi, slot->acc, r->arg);
+
+    if(r->combine == PRD_ATOMIC)
+    {
+        __atomic_add_fetch(&r->total, *slot->acc, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    // join is the barrier, the peer's slot is final once it returns
+    for(s=1; (slot->idx & s) == 0 && slot->idx + s < r->nthreads; s<<=1)
+    {
+        peer=&r->slots[slot->idx + s];
+        pthread_join(peer->thread, NULL);
+        *slot->acc+=*peer->acc;
+    }
+
+    return NULL;
+}
+
+
+int prd_create(prd_t *r, int nthreads, prd_combine_t combine, int layout, prd_fn_t fn, void *arg)
+{
+    void *buf;
+    int i;
+
+    memset(r, 0, sizeof(prd_t));
+    if(nthreads < 1 || posix_memalign(&buf, PRD_CACHE_LINE, nthreads*sizeof(prd_slot_t)) != 0)
+        return -1;
+    r->slots=(prd_slot_t *)buf;
+    memset(r->slots, 0, nthreads*sizeof(prd_slot_t));
+
+    if(layout == PRD_PACKED &&
+       (r->packed=(unsigned long long *)calloc(nthreads, sizeof(unsigned long long))) == NULL)
+    {
+        free(r->slots);
+        return -1;
+    }
+
+    r->nthreads=nthreads;
+    r->combine=combine;
+    r->layout=layout;
+    r->fn=fn;
+    r->arg=arg;
+
+    for(i=0; i<nthreads; i++)
+    {
+        r->slots[i].idx=i;
+        r->slots[i].r=r;
+        r->slots[i].acc=r->packed ? &r->packed[i] : &r->slots[i].sum;
+    }
+
+    return 0;
+}
+
+
+void prd_destroy(prd_t *r)
+{
+    free(r->slots);
+    free(r->packed);
+    r->slots=(prd_slot_t *)0;
+    r->packed=(unsigned long long *)0;
+}
+
+
+int prd_run(prd_t *r, pthread_attr_t *attr, unsigned long long n, unsigned long long *result)
+{
+    unsigned long long part=n / r->nthreads, extra=n % r->nthreads, lo=1;
+    int i, j, rc;
+
+    // the first n % nthreads parts get one more element
+    for(i=0; i<r->nthreads; i++)
+    {
+        r->slots[i].lo=lo;
+        r->slots[i].hi=lo + part + (i < (int)extra) - 1;
+        lo=r->slots[i].hi + 1;
+    }
+    r->total=0;
+
+    for(i=r->nthreads-1; i>=0; i--)
+    {
+        if((rc=pthread_create(&r->slots[i].thread, attr, prd_thread, (void *)&r->slots[i])) != 0)
+        {
+            printf("prd_run: thread %d of %d, rc=%d\n", i, r->nthreads, rc);
+            break;
+        }
+    }
+
+    if(i >= 0)
+    {
+        // join what was created and nobody else will: in a tree, thread j
+        // is joined by j with its lowest set bit cleared, if that exists
+        for(j=i+1; j<r->nthreads; j++)
+            if(r->combine == PRD_ATOMIC || (j & (j-1)) <= i)
+                pthread_join(r->slots[j].thread, NULL);
+        return -1;
+    }
+
+    if(r->combine == PRD_ATOMIC)
+    {
+        for(i=0; i<r->nthreads; i++)
+            pthread_join(r->slots[i].thread, NULL);
+        *result=__atomic_load_n(&r->total, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        pthread_join(r->slots[0].thread, NULL);
+        *result=*r->slots[0].acc;
+    }
+
+    return 0;
+}
+
+
+void prd_sum(unsigned long long lo, unsigned long long hi, unsigned long long *acc, void *arg)
+{
+    // register, or at the -O0 of the course Makefiles sum lives on the stack
+    register unsigned long long i, sum=0;
+
+    for(i=lo; i<=hi; i++)
+        sum+=i;
+    *acc=sum;
+}
+
+
+void prd_sum_inplace(unsigned long long lo, unsigned long long hi, unsigned long long *acc, void *arg)
+{
+    volatile unsigned long long *sum=(volatile unsigned long long *)acc;
+    unsigned long long i;
+
+    for(i=lo; i<=hi; i++)
+        *sum+=i;
+}
@@ -0,0 +1,89 @@
+#ifndef _PREDUCE_
+#define _PREDUCE_
+
+// Parallel reduction over a range for the Course 1 examples
+//
+// The counterThread workers each compute a sum and print it, and nothing
+// brings the sums back.  Writing them back into threadParams would put up
+// to 16 threads' results on one 64 byte line, and every write by one core
+// would take the line away from the others, false sharing.  A reduction
+// here gives each thread its own cache line aligned slot:
+//
+//    prd_run()       splits [1, n] into nthreads contiguous parts, one
+//                    thread each, created with the given attr, and each
+//                    thread reduces its part into its slot with fn
+//    PRD_TREE        thread i joins thread i+1, i+2, i+4 .. while i is a
+//                    multiple of twice the stride and adds their slots, so
+//                    the partials combine in log2(nthreads) parallel steps
+//                    and prd_run() only waits for thread 0
+//    PRD_ATOMIC      each thread adds its slot to one total with an atomic
+//                    add, prd_run() joins them all
+//
+// PRD_PACKED puts the slots back in one packed array of 8 byte sums, the
+// false sharing layout, so a benchmark can show what the padding buys.
+//
+// Threads are created highest index first, so every thread a tree thread
+// joins was created before it and its handle is already in place.
+//
+
+#include <pthread.h>
+
+#define PRD_CACHE_LINE (64)
+
+typedef enum
+{
+    PRD_TREE,
+    PRD_ATOMIC
+} prd_combine_t;
+
+// layout flags
+#define PRD_PADDED (0)
+#define PRD_PACKED (1)
+
+// Reduce [lo, hi] into *acc, which is the thread's slot
+typedef void (*prd_fn_t)(unsigned long long lo, unsigned long long hi, unsigned long long *acc, void *arg);
+
+struct prd;
+
+typedef struct
+{
+    unsigned long long sum;
+    unsigned long long *acc;    // &sum, or the packed array entry
+    unsigned long long lo, hi;
+    int idx;
+    struct prd *r;
+    pthread_t thread;
+} __attribute__((aligned(PRD_CACHE_LINE))) prd_slot_t;
+
+typedef struct prd
+{
+    int nthreads, layout;
+    prd_combine_t combine;
+    prd_fn_t fn;
+    void *arg;
+    prd_slot_t *slots;
+    unsigned long long *packed;
+
+    // the PRD_ATOMIC target, on a line of its own
+    unsigned long long total __attribute__((aligned(PRD_CACHE_LINE)));
+} prd_t;
+
+// nthreads slots combined by combine, in layout, with fn over each part.
+// Returns 0 or -1 out of memory.
+int prd_create(prd_t *r, int nthreads, prd_combine_t combine, int layout, prd_fn_t fn, void *arg);
+
+void prd_destroy(prd_t *r);
+
+// Reduce [1, n] with threads created from attr, NULL for the defaults.
+// Returns 0 with the result in *result, or -1 if a thread could not be
+// created, after joining the ones that were.
+int prd_run(prd_t *r, pthread_attr_t *attr, unsigned long long n, unsigned long long *result);
+
+// fn for a plain sum, accumulated in a register and stored once
+void prd_sum(unsigned long long lo, unsigned long long hi, unsigned long long *acc, void *arg);
+
+// fn for a sum accumulated in place, one store to the slot per element,
+// as a thread writing its running total back would
+void prd_sum_inplace(unsigned long long lo, unsigned long long hi, unsigned long long *acc, void *arg);
+
+#endif
@@ -0,0 +1,454 @@
+// Run environment of the Course 1 benchmark and RT programs, see rtenv.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <linux/perf_event.h>
+
+#include "rtenv.h"
+
+#define CPUFREQ "/sys/devices/system/cpu/cpu%d/cpufreq/%s"
+#define THERMAL "/sys/class/thermal/thermal_zone%d/%s"
+#define PI_THROTTLED "/sys/devices/platform/soc/soc:firmware/get_throttled"
+
+typedef struct
+{
+    char label[RTE_NAME_LEN+8];
+    pid_t tid;
+    int fd[RTE_NCOUNTERS];
+    unsigned long long value[RTE_NCOUNTERS];
+    int have[RTE_NCOUNTERS];
+    volatile int done;
+} rte_thread_t;
+
+static const struct
+{
+    const char *name;
+    unsigned int type;
+    unsigned long long config;
+} counters[RTE_NCOUNTERS] =
+{
+    {"cycles",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"ctx-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+static rte_thread_t threads[RTE_MAX_THREADS];
+static int nthreads=0;
+static int counting=0;
+
+static rte_state_t run_before;
+static char saved_governor[RTE_MAX_CPUS][RTE_NAME_LEN];
+static char saved_path[RTE_MAX_CPUS][128];
+static int saved_cpu[RTE_MAX_CPUS];
+static volatile int nsaved=0;
+
+// a run that ends without rte_end() still puts the governors back
+static const int restore_signals[]={SIGINT, SIGTERM, SIGHUP, SIGQUIT};
+static int restore_armed=0;
+
+
+// first line of a sysfs file without its newline, -1 if it cannot be read
+static int read_line(const char *path, char *buf, int len)
+{
+    FILE *fp;
+
+    if((fp=fopen(path, "r")) == NULL)
+        return -1;
+
+    if(fgets(buf, len, fp) == NULL)
+        buf[0]='\0';
+    fclose(fp);
+
+    buf[strcspn(buf, "\n")]='\0';
+    return 0;
+}
+
+
+static long read_long(const char *path, int base)
+{
+    char buf[64];
+
+    if(read_line(path, buf, sizeof(buf)) != 0)
+        return -1;
+
+    return strtol(buf, (char **)0, base);
+}
+
+
+static int write_line(const char *path, const char *value)
+{
+    FILE *fp;
+    int rc;
+
+    if((fp=fopen(path, "w")) == NULL)
+        return -1;
+
+    rc=(fputs(value, fp) < 0) ? -1 : 0;
+    if(fclose(fp) != 0) rc=-1;
+    return rc;
+}
+
+
+// put back saved governor i with open, write and close only, so a signal
+// handler can, returns 0 or -1
+static int restore_governor(int i)
+{
+    int fd, rc;
+
+    if((fd=open(saved_path[i], O_WRONLY)) < 0)
+        return -1;
+
+    rc=(write(fd, saved_governor[i], strlen(saved_governor[i])) < 0) ? -1 : 0;
+    if(close(fd) != 0) rc=-1;
+    return rc;
+}
+
+
+static void restore_at_exit(void)
+{
+    int i, n=nsaved;
+
+    nsaved=0;
+    for(i=0; i<n; i++)
+        restore_governor(i);
+}
+
+
+static void restore_on_signal(int sig)
+{
+    restore_at_exit();
+
+    // then die of the signal as if it had never been caught
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+
+// once, on the first governor changed: atexit for exit() before rte_end(),
+// and the kill signals the program leaves at their default
+static void arm_restore(void)
+{
+    struct sigaction sa, old;
+    unsigned int i;
+
+    if(restore_armed) return;
+    restore_armed=1;
+
+    atexit(restore_at_exit);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler=restore_on_signal;
+    sigemptyset(&sa.sa_mask);
+
+    for(i=0; i<sizeof(restore_signals)/sizeof(restore_signals[0]); i++)
+        if(sigaction(restore_signals[i], (struct sigaction *)0, &old) == 0 && old.sa_handler == SIG_DFL)
+            sigaction(restore_signals[i], &sa, (struct sigaction *)0);
+}
+
+
+int rte_governor(const char *want, int set)
+{
+    char path[128], gov[RTE_NAME_LEN];
+    int cpu, found=0, off=0;
+
+    for(cpu=0; cpu<get_nprocs_conf() && cpu<RTE_MAX_CPUS; cpu++)
+    {
+        snprintf(path, sizeof(path), CPUFREQ, cpu, "scaling_governor");
+        if(read_line(path, gov, sizeof(gov)) != 0)
+            continue;
+        found++;
+
+        if(strcmp(gov, want) == 0)
+            continue;
+
+        if(set && write_line(path, want) == 0)
+        {
+            // first change of this CPU is the one put back
+            if(nsaved < RTE_MAX_CPUS)
+            {
+                arm_restore();
+                saved_cpu[nsaved]=cpu;
+                snprintf(saved_path[nsaved], sizeof(saved_path[nsaved]), "%s", path);
+                snprintf(saved_governor[nsaved], RTE_NAME_LEN, "%s", gov);
+                __atomic_store_n(&nsaved, nsaved+1, __ATOMIC_RELEASE);
+            }
+            printf("cpu%d governor %s -> %s\n", cpu, gov, want);
+            continue;
+        }
+
+        if(set)
+            printf("cpu%d governor %s, could not set %s: %s\n", cpu, gov, want, strerror(errno));
+        off++;
+    }
+
+    return found ? off : -1;
+}
+
+
+void rte_read(rte_state_t *st)
+{
+    char path[128];
+    int cpu, z;
+
+    memset(st, 0, sizeof(rte_state_t));
+
+    for(cpu=0; cpu<get_nprocs_conf() && st->ncpus<RTE_MAX_CPUS; cpu++)
+    {
+        snprintf(path, sizeof(path), CPUFREQ, cpu, "scaling_governor");
+        if(read_line(path, st->governor[st->ncpus], RTE_NAME_LEN) != 0)
+            continue;
+
+        st->cpu[st->ncpus]=cpu;
+        snprintf(path, sizeof(path), CPUFREQ, cpu, "scaling_cur_freq");
+        st->cur_khz[st->ncpus]=read_long(path, 10);
+        snprintf(path, sizeof(path), CPUFREQ, cpu, "scaling_min_freq");
+        st->min_khz[st->ncpus]=read_long(path, 10);
+        snprintf(path, sizeof(path), CPUFREQ, cpu, "scaling_max_freq");
+        st->max_khz[st->ncpus]=read_long(path, 10);
+        st->ncpus++;
+    }
+
+    for(z=0; st->nzones<RTE_MAX_ZONES; z++)
+    {
+        snprintf(path, sizeof(path), THERMAL, z, "type");
+        if(read_line(path, st->zone[st->nzones], RTE_NAME_LEN) != 0)
+            break;
+
+        snprintf(path, sizeof(path), THERMAL, z, "temp");
+        st->temp_mc[st->nzones++]=read_long(path, 10);
+    }
+
+    st->throttled=read_long(PI_THROTTLED, 16);
+}
+
+
+void rte_print(const char *label, const rte_state_t *st)
+{
+    int i;
+
+    if(st->ncpus == 0)
+        printf("%s: no cpufreq, the clock is not managed by this kernel\n", label);
+
+    for(i=0; i<st->ncpus; i++)
+        printf("%s: cpu%d %s %.0lf MHz (%.0lf..%.0lf)\n", label, st->cpu[i], st->governor[i],
+               st->cur_khz[i]/1000.0, st->min_khz[i]/1000.0, st->max_khz[i]/1000.0);
+
+    for(i=0; i<st->nzones; i++)
+        printf("%s: %s %.1lf C\n", label, st->zone[i], st->temp_mc[i]/1000.0);
+
+    // under-voltage, capped and throttled now, bits 0-2, or since boot, 16-18
+    if(st->throttled >= 0)
+        printf("%s: throttled 0x%lx%s\n", label, st->throttled,
+               (st->throttled & 0x7) ? ", NOW" : ((st->throttled & 0x70000) ? ", earlier since boot" : ""));
+}
+
+
+void rte_compare(const rte_state_t *before, const rte_state_t *after)
+{
+    int i, changed=0;
+
+    for(i=0; i<before->ncpus && i<after->ncpus; i++)
+    {
+        if(strcmp(before->governor[i], after->governor[i]) != 0)
+        {
+            printf("cpu%d governor changed during the run, %s -> %s\n", after->cpu[i], before->governor[i], after->governor[i]);
+            changed++;
+        }
+        if(before->cur_khz[i] != after->cur_khz[i])
+        {
+            printf("cpu%d clock %.0lf -> %.0lf MHz during the run\n", after->cpu[i], before->cur_khz[i]/1000.0, after->cur_khz[i]/1000.0);
+            changed++;
+        }
+    }
+
+    for(i=0; i<before->nzones && i<after->nzones; i++)
+        printf("%s %.1lf -> %.1lf C\n", after->zone[i], before->temp_mc[i]/1000.0, after->temp_mc[i]/1000.0);
+
+    if(after->throttled >= 0 && after->throttled != before->throttled)
+    {
+        printf("throttle state 0x%lx -> 0x%lx during the run\n", before->throttled, after->throttled);
+        changed++;
+    }
+
+    if(before->ncpus && !changed)
+        printf("governors and clocks unchanged through the run\n");
+}
+
+
+void rte_begin(int pin, int counters_on)
+{
+    int off;
+
+    off=rte_governor(RTE_GOVERNOR, pin);
+    if(off > 0)
+        printf("WARNING: %d CPUs not at the %s governor, timing follows the clock ramp%s\n", off, RTE_GOVERNOR,
+               pin ? "" : ", pin it to compare runs");
+
+    rte_read(&run_before);
+    rte_print("env before", &run_before);
+
+    counting=counters_on;
+}
+
+
+void rte_end(void)
+{
+    rte_state_t after;
+    int i, n;
+
+    rte_read(&after);
+    rte_print("env after", &after);
+    rte_compare(&run_before, &after);
+
+    if(counting) rte_perf_report();
+
+    n=nsaved;
+    nsaved=0;
+    for(i=0; i<n; i++)
+        if(restore_governor(i) != 0)
+            printf("cpu%d governor could not be put back to %s\n", saved_cpu[i], saved_governor[i]);
+}
+
+
+static int perf_open(int c)
+{
+    struct perf_event_attr attr;
+    int fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size=sizeof(attr);
+    attr.type=counters[c].type;
+    attr.config=counters[c].config;
+    attr.read_format=PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_hv=1;
+
+    // this thread on any CPU, kernel time too where allowed
+    if((fd=(int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0)) < 0)
+    {
+        attr.exclude_kernel=1;
+        fd=(int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    return fd;
+}
+
+
+int rte_perf_begin(const char *label, int idx)
+{
+    rte_thread_t *t;
+    int slot, c, n=0;
+
+    if(!counting)
+        return -1;
+
+    if((slot=__atomic_fetch_add(&nthreads, 1, __ATOMIC_RELAXED)) >= RTE_MAX_THREADS)
+        return -1;
+
+    t=&threads[slot];
+    if(idx >= 0)
+        snprintf(t->label, sizeof(t->label), "%s %d", label, idx);
+    else
+        snprintf(t->label, sizeof(t->label), "%s", label);
+    t->tid=(pid_t)syscall(SYS_gettid);
+
+    for(c=0; c<RTE_NCOUNTERS; c++)
+        if((t->fd[c]=perf_open(c)) >= 0) n++;
+
+    // nothing to read at the end, the slot is done with nothing counted
+    if(n == 0)
+    {
+        __atomic_store_n(&t->done, 1, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    return slot;
+}
+
+
+void rte_perf_end(int slot)
+{
+    rte_thread_t *t;
+    unsigned long long v[3];
+    int c;
+
+    if(slot < 0 || slot >= RTE_MAX_THREADS)
+        return;
+
+    t=&threads[slot];
+    for(c=0; c<RTE_NCOUNTERS; c++)
+    {
+        if(t->fd[c] < 0) continue;
+
+        // value, time enabled, time running, scaled up if multiplexed
+        if(read(t->fd[c], v, sizeof(v)) == (ssize_t)sizeof(v) && v[2] > 0)
+        {
+            t->value[c]=(v[2] < v[1]) ? (unsigned long long)((double)v[0]*v[1]/v[2]) : v[0];
+            t->have[c]=1;
+        }
+        close(t->fd[c]);
+        t->fd[c]=-1;
+    }
+
+    __atomic_store_n(&t->done, 1, __ATOMIC_RELEASE);
+}
+
+
+void rte_perf_report(void)
+{
+    rte_thread_t *t;
+    int i, c, n=(nthreads < RTE_MAX_THREADS) ? nthreads : RTE_MAX_THREADS;
+
+    if(n == 0)
+    {
+        printf("perf: no counted threads\n");
+        return;
+    }
+
+    printf("%-24s %8s %16s %16s %6s %14s %10s\n", "thread", "tid", counters[0].name, counters[1].name, "IPC", counters[2].name, counters[3].name);
+    for(i=0; i<n; i++)
+    {
+        t=&threads[i];
+        if(!__atomic_load_n(&t->done, __ATOMIC_ACQUIRE))
+        {
+            printf("%-24s %8d still running, not read\n", t->label, (int)t->tid);
+            continue;
+        }
+
+        for(c=0; c<RTE_NCOUNTERS && !t->have[c]; c++);
+        if(c == RTE_NCOUNTERS)
+        {
+            printf("%-24s %8d no counters\n", t->label, (int)t->tid);
+            continue;
+        }
+
+        printf("%-24s %8d", t->label, (int)t->tid);
+        for(c=0; c<RTE_NCOUNTERS; c++)
+        {
+            if(t->have[c])
+                printf(" %*llu", (c == RTE_CONTEXT_SWITCHES) ? 10 : (c == RTE_CACHE_MISSES ? 14 : 16), t->value[c]);
+            else
+                printf(" %*s", (c == RTE_CONTEXT_SWITCHES) ? 10 : (c == RTE_CACHE_MISSES ? 14 : 16), "n/a");
+
+            if(c == RTE_INSTRUCTIONS)
+            {
+                if(t->have[RTE_CYCLES] && t->have[RTE_INSTRUCTIONS] && t->value[RTE_CYCLES])
+                    printf(" %6.2lf", (double)t->value[RTE_INSTRUCTIONS]/t->value[RTE_CYCLES]);
+                else
+                    printf(" %6s", "n/a");
+            }
+        }
+        printf("\n");
+    }
+
+    if(nthreads > RTE_MAX_THREADS)
+        printf("perf: %d more threads than the %d slots, not counted\n", nthreads-RTE_MAX_THREADS, RTE_MAX_THREADS);
+}
@@ -0,0 +1,91 @@
+#ifndef _RTENV_
+#define _RTENV_
+
+// Run environment of the Course 1 benchmark and RT programs
+//
+// On the Pi and the Jetson the ondemand and schedutil governors ramp the
+// clock with load, so a sharpen speed-up or a sequencer jitter number
+// depends on what the governor did during the run, and a hot board
+// throttles on top of that.  rte_begin() at the start of a run:
+//
+//    governor    checks every cpufreq policy is "performance", and with
+//                set switches them, root only, restored by rte_end()
+//    state       current, min and max clock of each CPU, every thermal
+//                zone and, on a Pi, the firmware throttle bits
+//
+// and rte_end() reads the state again and prints what changed, so every
+// result comes with the clock and temperature it was taken at.  A kernel
+// without cpufreq, e.g. a VM, says so and is left alone.  A run that
+// exit()s or is killed by SIGINT, SIGTERM, SIGHUP or SIGQUIT before
+// rte_end() still gets its governors back, unless the program has its own
+// handler for the signal.  Only SIGKILL or a crash leaves them switched.
+//
+// With counters on, each thread that calls rte_perf_begin() gets its own
+// perf_event_open(2) counters: cycles, instructions, cache misses and
+// context switches, counted only while it runs.  rte_perf_end() reads them
+// as it exits and rte_end() prints one line per thread.  Counting costs the
+// thread nothing on its release path, the PMU is saved and restored by the
+// kernel on context switches.  A counter the CPU or the hypervisor does
+// not have is left out, and without perf_event_open (paranoid above 2, or
+// no PMU) the threads just run uncounted.
+//
+
+#include <sys/types.h>
+
+#define RTE_GOVERNOR "performance"
+
+#define RTE_MAX_CPUS (64)
+#define RTE_MAX_ZONES (16)
+#define RTE_MAX_THREADS (64)
+#define RTE_NAME_LEN (24)
+
+// rte_perf counters
+#define RTE_CYCLES (0)
+#define RTE_INSTRUCTIONS (1)
+#define RTE_CACHE_MISSES (2)
+#define RTE_CONTEXT_SWITCHES (3)
+#define RTE_NCOUNTERS (4)
+
+typedef struct
+{
+    int ncpus;                          // CPUs with cpufreq, 0 without
+    int cpu[RTE_MAX_CPUS];
+    char governor[RTE_MAX_CPUS][RTE_NAME_LEN];
+    long cur_khz[RTE_MAX_CPUS], min_khz[RTE_MAX_CPUS], max_khz[RTE_MAX_CPUS];
+
+    int nzones;
+    char zone[RTE_MAX_ZONES][RTE_NAME_LEN];
+    long temp_mc[RTE_MAX_ZONES];        // millidegrees C
+
+    long throttled;                     // Pi get_throttled, -1 for none
+} rte_state_t;
+
+// Governor of every cpufreq policy to want, switching them when set, and
+// returns how many are not at want, -1 without cpufreq
+int rte_governor(const char *want, int set);
+
+void rte_read(rte_state_t *st);
+void rte_print(const char *label, const rte_state_t *st);
+
+// Clock, governor, temperature and throttle changes from before to after
+void rte_compare(const rte_state_t *before, const rte_state_t *after);
+
+// Top and tail of a run: pin the performance governor if pin, else only
+// check it, print the state and, with counters, turn on rte_perf;
+// rte_end() prints the state again with what changed and the per-thread
+// counters, and puts back any governor rte_begin() changed
+void rte_begin(int pin, int counters);
+void rte_end(void);
+
+// In a thread, once, before its first release: open its counters under
+// label, and idx after it when idx >= 0.  Returns the slot for
+// rte_perf_end(), -1 when counting is off or failed.
+int rte_perf_begin(const char *label, int idx);
+
+// In the same thread, after its last release
+void rte_perf_end(int slot);
+
+// One line per counted thread
+void rte_perf_report(void);
+
+#endif
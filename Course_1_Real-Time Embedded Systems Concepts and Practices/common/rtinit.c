@@ -0,0 +1,119 @@
+// Memory locking and prefault startup, see rtinit.h
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <alloca.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "rtinit.h"
+
+static size_t rti_stack=0;
+
+
+// a frame of size bytes, written so each page is really mapped
+static void __attribute__((noinline)) prefault_stack(size_t size)
+{
+    volatile unsigned char *frame=(volatile unsigned char *)alloca(size);
+    size_t i, page=(size_t)sysconf(_SC_PAGESIZE);
+
+    for(i=0; i<size; i+=page)
+        frame[i]=0;
+}
+
+
+int rti_init(size_t stack_size)
+{
+    rti_faults_t before;
+    int rc=0;
+
+    rti_faults(&before);
+    rti_stack=stack_size ? stack_size : RTI_STACK_SIZE;
+
+    // one heap that never goes back to the kernel, so a free and malloc in
+    // a release reuses locked pages, and no per-thread arena is mapped at
+    // a thread's first malloc
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    mallopt(M_ARENA_MAX, 1);
+
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        perror("rti_init: mlockall, memory not locked");
+        rc=-1;
+    }
+
+    // less some headroom for the frames already on it
+    if(rti_stack > 32*1024)
+        prefault_stack(rti_stack - 16*1024);
+
+    rti_report("memory lock and stack prefault", &before);
+    return rc;
+}
+
+
+void rti_attr_stack(pthread_attr_t *attr)
+{
+    if(rti_stack)
+        pthread_attr_setstacksize(attr, rti_stack);
+}
+
+
+void rti_touch(void *buf, size_t size)
+{
+    volatile unsigned char *p=(volatile unsigned char *)buf;
+    size_t i, page=(size_t)sysconf(_SC_PAGESIZE);
+
+    // written back as read, a read alone may only map the zero page
+    for(i=0; i<size; i+=page)
+        p[i]=p[i];
+    if(size)
+        p[size-1]=p[size-1];
+}
+
+
+void *rti_alloc(size_t size, size_t align, int huge)
+{
+    void *buf;
+
+    if(huge)
+    {
+        align=RTI_HUGE_PAGE;
+        size=(size + RTI_HUGE_PAGE-1) & ~(size_t)(RTI_HUGE_PAGE-1);
+    }
+
+    if(posix_memalign(&buf, align, size) != 0)
+        return NULL;
+
+    // before the first touch, or the range is already in small pages
+    if(huge && madvise(buf, size, MADV_HUGEPAGE) != 0)
+        perror("rti_alloc: madvise MADV_HUGEPAGE");
+
+    rti_touch(buf, size);
+    return buf;
+}
+
+
+void rti_faults(rti_faults_t *f)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    f->minflt=ru.ru_minflt;
+    f->majflt=ru.ru_majflt;
+}
+
+
+void rti_report(const char *what, const rti_faults_t *since)
+{
+    rti_faults_t now;
+
+    rti_faults(&now);
+    printf("%s: %ld minor, %ld major page faults\n", what, now.minflt - since->minflt, now.majflt - since->majflt);
+}
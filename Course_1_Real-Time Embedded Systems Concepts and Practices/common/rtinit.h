@@ -0,0 +1,63 @@
+#ifndef _RTINIT_
+#define _RTINIT_
+
+// Memory locking and prefault startup for the Course 1 RT programs
+//
+// A SCHED_FIFO thread that touches a page for the first time takes a page
+// fault in the middle of its release: a minor one to map a zero page or a
+// page already in the page cache, a major one if it has to wait for the
+// disk.  rti_init() takes them all up front:
+//
+//    mlockall(MCL_CURRENT|MCL_FUTURE)
+//                    everything mapped now is faulted in and locked, and so
+//                    is everything mapped later, thread stacks included,
+//                    at mmap time rather than at first touch
+//    stack           the calling thread's stack grows on demand, so the
+//                    first stack_size bytes of it are touched
+//    malloc          one arena, no trimming and no mmap for large blocks,
+//                    so freed memory stays mapped and locked for reuse
+//
+// With MCL_FUTURE every new thread's whole stack is locked when it is
+// created, 8 MB by default, so rti_attr_stack() sets the stack of a thread
+// attr to the same stack_size.  Large buffers come from rti_alloc(), which
+// touches every page and, with huge set, aligns them to 2 MB and asks for
+// transparent huge pages first, fewer TLB misses and 512 times fewer faults.
+//
+// rti_faults() samples the process minor and major fault counts, so a run
+// can report what it took during start up and check that the steady state
+// takes none.  Without root, or over RLIMIT_MEMLOCK, mlockall fails with a
+// warning and everything else still prefaults.
+//
+
+#include <stddef.h>
+#include <pthread.h>
+
+// default prefaulted and created thread stack
+#define RTI_STACK_SIZE (256*1024)
+#define RTI_HUGE_PAGE (2*1024*1024)
+
+typedef struct
+{
+    long minflt, majflt;
+} rti_faults_t;
+
+// Lock memory and prefault stack_size of this thread's stack, 0 for
+// RTI_STACK_SIZE, returns 0 or -1 if mlockall failed
+int rti_init(size_t stack_size);
+
+// Stack size of threads created from attr, nothing before rti_init()
+void rti_attr_stack(pthread_attr_t *attr);
+
+// Touch every page of size bytes at buf, keeping the contents
+void rti_touch(void *buf, size_t size);
+
+// size bytes aligned to align, 2 MB and huge page backed if huge, every
+// page touched, NULL if out of memory.  Release with free().
+void *rti_alloc(size_t size, size_t align, int huge);
+
+void rti_faults(rti_faults_t *f);
+
+// Faults taken since the sample in since, one line labelled what
+void rti_report(const char *what, const rti_faults_t *since);
+
+#endif
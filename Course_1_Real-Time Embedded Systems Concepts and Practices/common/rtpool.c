@@ -0,0 +1,278 @@
+// Fixed size RT worker pool, see rtpool.h
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "rtpool.h"
+
+typedef struct
+{
+    rtpool_t *pool;
+    int idx;
+} rtp_worker_arg_t;
+
+
+static long futex(volatile int *uaddr, int op, int val)
+{
+    return syscall(SYS_futex, uaddr, op, val, (void *)0, (void *)0, 0);
+}
+
+
+// Vyukov bounded MPMC: cell seq == pos when free for the producer at pos,
+// pos+1 once it holds a task for the consumer at pos
+static int ring_put(rtpool_t *p, const rtp_task_t *t)
+{
+    unsigned int pos=__atomic_load_n(&p->enq, __ATOMIC_RELAXED), seq;
+    rtp_cell_t *cell;
+    int dif;
+
+    while(1)
+    {
+        cell=&p->cells[pos & p->mask];
+        seq=__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        dif=(int)(seq - pos);
+
+        if(dif == 0)
+        {
+            if(__atomic_compare_exchange_n(&p->enq, &pos, pos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if(dif < 0)
+            return -1;
+        else
+            pos=__atomic_load_n(&p->enq, __ATOMIC_RELAXED);
+    }
+
+    cell->task=*t;
+    __atomic_store_n(&cell->seq, pos+1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+
+static int ring_get(rtpool_t *p, rtp_task_t *t)
+{
+    unsigned int pos=__atomic_load_n(&p->deq, __ATOMIC_RELAXED), seq;
+    rtp_cell_t *cell;
+    int dif;
+
+    while(1)
+    {
+        cell=&p->cells[pos & p->mask];
+        seq=__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        dif=(int)(seq - (pos+1));
+
+        if(dif == 0)
+        {
+            if(__atomic_compare_exchange_n(&p->deq, &pos, pos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if(dif < 0)
+            return -1;
+        else
+            pos=__atomic_load_n(&p->deq, __ATOMIC_RELAXED);
+    }
+
+    *t=cell->task;
+    __atomic_store_n(&cell->seq, pos + p->mask + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+
+static void *rtp_worker(void *argp)
+{
+    rtp_worker_arg_t *arg=(rtp_worker_arg_t *)argp;
+    rtpool_t *p=arg->pool;
+    int idx=arg->idx;
+    rtp_task_t t;
+
+    free(arg);
+
+    while(1)
+    {
+        while(sem_wait(&p->queued) != 0)
+            ;
+
+        // the count is posted after the task is in, but a producer ahead of
+        // it in the ring may still be filling its cell
+        while(ring_get(p, &t) != 0)
+        {
+            if(__atomic_load_n(&p->quit, __ATOMIC_ACQUIRE)) return NULL;
+            sched_yield();
+        }
+
+        t.fn(t.arg);
+        p->ran[idx]++;
+
+        if(__atomic_sub_fetch(&t.batch->pending, 1, __ATOMIC_ACQ_REL) == 0)
+            futex(&t.batch->pending, FUTEX_WAKE_PRIVATE, INT_MAX);
+    }
+}
+
+
+int rtp_create(rtpool_t *p, int nworkers, int policy, int priority, const cpu_set_t *cores, unsigned int qsize)
+{
+    struct sched_param param;
+    pthread_attr_t attr;
+    cpu_set_t cpu;
+    rtp_worker_arg_t *arg;
+    unsigned int size=2, i;
+    int w, c, ncores=cores ? CPU_COUNT(cores) : 0, rc;
+
+    memset(p, 0, sizeof(rtpool_t));
+
+    while(size < qsize) size*=2;
+    p->mask=size-1;
+
+    p->cells=(rtp_cell_t *)malloc(size*sizeof(rtp_cell_t));
+    p->threads=(pthread_t *)malloc(nworkers*sizeof(pthread_t));
+    p->ran=(unsigned long long *)calloc(nworkers, sizeof(unsigned long long));
+    if(!p->cells || !p->threads || !p->ran || (cores && ncores == 0))
+    {
+        printf("rtp_create: no memory for %d workers or no cores\n", nworkers);
+        free(p->cells); free(p->threads); free(p->ran);
+        return -1;
+    }
+
+    for(i=0; i<size; i++) p->cells[i].seq=i;
+    sem_init(&p->queued, 0, 0);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, policy);
+    param.sched_priority=priority;
+    pthread_attr_setschedparam(&attr, &param);
+
+    for(w=0; w<nworkers; w++)
+    {
+        if(cores)
+        {
+            // (w % ncores)th core of the set
+            for(c=0, rc=w % ncores; c < CPU_SETSIZE; c++)
+                if(CPU_ISSET(c, cores) && rc-- == 0) break;
+            CPU_ZERO(&cpu);
+            CPU_SET(c, &cpu);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpu);
+        }
+
+        if((arg=(rtp_worker_arg_t *)malloc(sizeof(rtp_worker_arg_t))) == NULL)
+            break;
+        arg->pool=p;
+        arg->idx=w;
+
+        if((rc=pthread_create(&p->threads[w], &attr, rtp_worker, (void *)arg)) != 0)
+        {
+            printf("rtp_create: worker %d, rc=%d\n", w, rc);
+            free(arg);
+            break;
+        }
+        p->nworkers++;
+    }
+
+    pthread_attr_destroy(&attr);
+
+    if(p->nworkers < nworkers)
+    {
+        rtp_destroy(p);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void rtp_destroy(rtpool_t *p)
+{
+    int w;
+
+    __atomic_store_n(&p->quit, 1, __ATOMIC_RELEASE);
+    for(w=0; w<p->nworkers; w++)
+        sem_post(&p->queued);
+    for(w=0; w<p->nworkers; w++)
+        pthread_join(p->threads[w], NULL);
+
+    sem_destroy(&p->queued);
+    free(p->cells); free(p->threads); free(p->ran);
+    p->cells=(rtp_cell_t *)0;
+    p->threads=(pthread_t *)0;
+    p->ran=(unsigned long long *)0;
+    p->nworkers=0;
+}
+
+
+void rtp_batch_init(rtp_batch_t *b)
+{
+    b->pending=0;
+}
+
+
+int rtp_submit(rtpool_t *p, rtp_batch_t *b, rtp_fn_t fn, void *arg)
+{
+    rtp_task_t t={fn, arg, b};
+
+    // counted first, a worker may finish it before ring_put returns
+    __atomic_add_fetch(&b->pending, 1, __ATOMIC_RELAXED);
+    if(ring_put(p, &t) != 0)
+    {
+        // the rest of the batch may have finished meanwhile, and a waiter
+        // that saw this task counted is asleep until pending reaches 0
+        if(__atomic_sub_fetch(&b->pending, 1, __ATOMIC_ACQ_REL) == 0)
+            futex(&b->pending, FUTEX_WAKE_PRIVATE, INT_MAX);
+        return -1;
+    }
+
+    sem_post(&p->queued);
+    return 0;
+}
+
+
+int rtp_submit_batch(rtpool_t *p, rtp_batch_t *b, rtp_fn_t fn, void **args, int n)
+{
+    rtp_task_t t={fn, (void *)0, b};
+    int i;
+
+    // one add for the batch, then hand the workers the lot
+    __atomic_add_fetch(&b->pending, n, __ATOMIC_RELAXED);
+
+    for(i=0; i<n; i++)
+    {
+        t.arg=args[i];
+        if(ring_put(p, &t) != 0) break;
+    }
+
+    // a rejected tail is given back the way a worker finishes a task
+    if(i < n && __atomic_sub_fetch(&b->pending, n-i, __ATOMIC_ACQ_REL) == 0)
+        futex(&b->pending, FUTEX_WAKE_PRIVATE, INT_MAX);
+
+    for(n=i; i>0; i--)
+        sem_post(&p->queued);
+
+    return n;
+}
+
+
+void rtp_wait(rtp_batch_t *b)
+{
+    int v;
+
+    while((v=__atomic_load_n(&b->pending, __ATOMIC_ACQUIRE)) != 0)
+        futex(&b->pending, FUTEX_WAIT_PRIVATE, v);
+}
+
+
+void rtp_report(const rtpool_t *p)
+{
+    int w;
+
+    printf("rtpool %d workers, tasks run:", p->nworkers);
+    for(w=0; w<p->nworkers; w++)
+        printf(" %llu", p->ran[w]);
+    printf("\n");
+}
@@ -0,0 +1,88 @@
+#ifndef _RTPOOL_
+#define _RTPOOL_
+
+// Fixed size RT worker pool shared by the Course 1 examples
+//
+// The demos spawn a thread per work item with the same attr, affinity and
+// priority boilerplate each time, and pay for pthread_create and
+// pthread_join on every item (thread_bench measures how much).  An rtpool
+// creates its workers once, each with an explicit policy and priority and
+// pinned round robin to the cores of a cpu set, and hands them tasks
+// through a bounded lock-free multi-producer multi-consumer ring, the
+// Vyukov sequence-per-cell queue, so submitting does not take a lock a
+// worker may hold, whatever its priority.
+//
+// Tasks are tracked by batch: every task submitted under a batch counts it
+// up, the worker that runs the last one wakes whoever is in rtp_wait(),
+// with one futex wake per batch rather than one per task.  A batch may
+// be reused once rtp_wait() returns.
+//
+// Idle workers block on a semaphore of queued tasks.  The ring does not
+// grow, rtp_submit() returns -1 when it is full, so size it for the
+// largest batch.
+//
+
+// cpu_set_t needs _GNU_SOURCE defined before the first system header
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+
+typedef void (*rtp_fn_t)(void *arg);
+
+typedef struct
+{
+    volatile int pending;       // tasks submitted and not yet done
+} rtp_batch_t;
+
+typedef struct
+{
+    rtp_fn_t fn;
+    void *arg;
+    rtp_batch_t *batch;
+} rtp_task_t;
+
+typedef struct
+{
+    unsigned int seq;
+    rtp_task_t task;
+} rtp_cell_t;
+
+typedef struct
+{
+    // producer and consumer positions on their own cache lines
+    unsigned int enq __attribute__((aligned(64)));
+    unsigned int deq __attribute__((aligned(64)));
+
+    rtp_cell_t *cells __attribute__((aligned(64)));
+    unsigned int mask;
+    sem_t queued;
+
+    int nworkers, quit;
+    pthread_t *threads;
+    unsigned long long *ran;    // tasks run per worker
+} rtpool_t;
+
+// nworkers threads of policy and priority, worker i pinned to the
+// (i % count)th core of cores, or left to the scheduler if cores is NULL,
+// with a ring of at least qsize tasks.  Returns 0, or -1 with no threads
+// left running, e.g. EPERM for SCHED_FIFO without root.
+int rtp_create(rtpool_t *p, int nworkers, int policy, int priority, const cpu_set_t *cores, unsigned int qsize);
+
+// Stop and join the workers, call once every batch is done
+void rtp_destroy(rtpool_t *p);
+
+void rtp_batch_init(rtp_batch_t *b);
+
+// Queue fn(arg) under b, returns 0 or -1 if the ring is full
+int rtp_submit(rtpool_t *p, rtp_batch_t *b, rtp_fn_t fn, void *arg);
+
+// Queue fn(args[i]) for n args under b, returns how many were queued
+int rtp_submit_batch(rtpool_t *p, rtp_batch_t *b, rtp_fn_t fn, void **args, int n);
+
+// Block until every task of b is done
+void rtp_wait(rtp_batch_t *b);
+
+// Tasks run by each worker
+void rtp_report(const rtpool_t *p);
+
+#endif
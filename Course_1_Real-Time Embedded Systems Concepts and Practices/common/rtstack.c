@@ -0,0 +1,179 @@
+// Guarded thread stacks from one locked arena, see rtstack.h
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "rtstack.h"
+
+
+static size_t page_size(void)
+{
+    long page=sysconf(_SC_PAGESIZE);
+
+    return (page > 0) ? (size_t)page : 4096;
+}
+
+
+// usable bytes of a stack asked for as size
+static size_t stack_round(size_t size, size_t page)
+{
+    if(size < RTS_STACK_MIN) size=RTS_STACK_MIN;
+    if(size < (size_t)PTHREAD_STACK_MIN) size=(size_t)PTHREAD_STACK_MIN;
+
+    return (size + page-1) & ~(page-1);
+}
+
+
+size_t rts_span(size_t size)
+{
+    size_t page=page_size();
+
+    return stack_round(size, page) + page;
+}
+
+
+int rts_arena_init(rts_arena_t *a, int max_stacks, size_t span)
+{
+    memset(a, 0, sizeof(rts_arena_t));
+    a->page=page_size();
+
+    if(max_stacks < 1 || span == 0)
+        return -1;
+
+    if((a->stacks=(rts_stack_t *)calloc(max_stacks, sizeof(rts_stack_t))) == NULL)
+    {
+        printf("rts_arena_init: no memory for %d stacks\n", max_stacks);
+        return -1;
+    }
+
+    // address space only, each stack is faulted in and locked as it is carved
+    a->map_size=(span + a->page-1) & ~(a->page-1);
+    if((a->map=(unsigned char *)mmap((void *)0, a->map_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+    {
+        perror("rts_arena_init mmap");
+        free(a->stacks);
+        a->stacks=(rts_stack_t *)0;
+        a->map=(unsigned char *)0;
+        return -1;
+    }
+
+    a->max_stacks=max_stacks;
+    return 0;
+}
+
+
+int rts_attr_stack(rts_arena_t *a, pthread_attr_t *attr, size_t size, const char *name)
+{
+    rts_stack_t *s;
+    size_t span;
+
+    size=stack_round(size, a->page);
+    span=size + a->page;
+
+    if(a->map == NULL || a->nstacks == a->max_stacks || a->carved + span > a->map_size)
+    {
+        printf("rts_attr_stack: no arena room for %s, %zu K stack from pthread_create\n", name ? name : "a thread", size/1024);
+        pthread_attr_setstacksize(attr, size);
+        return -1;
+    }
+
+    s=&a->stacks[a->nstacks];
+    s->base=a->map + a->carved + a->page;
+    s->size=size;
+    if(name != NULL)
+        snprintf(s->name, sizeof(s->name), "%s", name);
+    else
+        snprintf(s->name, sizeof(s->name), "stack %d", a->nstacks);
+
+    if(mprotect(a->map + a->carved, a->page, PROT_NONE) != 0)
+        perror("rts_attr_stack guard page");
+
+    // the fill faults every page in, the high water mark is where it ends
+    memset(s->base, RTS_FILL, size);
+    if(mlock(s->base, size) == 0)
+        a->locked++;
+    else if(a->locked == 0 && a->nstacks == 0)
+        perror("rts_attr_stack mlock, stacks not locked");
+
+    a->carved+=span;
+    pthread_attr_setstack(attr, s->base, size);
+
+    return a->nstacks++;
+}
+
+
+size_t rts_used(const rts_arena_t *a, int i)
+{
+    const rts_stack_t *s=&a->stacks[i];
+    size_t untouched=0;
+
+    // from the far end of the stack up to the first byte written
+    while(untouched < s->size && s->base[untouched] == RTS_FILL)
+        untouched++;
+
+    return s->size - untouched;
+}
+
+
+void rts_report(const rts_arena_t *a)
+{
+    pthread_attr_t attr;
+    size_t used, size, total_used=0, default_stack=0;
+    int i, deepest=0, warned=0;
+    double pct, max_pct=-1.0;
+
+    if(a->nstacks == 0)
+        return;
+
+    if(a->nstacks <= RTS_REPORT_LINES)
+        printf("%-24s %8s %8s %6s\n", "stack", "size K", "used K", "used");
+
+    for(i=0; i<a->nstacks; i++)
+    {
+        used=rts_used(a, i);
+        size=a->stacks[i].size;
+        pct=100.0*used/size;
+        total_used+=used;
+
+        if(pct > max_pct) { max_pct=pct; deepest=i; }
+        if(pct > RTS_WARN_PCT) warned++;
+
+        if(a->nstacks <= RTS_REPORT_LINES)
+            printf("%-24s %8zu %8.1lf %5.1lf%%%s\n", a->stacks[i].name, size/1024, used/1024.0, pct,
+                   (pct > RTS_WARN_PCT) ? "  near the guard page" : "");
+    }
+
+    if(a->nstacks > RTS_REPORT_LINES)
+        printf("deepest stack %s, %.1lf of %zu K used, %.1lf%%, %d of %d stacks above %d%%\n",
+               a->stacks[deepest].name, rts_used(a, deepest)/1024.0, a->stacks[deepest].size/1024, max_pct,
+               warned, a->nstacks, RTS_WARN_PCT);
+
+    // the stack every thread would have had without the arena
+    if(pthread_attr_init(&attr) == 0)
+    {
+        pthread_attr_getstacksize(&attr, &default_stack);
+        pthread_attr_destroy(&attr);
+    }
+
+    printf("%d stacks in a %zu K arena, %d locked, %.1lf K used in all, instead of %zu K of default stacks\n",
+           a->nstacks, a->map_size/1024, a->locked, total_used/1024.0, (size_t)a->nstacks*default_stack/1024);
+}
+
+
+void rts_arena_free(rts_arena_t *a)
+{
+    if(a->map != NULL)
+        munmap(a->map, a->map_size);
+    free(a->stacks);
+
+    a->map=(unsigned char *)0;
+    a->stacks=(rts_stack_t *)0;
+    a->nstacks=a->max_stacks=0;
+}
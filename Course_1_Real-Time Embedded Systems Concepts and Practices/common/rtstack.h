@@ -0,0 +1,80 @@
+#ifndef _RTSTACK_
+#define _RTSTACK_
+
+// Guarded thread stacks carved from one locked arena, shared by the
+// Course 1 thread examples
+//
+// Every pthread_create with a default attr maps an 8 MB stack, so the 128
+// threads of fifothreads reserve a gigabyte of address space on a 1 GB Pi,
+// and with mlockall(MCL_FUTURE) every byte of it is locked.  An arena is
+// one mmap sized for all of a program's threads up front, and
+// rts_attr_stack() hands each thread the next piece of it with
+// pthread_attr_setstack(), sized for that thread:
+//
+//    [guard][stack 0][guard][stack 1] ...
+//
+// Stacks grow down, so the PROT_NONE page below each one turns an
+// overflow into a SIGSEGV instead of a write into the neighbouring
+// thread's stack.  Each stack is filled with RTS_FILL and locked when it
+// is carved, so it is resident before the thread first runs, and
+// rts_report() finds how deep each one went from the lowest byte that
+// lost the fill, to size the table from a real run.  The deepest a stack
+// can go includes the thread descriptor and TLS that glibc keeps at the
+// top of a stack it is given, a few K.
+//
+// Stacks are never freed one by one, rts_arena_free() unmaps the lot once
+// every thread is joined.  A thread the arena has no room for gets a
+// stack of its size from pthread_create as usual, with a warning.
+//
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define RTS_FILL (0xa5)
+#define RTS_STACK_MIN (16*1024)
+#define RTS_NAME_LEN (24)
+
+// rts_report() flags a stack whose high water mark is above this
+#define RTS_WARN_PCT (75)
+// and lists every stack up to this many, beyond that the deepest only
+#define RTS_REPORT_LINES (16)
+
+typedef struct
+{
+    char name[RTS_NAME_LEN];
+    unsigned char *base;        // lowest byte, the guard page is just below
+    size_t size;
+} rts_stack_t;
+
+typedef struct
+{
+    unsigned char *map;         // NULL when the mmap failed
+    size_t map_size, carved, page;
+    int nstacks, max_stacks, locked;
+    rts_stack_t *stacks;
+} rts_arena_t;
+
+// Arena bytes a stack of size takes, its guard page included
+size_t rts_span(size_t size);
+
+// Map an arena of span bytes, the sum of rts_span() of every stack, for
+// up to max_stacks stacks.  Returns 0, or -1 with the arena empty, when
+// every rts_attr_stack() falls back to an unguarded stack of its size.
+int rts_arena_init(rts_arena_t *a, int max_stacks, size_t span);
+
+// Set the next stack of the arena, size bytes rounded up to a page, as
+// the stack of threads created from attr.  name, or "stack N" if NULL, is
+// what rts_report() calls it.  Returns the stack index, -1 with the size
+// set on attr instead when the arena is full.
+int rts_attr_stack(rts_arena_t *a, pthread_attr_t *attr, size_t size, const char *name);
+
+// High water mark of stack i in bytes
+size_t rts_used(const rts_arena_t *a, int i);
+
+// High water mark of every stack, and the footprint against default stacks
+void rts_report(const rts_arena_t *a);
+
+// Unmap the arena, after joining every thread running on it
+void rts_arena_free(rts_arena_t *a);
+
+#endif
@@ -0,0 +1,95 @@
+// ftrace trace_marker / LTTng-UST trace points, see rttrace.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#ifdef RT_TRACE_LTTNG
+#include <lttng/tracef.h>
+#endif
+
+#include "rttrace.h"
+
+int rtt_fd=-1;
+
+
+int rtt_open(void)
+{
+#ifdef RT_TRACE_LTTNG
+    return 0;
+#else
+    if(rtt_fd >= 0)
+        return 0;
+
+    if((rtt_fd=open(RTT_MARKER, O_WRONLY|O_CLOEXEC)) < 0 &&
+       (rtt_fd=open(RTT_MARKER_DEBUGFS, O_WRONLY|O_CLOEXEC)) < 0)
+    {
+        perror("rtt_open " RTT_MARKER ", trace points off");
+        return -1;
+    }
+
+    return 0;
+#endif
+}
+
+
+void rtt_close(void)
+{
+    if(rtt_fd >= 0)
+        close(rtt_fd);
+    rtt_fd=-1;
+}
+
+
+// n in decimal at p, returns the end
+static char *put_u64(char *p, unsigned long long n)
+{
+    char digits[20];
+    int k=0;
+
+    do
+    {
+        digits[k++]='0' + (char)(n % 10);
+        n/=10;
+    } while(n);
+
+    while(k)
+        *p++=digits[--k];
+    return p;
+}
+
+
+// at most max bytes of s at p, returns the end
+static char *put_str(char *p, const char *s, int max)
+{
+    while(*s && max-- > 0)
+        *p++=*s++;
+    return p;
+}
+
+
+void rtt_event(const char *event, const char *name, unsigned long long n)
+{
+    char line[RTT_LINE_LEN], *p=line;
+
+    // room for " " + 20 digits + "\n" is kept at the end
+    p=put_str(p, event, RTT_LINE_LEN/4);
+    if(name != NULL)
+    {
+        *p++=' ';
+        p=put_str(p, name, RTT_LINE_LEN-23 - (int)(p-line));
+    }
+    *p++=' ';
+    p=put_u64(p, n);
+    *p++='\n';
+
+#ifdef RT_TRACE_LTTNG
+    tracef("%.*s", (int)(p-line-1), line);
+#else
+    // one write is one event, a short or failed one is just lost
+    if(rtt_fd >= 0 && write(rtt_fd, line, p-line) < 0)
+        return;
+#endif
+}
@@ -0,0 +1,67 @@
+#ifndef _RTTRACE_
+#define _RTTRACE_
+
+// Trace points on the kernel's own timeline, shared by the Course 1 examples
+//
+// syslog lines are formatted, locked and sent to a daemon on the release
+// path, and their time stamps are when the daemon got them.  A trace point
+// is one write() to the ftrace trace_marker instead, through an fd opened
+// once by rtt_open(), so the event lands in the kernel ring buffer stamped
+// by the same clock as sched_switch, sched_wakeup and the IRQ events:
+//
+//    echo 1 > /sys/kernel/tracing/events/sched/enable
+//    echo 1 > /sys/kernel/tracing/tracing_on
+//    ./seqgen4 ... ; cat /sys/kernel/tracing/trace
+//
+// or trace-cmd record -e sched ./seqgen4 ..., and kernelshark shows the
+// services' events between the context switches that carried them.
+//
+// An event is a short fixed form line, "<event> <name> <n>", put together
+// with no printf on the stack and written with no lock, about a
+// microsecond of system call.  The points:
+//
+//    seq_tick      sequencer tick n
+//    seq_post      service name released on sequencer tick n
+//    svc_wake      service name woke for release n
+//    svc_done      service name done with release n
+//    tile_start    frame pool worker n starts its share of a frame
+//    tile_end      and is done with it
+//
+// They compile to nothing unless built with -DRT_TRACE, "make
+// TRACE=ftrace".  "make TRACE=lttng" sends the same events to LTTng-UST
+// tracef() instead, for an lttng session with the kernel domain enabled.
+// Without root, or with tracefs not mounted, rtt_open() warns and the
+// points stay quiet.
+//
+
+#define RTT_MARKER "/sys/kernel/tracing/trace_marker"
+#define RTT_MARKER_DEBUGFS "/sys/kernel/debug/tracing/trace_marker"
+
+// longest event line written
+#define RTT_LINE_LEN (96)
+
+// the pre-opened trace_marker, -1 until rtt_open()
+extern int rtt_fd;
+
+// Open the trace_marker once, before the first release, returns 0 or -1;
+// with LTTng there is nothing to open and it always returns 0
+int rtt_open(void);
+void rtt_close(void);
+
+// One "<event> <name> <n>" line, name may be NULL
+void rtt_event(const char *event, const char *name, unsigned long long n);
+
+#ifdef RT_TRACE
+#define RTT_EVENT(event, name, n) rtt_event((event), (name), (n))
+#else
+#define RTT_EVENT(event, name, n) do { } while(0)
+#endif
+
+#define RTT_TICK(tick) RTT_EVENT("seq_tick", (const char *)0, (tick))
+#define RTT_POST(name, release) RTT_EVENT("seq_post", (name), (release))
+#define RTT_WAKE(name, release) RTT_EVENT("svc_wake", (name), (release))
+#define RTT_DONE(name, release) RTT_EVENT("svc_done", (name), (release))
+#define RTT_TILE_START(worker) RTT_EVENT("tile_start", (const char *)0, (worker))
+#define RTT_TILE_END(worker) RTT_EVENT("tile_end", (const char *)0, (worker))
+
+#endif
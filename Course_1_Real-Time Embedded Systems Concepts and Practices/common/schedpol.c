@@ -0,0 +1,61 @@
+// Scheduling policy names, see schedpol.h
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+
+#include "schedpol.h"
+
+
+int schedpol_parse(const char *name)
+{
+    if(strcasecmp(name, "fifo") == 0 || strcasecmp(name, "SCHED_FIFO") == 0)
+        return SCHED_FIFO;
+    if(strcasecmp(name, "rr") == 0 || strcasecmp(name, "SCHED_RR") == 0)
+        return SCHED_RR;
+    if(strcasecmp(name, "other") == 0 || strcasecmp(name, "SCHED_OTHER") == 0)
+        return SCHED_OTHER;
+    return -1;
+}
+
+
+const char *schedpol_name(int policy)
+{
+    switch(policy)
+    {
+        case SCHED_FIFO: return "SCHED_FIFO";
+        case SCHED_RR: return "SCHED_RR";
+        case SCHED_OTHER: return "SCHED_OTHER";
+        default: return "UNKNOWN";
+    }
+}
+
+
+double schedpol_rr_quantum_ms(pid_t pid)
+{
+    struct timespec q;
+
+    if(sched_rr_get_interval(pid, &q) != 0)
+        return -1.0;
+    return q.tv_sec*1000.0 + q.tv_nsec/1000000.0;
+}
+
+
+void schedpol_print(const char *label)
+{
+    int policy=sched_getscheduler(0);
+
+    // for SCHED_OTHER the interval is the CFS slice, not a fixed quantum
+    if(policy == SCHED_RR)
+        printf("%sUsing %s policy, %.1lf ms quantum\n", label, schedpol_name(policy), schedpol_rr_quantum_ms(0));
+    else if(policy == SCHED_FIFO || policy == SCHED_OTHER)
+        printf("%sUsing %s policy\n", label, schedpol_name(policy));
+    else
+        printf("%sUsing UNKNOWN policy (%d)\n", label, policy);
+}
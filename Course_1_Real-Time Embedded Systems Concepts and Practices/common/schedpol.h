@@ -0,0 +1,25 @@
+#ifndef _SCHEDPOL_
+#define _SCHEDPOL_
+
+// Scheduling policy names for the Course 1 examples
+//
+// The assignments fix SCHED_POLICY at SCHED_FIFO.  These helpers let a
+// program take the policy from its command line instead, "fifo", "rr" or
+// "other", and print the SCHED_RR quantum, which the kernel sets in
+// /proc/sys/kernel/sched_rr_timeslice_ms, 100 ms by default.
+//
+
+#include <sys/types.h>
+
+// SCHED_FIFO, SCHED_RR or SCHED_OTHER for a name, -1 for anything else
+int schedpol_parse(const char *name);
+
+const char *schedpol_name(int policy);
+
+// SCHED_RR time slice of pid, 0 for the caller, in ms, -1 on error
+double schedpol_rr_quantum_ms(pid_t pid);
+
+// "Using SCHED_RR policy, 100.0 ms quantum" and the like for the caller
+void schedpol_print(const char *label);
+
+#endif
@@ -0,0 +1,106 @@
+// Cycle counter time stamps, see tstamp.h
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/prctl.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "tstamp.h"
+
+#define NANOSEC_PER_SEC (1000000000ULL)
+
+int ts_source=TS_CLOCK;
+unsigned int ts_mult=1, ts_shift=0;
+
+static int ts_ready=0;
+static double ts_rate=1.0e9;
+
+
+static ts_t raw_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+    return (ts_t)t.tv_sec*NANOSEC_PER_SEC + t.tv_nsec;
+}
+
+
+static int counter_usable(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    int tsc=0;
+
+    // CPUID.80000007H:EDX[8] invariant TSC
+    if(!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 8)))
+        return TS_CLOCK;
+    if(prctl(PR_GET_TSC, &tsc) == 0 && tsc != PR_TSC_ENABLE)
+        return TS_CLOCK;
+    return TS_TSC;
+#elif defined(__aarch64__)
+    return TS_CNTVCT;
+#else
+    return TS_CLOCK;
+#endif
+}
+
+
+int ts_init(void)
+{
+    struct timespec pause={0, TS_CALIB_MSEC*1000000L};
+    const char *env=getenv(TSTAMP_ENV);
+    ts_t c0, c1, t0, t1;
+    double ns_per_tick;
+
+    if(ts_ready) return ts_source;
+    ts_ready=1;
+
+    if(env && strcmp(env, "clock") == 0) return ts_source;
+
+    ts_source=counter_usable();
+    if(ts_source == TS_CLOCK) return ts_source;
+
+    // bracket each counter read with the clock, so the rate is off by at
+    // most the read time over the calibration time
+    t0=raw_ns(); c0=ts_now();
+    nanosleep(&pause, NULL);
+    t1=raw_ns(); c1=ts_now();
+
+    if(c1 <= c0)
+    {
+        printf("ts_init: %s did not advance, using the clock\n", ts_source_name());
+        ts_source=TS_CLOCK;
+        return ts_source;
+    }
+
+    ts_rate=(double)(c1 - c0)*NANOSEC_PER_SEC/(t1 - t0);
+    ns_per_tick=1.0e9/ts_rate;
+
+    // largest shift that keeps the multiplier in 31 bits
+    for(ts_shift=32; ts_shift>0 && ns_per_tick*(1ULL << ts_shift) >= (double)(1U << 31); ts_shift--)
+        ;
+    ts_mult=(unsigned int)(ns_per_tick*(1ULL << ts_shift) + 0.5);
+
+    return ts_source;
+}
+
+
+const char *ts_source_name(void)
+{
+    static const char *names[] = {"clock", "tsc", "cntvct"};
+
+    return names[ts_source];
+}
+
+
+double ts_hz(void)
+{
+    return ts_rate;
+}
@@ -0,0 +1,88 @@
+#ifndef _TSTAMP_
+#define _TSTAMP_
+
+// Cycle counter time stamps shared by the Course 1 examples
+//
+// clock_gettime() is a vDSO call, but still 20-50 ns of it, where a counter
+// read is a few ns.  ts_init() picks the first usable source:
+//
+//    tsc         x86 rdtsc, only with the invariant TSC cpuid bit, constant
+//                rate through P and C states, and rdtsc not disabled by
+//                PR_SET_TSC
+//    cntvct      ARMv8 cntvct_el0, the generic timer virtual count, which
+//                Linux always lets user space read
+//    clock       CLOCK_MONOTONIC_RAW from the vDSO, everything else,
+//                including the ARMv7 cycle counter seqgen2.c reads, which
+//                needs a kernel module to enable it
+//
+// and calibrates counter ticks to ns against CLOCK_MONOTONIC_RAW over
+// TS_CALIB_MSEC, as a mult and shift so a conversion is integer multiply,
+// shift and add.  Set TSTAMP=clock in the environment to force the clock.
+//
+// A counter is only as good as its sync between cores: stamps taken on two
+// cores are compared as if the counters agree, which the kernel checks
+// for the TSC before it makes it the clocksource.
+//
+
+#include <time.h>
+
+#define TS_CALIB_MSEC (50)
+#define TSTAMP_ENV "TSTAMP"
+
+#define TS_CLOCK (0)
+#define TS_TSC (1)
+#define TS_CNTVCT (2)
+
+typedef unsigned long long ts_t;
+
+// set by ts_init, read inline
+extern int ts_source;
+extern unsigned int ts_mult, ts_shift;
+
+// Detect and calibrate once, later calls return the source picked
+int ts_init(void);
+
+const char *ts_source_name(void);
+
+// counter ticks per second, 1e9 for the clock
+double ts_hz(void);
+
+static inline ts_t ts_now(void)
+{
+    struct timespec t;
+
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int lo, hi;
+
+    if(ts_source == TS_TSC)
+    {
+        asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+        return (ts_t)hi << 32 | lo;
+    }
+#elif defined(__aarch64__)
+    ts_t cnt;
+
+    if(ts_source == TS_CNTVCT)
+    {
+        asm volatile("isb; mrs %0, cntvct_el0" : "=r" (cnt) :: "memory");
+        return cnt;
+    }
+#endif
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+    return (ts_t)t.tv_sec*1000000000ULL + t.tv_nsec;
+}
+
+// ticks to ns, split so the multiply cannot overflow
+static inline long long ts_ticks_ns(ts_t ticks)
+{
+    return (long long)((ticks >> ts_shift)*ts_mult + (((ticks & ((1ULL << ts_shift) - 1))*ts_mult) >> ts_shift));
+}
+
+// ns from a to b, negative if b is earlier
+static inline long long ts_delta_ns(ts_t a, ts_t b)
+{
+    return (b >= a) ? ts_ticks_ns(b - a) : -ts_ticks_ns(a - b);
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _COREMAP_
+#define _COREMAP_
+
+// AMP core map shared by the Course 1 examples
+//
+// The examples assume a 4 core Raspberry Pi: sequencer on core 1, services
+// on cores 2 and 3, Linux and IRQs left on core 0.  A core map says which
+// cores to use instead, so the same binary runs on a 1 core VM or an 8 core
+// board:
+//
+//    seq=1,svc=2-7     sequencer on core 1, services spread over 2..7
+//    svc=3             every service on core 3, sequencer keeps its default
+//
+// Core lists use the kernel cpulist format, e.g. "2-3,6".  The map comes
+// from a -c option, or from the COREMAP environment variable when there is
+// none.  Cores that are not online are dropped with a warning, and with
+// nothing left everything falls back to the last online core.
+//
+// coremap_check() reports what the kernel does to the service cores:
+// isolcpus and nohz_full from sysfs, and whether irqbalance is running and
+// free to move IRQ handlers onto them.
+//
+
+// cpu_set_t needs _GNU_SOURCE defined before the first system header
+#include <sched.h>
+
+#define COREMAP_MAX_CORES (64)
+#define COREMAP_ENV "COREMAP"
+
+typedef struct
+{
+    int ncores;                         // online, get_nprocs()
+    int seq_core;
+    int svc_cores[COREMAP_MAX_CORES];
+    int nsvc;
+
+    cpu_set_t isolated;                 // isolcpus= cores
+    cpu_set_t nohz_full;
+    int irqbalance;                     // 1 running, 0 not, -1 unknown
+} coremap_t;
+
+// Discover the online cores and build the default map for them, seq=1 and
+// svc=2..n-1 on 4 or more cores, everything on the last core below that
+void coremap_init(coremap_t *cm);
+
+// Apply a "seq=...,svc=..." spec on top of the current map, NULL or "" to
+// use $COREMAP, returns 0 or -1 on a malformed spec
+int coremap_parse(coremap_t *cm, const char *spec);
+
+// Print the map and warn about service cores the kernel still schedules
+// or routes IRQs to
+void coremap_check(const coremap_t *cm);
+
+// Assign n services with utilization util[i] to the service cores, first
+// fit decreasing against the Liu and Layland bound of each core.  A
+// service that fits nowhere goes to the least loaded core and the call
+// returns how many did that, 0 when every core stays within its bound.
+int coremap_pack(const coremap_t *cm, const double *util, int n, int *core);
+
+// core if it is online, otherwise the last online core with a warning
+int coremap_online(int core);
+
+#endif
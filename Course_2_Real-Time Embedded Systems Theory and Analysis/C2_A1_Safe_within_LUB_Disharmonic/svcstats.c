@@ -0,0 +1,144 @@
+// Per-service latency/execution/response histograms, see svcstats.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <syslog.h>
+
+#include "svcstats.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+
+// same clock as the sequencers' MY_CLOCK_TYPE
+#define SVC_CLOCK CLOCK_MONOTONIC_RAW
+
+
+static long long ts_diff(const struct timespec *stop, const struct timespec *start)
+{
+    return (long long)(stop->tv_sec - start->tv_sec)*NANOSEC_PER_SEC + (stop->tv_nsec - start->tv_nsec);
+}
+
+
+// bucket of v nsec: octave*SVC_HIST_SUB plus the next two bits below the
+// leading one, values below SVC_HIST_SUB get a bucket each
+static int hist_bucket(long long v)
+{
+    int octave, b;
+
+    if(v < SVC_HIST_SUB) return (v < 0) ? 0 : (int)v;
+
+    octave=63 - __builtin_clzll((unsigned long long)v);
+    b=octave*SVC_HIST_SUB + (int)((v >> (octave-2)) & (SVC_HIST_SUB-1));
+
+    return (b < SVC_HIST_BUCKETS) ? b : SVC_HIST_BUCKETS-1;
+}
+
+
+// largest value that falls in bucket b
+static long long hist_upper(int b)
+{
+    int octave=b/SVC_HIST_SUB, sub=b%SVC_HIST_SUB;
+
+    if(b < SVC_HIST_SUB) return b;
+
+    return ((long long)(SVC_HIST_SUB+sub+1) << (octave-2)) - 1;
+}
+
+
+static void hist_add(svc_hist_t *h, long long v)
+{
+    h->count[hist_bucket(v)]++;
+    h->n++;
+    h->sum+=v;
+    if(v > h->max) h->max=v;
+}
+
+
+long long svc_hist_percentile(const svc_hist_t *h, double p)
+{
+    unsigned long long target, cum=0;
+    long long v;
+    int b;
+
+    if(h->n == 0) return 0;
+
+    target=(unsigned long long)(p*h->n + 0.5);
+    if(target < 1) target=1;
+
+    for(b=0; b<SVC_HIST_BUCKETS; b++)
+    {
+        cum+=h->count[b];
+        if(cum >= target) break;
+    }
+
+    v=hist_upper(b);
+    return (v < h->max) ? v : h->max;
+}
+
+
+void svc_stats_init(svc_stats_t *st, const char *name)
+{
+    memset(st, 0, sizeof(svc_stats_t));
+    st->name=name;
+}
+
+
+void svc_stats_post(svc_stats_t *st)
+{
+    clock_gettime(SVC_CLOCK, &st->post_ts[st->posts % SVC_POST_RING]);
+    st->posts++;
+}
+
+
+void svc_stats_wake(svc_stats_t *st, unsigned long long release)
+{
+    clock_gettime(SVC_CLOCK, &st->wake_ts);
+    st->release=release;
+
+    // the final shutdown sem_post is not a release, and a service more than
+    // a ring behind has lost its post time
+    st->valid = (release >= 1 && release <= st->posts && st->posts - release < SVC_POST_RING);
+
+    if(st->valid)
+        hist_add(&st->latency, ts_diff(&st->wake_ts, &st->post_ts[(release-1) % SVC_POST_RING]));
+}
+
+
+void svc_stats_done(svc_stats_t *st)
+{
+    struct timespec done_ts;
+
+    if(!st->valid) return;
+
+    clock_gettime(SVC_CLOCK, &done_ts);
+    hist_add(&st->exec, ts_diff(&done_ts, &st->wake_ts));
+    hist_add(&st->response, ts_diff(&done_ts, &st->post_ts[(st->release-1) % SVC_POST_RING]));
+}
+
+
+void svc_stats_report(svc_stats_t *st, int n)
+{
+    int i;
+    svc_stats_t *s;
+
+    printf("\n%-10s %8s %10s %10s %10s %10s %10s %10s %10s\n", "service", "releases",
+           "lat p99", "lat max", "exec avg", "exec p99", "WCET", "resp p99", "resp max");
+    printf("%-10s %8s %10s %10s %10s %10s %10s %10s %10s\n", "", "", "usec", "usec", "usec", "usec", "usec", "usec", "usec");
+
+    for(i=0; i<n; i++)
+    {
+        s=&st[i];
+
+        printf("%-10s %8llu %10.1lf %10.1lf %10.1lf %10.1lf %10.1lf %10.1lf %10.1lf\n", s->name, s->exec.n,
+               svc_hist_percentile(&s->latency, 0.99)/1000.0, s->latency.max/1000.0,
+               s->exec.n ? (double)s->exec.sum/s->exec.n/1000.0 : 0.0,
+               svc_hist_percentile(&s->exec, 0.99)/1000.0, s->exec.max/1000.0,
+               svc_hist_percentile(&s->response, 0.99)/1000.0, s->response.max/1000.0);
+
+        syslog(LOG_CRIT, "%s releases %llu latency p99 %lld max %lld exec p99 %lld WCET %lld response p99 %lld max %lld nsec\n",
+               s->name, s->exec.n, svc_hist_percentile(&s->latency, 0.99), s->latency.max,
+               svc_hist_percentile(&s->exec, 0.99), s->exec.max,
+               svc_hist_percentile(&s->response, 0.99), s->response.max);
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef _RTSTOP_
+#define _RTSTOP_
+
+// One stop word for a sequencer and its services, shared by the Course 1
+// sequencer examples
+//
+// The seqgen examples used to stop with a plain int abortSN flag per
+// service, set by the sequencer after one last sem_post to each.  Nothing
+// orders those stores, so a service the post woke on another core could
+// read its flag still FALSE. It would then count a release that never
+// happened and block in sem_wait for good, and the join never returned.
+// Here every service reads one state word instead:
+//
+//    RTSTOP_RUN      until the first rtstop_request()
+//    RTSTOP_CLAIMED  taken by that request, the stop time is being written
+//    RTSTOP_DONE     the sequencer ran all its periods
+//    RTSTOP_ABORT    stopped early
+//
+// rtstop_request() takes the word with a compare and swap, so a second
+// request is a no-op.  It stamps the stop time and stores the reason with
+// release ordering, and only then wakes everything: every thread blocked in
+// rtstop_wait() with one FUTEX_WAKE, and every registered service with a
+// post of its release semaphore.  A service that sees the stop with
+// rtstop_stopped(), an acquire load, also sees the stop time.  That holds
+// both at the top of its loop and straight after its sem_wait.  So it
+// leaves on the wakeup itself, without running a job for it.  A service
+// that is in the middle of a job leaves as soon as the job ends.  Every
+// service stops within one of its periods.
+//
+// rtstop_request() calls only clock_gettime, the futex syscall and
+// sem_post, so a SIGALRM handler sequencer can call it.  The printing is
+// left to rtstop_report().  It runs after the joins and shows how long
+// each service took to leave after the request.
+//
+
+#include <time.h>
+#include <semaphore.h>
+
+#define RTSTOP_RUN (0)
+#define RTSTOP_CLAIMED (1)
+#define RTSTOP_DONE (2)
+#define RTSTOP_ABORT (3)
+
+#define RTSTOP_MAX_SERVICES (16)
+#define RTSTOP_NAME_LEN (24)
+
+typedef struct
+{
+    volatile unsigned int state;    // the stop word, also the futex word
+    clockid_t clock;
+    long long stop_ns;              // written before state, read after it
+    int nservices;
+    sem_t *sem[RTSTOP_MAX_SERVICES];
+    char name[RTSTOP_MAX_SERVICES][RTSTOP_NAME_LEN];
+    long long exit_ns[RTSTOP_MAX_SERVICES]; // after the request, -1 until it leaves
+} rtstop_t;
+
+// Stop word in RTSTOP_RUN, stop and exit times taken from clock
+void rtstop_init(rtstop_t *s, clockid_t clock);
+
+// Register a service and the semaphore that releases it.  Do this before
+// its thread starts.  Returns the index rtstop_exit() takes, or -1 when
+// every slot is in use.
+int rtstop_add(rtstop_t *s, sem_t *sem, const char *name);
+
+// Stop every service for why, RTSTOP_DONE or RTSTOP_ABORT.  Safe to call
+// from a signal handler.  Returns 1 if this call stopped them, 0 if an
+// earlier request already did.
+int rtstop_request(rtstop_t *s, unsigned int why);
+
+// Non-zero once a request has published its stop time
+static inline int rtstop_stopped(rtstop_t *s)
+{
+    return __atomic_load_n(&s->state, __ATOMIC_ACQUIRE) >= RTSTOP_DONE;
+}
+
+// Block until a request, returns the reason
+unsigned int rtstop_wait(rtstop_t *s);
+
+// Service idx is leaving its loop, record how long after the request
+void rtstop_exit(rtstop_t *s, int idx);
+
+const char *rtstop_reason(unsigned int why);
+
+// Exit latency of every service and the longest, after the joins
+void rtstop_report(const rtstop_t *s);
+
+#endif
@@ -13,6 +13,10 @@
 // 2) Sequencer runs on core 1
 // 3) EVEN thread indexes run on core 2
 // 4) ODD thread indexes run on core 3
+//    That is the default core map of a 4 core board, set COREMAP, e.g.
+//    COREMAP="seq=1,svc=2-7", for any other, the services go round robin
+//    over its svc cores and boards with fewer cores fall back to the last
+//    one, see coremap.h
 // 5) Linux kernel mostly runs on core 0, but does load balance non-RT workload over all cores
 // 6) check for irqbalance [https://linux.die.net/man/1/irqbalance] which also distribute IRQ handlers
 //
@@ -107,6 +111,7 @@
 #include <sys/time.h>
 #include <sys/sysinfo.h>
 #include <errno.h>
+#include "coremap.h"
 
 #define USEC_PER_MSEC (1000)
 #define NANOSEC_PER_MSEC (1000000)
@@ -131,6 +136,7 @@
 int abortTest=FALSE;
 int abortS1=FALSE, abortS2=FALSE, abortS3=FALSE, abortS4=FALSE, abortS5=FALSE, abortS6=FALSE, abortS7=FALSE;
 sem_t semS1, semS2, semS3, semS4, semS5, semS6, semS7;
+coremap_t coremap;
 struct timespec start_time_val;
 double start_realtime;
 
@@ -233,6 +239,10 @@ void main(void)
 
    printf("Using CPUS=%d from total available.\n", CPU_COUNT(&allcpuset));
 
+   coremap_init(&coremap);
+   if(coremap_parse(&coremap, (const char *)0) != 0) exit(-1);
+   coremap_check(&coremap);
+
 
     // initialize the sequencer semaphores
     //
@@ -271,22 +281,11 @@ void main(void)
 
     for(i=0; i < NUM_THREADS; i++)
     {
-
-      // run even indexed threads on core 2
-      if(i % 2 == 0)
-      {
-          CPU_ZERO(&threadcpu);
-          cpuidx=(2);
-          CPU_SET(cpuidx, &threadcpu);
-      }
-
-      // run odd indexed threads on core 3
-      else
-      {
-          CPU_ZERO(&threadcpu);
-          cpuidx=(3);
-          CPU_SET(cpuidx, &threadcpu);
-      }
+      // round robin over the service cores, even indexed threads on core 2
+      // and odd on core 3 with the default map of a 4 core board
+      CPU_ZERO(&threadcpu);
+      cpuidx=coremap.svc_cores[i % coremap.nsvc];
+      CPU_SET(cpuidx, &threadcpu);
 
       rc=pthread_attr_init(&rt_sched_attr[i]);
       rc=pthread_attr_setinheritsched(&rt_sched_attr[i], PTHREAD_EXPLICIT_SCHED);
@@ -398,9 +397,9 @@ void main(void)
     printf("Start sequencer\n");
     threadParams[0].sequencePeriods=2000;
 
-    // run sequencer on core 1
+    // run sequencer on its own core, core 1 by default
     CPU_ZERO(&threadcpu);
-    cpuidx=(1);
+    cpuidx=coremap.seq_core;
     CPU_SET(cpuidx, &threadcpu);
     rc=pthread_attr_setaffinity_np(&rt_sched_attr[0], sizeof(cpu_set_t), &threadcpu);
 
@@ -0,0 +1,105 @@
+#ifndef _DEADMON_
+#define _DEADMON_
+
+// Online per-service deadline monitoring
+//
+// The sequencer calls dm_release for every release it is about to post and
+// the service calls dm_wake and dm_done around the release work, so the
+// monitor sees both ends of every release:
+//
+//    overrun   a release comes due while the previous one is still pending
+//              or running, found by the sequencer before it posts
+//    miss      a release completed later than its post time plus deadline,
+//              found by the service at completion
+//
+// On each overrun or miss the policy picks what happens next, either the
+// fixed policy of the service or a hook that decides per event:
+//
+//    DM_NONE      count only, late releases queue up on the semaphore
+//    DM_SKIP      drop a release while the previous one is unfinished
+//    DM_DEGRADE   keep releasing, the service runs reduced work (see
+//                 dm_degraded) until a release completes on time with
+//                 nothing pending
+//    DM_ABORT     ask the sequencer to stop the test
+//
+// Every counter has a single writer, the sequencer or the service, and is
+// read and written with __atomic builtins, so a monitor thread can take a
+// dm_snapshot at any time without a lock and without slowing either side.
+//
+
+#include <time.h>
+
+#define DM_NONE (0)
+#define DM_SKIP (1)
+#define DM_DEGRADE (2)
+#define DM_ABORT (3)
+
+// event passed to a hook
+#define DM_OVERRUN (0)
+#define DM_MISS (1)
+
+// post times kept for releases not yet completed, a service further behind
+// than this has every release counted as a miss
+#define DM_RING (16)
+
+typedef struct dm_monitor dm_monitor_t;
+
+// returns the policy to apply to this event
+typedef int (*dm_hook_t)(dm_monitor_t *m, int event);
+
+struct dm_monitor
+{
+    const char *name;
+    long long deadline_ns;
+    int policy;
+    dm_hook_t hook;
+
+    // sequencer side
+    unsigned long long releases, posts, skips, overruns;
+    long long post_ns[DM_RING];
+
+    // service side
+    unsigned long long done, misses;
+    long long start_ns, max_exec_ns, max_resp_ns;
+    int valid;
+
+    // set by either side
+    int degrade, abort;
+};
+
+typedef struct
+{
+    unsigned long long releases, posts, skips, overruns, done, misses;
+    long long max_exec_ns, max_resp_ns;
+    int degrade, abort;
+} dm_counts_t;
+
+void dm_init(dm_monitor_t *m, const char *name, long long deadline_ns, int policy);
+
+// optional, replaces the fixed policy, NULL to go back to it
+void dm_set_hook(dm_monitor_t *m, dm_hook_t hook);
+
+// sequencer, call for each release before sem_post, returns 1 if the
+// release should be posted and 0 if it was skipped
+int dm_release(dm_monitor_t *m);
+
+// service, right after sem_wait with its release count, and once the
+// release work is done
+void dm_wake(dm_monitor_t *m, unsigned long long release);
+void dm_done(dm_monitor_t *m, unsigned long long release);
+
+// service, run reduced work for this release
+int dm_degraded(const dm_monitor_t *m);
+
+// sequencer, any monitor asked for DM_ABORT
+int dm_abort_requested(const dm_monitor_t *m, int n);
+
+// lock free copy of the counters, for a monitoring thread
+void dm_snapshot(const dm_monitor_t *m, dm_counts_t *c);
+
+const char *dm_policy_name(int policy);
+
+// print a releases / overruns / misses / WCET table
+void dm_report(const dm_monitor_t *m, int n);
+
+#endif
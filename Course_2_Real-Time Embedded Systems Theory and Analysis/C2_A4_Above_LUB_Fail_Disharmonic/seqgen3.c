@@ -13,6 +13,10 @@
 // 2) Sequencer runs on core 1
 // 3) EVEN thread indexes run on core 2
 // 4) ODD thread indexes run on core 3
+//    That is the default core map of a 4 core board, set COREMAP, e.g.
+//    COREMAP="seq=1,svc=2-7", for any other, the services go round robin
+//    over its svc cores and boards with fewer cores fall back to the last
+//    one, see coremap.h
 // 5) Linux kernel mostly runs on core 0, but does load balance non-RT workload over all cores
 // 6) check for irqbalance [https://linux.die.net/man/1/irqbalance] which also distribute IRQ handlers
 //
@@ -109,6 +113,14 @@
 #include <errno.h>
 
 #include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+
+#include "svcstats.h"
+#include "busywork.h"
+#include "deadmon.h"
+#include "coremap.h"
+#include "rtstop.h"
 
 #define USEC_PER_MSEC (1000)
 #define NANOSEC_PER_MSEC (1000000)
@@ -119,10 +131,44 @@
 
 #define NUM_THREADS (4)
 
+// Take the interval timer signal with sigwaitinfo in a dedicated SCHED_FIFO
+// RT_MAX sequencer thread on core 1, instead of running Sequencer() as a
+// SIGALRM handler on whichever thread the signal happens to interrupt
+#define TIMER_THREAD
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+// per-service latency, execution and response time histograms, summary
+// printed at TEST COMPLETE
+#define SERVICE_STATS
+
 #define COURSE 2
 #define ASSIGNMENT 4
 #define MAX_STRING_LEN 250
+#define MAX_TAG_LEN 32
+
+// Every release of a service is buffered for the whole test, and only
+// formatted and handed to syslog by main once the services are joined, so
+// the SCHED_FIFO services never make a syslog call.  A service is released
+// at most once a sequencer period, so LOG_RECORDS holds an LCM_PERIOD test.
 #define LCM_PERIOD 13
+#define LOG_RECORDS (LCM_PERIOD+1)
+
+// Each service burns its C from the assignment table as calibrated busy
+// work (see busywork.h) on every release, in ticks of the 10 msec sequencer
+#define SYNTHETIC_LOAD
+#define TICK_USEC (10000)
+
+// Check every release against its deadline (see deadmon.h), counting
+// overruns and misses per service and applying DEADLINE_POLICY to each, a
+// degraded service burns DEGRADE_PCT of its C.  A SCHED_OTHER monitor
+// thread samples the counters every MONITOR_USEC and prints any change.
+#define DEADLINE_MONITOR
+#define DEADLINE_POLICY DM_NONE
+#define DEGRADE_PCT (50)
+#define MONITOR_USEC (10000)
 
 // Of the available user space clocks, CLOCK_MONONTONIC_RAW is typically most precise and not subject to
 // updates from external timer adjustments
@@ -135,14 +181,57 @@
 //#define MY_CLOCK_TYPE CLOCK_REALTIME_COARSE
 //#define MY_CLOCK_TYPE CLOCK_MONTONIC_COARSE
 
-int abortTest = FALSE;
-int abortS1 = FALSE, abortS2 = FALSE, abortS3 = FALSE, abortS4 = FALSE;
+// The services stop on one shared stop word, see rtstop.h.  The sequencer
+// sets it without printing, since without TIMER_THREAD it runs as the
+// SIGALRM handler, and main prints the stop once it has happened.
+// rtstop_request(&stop, RTSTOP_ABORT) from anywhere ends the run early.
+rtstop_t stop;
 sem_t semS1, semS2, semS3, semS4;
+coremap_t coremap;
+
+#ifdef SERVICE_STATS
+svc_stats_t svcStats[4];
+#endif
+
+#ifdef DEADLINE_MONITOR
+dm_monitor_t deadMon[NUM_THREADS];
+static int monitorDone = FALSE;
+#endif
+
+// sem_post a release, stamping the post time for the latency histogram,
+// unless the deadline policy skips it
+#ifdef DEADLINE_MONITOR
+#define SVC_GATE(i) dm_release(&deadMon[i])
+#else
+#define SVC_GATE(i) (1)
+#endif
+
+#ifdef SERVICE_STATS
+#define SVC_RELEASE(i, sem) do { if(SVC_GATE(i)) { svc_stats_post(&svcStats[i]); sem_post(sem); } } while(0)
+#else
+#define SVC_RELEASE(i, sem) do { if(SVC_GATE(i)) sem_post(sem); } while(0)
+#endif
+
+#ifdef SYNTHETIC_LOAD
+static const int wcetTicks[NUM_THREADS] = {1, 1, 1, 2};
+#endif
+
+#ifdef DEADLINE_MONITOR
+// relative deadline of each service in ticks
+static const int deadlineTicks[NUM_THREADS] = {2, 5, 7, 13};
+#define SVC_LOAD_USEC(i) (wcetTicks[i]*TICK_USEC*(dm_degraded(&deadMon[i]) ? DEGRADE_PCT : 100)/100)
+#else
+#define SVC_LOAD_USEC(i) (wcetTicks[i]*TICK_USEC)
+#endif
+
 struct timespec start_time_val;
 double start_realtime;
 unsigned long long sequencePeriods;
 
 static timer_t timer_1;
+#ifdef TIMER_THREAD
+static unsigned long long timerOverruns=0;
+#endif
 static struct itimerspec itime = {{1, 0}, {1, 0}};
 static struct itimerspec last_itime;
 
@@ -155,6 +244,12 @@ typedef struct
 
 
 void Sequencer(int id);
+#ifdef TIMER_THREAD
+void *SequencerThread(void *threadp);
+#endif
+#ifdef DEADLINE_MONITOR
+void *MonitorThread(void *threadp);
+#endif
 
 void *Service_1(void *threadp);
 void *Service_2(void *threadp);
@@ -165,6 +260,25 @@ double getTimeMsec(void);
 double realtime(struct timespec *tsptr);
 void print_scheduler(void);
 
+// One release of a service, formatted only when the log is flushed at exit
+typedef struct
+{
+    unsigned long long count;
+    struct timespec ts;
+    int core;
+} logRecord_t;
+
+typedef struct
+{
+    char tag[MAX_TAG_LEN];
+    unsigned int n;
+    unsigned long long dropped;
+    logRecord_t rec[LOG_RECORDS];
+} serviceLog_t;
+
+static char syslog_ident[MAX_STRING_LEN];
+static serviceLog_t serviceLog[NUM_THREADS];
+
 typedef enum syslogState
 {
     SYSLOG_DATA,
@@ -181,10 +295,6 @@ typedef enum syslogState
  */
 void syslogPrint(const char *data, const State flag)
 {
-    char data_t[MAX_STRING_LEN];
-    sprintf(data_t, "[COURSE:%d][ASSIGNMENT:%d]", COURSE, ASSIGNMENT);
-    openlog(data_t, LOG_NDELAY, LOG_DAEMON);
-
     switch (flag)
     {
     case SYSLOG_UNAME:
@@ -214,8 +324,82 @@ void syslogPrint(const char *data, const State flag)
     default:
         break;
     }
+}
 
-    closelog();
+/*
+ * void syslogOpen(void)
+ * @desc: Opens syslog once for the whole test with the course and assignment
+ *        identifier, and formats the per-service tags used by syslogRelease
+ * @return: None
+ */
+void syslogOpen(void)
+{
+    int i;
+
+    // openlog keeps the pointer, so the identifier must outlive this call
+    sprintf(syslog_ident, "[COURSE:%d][ASSIGNMENT:%d]", COURSE, ASSIGNMENT);
+    openlog(syslog_ident, LOG_NDELAY, LOG_DAEMON);
+
+    for(i=0; i < NUM_THREADS; i++)
+    {
+        sprintf(serviceLog[i].tag, "Thread %d start", i+1);
+        serviceLog[i].n=0;
+        serviceLog[i].dropped=0;
+    }
+}
+
+/*
+ * void syslogFlush(serviceLog_t *slog)
+ * @desc: Formats and writes out every buffered release of one service, once
+ *        its thread is joined
+ * @param slog: the service log to flush
+ * @return: None
+ */
+void syslogFlush(serviceLog_t *slog)
+{
+    unsigned int i;
+    logRecord_t *rec;
+
+    for(i=0; i < slog->n; i++)
+    {
+        rec=&slog->rec[i];
+        syslog(LOG_DEBUG, "%s %llu @ sec=%6.9lf on core %d\n", slog->tag, rec->count, realtime(&rec->ts) - start_realtime, rec->core);
+    }
+
+    if(slog->dropped)
+    {
+        printf("%s: %llu releases past LOG_RECORDS not logged\n", slog->tag, slog->dropped);
+        syslog(LOG_DEBUG, "%s: %llu releases past LOG_RECORDS not logged\n", slog->tag, slog->dropped);
+    }
+
+    slog->n=0;
+    slog->dropped=0;
+}
+
+/*
+ * void syslogRelease(serviceLog_t *slog, unsigned long long count, const struct timespec *ts)
+ * @desc: Records one release of a service, called on every release so it
+ *        only copies the raw values into the service buffer, a release
+ *        past the end of the buffer is counted and not logged
+ * @param slog: the releasing service's log, written by that service only
+ * @param count: release count
+ * @param ts: release timestamp read with MY_CLOCK_TYPE
+ * @return: None
+ */
+void syslogRelease(serviceLog_t *slog, unsigned long long count, const struct timespec *ts)
+{
+    logRecord_t *rec;
+
+    if(slog->n == LOG_RECORDS)
+    {
+        slog->dropped++;
+        return;
+    }
+
+    rec=&slog->rec[slog->n++];
+    rec->count=count;
+    rec->ts=*ts;
+    rec->core=sched_getcpu();
 }
 
 // For background on high resolution time-stamps and clocks:
@@ -261,7 +445,7 @@ void main(void)
     struct timespec current_time_val, current_time_res;
     double current_realtime, current_realtime_res;
 
-    int i, rc, scope, flags=0;
+    int i, rc, scope;
 
     cpu_set_t threadcpu;
     cpu_set_t allcpuset;
@@ -277,8 +461,24 @@ void main(void)
     pthread_attr_t main_attr;
     pid_t mainpid;
 
+#ifdef TIMER_THREAD
+    sigset_t alarmset;
+    pthread_t seq_thread;
+    pthread_attr_t seq_attr;
+    struct sched_param seq_param;
+#else
+    int flags=0;
+#endif
+
+#ifdef DEADLINE_MONITOR
+    pthread_t mon_thread;
+    pthread_attr_t mon_attr;
+    struct sched_param mon_param;
+#endif
+
     // Print out uname on terminal
     system("echo > /dev/null | sudo tee /var/log/syslog");
+    syslogOpen();
     syslogPrint(NULL, SYSLOG_UNAME);
 
     printf("Starting High Rate Sequencer Demo\n");
@@ -303,6 +503,10 @@ void main(void)
 
    printf("Using CPUS=%d from total available.\n", CPU_COUNT(&allcpuset));
 
+   coremap_init(&coremap);
+   if(coremap_parse(&coremap, (const char *)0) != 0) exit(-1);
+   coremap_check(&coremap);
+
 
     // initialize the sequencer semaphores
     //
@@ -311,8 +515,35 @@ void main(void)
     if (sem_init (&semS3, 0, 0)) { printf ("Failed to initialize S3 semaphore\n"); exit (-1); }
     if (sem_init (&semS4, 0, 0)) { printf ("Failed to initialize S4 semaphore\n"); exit (-1); }
 
+    // in service order, the index each service's rtstop_exit() takes
+    rtstop_init(&stop, MY_CLOCK_TYPE);
+    rtstop_add(&stop, &semS1, "Thread 1"); rtstop_add(&stop, &semS2, "Thread 2");
+    rtstop_add(&stop, &semS3, "Thread 3"); rtstop_add(&stop, &semS4, "Thread 4");
+
+#ifdef SERVICE_STATS
+    svc_stats_init(&svcStats[0], "Thread 1");
+    svc_stats_init(&svcStats[1], "Thread 2");
+    svc_stats_init(&svcStats[2], "Thread 3");
+    svc_stats_init(&svcStats[3], "Thread 4");
+#endif
+
+#ifdef DEADLINE_MONITOR
+    dm_init(&deadMon[0], "Thread 1", (long long)deadlineTicks[0]*TICK_USEC*1000, DEADLINE_POLICY);
+    dm_init(&deadMon[1], "Thread 2", (long long)deadlineTicks[1]*TICK_USEC*1000, DEADLINE_POLICY);
+    dm_init(&deadMon[2], "Thread 3", (long long)deadlineTicks[2]*TICK_USEC*1000, DEADLINE_POLICY);
+    dm_init(&deadMon[3], "Thread 4", (long long)deadlineTicks[3]*TICK_USEC*1000, DEADLINE_POLICY);
+#endif
+
     mainpid=getpid();
 
+#ifdef TIMER_THREAD
+    // block SIGALRM before any thread is created so every thread inherits
+    // the mask, only the sequencer thread ever takes it with sigwaitinfo
+    sigemptyset(&alarmset);
+    sigaddset(&alarmset, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alarmset, NULL);
+#endif
+
     rt_max_prio = sched_get_priority_max(SCHED_FIFO);
     rt_min_prio = sched_get_priority_min(SCHED_FIFO);
 
@@ -322,6 +553,10 @@ void main(void)
     if(rc < 0) perror("main_param");
     print_scheduler();
 
+#ifdef SYNTHETIC_LOAD
+    printf("Busy work calibrated to %.1lf iterations/usec\n", busy_calibrate());
+#endif
+
 
     pthread_attr_getscope(&main_attr, &scope);
 
@@ -338,22 +573,11 @@ void main(void)
     // Setup FIFO attribute for all threads
     for(i=0; i < NUM_THREADS; i++)
     {
-
-      // run even indexed threads on core 2
-      if(i % 2 == 0)
-      {
-          CPU_ZERO(&threadcpu);
-          cpuidx=(2);
-          CPU_SET(cpuidx, &threadcpu);
-      }
-
-      // run odd indexed threads on core 3
-      else
-      {
-          CPU_ZERO(&threadcpu);
-          cpuidx=(3);
-          CPU_SET(cpuidx, &threadcpu);
-      }
+      // round robin over the service cores, even indexed threads on core 2
+      // and odd on core 3 with the default map of a 4 core board
+      CPU_ZERO(&threadcpu);
+      cpuidx=coremap.svc_cores[i % coremap.nsvc];
+      CPU_SET(cpuidx, &threadcpu);
 
       rc=pthread_attr_init(&rt_sched_attr[i]);
       rc=pthread_attr_setinheritsched(&rt_sched_attr[i], PTHREAD_EXPLICIT_SCHED);
@@ -426,10 +650,45 @@ void main(void)
     //
     // sleep(1);
  
+#ifdef DEADLINE_MONITOR
+    // the monitor only reads the counters, so it stays out of the RT
+    // priorities and runs on whatever core has time for it
+    pthread_attr_init(&mon_attr);
+    pthread_attr_setinheritsched(&mon_attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&mon_attr, SCHED_OTHER);
+    mon_param.sched_priority=0;
+    pthread_attr_setschedparam(&mon_attr, &mon_param);
+
+    if((rc=pthread_create(&mon_thread, &mon_attr, MonitorThread, (void *)0)) != 0)
+    {
+        printf("pthread_create for monitor failed, rc=%d\n", rc);
+        exit(-1);
+    }
+#endif
+
     // Create Sequencer thread, which like a cyclic executive, is highest prio
     printf("Start sequencer\n");
     sequencePeriods=LCM_PERIOD;
 
+#ifdef TIMER_THREAD
+    // Sequencer = RT_MAX	@ 100 Hz, creates and arms its own timer
+    //
+    CPU_ZERO(&threadcpu);
+    CPU_SET(coremap.seq_core, &threadcpu);
+
+    pthread_attr_init(&seq_attr);
+    pthread_attr_setinheritsched(&seq_attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&seq_attr, SCHED_FIFO);
+    pthread_attr_setaffinity_np(&seq_attr, sizeof(cpu_set_t), &threadcpu);
+    seq_param.sched_priority=rt_max_prio;
+    pthread_attr_setschedparam(&seq_attr, &seq_param);
+
+    if((rc=pthread_create(&seq_thread, &seq_attr, SequencerThread, (void *)0)) != 0)
+    {
+        printf("pthread_create for sequencer failed, rc=%d\n", rc);
+        exit(-1);
+    }
+#else
     // Sequencer = RT_MAX	@ 100 Hz
     //
     /* set up to signal SIGALRM if timer expires */
@@ -449,7 +708,11 @@ void main(void)
     //itime.it_value.tv_nsec = 0;
 
     timer_settime(timer_1, flags, &itime, &last_itime);
+#endif
 
+    // the sequencer only sets the stop word, the message is printed here
+    rc=rtstop_wait(&stop);
+    printf("Disabling sequencer interval timer with %s at %llu of %llu\n", rtstop_reason(rc), seqCnt, sequencePeriods);
 
     for(i=0;i<NUM_THREADS;i++)
     {
@@ -459,11 +722,135 @@ void main(void)
 		printf("joined thread %d\n", i);
     }
 
+#ifdef TIMER_THREAD
+    pthread_join(seq_thread, NULL);
+    printf("Sequencer timer overruns %llu\n", timerOverruns);
+    syslog(LOG_CRIT, "Sequencer timer overruns %llu\n", timerOverruns);
+#endif
+
+#ifdef DEADLINE_MONITOR
+    __atomic_store_n(&monitorDone, TRUE, __ATOMIC_RELAXED);
+    pthread_join(mon_thread, NULL);
+#endif
+
+   // every release of the test, now that no service is running
+   for(i=0;i<NUM_THREADS;i++)
+       syslogFlush(&serviceLog[i]);
+
+#ifdef SERVICE_STATS
+   svc_stats_report(svcStats, 4);
+#endif
+
+#ifdef DEADLINE_MONITOR
+   dm_report(deadMon, NUM_THREADS);
+#endif
+
+#ifdef SYNTHETIC_LOAD
+   busy_report();
+#endif
+
+   rtstop_report(&stop);
+
    printf("\nTEST COMPLETE\n");
    closelog();
 }
 
 
+#ifdef TIMER_THREAD
+void *SequencerThread(void *threadp)
+{
+    struct sigevent sev;
+    sigset_t alarmset;
+    siginfo_t info;
+    int overrun, flags=0;
+
+    sigemptyset(&alarmset);
+    sigaddset(&alarmset, SIGALRM);
+
+    // timer expiry is queued to this thread only, never to a service
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify=SIGEV_THREAD_ID;
+    sev.sigev_signo=SIGALRM;
+    sev.sigev_notify_thread_id=syscall(SYS_gettid);
+
+    if(timer_create(CLOCK_REALTIME, &sev, &timer_1) != 0)
+    {
+        perror("timer_create SIGEV_THREAD_ID");
+        exit(-1);
+    }
+
+    /* arm the interval timer */
+    itime.it_interval.tv_sec = 0;
+    itime.it_interval.tv_nsec = 10000000;
+    itime.it_value.tv_sec = 0;
+    itime.it_value.tv_nsec = 10000000;
+
+    timer_settime(timer_1, flags, &itime, &last_itime);
+
+    while(!rtstop_stopped(&stop) && (seqCnt < sequencePeriods))
+    {
+        if(sigwaitinfo(&alarmset, &info) < 0)
+        {
+            if(errno == EINTR) continue;
+            perror("sigwaitinfo");
+            break;
+        }
+
+        // expirations that came and went while the signal was pending are
+        // merged into it, release for them too so seqCnt stays locked to time
+        overrun=timer_getoverrun(timer_1);
+        if(overrun > 0) timerOverruns+=overrun;
+
+        do
+        {
+            Sequencer(info.si_signo);
+        } while((overrun-- > 0) && (seqCnt < sequencePeriods));
+    }
+
+    timer_delete(timer_1);
+
+    pthread_exit((void *)0);
+}
+#endif
+
+
+#ifdef DEADLINE_MONITOR
+/*
+ * void *MonitorThread(void *threadp)
+ * @desc: Samples the deadline counters of every service each MONITOR_USEC
+ *        and prints the services whose overruns, misses or skips changed
+ * @return: None
+ */
+void *MonitorThread(void *threadp)
+{
+    dm_counts_t last[NUM_THREADS], c;
+    struct timespec current_time_val;
+    int i;
+
+    memset(last, 0, sizeof(last));
+
+    while(!__atomic_load_n(&monitorDone, __ATOMIC_RELAXED))
+    {
+        usleep(MONITOR_USEC);
+
+        for(i=0; i < NUM_THREADS; i++)
+        {
+            dm_snapshot(&deadMon[i], &c);
+            if(c.overruns == last[i].overruns && c.misses == last[i].misses && c.skips == last[i].skips) continue;
+
+            clock_gettime(MY_CLOCK_TYPE, &current_time_val);
+            printf("%s @ sec=%6.9lf releases %llu overruns %llu misses %llu skipped %llu%s\n", deadMon[i].name,
+                   realtime(&current_time_val) - start_realtime, c.releases, c.overruns, c.misses, c.skips,
+                   c.degrade ? " degraded" : "");
+            last[i]=c;
+        }
+    }
+
+    pthread_exit((void *)0);
+}
+#endif
+
+
 /*
  * void Sequencer(int id)
  * @desc: A sequencer where we can hand out semaphores to allow a given thread
@@ -479,23 +866,27 @@ void Sequencer(int id)
     // Release each service at a sub-rate of the generic sequencer rate
 
     // Servcie_1 = RT_MAX-1	@ 50 Hz = 20ms
-    if((seqCnt % 2) == 0) sem_post(&semS1);
+    if((seqCnt % 2) == 0) SVC_RELEASE(0, &semS1);
 
     // Service_2 = RT_MAX-2	@ 20 Hz = 50ms
-    if((seqCnt % 5) == 0) sem_post(&semS2);
+    if((seqCnt % 5) == 0) SVC_RELEASE(1, &semS2);
 
     // Service_3 = RT_MAX-3	@ 14.29 Hz = 70ms
-    if((seqCnt % 7) == 0) sem_post(&semS3);           
+    if((seqCnt % 7) == 0) SVC_RELEASE(2, &semS3);           
     
     // Service_4 = RT_MAX-4	@ 7.7 Hz = 130ms
-    if((seqCnt % 13) == 0) sem_post(&semS4);   
+    if((seqCnt % 13) == 0) SVC_RELEASE(3, &semS4);   
     seqCnt++;
 
     //clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
     //printf("Sequencer on core %d for cycle %llu @ sec=%6.9lf\n", sched_getcpu(), seqCnt, current_realtime-start_realtime);
     //syslog(LOG_CRIT, "Sequencer on core %d for cycle %llu @ sec=%6.9lf\n", sched_getcpu(), seqCnt, current_realtime-start_realtime);
 
-    if(abortTest || (seqCnt >= sequencePeriods))
+#ifdef DEADLINE_MONITOR
+    if(dm_abort_requested(deadMon, NUM_THREADS)) rtstop_request(&stop, RTSTOP_ABORT);
+#endif
+
+    if(rtstop_stopped(&stop) || (seqCnt >= sequencePeriods))
     {
         // disable interval timer
         itime.it_interval.tv_sec = 0;
@@ -503,13 +894,9 @@ void Sequencer(int id)
         itime.it_value.tv_sec = 0;
         itime.it_value.tv_nsec = 0;
         timer_settime(timer_1, flags, &itime, &last_itime);
-	printf("Disabling sequencer interval timer with abort=%d and %llu of %d\n", abortTest, seqCnt, sequencePeriods);
-
-	// shutdown all services
-        sem_post(&semS1); sem_post(&semS2); sem_post(&semS3); sem_post(&semS4);
-
-        abortS1=TRUE; abortS2=TRUE; abortS3=TRUE; abortS4=TRUE;
 
+	// shutdown all services, signal safe, a no-op after an abort request
+        rtstop_request(&stop, RTSTOP_DONE);
     }
 
 }
@@ -529,7 +916,6 @@ void *Service_1(void *threadp)
     double current_realtime;
     unsigned long long S1Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
-    char data[MAX_STRING_LEN];
 
     // Start up processing and resource initialization
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
@@ -537,23 +923,39 @@ void *Service_1(void *threadp)
     //syslog(LOG_CRIT, "S1 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S1 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS1) // check for synchronous abort request
+    while(!rtstop_stopped(&stop)) // check for synchronous abort request
     {
 	// wait for service request from the sequencer, a signal handler or ISR in kernel
         sem_wait(&semS1);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
+
         S1Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[0], S1Cnt);
+#endif
+#ifdef DEADLINE_MONITOR
+        dm_wake(&deadMon[0], S1Cnt);
+#endif
 
 	// DO WORK
 
 	// on order of up to milliseconds of latency to get time
-        clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
-        current_realtime = realtime(&current_time_val);
-        sprintf(data, "Thread 1 start %llu @ sec=%6.9lf on core %d\n", S1Cnt, current_realtime - start_realtime, sched_getcpu());
-        syslogPrint(data, SYSLOG_DATA);
+        clock_gettime(MY_CLOCK_TYPE, &current_time_val);
+        syslogRelease(&serviceLog[0], S1Cnt, &current_time_val);
+#ifdef SYNTHETIC_LOAD
+        busy_work_usec(SVC_LOAD_USEC(0));
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[0]);
+#endif
+#ifdef DEADLINE_MONITOR
+        dm_done(&deadMon[0], S1Cnt);
+#endif
     }
 
     // Resource shutdown here
     //
+    rtstop_exit(&stop, 0);
     pthread_exit((void *)0);
 }
 
@@ -571,7 +973,6 @@ void *Service_2(void *threadp)
     double current_realtime;
     unsigned long long S2Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
-    char data[MAX_STRING_LEN];
 
     // Start up processing and resource initialization
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
@@ -579,19 +980,35 @@ void *Service_2(void *threadp)
     //syslog(LOG_CRIT, "S2 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S2 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS2) // check for synchronous abort request
+    while(!rtstop_stopped(&stop)) // check for synchronous abort request
     {
         // wait for service request from the sequencer, a signal handler or ISR in kernel
         sem_wait(&semS2);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
+
         S2Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[1], S2Cnt);
+#endif
+#ifdef DEADLINE_MONITOR
+        dm_wake(&deadMon[1], S2Cnt);
+#endif
 
         // on order of up to milliseconds of latency to get time
-        clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
-        current_realtime = realtime(&current_time_val);
-        sprintf(data, "Thread 2 start %llu @ sec=%6.9lf on core %d\n", S2Cnt, current_realtime - start_realtime, sched_getcpu());
-        syslogPrint(data, SYSLOG_DATA);    
+        clock_gettime(MY_CLOCK_TYPE, &current_time_val);
+        syslogRelease(&serviceLog[1], S2Cnt, &current_time_val);
+#ifdef SYNTHETIC_LOAD
+        busy_work_usec(SVC_LOAD_USEC(1));
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[1]);
+#endif
+#ifdef DEADLINE_MONITOR
+        dm_done(&deadMon[1], S2Cnt);
+#endif
     }
     // Resource shutdown here
+    rtstop_exit(&stop, 1);
     pthread_exit((void *)0);
 }
 
@@ -609,7 +1026,6 @@ void *Service_3(void *threadp)
     double current_realtime;
     unsigned long long S3Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
-    char data[MAX_STRING_LEN];
 
     // Start up processing and resource initialization
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
@@ -617,19 +1033,35 @@ void *Service_3(void *threadp)
     //syslog(LOG_CRIT, "S3 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S3 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS3) // check for synchronous abort request
+    while(!rtstop_stopped(&stop)) // check for synchronous abort request
     {
         // wait for service request from the sequencer, a signal handler or ISR in kernel
         sem_wait(&semS3);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
+
         S3Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[2], S3Cnt);
+#endif
+#ifdef DEADLINE_MONITOR
+        dm_wake(&deadMon[2], S3Cnt);
+#endif
 
         // on order of up to milliseconds of latency to get time
-        clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
-        current_realtime = realtime(&current_time_val);
-        sprintf(data, "Thread 3 start %llu @ sec=%6.9lf on core %d\n", S3Cnt, current_realtime - start_realtime, sched_getcpu());
-        syslogPrint(data, SYSLOG_DATA);    
+        clock_gettime(MY_CLOCK_TYPE, &current_time_val);
+        syslogRelease(&serviceLog[2], S3Cnt, &current_time_val);
+#ifdef SYNTHETIC_LOAD
+        busy_work_usec(SVC_LOAD_USEC(2));
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[2]);
+#endif
+#ifdef DEADLINE_MONITOR
+        dm_done(&deadMon[2], S3Cnt);
+#endif
     }
     // Resource shutdown here
+    rtstop_exit(&stop, 2);
     pthread_exit((void *)0);
 }
 
@@ -647,7 +1079,6 @@ void *Service_4(void *threadp)
     double current_realtime;
     unsigned long long S4Cnt=0;
     threadParams_t *threadParams = (threadParams_t *)threadp;
-    char data[MAX_STRING_LEN];
 
     // Start up processing and resource initialization
     clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
@@ -655,19 +1086,35 @@ void *Service_4(void *threadp)
     //syslog(LOG_CRIT, "S3 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
     printf("S4 thread @ sec=%6.9lf\n", current_realtime-start_realtime);
 
-    while(!abortS4) // check for synchronous abort request
+    while(!rtstop_stopped(&stop)) // check for synchronous abort request
     {
         // wait for service request from the sequencer, a signal handler or ISR in kernel
         sem_wait(&semS4);
+        if(rtstop_stopped(&stop)) break; // the stop wakeup, not a release
+
         S4Cnt++;
+#ifdef SERVICE_STATS
+        svc_stats_wake(&svcStats[3], S4Cnt);
+#endif
+#ifdef DEADLINE_MONITOR
+        dm_wake(&deadMon[3], S4Cnt);
+#endif
 
         // on order of up to milliseconds of latency to get time
-        clock_gettime(MY_CLOCK_TYPE, &current_time_val); current_realtime=realtime(&current_time_val);
-        current_realtime = realtime(&current_time_val);
-        sprintf(data, "Thread 4 start %llu @ sec=%6.9lf on core %d\n", S4Cnt, current_realtime - start_realtime, sched_getcpu());
-        syslogPrint(data, SYSLOG_DATA);    
+        clock_gettime(MY_CLOCK_TYPE, &current_time_val);
+        syslogRelease(&serviceLog[3], S4Cnt, &current_time_val);
+#ifdef SYNTHETIC_LOAD
+        busy_work_usec(SVC_LOAD_USEC(3));
+#endif
+#ifdef SERVICE_STATS
+        svc_stats_done(&svcStats[3]);
+#endif
+#ifdef DEADLINE_MONITOR
+        dm_done(&deadMon[3], S4Cnt);
+#endif
     }
     // Resource shutdown here
+    rtstop_exit(&stop, 3);
     pthread_exit((void *)0);
 }
 
@@ -0,0 +1,189 @@
+// Online per-service deadline monitoring, see deadmon.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <syslog.h>
+
+#include "deadmon.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+
+// same clock as the sequencers' MY_CLOCK_TYPE
+#define DM_CLOCK CLOCK_MONOTONIC_RAW
+
+static const char *policy_names[] = {"none", "skip", "degrade", "abort"};
+
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(DM_CLOCK, &ts);
+    return (long long)ts.tv_sec*NANOSEC_PER_SEC + ts.tv_nsec;
+}
+
+
+// policy for this event, latching degrade and abort for the other side
+static int dm_action(dm_monitor_t *m, int event)
+{
+    int action=(m->hook) ? m->hook(m, event) : m->policy;
+
+    if(action == DM_DEGRADE) __atomic_store_n(&m->degrade, 1, __ATOMIC_RELAXED);
+    if(action == DM_ABORT) __atomic_store_n(&m->abort, 1, __ATOMIC_RELAXED);
+
+    return action;
+}
+
+
+void dm_init(dm_monitor_t *m, const char *name, long long deadline_ns, int policy)
+{
+    memset(m, 0, sizeof(dm_monitor_t));
+    m->name=name;
+    m->deadline_ns=deadline_ns;
+    m->policy=policy;
+}
+
+
+void dm_set_hook(dm_monitor_t *m, dm_hook_t hook)
+{
+    m->hook=hook;
+}
+
+
+int dm_release(dm_monitor_t *m)
+{
+    unsigned long long posts=m->posts;
+
+    __atomic_store_n(&m->releases, m->releases+1, __ATOMIC_RELAXED);
+
+    // done is the count of the last release completed, in release order
+    if(__atomic_load_n(&m->done, __ATOMIC_ACQUIRE) < posts)
+    {
+        __atomic_store_n(&m->overruns, m->overruns+1, __ATOMIC_RELAXED);
+
+        if(dm_action(m, DM_OVERRUN) == DM_SKIP)
+        {
+            __atomic_store_n(&m->skips, m->skips+1, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+
+    // stamp before the count goes up, the service only reads stamps of
+    // releases it has been posted
+    m->post_ns[posts % DM_RING]=now_ns();
+    __atomic_store_n(&m->posts, posts+1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+
+void dm_wake(dm_monitor_t *m, unsigned long long release)
+{
+    // the final shutdown sem_post is not a release
+    m->valid = (release >= 1 && release <= __atomic_load_n(&m->posts, __ATOMIC_ACQUIRE));
+    if(m->valid) m->start_ns=now_ns();
+}
+
+
+void dm_done(dm_monitor_t *m, unsigned long long release)
+{
+    unsigned long long posts;
+    long long now, exec, resp=0;
+    int late;
+
+    if(!m->valid) return;
+
+    now=now_ns();
+    exec=now - m->start_ns;
+    if(exec > m->max_exec_ns) __atomic_store_n(&m->max_exec_ns, exec, __ATOMIC_RELAXED);
+
+    posts=__atomic_load_n(&m->posts, __ATOMIC_ACQUIRE);
+
+    // a post time more than a ring old may already be overwritten
+    if(posts - release < DM_RING)
+    {
+        resp=now - m->post_ns[(release-1) % DM_RING];
+        late=(resp > m->deadline_ns);
+        if(resp > m->max_resp_ns) __atomic_store_n(&m->max_resp_ns, resp, __ATOMIC_RELAXED);
+    }
+    else
+        late=1;
+
+    __atomic_store_n(&m->done, release, __ATOMIC_RELEASE);
+
+    if(late)
+    {
+        __atomic_store_n(&m->misses, m->misses+1, __ATOMIC_RELAXED);
+        dm_action(m, DM_MISS);
+    }
+    else if(release == posts && __atomic_load_n(&m->degrade, __ATOMIC_RELAXED))
+    {
+        // caught up, back to full work
+        __atomic_store_n(&m->degrade, 0, __ATOMIC_RELAXED);
+    }
+}
+
+
+int dm_degraded(const dm_monitor_t *m)
+{
+    return __atomic_load_n(&m->degrade, __ATOMIC_RELAXED);
+}
+
+
+int dm_abort_requested(const dm_monitor_t *m, int n)
+{
+    int i;
+
+    for(i=0; i<n; i++)
+        if(__atomic_load_n(&m[i].abort, __ATOMIC_RELAXED)) return 1;
+
+    return 0;
+}
+
+
+void dm_snapshot(const dm_monitor_t *m, dm_counts_t *c)
+{
+    c->releases=__atomic_load_n(&m->releases, __ATOMIC_RELAXED);
+    c->posts=__atomic_load_n(&m->posts, __ATOMIC_RELAXED);
+    c->skips=__atomic_load_n(&m->skips, __ATOMIC_RELAXED);
+    c->overruns=__atomic_load_n(&m->overruns, __ATOMIC_RELAXED);
+    c->done=__atomic_load_n(&m->done, __ATOMIC_RELAXED);
+    c->misses=__atomic_load_n(&m->misses, __ATOMIC_RELAXED);
+    c->max_exec_ns=__atomic_load_n(&m->max_exec_ns, __ATOMIC_RELAXED);
+    c->max_resp_ns=__atomic_load_n(&m->max_resp_ns, __ATOMIC_RELAXED);
+    c->degrade=__atomic_load_n(&m->degrade, __ATOMIC_RELAXED);
+    c->abort=__atomic_load_n(&m->abort, __ATOMIC_RELAXED);
+}
+
+
+const char *dm_policy_name(int policy)
+{
+    return (policy >= DM_NONE && policy <= DM_ABORT) ? policy_names[policy] : "hook";
+}
+
+
+void dm_report(const dm_monitor_t *m, int n)
+{
+    dm_counts_t c;
+    int i;
+
+    printf("\n%-10s %8s %8s %8s %8s %8s %8s %10s %10s %8s\n", "service", "deadline", "releases",
+           "skipped", "done", "overrun", "missed", "WCET", "resp max", "policy");
+    printf("%-10s %8s %8s %8s %8s %8s %8s %10s %10s %8s\n", "", "msec", "", "", "", "", "", "usec", "usec", "");
+
+    for(i=0; i<n; i++)
+    {
+        dm_snapshot(&m[i], &c);
+
+        printf("%-10s %8.1lf %8llu %8llu %8llu %8llu %8llu %10.1lf %10.1lf %8s\n", m[i].name,
+               m[i].deadline_ns/1000000.0, c.releases, c.skips, c.done, c.overruns, c.misses,
+               c.max_exec_ns/1000.0, c.max_resp_ns/1000.0,
+               m[i].hook ? "hook" : dm_policy_name(m[i].policy));
+
+        syslog(LOG_CRIT, "%s deadline %lld releases %llu skipped %llu done %llu overruns %llu misses %llu WCET %lld response max %lld nsec\n",
+               m[i].name, m[i].deadline_ns, c.releases, c.skips, c.done, c.overruns, c.misses,
+               c.max_exec_ns, c.max_resp_ns);
+    }
+}
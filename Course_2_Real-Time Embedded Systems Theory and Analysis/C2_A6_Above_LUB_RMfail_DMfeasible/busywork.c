@@ -0,0 +1,133 @@
+// Calibrated synthetic load, see busywork.h
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <time.h>
+#include <syslog.h>
+
+#include "busywork.h"
+
+#define NANOSEC_PER_SEC (1000000000)
+
+// calibration run, best of BUSY_CAL_RUNS windows of BUSY_CAL_USEC
+#define BUSY_CAL_RUNS (5)
+#define BUSY_CAL_USEC (10000)
+
+// shared by all services, updated by whichever one sees drift; a torn or
+// stale value only changes the size of one chunk
+static volatile double iters_per_usec=0.0;
+static volatile unsigned long recalibrations=0;
+
+// keeps the compiler from removing the loop
+static volatile unsigned int busy_sink;
+
+
+static long long ts_nsec(const struct timespec *ts)
+{
+    return (long long)ts->tv_sec*NANOSEC_PER_SEC + ts->tv_nsec;
+}
+
+
+static void spin(unsigned long iters)
+{
+    unsigned int x=busy_sink;
+    unsigned long i;
+
+    for(i=0; i<iters; i++)
+        x=x*1103515245u + 12345u;
+
+    busy_sink=x;
+}
+
+
+double busy_calibrate(void)
+{
+    struct timespec t0, t1;
+    unsigned long iters=1000;
+    double best=0.0, rate;
+    long long ns;
+    int run;
+
+    // grow the loop until one pass takes a measurable window
+    do
+    {
+        iters*=2;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &t0);
+        spin(iters);
+        clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+        ns=ts_nsec(&t1)-ts_nsec(&t0);
+    } while(ns < BUSY_CAL_USEC*1000LL/4);
+
+    iters=(unsigned long)((double)iters*BUSY_CAL_USEC*1000.0/ns);
+
+    // fastest window is the one least disturbed by interrupts
+    for(run=0; run<BUSY_CAL_RUNS; run++)
+    {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &t0);
+        spin(iters);
+        clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+
+        rate=(double)iters*1000.0/(ts_nsec(&t1)-ts_nsec(&t0));
+        if(rate > best) best=rate;
+    }
+
+    iters_per_usec=best;
+    return best;
+}
+
+
+void busy_work_usec(long usec)
+{
+    struct timespec cpu0, cpu1, raw0, raw1, start;
+    long long target=usec*1000LL, cpu_ns, raw_ns;
+    unsigned long chunk;
+    double rate, cal;
+
+    if(iters_per_usec <= 0.0) busy_calibrate();
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    cpu0=start;
+
+    while(ts_nsec(&cpu0)-ts_nsec(&start) < target)
+    {
+        cal=iters_per_usec;
+        chunk=(unsigned long)(cal*BUSY_CHUNK_USEC);
+
+        // last chunk only as long as what is left
+        if(target-(ts_nsec(&cpu0)-ts_nsec(&start)) < BUSY_CHUNK_USEC*1000LL)
+            chunk=(unsigned long)(cal*(target-(ts_nsec(&cpu0)-ts_nsec(&start)))/1000.0);
+
+        if(chunk == 0) chunk=1;
+
+        clock_gettime(CLOCK_MONOTONIC_RAW, &raw0);
+        spin(chunk);
+        clock_gettime(CLOCK_MONOTONIC_RAW, &raw1);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu1);
+
+        cpu_ns=ts_nsec(&cpu1)-ts_nsec(&cpu0);
+        raw_ns=ts_nsec(&raw1)-ts_nsec(&raw0);
+
+        // a chunk that was not preempted is a fresh calibration sample
+        if(raw_ns > 0 && cpu_ns >= raw_ns - raw_ns/20 && chunk >= (unsigned long)(cal*BUSY_CHUNK_USEC))
+        {
+            rate=(double)chunk*1000.0/raw_ns;
+
+            // move a quarter of the way, one interrupt in a chunk should
+            // not swing the chunk size
+            if(rate > cal*(100+BUSY_DRIFT_PCT)/100.0 || rate < cal*(100-BUSY_DRIFT_PCT)/100.0)
+            {
+                iters_per_usec=(3.0*cal + rate)/4.0;
+                recalibrations++;
+            }
+        }
+
+        cpu0=cpu1;
+    }
+}
+
+
+void busy_report(void)
+{
+    printf("busy work: %.1lf iterations/usec, %lu recalibrations\n", iters_per_usec, recalibrations);
+    syslog(LOG_CRIT, "busy work: %.1lf iterations/usec, %lu recalibrations\n", iters_per_usec, recalibrations);
+}
@@ -0,0 +1,292 @@
+// AMP core map shared by the Course 1 examples, see coremap.h
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <math.h>
+#include <sched.h>
+#include <sys/sysinfo.h>
+
+#include "coremap.h"
+
+#define COREMAP_LINE_LEN (256)
+
+
+// kernel cpulist "0-2,5" into set, returns 0 or -1
+static int parse_cpulist(const char *list, cpu_set_t *set)
+{
+    char *end;
+    long lo, hi, c;
+
+    CPU_ZERO(set);
+
+    while(*list && *list != '\n')
+    {
+        lo=strtol(list, &end, 10);
+        if(end == list || lo < 0) return -1;
+
+        hi=lo;
+        if(*end == '-')
+        {
+            list=end+1;
+            hi=strtol(list, &end, 10);
+            if(end == list || hi < lo) return -1;
+        }
+
+        for(c=lo; c<=hi && c<COREMAP_MAX_CORES; c++)
+            CPU_SET(c, set);
+
+        list=end;
+        if(*list == ',') list++;
+        else if(*list && *list != '\n') return -1;
+    }
+
+    return 0;
+}
+
+
+// cpulist from a sysfs file, empty if it is missing
+static void read_cpulist(const char *path, cpu_set_t *set)
+{
+    char line[COREMAP_LINE_LEN];
+    FILE *fp;
+
+    CPU_ZERO(set);
+
+    if((fp=fopen(path, "r")) == NULL) return;
+
+    if(fgets(line, sizeof(line), fp) && parse_cpulist(line, set) != 0)
+        CPU_ZERO(set);
+
+    fclose(fp);
+}
+
+
+// 1 if an irqbalance process is running, 0 if not, -1 if /proc is unreadable
+static int irqbalance_running(void)
+{
+    char path[sizeof(((struct dirent *)0)->d_name) + 16], comm[COREMAP_LINE_LEN];
+    struct dirent *de;
+    DIR *dp;
+    FILE *fp;
+    int found=0;
+
+    if((dp=opendir("/proc")) == NULL) return -1;
+
+    while(!found && (de=readdir(dp)) != NULL)
+    {
+        if(!isdigit((unsigned char)de->d_name[0])) continue;
+
+        snprintf(path, sizeof(path), "/proc/%s/comm", de->d_name);
+        if((fp=fopen(path, "r")) == NULL) continue;
+
+        if(fgets(comm, sizeof(comm), fp) && strncmp(comm, "irqbalance", 10) == 0)
+            found=1;
+
+        fclose(fp);
+    }
+
+    closedir(dp);
+    return found;
+}
+
+
+int coremap_online(int core)
+{
+    int n=get_nprocs();
+
+    if(core >= 0 && core < n) return core;
+
+    printf("core %d is not online, using core %d of %d\n", core, n-1, n);
+    return n-1;
+}
+
+
+void coremap_init(coremap_t *cm)
+{
+    int i;
+
+    memset(cm, 0, sizeof(coremap_t));
+    cm->ncores=get_nprocs();
+    if(cm->ncores > COREMAP_MAX_CORES) cm->ncores=COREMAP_MAX_CORES;
+
+    if(cm->ncores >= 4)
+    {
+        cm->seq_core=1;
+        for(i=2; i<cm->ncores; i++)
+            cm->svc_cores[cm->nsvc++]=i;
+    }
+    else
+    {
+        cm->seq_core=cm->ncores-1;
+        cm->svc_cores[cm->nsvc++]=cm->ncores-1;
+    }
+
+    read_cpulist("/sys/devices/system/cpu/isolated", &cm->isolated);
+    read_cpulist("/sys/devices/system/cpu/nohz_full", &cm->nohz_full);
+    cm->irqbalance=irqbalance_running();
+}
+
+
+int coremap_parse(coremap_t *cm, const char *spec)
+{
+    char buf[COREMAP_LINE_LEN], *item, *save, *val;
+    cpu_set_t set;
+    int c, n;
+
+    if(spec == NULL || *spec == '\0')
+        spec=getenv(COREMAP_ENV);
+    if(spec == NULL || *spec == '\0')
+        return 0;
+
+    strncpy(buf, spec, sizeof(buf)-1);
+    buf[sizeof(buf)-1]='\0';
+
+    // a comma starts a new item only if name= follows, so svc= can itself
+    // hold a "2-3,6" list
+    for(val=buf; (val=strchr(val, ',')) != NULL; val++)
+    {
+        for(c=1; val[c] && val[c] != ',' && val[c] != '='; c++);
+        if(val[c] == '=') *val=';';
+    }
+
+    for(item=strtok_r(buf, ";", &save); item; item=strtok_r((char *)0, ";", &save))
+    {
+        if((val=strchr(item, '=')) == NULL)
+        {
+            printf("core map item \"%s\" is not name=cpulist\n", item);
+            return -1;
+        }
+        *val++='\0';
+
+        if(parse_cpulist(val, &set) != 0 || CPU_COUNT(&set) == 0)
+        {
+            printf("core map %s=\"%s\" is not a cpulist\n", item, val);
+            return -1;
+        }
+
+        if(strcmp(item, "seq") == 0)
+        {
+            for(c=0; !CPU_ISSET(c, &set); c++);
+            cm->seq_core=(c < cm->ncores) ? c : coremap_online(c);
+        }
+        else if(strcmp(item, "svc") == 0)
+        {
+            n=0;
+            for(c=0; c<COREMAP_MAX_CORES; c++)
+            {
+                if(!CPU_ISSET(c, &set)) continue;
+
+                if(c < cm->ncores) cm->svc_cores[n++]=c;
+                else printf("core map svc core %d is not online, dropped\n", c);
+            }
+
+            if(n == 0) cm->svc_cores[n++]=cm->ncores-1;
+            cm->nsvc=n;
+        }
+        else
+        {
+            printf("core map item \"%s\" unknown, expected seq or svc\n", item);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+void coremap_check(const coremap_t *cm)
+{
+    int i, c, shared=0;
+
+    printf("Core map: %d online, sequencer on core %d, services on", cm->ncores, cm->seq_core);
+    for(i=0; i<cm->nsvc; i++)
+        printf(" %d", cm->svc_cores[i]);
+    printf("\n");
+
+    for(i=0; i<cm->nsvc; i++)
+    {
+        c=cm->svc_cores[i];
+
+        if(c == cm->seq_core) shared=1;
+
+        if(!CPU_ISSET(c, &cm->isolated))
+            printf("  core %d is not in isolcpus=, the kernel may schedule other work on it\n", c);
+        if(!CPU_ISSET(c, &cm->nohz_full))
+            printf("  core %d is not in nohz_full=, it keeps the scheduler tick\n", c);
+    }
+
+    if(shared)
+        printf("  sequencer shares core %d with services\n", cm->seq_core);
+
+    if(cm->irqbalance == 1)
+        printf("  irqbalance is running and may move IRQ handlers onto service cores,\n"
+               "  stop it or set IRQBALANCE_BANNED_CPUS\n");
+    else if(cm->irqbalance < 0)
+        printf("  could not tell whether irqbalance is running\n");
+}
+
+
+int coremap_pack(const coremap_t *cm, const double *util, int n, int *core)
+{
+    double load[COREMAP_MAX_CORES];
+    int count[COREMAP_MAX_CORES];
+    int *order;
+    int i, j, k, t, best, overflow=0;
+
+    if((order=(int *)malloc(n*sizeof(int))) == NULL)
+    {
+        printf("coremap_pack: no memory for %d services\n", n);
+        for(i=0; i<n; i++) core[i]=cm->svc_cores[0];
+        return n;
+    }
+
+    for(k=0; k<cm->nsvc; k++) { load[k]=0.0; count[k]=0; }
+    for(i=0; i<n; i++) order[i]=i;
+
+    // decreasing utilization, insertion sort as n is a table of services
+    for(i=1; i<n; i++)
+    {
+        t=order[i];
+        for(j=i; j>0 && util[order[j-1]] < util[t]; j--)
+            order[j]=order[j-1];
+        order[j]=t;
+    }
+
+    for(i=0; i<n; i++)
+    {
+        t=order[i];
+
+        // first core that stays within its RM bound m(2^(1/m)-1)
+        for(k=0; k<cm->nsvc; k++)
+        {
+            j=count[k]+1;
+            if(load[k] + util[t] <= j*(pow(2.0, 1.0/j) - 1.0))
+                break;
+        }
+
+        if(k == cm->nsvc)
+        {
+            best=0;
+            for(k=1; k<cm->nsvc; k++)
+                if(load[k] < load[best]) best=k;
+            k=best;
+            overflow++;
+        }
+
+        core[t]=cm->svc_cores[k];
+        load[k]+=util[t];
+        count[k]++;
+    }
+
+    for(k=0; k<cm->nsvc; k++)
+        printf("  core %d: %d services, U=%.3lf\n", cm->svc_cores[k], count[k], load[k]);
+
+    free(order);
+    return overflow;
+}
@@ -0,0 +1,147 @@
+// One stop word for a sequencer and its services, see rtstop.h
+//
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "rtstop.h"
+
+
+static long futex(volatile unsigned int *uaddr, int op, unsigned int val)
+{
+    return syscall(SYS_futex, uaddr, op, val, (void *)0, (void *)0, 0);
+}
+
+
+static long long clock_ns(clockid_t clock)
+{
+    struct timespec t;
+
+    clock_gettime(clock, &t);
+    return (long long)t.tv_sec*1000000000LL + t.tv_nsec;
+}
+
+
+void rtstop_init(rtstop_t *s, clockid_t clock)
+{
+    memset(s, 0, sizeof(rtstop_t));
+    s->clock=clock;
+    s->state=RTSTOP_RUN;
+}
+
+
+int rtstop_add(rtstop_t *s, sem_t *sem, const char *name)
+{
+    int idx=s->nservices;
+
+    if(idx == RTSTOP_MAX_SERVICES)
+    {
+        printf("rtstop_add: more than %d services, %s is not stopped\n", RTSTOP_MAX_SERVICES, name ? name : "one");
+        return -1;
+    }
+
+    s->sem[idx]=sem;
+    s->exit_ns[idx]=-1;
+    if(name != NULL)
+        snprintf(s->name[idx], RTSTOP_NAME_LEN, "%s", name);
+    else
+        snprintf(s->name[idx], RTSTOP_NAME_LEN, "service %d", idx);
+
+    s->nservices++;
+    return idx;
+}
+
+
+int rtstop_request(rtstop_t *s, unsigned int why)
+{
+    unsigned int run=RTSTOP_RUN;
+    int i;
+
+    if(!__atomic_compare_exchange_n(&s->state, &run, RTSTOP_CLAIMED, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return 0;
+
+    s->stop_ns=clock_ns(s->clock);
+    __atomic_store_n(&s->state, why, __ATOMIC_RELEASE);
+
+    // the stop is visible before anything wakes to look for it.  The one
+    // FUTEX_WAKE reaches every rtstop_wait() caller, but a service sleeps
+    // in sem_wait on its own release semaphore, not on the stop word, so
+    // each one still takes a post of that semaphore
+    futex(&s->state, FUTEX_WAKE_PRIVATE, INT_MAX);
+    for(i=0; i<s->nservices; i++)
+        sem_post(s->sem[i]);
+
+    return 1;
+}
+
+
+unsigned int rtstop_wait(rtstop_t *s)
+{
+    unsigned int state;
+
+    // a request in RTSTOP_CLAIMED has not woken anyone yet, wait it out
+    while((state=__atomic_load_n(&s->state, __ATOMIC_ACQUIRE)) < RTSTOP_DONE)
+        futex(&s->state, FUTEX_WAIT_PRIVATE, state);
+
+    return state;
+}
+
+
+void rtstop_exit(rtstop_t *s, int idx)
+{
+    if(idx < 0 || idx >= s->nservices)
+        return;
+
+    // a service that leaves without a request, on an error, is not timed
+    if(rtstop_stopped(s))
+        s->exit_ns[idx]=clock_ns(s->clock) - s->stop_ns;
+}
+
+
+const char *rtstop_reason(unsigned int why)
+{
+    switch(why)
+    {
+        case RTSTOP_RUN: return "running";
+        case RTSTOP_CLAIMED: return "stopping";
+        case RTSTOP_DONE: return "done";
+        case RTSTOP_ABORT: return "abort";
+        default: return "unknown";
+    }
+}
+
+
+void rtstop_report(const rtstop_t *s)
+{
+    long long max_ns=-1;
+    int i, slowest=-1, timed=0;
+
+    if(s->nservices == 0)
+        return;
+
+    printf("%-24s %12s\n", "service", "exit usec");
+    for(i=0; i<s->nservices; i++)
+    {
+        if(s->exit_ns[i] < 0)
+        {
+            printf("%-24s %12s\n", s->name[i], "-");
+            continue;
+        }
+
+        printf("%-24s %12.1lf\n", s->name[i], s->exit_ns[i]/1000.0);
+        timed++;
+        if(s->exit_ns[i] > max_ns) { max_ns=s->exit_ns[i]; slowest=i; }
+    }
+
+    if(slowest >= 0)
+        printf("stop %s, %d of %d services out within %.1lf usec of the request, the last %s\n",
+               rtstop_reason(s->state), timed, s->nservices, max_ns/1000.0, s->name[slowest]);
+    else
+        printf("stop %s, no service timed\n", rtstop_reason(s->state));
+}
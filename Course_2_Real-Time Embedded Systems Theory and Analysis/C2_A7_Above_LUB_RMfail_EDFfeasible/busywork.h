@@ -0,0 +1,32 @@
+#ifndef _BUSYWORK_
+#define _BUSYWORK_
+
+// Calibrated synthetic load for service threads
+//
+// busy_calibrate() measures how many iterations of a fixed integer loop
+// run per microsecond.  busy_work_usec(c) then burns c usec of this
+// thread's own CPU time in chunks of about BUSY_CHUNK_USEC:
+//
+// - completion is decided by CLOCK_THREAD_CPUTIME_ID, so time spent
+//   preempted by a higher priority service does not count towards C, which
+//   is what the RM/DM/EDF analysis assumes
+// - each chunk that ran without being preempted (its CPU time matches its
+//   CLOCK_MONOTONIC_RAW time) re-checks the calibration, so a change in
+//   core frequency changes the chunk size, not the amount of work done
+//
+
+#define BUSY_CHUNK_USEC (50)
+
+// chunks more than this far off the calibration trigger a recalibration
+#define BUSY_DRIFT_PCT (5)
+
+// Measure iterations per usec on the calling thread's core, returns it
+double busy_calibrate(void);
+
+// Consume usec of CPU time on the calling thread
+void busy_work_usec(long usec);
+
+// Print the calibration and how often it had to be corrected
+void busy_report(void);
+
+#endif